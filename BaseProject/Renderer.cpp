@@ -9,61 +9,139 @@
 #include <glm/ext/matrix_transform.hpp> // glm::translate, glm::rotate, glm::scale
 #include <glm/ext/matrix_clip_space.hpp> // glm::perspective
 
-#define TINYOBJLOADER_IMPLEMENTATION // add this to exactly 1 of your C++ files
-#include "tiny_obj_loader.h"
+#include "mesh-loader.h"
+#include "thread-pool.h"
+#include "lod-selector.h"
+#include "meshlets.h"
+#include "number-scanner.h"
+#include "process-stats.h"
+#include "webgpu-utils.h"
+#include "profiler.h"
+#include "frame-encoder.h"
+#include "compact-vertex.h"
 
 #include <iostream>
+#include <cmath>
 #include <cassert>
 #include <vector>
 
 #include <fstream>
-#include <sstream>
 #include <string>
 #include <array>
+#include <chrono>
+#include <algorithm>
+#include <iterator>
+#include <cstring>
+#include <unordered_map>
 
 #ifdef __EMSCRIPTEN__
 #  include <emscripten.h>
 #endif // __EMSCRIPTEN__
 
-static mat4x4 T1S = mat4x4(1.0);
+// Room in the uniform ring for this many MyUniforms blocks per frame
+static const uint32_t MaxUniformBlocksPerFrame = 1024;
+
+static const TextureFormat DepthTextureFormat = TextureFormat::Depth24Plus;
+
+// Bytes of mesh data streamed to the GPU per frame while a mesh loads
+static const uint64_t UploadBudgetPerFrame = 8 * 1024 * 1024;
+
+// Size of the instance storage buffer
+static const uint32_t MaxInstances = 16384;
+
+// Instance bounds get a hierarchy from this many instances, below it
+// testing them all is as fast
+static const uint32_t MinHierarchyInstances = 1024;
+
+// Meshlets are only culled when this few instances draw the full mesh,
+// beyond that culling costs more than it saves
+static const uint32_t MaxCulledInstances = 16;
+
+// Occlusion culling draws this many of the nearest instances, with a mesh
+// of at most MaxOccluderTriangles, into a depth buffer of 1/OcclusionScale
+// of the view in both directions
+static const uint32_t MaxOccluderInstances = 16;
+static const size_t MaxOccluderTriangles = 512;
+static const uint32_t OcclusionScale = 4;
 
 static uint32_t ceilToNextMultiple(uint32_t value, uint32_t step) {
 	uint32_t divide_and_ceil = value / step + (value % step == 0 ? 0 : 1);
 	return step * divide_and_ceil;
 }
 
+// Save RGBA8 rows, bytesPerRow apart, as a binary PPM (alpha is dropped)
+static bool writePpm(const fs::path& path, const uint8_t* pixels, uint32_t width, uint32_t height, uint32_t bytesPerRow) {
+	std::ofstream file(path, std::ios::binary);
+	if (!file.is_open()) {
+		return false;
+	}
+	file << "P6\n" << width << " " << height << "\n255\n";
+	std::vector<uint8_t> row(size_t(width) * 3);
+	for (uint32_t y = 0; y < height; ++y) {
+		const uint8_t* src = pixels + size_t(y) * bytesPerRow;
+		for (uint32_t x = 0; x < width; ++x) {
+			row[3 * x + 0] = src[4 * x + 0];
+			row[3 * x + 1] = src[4 * x + 1];
+			row[3 * x + 2] = src[4 * x + 2];
+		}
+		file.write(reinterpret_cast<const char*>(row.data()), row.size());
+	}
+	return file.good();
+}
+
 
-Renderer::Renderer(): device(nullptr), queue(nullptr), surface(nullptr), pipeline(nullptr), 
-		pointBuffer(nullptr), indexBuffer(nullptr), colorBuffer(nullptr), normalBuffer(nullptr),  uniformBuffer(nullptr),
-		bindGroup(nullptr), depthTexture(nullptr), depthTextureView(nullptr), vertexData()
+Renderer::Renderer(): device(nullptr), queue(nullptr), surface(nullptr), 
+		colorBuffer(nullptr), normalBuffer(nullptr),
+		vertexCount(0), indexCount(0), indexFormat(IndexFormat::Uint16), bindGroup(nullptr)
 {
-	uniformStride = new uint32_t();
 };
 
 
-bool Renderer::Initialize() {
+bool Renderer::Initialize(const RendererOptions& rendererOptions) {
+	options = rendererOptions;
+	initializeStart = std::chrono::steady_clock::now();
+
 	// Open window
-	glfwInit();
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
-	window = glfwCreateWindow(640, 480, "Learn WebGPU", nullptr, nullptr);
+	if (!options.headless) {
+		glfwInit();
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_FALSE);
+		window = glfwCreateWindow(options.width, options.height, "Learn WebGPU", nullptr, nullptr);
+	}
 	
 	Instance instance = wgpuCreateInstance(nullptr);
 	
 	// Get adapter
 	std::cout << "Requesting adapter..." << std::endl;
-	surface = glfwGetWGPUSurface(instance, window);
+	if (!options.headless) {
+		surface = glfwGetWGPUSurface(instance, window);
+	}
 	RequestAdapterOptions adapterOpts = {};
 	adapterOpts.compatibleSurface = surface;
+	adapterOpts.forceFallbackAdapter = options.forceFallbackAdapter;
 	Adapter adapter = instance.requestAdapter(adapterOpts);
 	std::cout << "Got adapter: " << adapter << std::endl;
 	
 	instance.release();
+
+	if (!adapter) {
+		std::cout << "*** ERROR *** No WebGPU adapter available" << std::endl;
+		return false;
+	}
 	
 	std::cout << "Requesting device..." << std::endl;
 	DeviceDescriptor deviceDesc = {};
 	deviceDesc.label = "My Device";
 	deviceDesc.requiredFeatureCount = 0;
+	WGPUFeatureName timestampFeature = FeatureName::TimestampQuery;
+	bool useTimestamps = options.gpuTimestamps && adapter.hasFeature(FeatureName::TimestampQuery);
+	if (useTimestamps) {
+		deviceDesc.requiredFeatureCount = 1;
+		deviceDesc.requiredFeatures = &timestampFeature;
+	}
+	else if (options.gpuTimestamps) {
+		std::cout << "Timestamp queries are not supported by this adapter" << std::endl;
+	}
 	//deviceDesc.defaultQueue.nextInChain = nullptr;
 	deviceDesc.defaultQueue.label = "The default queue";
 	deviceDesc.deviceLostCallback = [](WGPUDeviceLostReason reason, char const* message, void* /* pUserData */) {
@@ -88,25 +166,64 @@ bool Renderer::Initialize() {
 	});
 	
 	queue = device.getQueue();
+	if (useTimestamps) {
+		gpuTimer = std::make_unique<GpuTimer>(device, "Render pass");
+	}
+	backend = std::make_unique<WebGpuBackend>(device, queue);
+	pipelineCache = std::make_unique<PipelineCache>(*backend);
+	// Mesh and material buffers are carved out of shared pages
+	SupportedLimits deviceLimits;
+	device.getLimits(&deviceLimits);
+	BufferAllocatorLimits allocatorLimits;
+	allocatorLimits.minUniformBufferOffsetAlignment = deviceLimits.limits.minUniformBufferOffsetAlignment;
+	allocatorLimits.minStorageBufferOffsetAlignment = deviceLimits.limits.minStorageBufferOffsetAlignment;
+	bufferAllocator = std::make_unique<BufferAllocator>(*backend, allocatorLimits);
+	uploader = std::make_unique<StreamingUploader>(device, queue);
+
+	if (options.headless) {
+		// No swap chain, frames are rendered into a texture that can be
+		// copied back to the CPU
+		surfaceFormat = TextureFormat::RGBA8Unorm;
+		TextureDescriptor offscreenDesc;
+		offscreenDesc.label = "Offscreen Frame";
+		offscreenDesc.dimension = TextureDimension::_2D;
+		offscreenDesc.format = surfaceFormat;
+		offscreenDesc.mipLevelCount = 1;
+		offscreenDesc.sampleCount = 1;
+		offscreenDesc.size = { options.width, options.height, 1 };
+		offscreenDesc.usage = TextureUsage::RenderAttachment | TextureUsage::CopySrc;
+		offscreenDesc.viewFormatCount = 0;
+		offscreenDesc.viewFormats = nullptr;
+		offscreenTexture = device.createTexture(offscreenDesc);
+	}
+	else {
+		// Configure the surface
+		SurfaceConfiguration config = {};
+		
+		// Configuration of the textures created for the underlying swap chain
+		config.width = options.width;
+		config.height = options.height;
+		config.usage = TextureUsage::RenderAttachment;
+		surfaceFormat = surface.getPreferredFormat(adapter);
+		config.format = surfaceFormat;
+
+		// And we do not need any particular view format:
+		config.viewFormatCount = 0;
+		config.viewFormats = nullptr;
+		config.device = device;
+		config.presentMode = PresentMode::Fifo;
+		config.alphaMode = CompositeAlphaMode::Auto;
+
+		surface.configure(config);
+	}
 
-	// Configure the surface
-	SurfaceConfiguration config = {};
-	
-	// Configuration of the textures created for the underlying swap chain
-	config.width = 640;
-	config.height = 480;
-	config.usage = TextureUsage::RenderAttachment;
-	surfaceFormat = surface.getPreferredFormat(adapter);
-	config.format = surfaceFormat;
-
-	// And we do not need any particular view format:
-	config.viewFormatCount = 0;
-	config.viewFormats = nullptr;
-	config.device = device;
-	config.presentMode = PresentMode::Fifo;
-	config.alphaMode = CompositeAlphaMode::Auto;
-
-	surface.configure(config);
+	if (options.renderBundles) {
+		renderBundles = std::make_unique<RenderBundles>(*backend, surfaceFormat, DepthTextureFormat);
+	}
+	if (options.occlusionCulling) {
+		occlusionCuller = std::make_unique<OcclusionCuller>(std::max(options.width / OcclusionScale, 1u),
+															std::max(options.height / OcclusionScale, 1u));
+	}
 
 	// Release the adapter only after it has been fully utilized
 	adapter.release();
@@ -119,148 +236,390 @@ bool Renderer::Initialize() {
 
 void Renderer::Terminate() {
 
-	pointBuffer.release();
-	indexBuffer.release();
+	// Wait for the loads still running before releasing anything
+	assetLoader.reset();
+	meshUpload.reset();
+	uploader.reset();
+
+	// Bundles reference the buffers and bind groups
+	renderBundles.reset();
+	occlusionCuller.reset();
+	ReleaseFrameGraphResources();
+	frameGraph.clear();
+
+	bufferAllocator->free(vertexAllocation);
+	bufferAllocator->free(indexAllocation);
+	for (BindGroup materialBindGroup : materialBindGroups) {
+		materialBindGroup.release();
+	}
+	materialBindGroups.clear();
+	bufferAllocator->free(materialAllocation);
+	bufferAllocator.reset();
 	colorBuffer.release();
-	uniformBuffer.release();
-
-	depthTextureView.release();
-	depthTexture.destroy();
-	depthTexture.release();
-
-	pipeline.release();
-	surface.unconfigure();
+	instances.reset();
+	uniformRing.reset();
+	// Pipelines still being created call back into the cache
+	while (pipelineCache->pendingCount() > 0) {
+		pollDevice(device, true);
+	}
+	shaderVariants.reset();
+	pipelineCache.reset();
+	backend.reset();
+	gpuTimer.reset();
+
+	if (options.headless) {
+		offscreenTexture.destroy();
+		offscreenTexture.release();
+	}
+	else {
+		surface.unconfigure();
+		surface.release();
+	}
 	queue.release();
-	surface.release();
 	device.release();
-	glfwDestroyWindow(window);
-	glfwTerminate();
+	if (window) {
+		glfwDestroyWindow(window);
+		glfwTerminate();
+	}
 }
 
 
 void Renderer::MainLoop() {
-	glfwPollEvents();
+	// Gather the zones of the previous frames, from every thread
+	if (Profiler::enabled()) {
+		Profiler::collect();
+	}
+	PROFILE_ZONE("MainLoop");
 
-	uniforms.time = static_cast<float>(glfwGetTime()); // glfwGetTime returns a double
-	queue.writeBuffer(uniformBuffer, offsetof(MyUniforms, time), &uniforms.time, sizeof(MyUniforms::time));
+	if (!options.headless) {
+		PROFILE_ZONE("glfwPollEvents");
+		glfwPollEvents();
+	}
+
+	ProcessLoadedAssets();
+	RenderPipeline pipeline = pipelineCache->renderPipeline(pipelineId);
+	bool meshResident = pipeline && meshHandle.state() == AssetState::Ready;
+
+	// Headless frames advance at a fixed 60 Hz so that renders are
+	// reproducible, from the first frame that draws the mesh
+	if (options.headless) {
+		uniforms.time = static_cast<float>(residentFrameIndex) / 60.0f;
+	}
+	else {
+		uniforms.time = static_cast<float>(glfwGetTime()); // glfwGetTime returns a double
+	}
 	
+	// The model turns, the mesh placed in it follows
 	float angle1 = uniforms.time * 0.25;
-	mat4x4 R1 = glm::rotate(mat4x4(1.0), angle1, glm::vec3(0.0, 0.0, 1.0));
-	uniforms.modelMatrix = R1 * T1S;
-	queue.writeBuffer(uniformBuffer, offsetof(MyUniforms, modelMatrix), &uniforms.modelMatrix, sizeof(MyUniforms::modelMatrix));
+	transforms.setLocal(modelTransform, glm::rotate(mat4x4(1.0), angle1, glm::vec3(0.0, 0.0, 1.0)));
+	{
+		PROFILE_ZONE("Transforms");
+		transforms.update();
+	}
+	uniforms.modelMatrix = transforms.world(meshTransform);
+	if (instanceTransformsDirty) {
+		for (uint32_t i = 0; i < instances->instanceCount(); ++i) {
+			if (transforms.changed(instanceTransforms[i])) {
+				instances->setModelMatrix(i, transforms.world(instanceTransforms[i]));
+			}
+		}
+		instanceTransformsDirty = false;
+		instanceBoundsDirty = true;
+	}
+
+	// Leave out the instances out of the view frustum, their bounds are in
+	// the space of uniforms.modelMatrix
+	mat4x4 modelView = uniforms.viewMatrix * uniforms.modelMatrix;
+	bool instancesCulled = false;
+	if (meshResident) {
+		if (instanceBoundsDirty) {
+			UpdateInstanceBounds();
+		}
+		PROFILE_ZONE("Frustum culling");
+		instanceBounds.cull(FrustumPlanes(uniforms.projectionMatrix * modelView), instanceVisibility);
+		instancesCulled = true;
+	}
+	if (instancesCulled && occlusionCuller && !occluderLods.empty()) {
+		PROFILE_ZONE("Occlusion culling");
+		CullOccludedInstances(modelView);
+	}
+
+	// Draw every other instance with the coarsest level whose error stays
+	// below a pixel on screen
+	{
+		PROFILE_ZONE("LOD selection");
+		float errorScale = lodErrorScale(uniforms.projectionMatrix, static_cast<float>(options.height));
+		for (uint32_t i = 0; i < instances->instanceCount(); ++i) {
+			if (instancesCulled && !instanceVisibility[i]) {
+				instances->hide(i);
+				continue;
+			}
+			uint32_t level = selectLod(selectionLods, uniforms.projectionMatrix, modelView * instances->instance(i).modelMatrix, meshBounds, errorScale);
+			instances->setLevel(i, level);
+		}
+	}
+
+	// Only draw the meshlets of the full mesh that one of its instances sees
+	const std::vector<IndexRange>* submeshFullDetailRanges = nullptr;
+	if (meshletCuller) {
+		PROFILE_ZONE("Meshlet culling");
+		meshletCuller->clear();
+		uint32_t fullDetailCount = 0;
+		for (uint32_t i = 0; i < instances->instanceCount() && fullDetailCount <= MaxCulledInstances; ++i) {
+			if (instances->level(i) != 0) {
+				continue;
+			}
+			++fullDetailCount;
+			mat4x4 instanceModelView = modelView * instances->instance(i).modelMatrix;
+			glm::vec3 camera = glm::vec3(glm::inverse(instanceModelView)[3]);
+			meshletCuller->cull(uniforms.projectionMatrix * instanceModelView, camera);
+		}
+		if (fullDetailCount <= MaxCulledInstances) {
+			meshletCuller->compact(submeshes, fullDetailRanges);
+			submeshFullDetailRanges = fullDetailRanges.data();
+		}
+	}
+
+	uint32_t dynamicOffset = uploadFrame(*uniformRing, *instances, uniforms);
 
 	// Loop: Get the next target texture view
+	ProfileZone acquireZone("GetNextSurfaceTextureView");
 	TextureView targetView = GetNextSurfaceTextureView();
+	acquireZone.end();
 	if (!targetView) return;
 
+	ProfileZone encodingZone("Encoding");
+
 	// Create a command encoder for the draw call
 	CommandEncoderDescriptor encoderDesc = {};
 	encoderDesc.label = "My command encoder";
 	CommandEncoder encoder = wgpuDeviceCreateCommandEncoder(device, &encoderDesc);
 
-	// Create the render pass that clears the screen with our color
-	RenderPassDescriptor renderPassDesc = {};
-
-	// The attachment part of the render pass descriptor describes the target texture of the pass
-	RenderPassColorAttachment renderPassColorAttachment = {};
-	renderPassColorAttachment.view = targetView;
-	renderPassColorAttachment.resolveTarget = nullptr;
-	renderPassColorAttachment.loadOp = LoadOp::Clear;
-	renderPassColorAttachment.storeOp = StoreOp::Store;
-	renderPassColorAttachment.clearValue = WGPUColor{ 0.2, 0.2, 0.2, 1.0 };
-
-	// Add depth/stencil attachment:
-	RenderPassDepthStencilAttachment depthStencilAttachment;
-	depthStencilAttachment.view = depthTextureView;	
-	depthStencilAttachment.depthClearValue = 1.0f; // The initial value of the depth buffer, meaning "far"	
-	depthStencilAttachment.depthLoadOp = LoadOp::Clear; // Operation settings comparable to the color attachment
-	depthStencilAttachment.depthStoreOp = StoreOp::Store;	
-	depthStencilAttachment.depthReadOnly = false; // we could turn off writing to the depth buffer globally here	
-	depthStencilAttachment.stencilClearValue = 0; // Stencil setup, mandatory but unused
-	depthStencilAttachment.stencilLoadOp = LoadOp::Undefined;
-	depthStencilAttachment.stencilStoreOp = StoreOp::Undefined;
-	depthStencilAttachment.stencilReadOnly = true;
-	
-	renderPassDesc.depthStencilAttachment = &depthStencilAttachment;
-
-#ifndef WEBGPU_BACKEND_WGPU
-	renderPassColorAttachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
-#endif // NOT WEBGPU_BACKEND_WGPU
-
-	renderPassDesc.colorAttachmentCount = 1;
-	renderPassDesc.colorAttachments = &renderPassColorAttachment;
-	
-	renderPassDesc.timestampWrites = nullptr;
-
-	RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
-
-	// Select which render pipeline to use
-	renderPass.setPipeline(pipeline);
-
-	// Set vertex buffer while encoding the render pass
-	//renderPass.setIndexBuffer(indexBuffer, IndexFormat::Uint16, 0, indexBuffer.getSize());
-	//renderPass.setVertexBuffer(0, pointBuffer, 0, pointBuffer.getSize());
-	//renderPass.setVertexBuffer(1, normalBuffer, 0, normalBuffer.getSize());
-	//renderPass.setVertexBuffer(2, colorBuffer, 0, colorBuffer.getSize());	
-	renderPass.setVertexBuffer(0, pointBuffer, 0, vertexData.size() * sizeof(VertexAttributes));
-
-	uint32_t dynamicOffset = 0;
-
-	// Set binding group
-	dynamicOffset =  0 * (*uniformStride);
-	renderPass.setBindGroup(0, bindGroup, 1, &dynamicOffset);
-	
-	//renderPass.drawIndexed(indexCount, 1, 0, 0, 0);
-	renderPass.draw(indexCount, 1, 0, 0);
-
-	// Set binding group with a different uniform offset
-	/*
-	dynamicOffset = 1 * (*uniformStride);
-	renderPass.setBindGroup(0, bindGroup, 1, &dynamicOffset);
-	renderPass.drawIndexed(indexCount, 1, 0, 0, 0);
-	*/
-
-	renderPass.end();
-	renderPass.release();
+	// Run the passes of the frame graph. Until the shader and the mesh are
+	// resident, the scene pass only clears.
+	framePipeline = meshResident ? pipeline : nullptr;
+	frameDynamicOffset = dynamicOffset;
+	frameFullDetailRanges = submeshFullDetailRanges;
+	ExecuteFrameGraph(encoder, targetView);
+	if (gpuTimer) {
+		gpuTimer->resolve(encoder);
+	}
 
 	// Finally encode and submit the render pass
 	CommandBufferDescriptor cmdBufferDescriptor = {};
 	cmdBufferDescriptor.label = "Command buffer";
 	CommandBuffer command = encoder.finish(cmdBufferDescriptor);
 	encoder.release();
+	encodingZone.end();
 
 	//std::cout << "Submitting command..." << std::endl;
+	ProfileZone submitZone("queue.submit");
 	queue.submit(1, &command);
 	command.release();
+	submitZone.end();
 	//std::cout << "Command submitted." << std::endl;
+	if (gpuTimer) {
+		gpuTimer->afterSubmit();
+	}
+
+	if (!firstFrameReported || (meshResident && !firstMeshFrameReported)) {
+		auto sinceStart = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - initializeStart);
+		std::cout << (firstFrameReported ? "First frame with the mesh" : "First frame") << " submitted "
+			<< sinceStart.count() << " ms after start (frame " << frameIndex << ")" << std::endl;
+		firstMeshFrameReported = meshResident;
+		firstFrameReported = true;
+	}
 
 	// At the end of the frame
 	targetView.release();
 #ifndef __EMSCRIPTEN__
-	surface.present();
+	if (!options.headless) {
+		PROFILE_ZONE("surface.present");
+		surface.present();
+	}
 #endif
 
-#if defined(WEBGPU_BACKEND_DAWN)
-	device.tick();
-#elif defined(WEBGPU_BACKEND_WGPU)
-	device.poll(false);
-#endif
+	// Headless frames wait for the GPU, so that the time spent in MainLoop
+	// is the full frame time
+	ProfileZone pollZone("Device poll");
+	pollDevice(device, options.headless);
+	pollZone.end();
+	++frameIndex;
+	if (meshResident) {
+		++residentFrameIndex;
+	}
 }
 
 
 bool Renderer::IsRunning() {
-	return !glfwWindowShouldClose(window);
+	// Without a window, the caller decides how many frames to render
+	return options.headless || !glfwWindowShouldClose(window);
+}
+
+
+void Renderer::ClearInstances() {
+	instances->clear();
+	// The instances were added after the model and mesh transforms
+	transforms.truncate(meshTransform + 1);
+	instanceTransforms.clear();
+	instanceBoundsDirty = true;
+}
+
+
+bool Renderer::AddInstance(const mat4x4& modelMatrix, const vec4& color, uint32_t parentInstance) {
+	if (!instances->add(modelMatrix, color)) {
+		return false;
+	}
+	TransformId parent = parentInstance == NoParentInstance ? InvalidTransform : instanceTransforms[parentInstance];
+	instanceTransforms.push_back(transforms.add(parent, modelMatrix));
+	instanceTransformsDirty = true;
+	instanceBoundsDirty = true;
+	return true;
+}
+
+
+void Renderer::SetInstanceTransform(uint32_t instance, const mat4x4& modelMatrix) {
+	transforms.setLocal(instanceTransforms[instance], modelMatrix);
+	instanceTransformsDirty = true;
+}
+
+
+void Renderer::UpdateInstanceBounds() {
+	PROFILE_ZONE("Instance bounds");
+	instanceBounds.clear();
+	instanceBoxMin.resize(instances->instanceCount());
+	instanceBoxMax.resize(instances->instanceCount());
+	for (uint32_t i = 0; i < instances->instanceCount(); ++i) {
+		glm::vec3 boxMin = meshBoxMin;
+		glm::vec3 boxMax = meshBoxMax;
+		glm::vec4 sphere = meshBounds;
+		transformBounds(instances->instance(i).modelMatrix, boxMin, boxMax, sphere);
+		instanceBounds.add(boxMin, boxMax, sphere);
+		instanceBoxMin[i] = boxMin;
+		instanceBoxMax[i] = boxMax;
+	}
+	if (instanceBounds.objectCount() >= MinHierarchyInstances) {
+		instanceBounds.buildHierarchy();
+	}
+	instanceBoundsDirty = false;
+}
+
+
+void Renderer::CullOccludedInstances(const mat4x4& modelView) {
+	// The visible instances nearest to the camera occlude the others
+	occluderOrder.clear();
+	for (uint32_t i = 0; i < instances->instanceCount(); ++i) {
+		if (instanceVisibility[i]) {
+			glm::vec3 center = 0.5f * (instanceBoxMin[i] + instanceBoxMax[i]);
+			occluderOrder.push_back({ glm::length(glm::vec3(modelView * glm::vec4(center, 1.0f))), i });
+		}
+	}
+	size_t occluderCount = std::min<size_t>(occluderOrder.size(), MaxOccluderInstances);
+	std::partial_sort(occluderOrder.begin(), occluderOrder.begin() + occluderCount, occluderOrder.end());
+
+	// Each with the coarsest level that stays within a texel of the full
+	// mesh in the depth buffer, or not at all when none does: coarser ones
+	// may hide instances that are actually visible
+	mat4x4 clipFromModel = uniforms.projectionMatrix * modelView;
+	float errorScale = lodErrorScale(uniforms.projectionMatrix, static_cast<float>(occlusionCuller->height()));
+	occlusionCuller->clear();
+	for (size_t k = 0; k < occluderCount; ++k) {
+		const mat4x4& modelMatrix = instances->instance(occluderOrder[k].second).modelMatrix;
+		uint32_t level = selectOccluderLod(occluderLods, uniforms.projectionMatrix, modelView * modelMatrix, meshBounds, errorScale);
+		if (level == NoOccluderLod) {
+			continue;
+		}
+		const MeshLod& lod = occluderLods[level];
+		occlusionCuller->addOccluder(clipFromModel * modelMatrix, occluderPositions.data(),
+									occluderIndices.data() + lod.firstIndex, lod.indexCount);
+	}
+	occlusionCuller->render(&ThreadPool::shared());
+	occlusionCuller->cull(clipFromModel, instanceBoxMin.data(), instanceBoxMax.data(), instances->instanceCount(),
+						instanceVisibility.data(), &ThreadPool::shared());
+}
+
+
+bool Renderer::CaptureFrame(const fs::path& path) {
+	if (!options.headless) {
+		std::cout << "*** ERROR *** Frames can only be captured in headless mode" << std::endl;
+		return false;
+	}
+
+	// Rows of a texture to buffer copy must be 256-byte aligned
+	uint32_t bytesPerRow = ceilToNextMultiple(options.width * 4, 256);
+	BufferDescriptor bufferDesc;
+	bufferDesc.label = "Frame Readback";
+	bufferDesc.size = uint64_t(bytesPerRow) * options.height;
+	bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::MapRead;
+	bufferDesc.mappedAtCreation = false;
+	Buffer readbackBuffer = device.createBuffer(bufferDesc);
+
+	CommandEncoderDescriptor encoderDesc = {};
+	encoderDesc.label = "Frame capture encoder";
+	CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+
+	ImageCopyTexture source = Default;
+	source.texture = offscreenTexture;
+	source.mipLevel = 0;
+	source.origin = { 0, 0, 0 };
+	source.aspect = TextureAspect::All;
+
+	ImageCopyBuffer destination = Default;
+	destination.buffer = readbackBuffer;
+	destination.layout.offset = 0;
+	destination.layout.bytesPerRow = bytesPerRow;
+	destination.layout.rowsPerImage = options.height;
+
+	Extent3D copySize;
+	copySize.width = options.width;
+	copySize.height = options.height;
+	copySize.depthOrArrayLayers = 1;
+	encoder.copyTextureToBuffer(source, destination, copySize);
+
+	CommandBufferDescriptor cmdBufferDescriptor = {};
+	cmdBufferDescriptor.label = "Frame capture";
+	CommandBuffer command = encoder.finish(cmdBufferDescriptor);
+	encoder.release();
+	queue.submit(1, &command);
+	command.release();
+
+	// Wait for the copy to land in the readback buffer
+	bool mapped = false;
+	bool success = false;
+	auto mapCallback = readbackBuffer.mapAsync(MapMode::Read, 0, bufferDesc.size, [&](BufferMapAsyncStatus status) {
+		mapped = true;
+		success = status == BufferMapAsyncStatus::Success;
+	});
+	while (!mapped) {
+		pollDevice(device, true);
+	}
+
+	if (success) {
+		const uint8_t* pixels = static_cast<const uint8_t*>(readbackBuffer.getConstMappedRange(0, bufferDesc.size));
+		success = writePpm(path, pixels, options.width, options.height, bytesPerRow);
+		readbackBuffer.unmap();
+	}
+	if (!success) {
+		std::cout << "*** ERROR *** Could not capture frame to " << path << std::endl;
+	}
+
+	readbackBuffer.destroy();
+	readbackBuffer.release();
+	return success;
 }
 
 
 TextureView Renderer::GetNextSurfaceTextureView() {
-	// Get the surface texture
-	SurfaceTexture surfaceTexture;
-	surface.getCurrentTexture(&surfaceTexture);
-	if (surfaceTexture.status != SurfaceGetCurrentTextureStatus::Success) {
-		return nullptr;
+	Texture texture = offscreenTexture;
+	if (!options.headless) {
+		// Get the surface texture
+		SurfaceTexture surfaceTexture;
+		surface.getCurrentTexture(&surfaceTexture);
+		if (surfaceTexture.status != SurfaceGetCurrentTextureStatus::Success) {
+			return nullptr;
+		}
+		texture = surfaceTexture.texture;
 	}
-	Texture texture = surfaceTexture.texture;
 
 	// Create a view for this surface texture
 	TextureViewDescriptor viewDescriptor;
@@ -278,12 +637,291 @@ TextureView Renderer::GetNextSurfaceTextureView() {
 }
 
 
+void Renderer::InitializeFrameGraph() {
+	// The scene is drawn straight into the surface texture, with a depth
+	// buffer the graph allocates
+	frameGraph.clear();
+	frameTarget = frameGraph.importTexture("Surface");
+	GraphTextureDesc depthDesc;
+	depthDesc.width = options.width;
+	depthDesc.height = options.height;
+	depthDesc.format = DepthTextureFormat;
+	depthDesc.usage = TextureUsage::RenderAttachment;
+	RenderGraph::ResourceId depth = frameGraph.createTexture("Depth", depthDesc);
+
+	scenePass = frameGraph.addPass("Scene", [this](WebGpuRenderPass& pass) { EncodeScenePass(pass); });
+	frameGraph.colorAttachment(scenePass, frameTarget);
+	frameGraph.depthAttachment(scenePass, depth);
+}
+
+
+bool Renderer::CompileFrameGraph() {
+	ReleaseFrameGraphResources();
+	if (!frameGraph.compile()) {
+		return false;
+	}
+	frameGraph.printStats(std::cout);
+
+	// A texture or a buffer per allocation, shared by the resources the
+	// graph aliased
+	for (const RenderGraph::Allocation& allocation : frameGraph.allocations()) {
+		Texture texture = nullptr;
+		TextureView view = nullptr;
+		Buffer buffer = nullptr;
+		if (allocation.texture) {
+			TextureFormat format = allocation.textureDesc.format;
+			TextureDescriptor textureDesc;
+			textureDesc.label = "Render graph texture";
+			textureDesc.dimension = TextureDimension::_2D;
+			textureDesc.format = format;
+			textureDesc.mipLevelCount = allocation.textureDesc.mipLevelCount;
+			textureDesc.sampleCount = allocation.textureDesc.sampleCount;
+			textureDesc.size = { allocation.textureDesc.width, allocation.textureDesc.height, 1 };
+			textureDesc.usage = allocation.textureDesc.usage;
+			textureDesc.viewFormatCount = 1;
+			textureDesc.viewFormats = (WGPUTextureFormat*)&format;
+			texture = device.createTexture(textureDesc);
+
+			TextureViewDescriptor viewDesc;
+			viewDesc.aspect = TextureAspect::All;
+			viewDesc.baseArrayLayer = 0;
+			viewDesc.arrayLayerCount = 1;
+			viewDesc.baseMipLevel = 0;
+			viewDesc.mipLevelCount = allocation.textureDesc.mipLevelCount;
+			viewDesc.dimension = TextureViewDimension::_2D;
+			viewDesc.format = format;
+			view = texture.createView(viewDesc);
+		}
+		else {
+			BufferDescriptor bufferDesc;
+			bufferDesc.label = "Render graph buffer";
+			bufferDesc.size = allocation.bufferDesc.size;
+			bufferDesc.usage = allocation.bufferDesc.usage;
+			bufferDesc.mappedAtCreation = false;
+			buffer = backend->createBuffer(bufferDesc);
+		}
+		graphTextures.push_back(texture);
+		graphTextureViews.push_back(view);
+		graphBuffers.push_back(buffer);
+	}
+	return true;
+}
+
+
+void Renderer::ReleaseFrameGraphResources() {
+	for (TextureView view : graphTextureViews) {
+		if (view) view.release();
+	}
+	for (Texture texture : graphTextures) {
+		if (texture) {
+			texture.destroy();
+			texture.release();
+		}
+	}
+	for (Buffer buffer : graphBuffers) {
+		if (buffer) backend->destroyBuffer(buffer);
+	}
+	graphTextureViews.clear();
+	graphTextures.clear();
+	graphBuffers.clear();
+}
+
+
+void Renderer::ExecuteFrameGraph(CommandEncoder encoder, TextureView targetView) {
+	// Compiled again only when the passes changed
+	if (!frameGraph.compiled() && !CompileFrameGraph()) {
+		return;
+	}
+
+	std::vector<RenderPassColorAttachment> colorAttachments;
+	for (RenderGraph::PassId passId : frameGraph.passOrder()) {
+		// The first pass using an attachment in the frame clears it, and the
+		// last one drops it unless it outlives the frame
+		colorAttachments.clear();
+		RenderPassDepthStencilAttachment depthStencilAttachment;
+		bool hasDepth = false;
+		for (const RenderGraph::Access& access : frameGraph.accesses(passId)) {
+			TextureView view = frameGraph.imported(access.resource) ? targetView
+				: graphTextureViews[frameGraph.allocation(access.resource)];
+			LoadOp loadOp = access.first ? LoadOp::Clear : LoadOp::Load;
+			StoreOp storeOp = access.last && !frameGraph.imported(access.resource) ? StoreOp::Discard : StoreOp::Store;
+			if (access.type == RenderGraph::AccessType::ColorAttachment) {
+				RenderPassColorAttachment colorAttachment = {};
+				colorAttachment.view = view;
+				colorAttachment.resolveTarget = nullptr;
+				colorAttachment.loadOp = loadOp;
+				colorAttachment.storeOp = storeOp;
+				colorAttachment.clearValue = WGPUColor{ 0.2, 0.2, 0.2, 1.0 };
+#ifndef WEBGPU_BACKEND_WGPU
+				colorAttachment.depthSlice = WGPU_DEPTH_SLICE_UNDEFINED;
+#endif // NOT WEBGPU_BACKEND_WGPU
+				colorAttachments.push_back(colorAttachment);
+			}
+			else if (access.type == RenderGraph::AccessType::DepthAttachment) {
+				depthStencilAttachment.view = view;
+				depthStencilAttachment.depthClearValue = 1.0f; // The initial value of the depth buffer, meaning "far"
+				depthStencilAttachment.depthLoadOp = loadOp;
+				depthStencilAttachment.depthStoreOp = storeOp;
+				depthStencilAttachment.depthReadOnly = false;
+				depthStencilAttachment.stencilClearValue = 0; // Stencil setup, mandatory but unused
+				depthStencilAttachment.stencilLoadOp = LoadOp::Undefined;
+				depthStencilAttachment.stencilStoreOp = StoreOp::Undefined;
+				depthStencilAttachment.stencilReadOnly = true;
+				hasDepth = true;
+			}
+		}
+		// The frame graph only has render passes so far
+		assert(!colorAttachments.empty() || hasDepth);
+
+		RenderPassDescriptor renderPassDesc = {};
+		renderPassDesc.label = frameGraph.passName(passId).c_str();
+		renderPassDesc.colorAttachmentCount = colorAttachments.size();
+		renderPassDesc.colorAttachments = colorAttachments.data();
+		renderPassDesc.depthStencilAttachment = hasDepth ? &depthStencilAttachment : nullptr;
+		renderPassDesc.timestampWrites = gpuTimer && passId == scenePass ? gpuTimer->timestampWrites() : nullptr;
+
+		RenderPassEncoder renderPass = encoder.beginRenderPass(renderPassDesc);
+		WebGpuRenderPass pass(renderPass);
+		frameGraph.execute(passId, pass);
+		renderPass.end();
+		renderPass.release();
+	}
+}
+
+
+void Renderer::EncodeScenePass(WebGpuRenderPass& pass) {
+	if (!framePipeline) {
+		return;
+	}
+	SceneBindings scene;
+	scene.pipeline = framePipeline;
+	scene.bindGroup = bindGroup;
+	scene.vertexBuffer = vertexAllocation.buffer;
+	scene.vertexBufferOffset = vertexAllocation.offset;
+	scene.vertexBufferSize = vertexAllocation.size;
+	scene.indexBuffer = indexAllocation.buffer;
+	scene.indexFormat = indexFormat;
+	scene.indexBufferOffset = indexAllocation.offset;
+	scene.indexBufferSize = indexAllocation.size;
+	scene.lods = lods.data();
+	scene.lodCount = lods.size();
+	scene.submeshes = submeshes.data();
+	scene.submeshCount = submeshes.size();
+	scene.materialBindGroups = materialBindGroups.data();
+	scene.fullDetailRanges = frameFullDetailRanges;
+	if (renderBundles) {
+		// Capture the draws, record them on the workers and replay them.
+		// Dawn devices are not thread-safe by default, its bundles are
+		// recorded on this thread.
+#ifdef WEBGPU_BACKEND_WGPU
+		ThreadPool* bundlePool = &ThreadPool::shared();
+#else
+		ThreadPool* bundlePool = nullptr;
+#endif // WEBGPU_BACKEND_WGPU
+		drawList.clear();
+		encodeScene(drawList, scene, frameDynamicOffset, *instances);
+		const std::vector<RenderBundle>& bundles = renderBundles->record(drawList, bundlePool);
+		pass.executeBundles(bundles.size(), bundles.data());
+	}
+	else {
+		encodeScene(pass, scene, frameDynamicOffset, *instances);
+	}
+}
+
+
 void Renderer::InitializePipeline() {
-	
-	std::cout << "Creating shader module..." << std::endl;
-	ShaderModule shaderModule = loadShaderModule("C:/Users/admin/Desktop/WebGPU/BaseProject/resources/shaders2.wgsl");
+
+	// The shader and the mesh load in the background while frames are
+	// already being rendered, see ProcessLoadedAssets()
+	assetLoader = std::make_unique<AssetLoader>(ThreadPool::shared());
 	std::cout << fs::current_path().string() << std::endl;
-	std::cout << "Shader module: " << shaderModule << std::endl;
+	shaderHandle = assetLoader->loadShader(options.resourceDirectory / "shaders2.wgsl");
+
+	// Create binding layout (don't forget to = Default)
+	std::vector<BindGroupLayoutEntry> bindingLayouts(2, Default);
+	BindGroupLayoutEntry& bindingLayout = bindingLayouts[0];
+	bindingLayout.binding = 0;
+	bindingLayout.visibility = ShaderStage::Vertex | ShaderStage::Fragment;
+	bindingLayout.buffer.type = BufferBindingType::Uniform;
+	bindingLayout.buffer.minBindingSize = sizeof(MyUniforms);
+	bindingLayout.buffer.hasDynamicOffset = true;
+
+	// Per-instance transforms and colors
+	BindGroupLayoutEntry& instanceBindingLayout = bindingLayouts[1];
+	instanceBindingLayout.binding = 1;
+	instanceBindingLayout.visibility = ShaderStage::Vertex;
+	instanceBindingLayout.buffer.type = BufferBindingType::ReadOnlyStorage;
+	instanceBindingLayout.buffer.minBindingSize = sizeof(InstanceData);
+	
+	// Create a bind group layout
+	BindGroupLayoutDescriptor bindGroupLayoutDesc;
+	bindGroupLayoutDesc.entryCount = (uint32_t)bindingLayouts.size();
+	bindGroupLayoutDesc.entries = bindingLayouts.data();
+	BindGroupLayout bindGroupLayout = pipelineCache->bindGroupLayout(bindGroupLayoutDesc);
+
+	// Material of the submesh being drawn, switched between draw calls
+	BindGroupLayoutEntry materialBindingLayout = Default;
+	materialBindingLayout.binding = 0;
+	materialBindingLayout.visibility = ShaderStage::Fragment;
+	materialBindingLayout.buffer.type = BufferBindingType::Uniform;
+	materialBindingLayout.buffer.minBindingSize = sizeof(Material);
+	BindGroupLayoutDescriptor materialLayoutDesc;
+	materialLayoutDesc.entryCount = 1;
+	materialLayoutDesc.entries = &materialBindingLayout;
+	materialBindGroupLayout = pipelineCache->bindGroupLayout(materialLayoutDesc);
+
+	// Create the pipeline layout. The cache owns the layouts.
+	std::array<BindGroupLayout, 2> bindGroupLayouts = { bindGroupLayout, materialBindGroupLayout };
+	pipelineLayout = pipelineCache->pipelineLayout(bindGroupLayouts.data(), bindGroupLayouts.size());
+
+	// Passes of the frame, compiled before the first one
+	InitializeFrameGraph();
+	CompileFrameGraph();
+
+	InitializeBuffers();
+
+	// Initial value of the uniforms, they are uploaded every frame
+	InitializeUniforms();
+
+	// Create a binding
+	std::vector<BindGroupEntry> bindings(2);
+	bindings[0].binding = 0;
+	bindings[0].buffer = uniformRing->buffer();
+	bindings[0].offset = 0;
+	bindings[0].size = sizeof(MyUniforms);
+
+	bindings[1].binding = 1;
+	bindings[1].buffer = instances->buffer();
+	bindings[1].offset = 0;
+	bindings[1].size = instances->bufferSize();
+
+	// A bind group contains one or multiple bindings
+	BindGroupDescriptor bindGroupDesc{};
+	bindGroupDesc.layout = bindGroupLayout;
+	// There must be as many bindings as declared in the layout!
+	bindGroupDesc.entryCount = bindGroupLayoutDesc.entryCount;
+	bindGroupDesc.entries = bindings.data();
+	bindGroup = device.createBindGroup(bindGroupDesc);
+}
+
+
+void Renderer::CreateRenderPipeline() {
+
+	// Variant of the shader specialized for the options, its module shared
+	// with any other pipeline made of the same source
+	ShaderFeatures features = 0;
+	if (options.compactVertices) {
+		features |= ShaderFeatureCompactVertices;
+	}
+	if (options.vertexColors) {
+		features |= ShaderFeatureVertexColors;
+	}
+	const ShaderVariant& shaderVariant = shaderVariants->variant(features);
+	if (!shaderVariant.module) {
+		std::cout << "*** ERROR *** No shader, the scene stays empty" << std::endl;
+		return;
+	}
+	ShaderModule shaderModule = shaderVariant.module;
 
 	// Create the render pipeline
 	RenderPipelineDescriptor pipelineDesc;
@@ -346,10 +984,22 @@ void Renderer::InitializePipeline() {
 	vertexAttribs[2].format = VertexFormat::Float32x3;
 	vertexAttribs[2].offset = offsetof(VertexAttributes, color);
 
+	uint64_t vertexStride = sizeof(VertexAttributes);
+	if (options.compactVertices) {
+		// Same shader inputs, vs_main decodes them
+		vertexAttribs[0].format = VertexFormat::Unorm16x4;
+		vertexAttribs[0].offset = offsetof(CompactVertex, position);
+		vertexAttribs[1].format = VertexFormat::Snorm16x2;
+		vertexAttribs[1].offset = offsetof(CompactVertex, normal);
+		vertexAttribs[2].format = VertexFormat::Unorm8x4;
+		vertexAttribs[2].offset = offsetof(CompactVertex, color);
+		vertexStride = sizeof(CompactVertex);
+	}
+
 	VertexBufferLayout vertexBufferLayout;
 	vertexBufferLayout.attributeCount = (uint32_t)vertexAttribs.size();
 	vertexBufferLayout.attributes = vertexAttribs.data();
-	vertexBufferLayout.arrayStride = sizeof(VertexAttributes);
+	vertexBufferLayout.arrayStride = vertexStride;
 	vertexBufferLayout.stepMode = VertexStepMode::Vertex;
 	
 	pipelineDesc.vertex.bufferCount = 1;
@@ -360,8 +1010,8 @@ void Renderer::InitializePipeline() {
 	// by the function called 'vs_main' in that module.
 	pipelineDesc.vertex.module = shaderModule;
 	pipelineDesc.vertex.entryPoint = "vs_main";
-	pipelineDesc.vertex.constantCount = 0;
-	pipelineDesc.vertex.constants = nullptr;
+	pipelineDesc.vertex.constantCount = shaderVariant.constants.size();
+	pipelineDesc.vertex.constants = shaderVariant.constants.data();
 
 	// Each sequence of 3 vertices is considered as a triangle
 	pipelineDesc.primitive.topology = PrimitiveTopology::TriangleList;
@@ -386,8 +1036,8 @@ void Renderer::InitializePipeline() {
 	FragmentState fragmentState;
 	fragmentState.module = shaderModule;
 	fragmentState.entryPoint = "fs_main";
-	fragmentState.constantCount = 0;
-	fragmentState.constants = nullptr;
+	fragmentState.constantCount = shaderVariant.constants.size();
+	fragmentState.constants = shaderVariant.constants.data();
 
 	BlendState blendState;
 	blendState.color.srcFactor = BlendFactor::SrcAlpha;
@@ -415,8 +1065,7 @@ void Renderer::InitializePipeline() {
 	depthStencilState.depthCompare = CompareFunction::Less;
 	depthStencilState.depthWriteEnabled = true;
 
-	TextureFormat depthTextureFormat = TextureFormat::Depth24Plus;
-	depthStencilState.format = depthTextureFormat;
+	depthStencilState.format = DepthTextureFormat;
 
 	depthStencilState.stencilReadMask = 0;
 	depthStencilState.stencilWriteMask = 0;
@@ -427,83 +1076,10 @@ void Renderer::InitializePipeline() {
 	pipelineDesc.multisample.mask = ~0u;
 	pipelineDesc.multisample.alphaToCoverageEnabled = false;
 
-	// Create binding layout (don't forget to = Default)
-	BindGroupLayoutEntry bindingLayout = Default;
-	bindingLayout.binding = 0;
-	bindingLayout.visibility = ShaderStage::Vertex | ShaderStage::Fragment;
-	bindingLayout.buffer.type = BufferBindingType::Uniform;
-	bindingLayout.buffer.minBindingSize = sizeof(MyUniforms);
-	bindingLayout.buffer.hasDynamicOffset = true;
-	
-	// Create a bind group layout
-	BindGroupLayoutDescriptor bindGroupLayoutDesc;
-	bindGroupLayoutDesc.entryCount = 1;
-	bindGroupLayoutDesc.entries = &bindingLayout;
-	BindGroupLayout bindGroupLayout = device.createBindGroupLayout(bindGroupLayoutDesc);
-
-	// Create the pipeline layout
-	PipelineLayoutDescriptor layoutDesc{};
-	layoutDesc.bindGroupLayoutCount = 1;
-	layoutDesc.bindGroupLayouts = (WGPUBindGroupLayout*)&bindGroupLayout;
-	PipelineLayout layout = device.createPipelineLayout(layoutDesc);
-
-	// Assign the PipelineLayout to the RenderPipelineDescriptor's layout field
-	pipelineDesc.layout = layout;
-	pipeline = device.createRenderPipeline(pipelineDesc);
-
-	// Create the depth texture
-	TextureDescriptor depthTextureDesc;
-	depthTextureDesc.dimension = TextureDimension::_2D;
-	depthTextureDesc.format = depthTextureFormat;
-	depthTextureDesc.mipLevelCount = 1;
-	depthTextureDesc.sampleCount = 1;
-	depthTextureDesc.size = { 640, 480, 1 };
-	depthTextureDesc.usage = TextureUsage::RenderAttachment;
-	depthTextureDesc.viewFormatCount = 1;
-	depthTextureDesc.viewFormats = (WGPUTextureFormat*)&depthTextureFormat;
-	depthTexture = device.createTexture(depthTextureDesc);
-
-	// Create the view of the depth texture 
-	TextureViewDescriptor depthTextureViewDesc;
-	depthTextureViewDesc.aspect = TextureAspect::DepthOnly;
-	depthTextureViewDesc.baseArrayLayer = 0;
-	depthTextureViewDesc.arrayLayerCount = 1;
-	depthTextureViewDesc.baseMipLevel = 0;
-	depthTextureViewDesc.mipLevelCount = 1;
-	depthTextureViewDesc.dimension = TextureViewDimension::_2D;
-	depthTextureViewDesc.format = depthTextureFormat;
-	depthTextureView = depthTexture.createView(depthTextureViewDesc);
-
-	InitializeBuffers();
-
-	// Upload the initial value of the uniforms
-	InitializeUniforms();
-	queue.writeBuffer(uniformBuffer, 0, &uniforms, sizeof(MyUniforms));
-
-	// Upload second value
-	/*
-	uniforms.time = -1.0f;
-	uniforms.color = { 1.0f, 1.0f, 1.0f, 0.7f };
-	queue.writeBuffer(uniformBuffer, *uniformStride, &uniforms, sizeof(MyUniforms));
-	*/
-
-	// Create a binding
-	BindGroupEntry binding{};
-	binding.binding = 0;
-	binding.buffer = uniformBuffer;
-	binding.offset = 0;
-	binding.size = sizeof(MyUniforms);
-
-	// A bind group contains one or multiple bindings
-	BindGroupDescriptor bindGroupDesc{};
-	bindGroupDesc.layout = bindGroupLayout;
-	// There must be as many bindings as declared in the layout!
-	bindGroupDesc.entryCount = bindGroupLayoutDesc.entryCount;
-	bindGroupDesc.entries = &binding;
-	bindGroup = device.createBindGroup(bindGroupDesc);	
-
-	// We no longer need to access the shader module
-	shaderModule.release();
+	// The layout is created up front, with the bind group. Frames only
+	// clear until the pipeline is compiled, see MainLoop().
+	pipelineDesc.layout = pipelineLayout;
+	pipelineId = pipelineCache->requestRenderPipeline(pipelineDesc);
 }
 
 
@@ -519,27 +1095,25 @@ RequiredLimits Renderer::GetRequiredLimits(Adapter adapter) const {
 	requiredLimits.limits.maxVertexAttributes = 3;
 	// We should also tell that we use 1 vertex buffers
 	requiredLimits.limits.maxVertexBuffers = 3;
-	// Maximum size of a buffer is 6 vertices of 2 float each
-	requiredLimits.limits.maxBufferSize = 3 * 10000 * sizeof(float);
+	// Meshes can be arbitrarily large, so allow whatever the adapter supports
+	requiredLimits.limits.maxBufferSize = supportedLimits.limits.maxBufferSize;
 	// Maximum stride between 2 consecutive vertices in the vertex buffer
-	requiredLimits.limits.maxVertexBufferArrayStride = 3 * sizeof(float); // 3 * sizeof(float)
+	requiredLimits.limits.maxVertexBufferArrayStride = sizeof(VertexAttributes);
 
-	requiredLimits.limits.maxTextureDimension1D = 480;
-	requiredLimits.limits.maxTextureDimension2D = 640;
+	requiredLimits.limits.maxTextureDimension1D = std::max(options.width, options.height);
+	requiredLimits.limits.maxTextureDimension2D = std::max(options.width, options.height);
 	requiredLimits.limits.maxTextureArrayLayers = 1;
 
 	requiredLimits.limits.minUniformBufferOffsetAlignment = supportedLimits.limits.minUniformBufferOffsetAlignment;
 	requiredLimits.limits.minStorageBufferOffsetAlignment = supportedLimits.limits.minStorageBufferOffsetAlignment;
 
-	requiredLimits.limits.maxBindGroups = 1;
-	requiredLimits.limits.maxUniformBuffersPerShaderStage = 1;
-	requiredLimits.limits.maxUniformBufferBindingSize = 16 * 4;
+	// The uniforms and the material, both read by the fragment stage
+	requiredLimits.limits.maxBindGroups = 2;
+	requiredLimits.limits.maxUniformBuffersPerShaderStage = 2;
+	requiredLimits.limits.maxUniformBufferBindingSize = sizeof(MyUniforms);
 	requiredLimits.limits.maxDynamicUniformBuffersPerPipelineLayout = 1;
-
-	*uniformStride = ceilToNextMultiple(
-		(uint32_t)sizeof(MyUniforms),
-		(uint32_t)requiredLimits.limits.minUniformBufferOffsetAlignment
-	);
+	requiredLimits.limits.maxStorageBuffersPerShaderStage = 1;
+	requiredLimits.limits.maxStorageBufferBindingSize = uint64_t(MaxInstances) * sizeof(InstanceData);
 
 	return requiredLimits;
 }
@@ -560,20 +1134,20 @@ void Renderer::InitializeBuffers() {
 	indexCount = static_cast<uint32_t>(indexData.size());
 	*/
 
-	
-	if (!loadGeometryFromObj("C:/Users/admin/Desktop/WebGPU/BaseProject/resources/mammoth.obj", vertexData)) {
-		std::cout << "*** ERROR *** No se puede cargar el fichero OBJ" << std::endl;
-	}
-	indexCount = static_cast<int>(vertexData.size());	
+	fs::path objPath = options.meshPath.empty() ? options.resourceDirectory / "mammoth.obj" : options.meshPath;
+	MeshLoaderOptions loaderOptions;
 
-	// Create vertex buffer
-	BufferDescriptor bufferDesc;
-	bufferDesc.size = vertexData.size() * sizeof(VertexAttributes); // changed
-	bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Vertex;
-	bufferDesc.mappedAtCreation = false;
-	pointBuffer = device.createBuffer(bufferDesc);
-	queue.writeBuffer(pointBuffer, 0, vertexData.data(), bufferDesc.size); // changed
+	// The compressed mesh, when it was shipped, reads much less from disk
+	// (see App --compress-mesh)
+	fs::path compressedPath = fs::path(objPath).replace_extension(".meshz");
+	std::error_code ec;
+	if (fs::exists(compressedPath, ec)) {
+		objPath = compressedPath;
+	}
 
+	// Parsed or decompressed on a worker, or mapped from the binary cache
+	// when it is up to date, then streamed to the GPU a slice per frame
+	meshHandle = assetLoader->loadMesh(objPath, loaderOptions);
 
 	/*
 	// Create vertex buffer
@@ -608,14 +1182,319 @@ void Renderer::InitializeBuffers() {
 	queue.writeBuffer(indexBuffer, 0, indexData.data(), bufferDesc.size);
 	*/
 
-	// Uniform buffer
-	bufferDesc.size = sizeof(MyUniforms); //+ (*uniformStride)
-	bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Uniform;
-	bufferDesc.mappedAtCreation = false;
-	uniformBuffer = device.createBuffer(bufferDesc);
+	// Uniform buffer, split in one region per frame in flight. Blocks are
+	// spaced by the offset alignment the device requires.
+	SupportedLimits deviceLimits;
+	device.getLimits(&deviceLimits);
+	uint32_t uniformAlignment = deviceLimits.limits.minUniformBufferOffsetAlignment;
+	uint32_t uniformStride = ceilToNextMultiple((uint32_t)sizeof(MyUniforms), uniformAlignment);
+	uniformRing = std::make_unique<UniformRing>(*backend, uniformAlignment, uint64_t(MaxUniformBlocksPerFrame) * uniformStride);
+
+	// Transforms of the model and of the mesh in it, set by
+	// InitializeUniforms(), then those of the instances
+	transforms.clear();
+	modelTransform = transforms.add(InvalidTransform, mat4x4(1.0));
+	meshTransform = transforms.add(modelTransform, mat4x4(1.0));
+	instanceTransforms.clear();
+
+	// Instance buffer, with a single untransformed instance to begin with
+	instances = std::make_unique<InstanceBatch>(*backend, MaxInstances);
+	AddInstance(mat4x4(1.0), vec4(1.0));
+}
+
 
-	float currentTime = 1.0f;
-	queue.writeBuffer(uniformBuffer, 0, &currentTime, sizeof(float));
+void Renderer::ProcessLoadedAssets() {
+	PROFILE_ZONE("Asset uploads");
+	std::unique_ptr<LoadedAsset> asset;
+	while (assetLoader->poll(asset)) {
+		if (asset->failed) {
+			// The loader reported why, the scene stays empty
+			continue;
+		}
+		if (asset->type == AssetType::Shader) {
+			shaderVariants = std::make_unique<ShaderVariants>(*pipelineCache, std::move(asset->shaderSources));
+			CreateRenderPipeline();
+			asset->handle.setState(AssetState::Ready);
+		}
+		else if (asset->type == AssetType::Mesh && meshUpload) {
+			// A single mesh is drawn, and its buffers are still being
+			// written: the later one cannot replace it
+			std::cout << "*** ERROR *** Mesh " << asset->path << " loaded while " << meshUpload->path
+				<< " is uploading, it is dropped" << std::endl;
+			asset->handle.setState(AssetState::Failed);
+		}
+		else if (asset->type == AssetType::Mesh) {
+			BeginMeshUpload(std::move(asset));
+		}
+	}
+
+	if (meshUpload && ContinueMeshUpload(UploadBudgetPerFrame)) {
+		FinishMeshUpload();
+	}
+
+	// Copies are submitted before the frame, which may already use them
+	uploader->submit();
+}
+
+
+bool Renderer::IsLoading() const {
+	return assetLoader->pendingCount() > 0 || meshUpload != nullptr || pipelineCache->pendingCount() > 0;
+}
+
+
+bool Renderer::LoadFailed() const {
+	return shaderHandle.state() == AssetState::Failed || meshHandle.state() == AssetState::Failed;
+}
+
+
+void Renderer::PrintPipelineCacheStats(std::ostream& out) const {
+	pipelineCache->printStats(out);
+}
+
+
+void Renderer::PrintBufferPoolStats(std::ostream& out) const {
+	bufferAllocator->printStats(out);
+}
+
+
+void Renderer::BeginMeshUpload(std::unique_ptr<LoadedAsset> asset) {
+	const MeshData& data = asset->mesh;
+	const VertexAttributes* vertices = data.vertices();
+	size_t numVertices = data.vertexCount();
+	vertexCount = static_cast<uint32_t>(numVertices);
+	indexCount = static_cast<uint32_t>(data.indexCount());
+	meshBounds = meshBoundingSphere(vertices, numVertices);
+	meshBoxMin = glm::vec3(INFINITY);
+	meshBoxMax = glm::vec3(-INFINITY);
+	for (size_t i = 0; i < numVertices; ++i) {
+		meshBoxMin = glm::min(meshBoxMin, vertices[i].position);
+		meshBoxMax = glm::max(meshBoxMax, vertices[i].position);
+	}
+	instanceBoundsDirty = true;
+
+	// The index format follows the vertex count
+	indexFormat = fitsUint16Indices(numVertices) ? IndexFormat::Uint16 : IndexFormat::Uint32;
+	size_t indexSize = indexFormat == IndexFormat::Uint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	assert(data.indexStride() == indexSize || (data.indexStride() == sizeof(uint32_t) && indexSize == sizeof(uint16_t)));
+
+	// Vertex region
+	vertexAllocation = bufferAllocator->allocate(BufferClass::Vertex,
+		numVertices * (options.compactVertices ? sizeof(CompactVertex) : sizeof(VertexAttributes)));
+
+	// Float vertices need no decoding
+	positionDecode = PositionDecode();
+	if (options.compactVertices) {
+		positionDecode = computePositionDecode(vertices, numVertices);
+	}
+	uniforms.positionOffset = vec4(positionDecode.offset, 0.0f);
+	uniforms.positionScale = vec4(positionDecode.scale, 0.0f);
+
+	// Index region, its size rounded up to a multiple of 4 for the copies
+	indexAllocation = bufferAllocator->allocate(BufferClass::Index, data.indexCount() * indexSize);
+
+	lods = data.lods();
+	std::vector<Meshlet> meshlets = data.meshlets();
+	if (!meshlets.empty()) {
+		meshletCuller = std::make_unique<MeshletCuller>(meshlets);
+	}
+
+	// A mesh without a draw table is a single submesh
+	submeshes = data.submeshes();
+	if (submeshes.empty()) {
+		submeshes.push_back(wholeMesh(lods, indexCount, meshlets.size()));
+	}
+
+	// Instances pick one level for all the submeshes, the first one whose
+	// error stays small enough in every submesh
+	selectionLods.clear();
+	for (const Submesh& submesh : submeshes) {
+		selectionLods.resize(std::max<size_t>({ selectionLods.size(), submesh.lodCount, 1 }), { 0, 0, 0.0f, 0 });
+	}
+	for (size_t level = 0; level < selectionLods.size(); ++level) {
+		for (const Submesh& submesh : submeshes) {
+			if (submesh.lodCount > 0) {
+				const MeshLod& lod = lods[submesh.firstLod + std::min<size_t>(level, submesh.lodCount - 1)];
+				selectionLods[level].error = std::max(selectionLods[level].error, lod.error);
+			}
+		}
+	}
+
+	CreateMaterials(data.materials());
+	if (occlusionCuller) {
+		BuildOccluderMesh(data);
+	}
+
+	meshUpload = std::move(asset);
+	uploadedVertices = 0;
+	uploadedIndices = 0;
+}
+
+
+bool Renderer::ContinueMeshUpload(uint64_t byteBudget) {
+	const MeshData& data = meshUpload->mesh;
+
+	// Vertices first, then indices, at least one of them per call
+	size_t vertexSize = options.compactVertices ? sizeof(CompactVertex) : sizeof(VertexAttributes);
+	if (uploadedVertices < vertexCount) {
+		size_t count = std::min<size_t>(vertexCount - uploadedVertices, std::max<uint64_t>(byteBudget / vertexSize, 1));
+		UploadVertices(data.vertices(), uploadedVertices, count);
+		uploadedVertices += count;
+		byteBudget -= std::min<uint64_t>(byteBudget, count * vertexSize);
+	}
+
+	size_t indexSize = indexFormat == IndexFormat::Uint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	if (uploadedVertices == vertexCount && uploadedIndices < indexCount && byteBudget > 0) {
+		// Slices of 16-bit indices start on 4-byte boundaries
+		size_t count = std::min<size_t>(indexCount - uploadedIndices, std::max<uint64_t>(byteBudget / indexSize, 2) & ~uint64_t(1));
+		UploadIndices(data.indexData(), data.indexStride(), uploadedIndices, count);
+		uploadedIndices += count;
+	}
+	return uploadedVertices == vertexCount && uploadedIndices == indexCount;
+}
+
+
+void Renderer::FinishMeshUpload() {
+	auto sinceStart = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - initializeStart);
+	std::cout << "Mesh loaded from " << (meshUpload->mesh.fromCache() ? "cache" : "OBJ") << " in "
+		<< meshUpload->loadMs << " ms, resident " << sinceStart.count() << " ms after start (" << vertexCount << " vertices, "
+		<< indexCount << " indices, " << submeshes.size() << " submeshes, " << selectionLods.size() << " levels of detail, "
+		<< (meshletCuller ? meshletCuller->meshletCount() : 0) << " meshlets, peak RSS " << peakResidentMiB() << " MiB)" << std::endl;
+	if (options.compactVertices) {
+		size_t saved = sizeof(VertexAttributes) - sizeof(CompactVertex);
+		std::cout << "Compact vertices: " << sizeof(CompactVertex) << " bytes/vertex instead of "
+			<< sizeof(VertexAttributes) << ", " << saved * vertexCount / 1024 << " KiB saved" << std::endl;
+	}
+
+	// Releases the mapping of the cache, the data was copied to staging
+	// buffers as it was written
+	meshUpload->handle.setState(AssetState::Ready);
+	meshUpload.reset();
+}
+
+
+void Renderer::BuildOccluderMesh(const MeshData& data) {
+	// Every level that instances are drawn with, each submesh at its level
+	// like LOD selection does, as long as it fits the triangle budget. The
+	// levels share the vertices they use.
+	occluderPositions.clear();
+	occluderIndices.clear();
+	occluderLods.clear();
+	const VertexAttributes* vertices = data.vertices();
+	const void* indices = data.indexData();
+	std::unordered_map<uint32_t, uint32_t> remap;
+	auto submeshLevel = [&](const Submesh& submesh, size_t level) {
+		return submesh.lodCount > 0 ? lods[submesh.firstLod + std::min<size_t>(level, submesh.lodCount - 1)]
+			: MeshLod{ submesh.firstIndex, submesh.indexCount, 0.0f, 0 };
+	};
+	for (size_t level = 0; level < selectionLods.size(); ++level) {
+		size_t levelIndexCount = 0;
+		for (const Submesh& submesh : submeshes) {
+			levelIndexCount += submeshLevel(submesh, level).indexCount;
+		}
+		if (levelIndexCount / 3 > MaxOccluderTriangles) {
+			continue;
+		}
+
+		MeshLod occluder = { static_cast<uint32_t>(occluderIndices.size()), static_cast<uint32_t>(levelIndexCount),
+			selectionLods[level].error, 0 };
+		for (const Submesh& submesh : submeshes) {
+			MeshLod lod = submeshLevel(submesh, level);
+			for (uint32_t i = lod.firstIndex; i < lod.firstIndex + lod.indexCount; ++i) {
+				uint32_t index = data.indexStride() == sizeof(uint16_t) ? static_cast<const uint16_t*>(indices)[i]
+					: static_cast<const uint32_t*>(indices)[i];
+				auto inserted = remap.emplace(index, static_cast<uint32_t>(occluderPositions.size()));
+				if (inserted.second) {
+					occluderPositions.push_back(vertices[index].position);
+				}
+				occluderIndices.push_back(inserted.first->second);
+			}
+		}
+		occluderLods.push_back(occluder);
+	}
+	if (occluderLods.empty()) {
+		std::cout << "Occlusion culling: no occluder, the coarsest level of the mesh has more than "
+			<< MaxOccluderTriangles << " triangles" << std::endl;
+	}
+}
+
+
+void Renderer::CreateMaterials(const std::vector<Material>& materials) {
+	// One block per material at the offset alignment of the device, the
+	// default material (white) first
+	SupportedLimits deviceLimits;
+	device.getLimits(&deviceLimits);
+	uint32_t materialStride = ceilToNextMultiple((uint32_t)sizeof(Material), deviceLimits.limits.minUniformBufferOffsetAlignment);
+	std::vector<uint8_t> materialData((materials.size() + 1) * materialStride, 0);
+	Material defaultMaterial = { vec4(1.0f) };
+	std::memcpy(materialData.data(), &defaultMaterial, sizeof(Material));
+	for (size_t i = 0; i < materials.size(); ++i) {
+		std::memcpy(materialData.data() + (i + 1) * materialStride, &materials[i], sizeof(Material));
+	}
+
+	// The region starts at a multiple of the offset alignment as well
+	materialAllocation = bufferAllocator->allocate(BufferClass::Uniform, materialData.size());
+	backend->writeBuffer(materialAllocation.buffer, materialAllocation.offset, materialData.data(), materialData.size());
+
+	BindGroupEntry binding;
+	binding.binding = 0;
+	binding.buffer = materialAllocation.buffer;
+	binding.size = sizeof(Material);
+	BindGroupDescriptor bindGroupDesc{};
+	bindGroupDesc.layout = materialBindGroupLayout;
+	bindGroupDesc.entryCount = 1;
+	bindGroupDesc.entries = &binding;
+	for (size_t i = 0; i <= materials.size(); ++i) {
+		binding.offset = materialAllocation.offset + i * materialStride;
+		materialBindGroups.push_back(device.createBindGroup(bindGroupDesc));
+	}
+}
+
+
+void Renderer::UploadVertices(const VertexAttributes* vertices, size_t first, size_t count) {
+	if (!options.compactVertices) {
+		uploader->write(vertexAllocation.buffer, vertexAllocation.offset + first * sizeof(VertexAttributes),
+			vertices + first, count * sizeof(VertexAttributes));
+		return;
+	}
+
+	// Encode batch by batch rather than in a full copy
+	CompactVertex batch[1024];
+	for (size_t end = first + count; first < end; first += std::size(batch)) {
+		size_t batchCount = std::min(std::size(batch), end - first);
+		encodeVertices(vertices + first, batchCount, positionDecode, batch);
+		uploader->write(vertexAllocation.buffer, vertexAllocation.offset + first * sizeof(CompactVertex),
+			batch, batchCount * sizeof(CompactVertex));
+	}
+}
+
+
+void Renderer::UploadIndices(const void* indices, size_t indexStride, size_t first, size_t count) {
+	size_t indexSize = indexFormat == IndexFormat::Uint16 ? sizeof(uint16_t) : sizeof(uint32_t);
+	if (indexStride == indexSize) {
+		const uint8_t* bytes = static_cast<const uint8_t*>(indices) + first * indexSize;
+		size_t byteSize = count * indexSize;
+		uploader->write(indexAllocation.buffer, indexAllocation.offset + first * indexSize, bytes, byteSize & ~size_t(3));
+		if (byteSize % 4 != 0) {
+			// Odd number of 16-bit indices: pad the last one
+			uint16_t tail[2] = { static_cast<const uint16_t*>(indices)[first + count - 1], 0 };
+			uploader->write(indexAllocation.buffer, indexAllocation.offset + ((first * indexSize + byteSize) & ~size_t(3)), tail, sizeof(tail));
+		}
+		return;
+	}
+
+	// Narrow 32-bit indices batch by batch rather than in a full copy
+	const uint32_t* wideIndices = static_cast<const uint32_t*>(indices);
+	uint16_t batch[4096];
+	for (size_t end = first + count; first < end; first += std::size(batch)) {
+		size_t batchCount = std::min(std::size(batch), end - first);
+		for (size_t i = 0; i < batchCount; ++i) {
+			batch[i] = static_cast<uint16_t>(wideIndices[first + i]);
+		}
+		if (batchCount % 2 != 0) {
+			batch[batchCount++] = 0;
+		}
+		uploader->write(indexAllocation.buffer, indexAllocation.offset + first * sizeof(uint16_t), batch, batchCount * sizeof(uint16_t));
+	}
 }
 
 
@@ -669,11 +1548,12 @@ void Renderer::InitializeUniforms() {
 		0.0, 0.0, 0.0, 1.0
 	));
 
-	T1S = T1 * S;
+	transforms.setLocal(modelTransform, R1);
+	transforms.setLocal(meshTransform, T1 * S);
 	uniforms.modelMatrix = R1 * T1 * S;
 	uniforms.viewMatrix = T2 * R2;
 
-	float ratio = 640.0f / 480.0f;
+	float ratio = static_cast<float>(options.width) / static_cast<float>(options.height);
 	float focalLength = 2.0;
 	float near = 0.01f;
 	float far = 100.0f;
@@ -713,8 +1593,8 @@ bool Renderer::loadGeometry(const fs::path& path,
     };
     Section currentSection = Section::None;
 
-    float value;
-    uint16_t index;
+    float values[3];
+    int index;
     std::string line;
     while (!file.eof()) {
         getline(file, line);
@@ -724,6 +1604,9 @@ bool Renderer::loadGeometry(const fs::path& path,
               line.pop_back();
             }
         
+        const char* begin = line.data();
+        const char* end = line.data() + line.size();
+
         if (line == "[points]") {
             currentSection = Section::Points;
         }
@@ -740,37 +1623,30 @@ bool Renderer::loadGeometry(const fs::path& path,
             // Do nothing, this is a comment
         }
         else if (currentSection == Section::Points) {
-            std::istringstream iss(line);
-            // Get x, y
-            for (int i = 0; i < 3; ++i) {
-                iss >> value;
-                pointData.push_back(value);
-            }
+            // Get x, y, z
+            size_t count = scanFloats(begin, end, values, 3);
+            pointData.insert(pointData.end(), values, values + count);
         }
 		else if (currentSection == Section::Colors) {
-            std::istringstream iss(line);
             // Get r, g, b
-            for (int i = 0; i < 3; ++i) {
-                iss >> value;
-                colorData.push_back(value);
-            }
+            size_t count = scanFloats(begin, end, values, 3);
+            colorData.insert(colorData.end(), values, values + count);
         }
         else if (currentSection == Section::Indices) {
-            std::istringstream iss(line);
             // Get corners #0 #1 and #2
             for (int i = 0; i < 3; ++i) {
-                iss >> index;
-                indexData.push_back(index);
+                begin = scanInt(begin, end, index);
+                if (!begin) break;
+                indexData.push_back(static_cast<uint16_t>(index));
             }
         }
 		else if (currentSection == Section::Normal) {
 			
-			std::istringstream iss(line);
 			// Get corners #0 #1 and #2
-			for (int i = 0; i < 3; ++i) {
-				iss >> value;
-				normalData.push_back(value);
-				std::cout << value << " ";
+			size_t count = scanFloats(begin, end, values, 3);
+			for (size_t i = 0; i < count; ++i) {
+				normalData.push_back(values[i]);
+				std::cout << values[i] << " ";
 			}
 			std::cout << std::endl;
 			
@@ -810,84 +1686,3 @@ bool Renderer::loadGeometry(const fs::path& path,
 
     return true;
 }
-
-
-ShaderModule Renderer::loadShaderModule(const fs::path& path) {
-    std::ifstream file(path);
-    if (!file.is_open()) {
-		std::cout<<"*** ERROR *** Invalid path: "<<path<<std::endl;
-        return nullptr;
-    }
-
-    file.seekg(0, std::ios::end);
-    size_t size = file.tellg();
-    std::string shaderSource(size, ' ');
-    file.seekg(0);
-    file.read(shaderSource.data(), size);
-
-    ShaderModuleWGSLDescriptor shaderCodeDesc{};
-    shaderCodeDesc.chain.next = nullptr;
-    shaderCodeDesc.chain.sType = SType::ShaderModuleWGSLDescriptor;
-    shaderCodeDesc.code = shaderSource.c_str();
-    ShaderModuleDescriptor shaderDesc{};
-    shaderDesc.nextInChain = &shaderCodeDesc.chain;
-    return device.createShaderModule(shaderDesc);
-}
-
-
-bool  Renderer::loadGeometryFromObj(const fs::path& path,
-									std::vector<VertexAttributes>& vertexData)
-{
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-
-	std::string warn;
-	std::string err;
-
-	bool ret = tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.string().c_str());
-
-	if (!warn.empty()) {
-		std::cout << warn << std::endl;
-	}
-
-	if (!err.empty()) {
-		std::cerr << err << std::endl;
-	}
-
-	if (!ret) {
-		std::cout << "FAIL - loadGeometryFromObj" << std::endl;
-		return false;
-	}
-
-	// Fill in vertexData here
-	const auto& shape = shapes[0]; // look at the first shape only
-
-	vertexData.resize(shape.mesh.indices.size());
-
-	for (size_t i = 0; i < shape.mesh.indices.size(); ++i) {
-		const tinyobj::index_t& idx = shape.mesh.indices[i];
-
-		vertexData[i].position = {
-			attrib.vertices[3 * idx.vertex_index + 0],
-			attrib.vertices[3 * idx.vertex_index + 2],
-			attrib.vertices[3 * idx.vertex_index + 1]			
-		};
-
-		vertexData[i].normal = {
-			attrib.normals[3 * idx.normal_index + 0],
-			attrib.normals[3 * idx.normal_index + 2],
-			attrib.normals[3 * idx.normal_index + 1]			
-		};
-
-		vertexData[i].color = {
-			attrib.colors[3 * idx.vertex_index + 0],
-			attrib.colors[3 * idx.vertex_index + 2],
-			attrib.colors[3 * idx.vertex_index + 1]			
-		};
-	}
-
-	std::cout << "Mesh indices " << shape.mesh.indices.size() << std::endl;
-
-	return true;
-}
\ No newline at end of file
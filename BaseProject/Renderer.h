@@ -1,12 +1,36 @@
 #pragma once
 
+#include "mesh.h"
+#include "uniforms.h"
+#include "streaming-uploader.h"
+#include "uniform-ring.h"
+#include "instance-batch.h"
+#include "meshlets.h"
+#include "asset-loader.h"
+#include "compact-vertex.h"
+#include "gpu-timer.h"
+#include "pipeline-cache.h"
+#include "shader-variants.h"
+#include "buffer-allocator.h"
+#include "scene-bounds.h"
+#include "transform-hierarchy.h"
+#include "render-bundles.h"
+#include "render-graph.h"
+#include "occlusion-culler.h"
+
 #include <webgpu/webgpu.hpp>
 
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 
 #include <filesystem>
+#include <chrono>
+#include <iosfwd>
+#include <string>
 #include <array>
+#include <vector>
+#include <memory>
+#include <utility>
 
 
 namespace fs = std::filesystem;
@@ -15,22 +39,40 @@ using namespace wgpu;
 using glm::mat4x4;
 using glm::vec4;
 
-struct MyUniforms {
-	mat4x4 projectionMatrix;
-	mat4x4 viewMatrix;
-	mat4x4 modelMatrix;
-	std::array<float, 4> color;
-	float time;	
-	float _pad[3];
-};
+static const float PI = 3.14159265358979323846f;
 
-struct VertexAttributes {
-	glm::vec3 position;
-	glm::vec3 normal;
-	glm::vec3 color;
-};
+// Where the shaders and the default mesh are, when the build does not say
+#ifndef RESOURCE_DIR
+#define RESOURCE_DIR "resources"
+#endif
 
-static const float PI = 3.14159265358979323846f;
+struct RendererOptions {
+	uint32_t width = 640;
+	uint32_t height = 480;
+	// Render into an offscreen texture, without any window or surface. Frames
+	// can then be saved with CaptureFrame().
+	bool headless = false;
+	// Ask for a CPU implementation of WebGPU (lavapipe, SwiftShader, WARP...)
+	bool forceFallbackAdapter = false;
+	// Time the render pass on the GPU with timestamp queries, when the
+	// adapter supports them. Results go to the Profiler while it is enabled.
+	bool gpuTimestamps = false;
+	// Upload the mesh as CompactVertex (16 bytes) rather than
+	// VertexAttributes (36 bytes). Attributes lose some precision.
+	bool compactVertices = false;
+	// Shade with the vertex colors rather than the normals
+	bool vertexColors = false;
+	// Record the draws into render bundles on the thread pool, reused across
+	// frames while they do not change, rather than into the render pass
+	bool renderBundles = false;
+	// Draw the instances nearest to the camera into a small depth buffer on
+	// the CPU, and skip the instances they entirely hide
+	bool occlusionCulling = false;
+	// Directory of the shaders, and of the mesh when meshPath is empty
+	fs::path resourceDirectory = RESOURCE_DIR;
+	// Mesh to draw, mammoth.obj of the resource directory when empty
+	fs::path meshPath;
+};
 
 class Renderer {
 public:
@@ -38,7 +80,7 @@ public:
 	Renderer();
 
 	// Initialize everything and return true if it went all right
-	bool Initialize();
+	bool Initialize(const RendererOptions& rendererOptions = RendererOptions());
 
 	// Uninitialize everything that was initialized
 	void Terminate();
@@ -49,6 +91,33 @@ public:
 	// Return true as long as the main loop should keep on running
 	bool IsRunning();
 
+	// Return true while assets are still loading or being uploaded. Frames
+	// render meanwhile, with whatever is already resident.
+	bool IsLoading() const;
+
+	// Return true if the shader or the mesh could not be loaded, in which
+	// case the frames stay empty
+	bool LoadFailed() const;
+
+	// Copies of the mesh drawn every frame, each with its own transform
+	// (applied before the model matrix) and color. There is a single
+	// identity instance until ClearInstances() is called. An instance added
+	// under a parent instance is placed relative to it, and follows it when
+	// SetInstanceTransform() moves it.
+	static constexpr uint32_t NoParentInstance = UINT32_MAX;
+	void ClearInstances();
+	bool AddInstance(const mat4x4& modelMatrix, const vec4& color, uint32_t parentInstance = NoParentInstance);
+	void SetInstanceTransform(uint32_t instance, const mat4x4& modelMatrix);
+
+	// Write the last rendered frame to a binary PPM image. Headless mode only.
+	bool CaptureFrame(const fs::path& path);
+
+	// Requests, hits and misses of the pipeline cache so far
+	void PrintPipelineCacheStats(std::ostream& out) const;
+
+	// Occupancy and fragmentation of the pages the buffers are carved from
+	void PrintBufferPoolStats(std::ostream& out) const;
+
 private:
 	TextureView GetNextSurfaceTextureView();
 
@@ -59,42 +128,157 @@ private:
 	void InitializeBuffers();
 	void InitializeUniforms();
 
+	// Declare the passes of a frame and their resources in frameGraph, then
+	// compile it and create the textures and buffers of its allocations.
+	// ExecuteFrameGraph() compiles it again after its passes changed.
+	void InitializeFrameGraph();
+	bool CompileFrameGraph();
+	void ReleaseFrameGraphResources();
+	// Encode the passes the graph kept, the surface texture being targetView
+	void ExecuteFrameGraph(CommandEncoder encoder, TextureView targetView);
+	// Draws of the scene pass
+	void EncodeScenePass(WebGpuRenderPass& pass);
+
+	// Substep of MainLoop() that takes the assets finished by the loader and
+	// streams the mesh to the GPU, UploadBudgetPerFrame bytes at a time
+	void ProcessLoadedAssets();
+
+	// Bounds of every instance, from those of the mesh, for the frustum
+	// culling of MainLoop()
+	void UpdateInstanceBounds();
+	// Clear instanceVisibility for the instances the nearest ones hide
+	void CullOccludedInstances(const mat4x4& modelView);
+
+	// Request the render pipeline from the cache once the shader sources are
+	// there, with the shader variant that matches the options. It compiles in
+	// the background.
+	void CreateRenderPipeline();
+
+	// Create the vertex and index buffers of a loaded mesh, then fill them
+	// a slice per frame. The GPU indices are uint16_t if
+	// fitsUint16Indices(vertexCount), uint32_t otherwise; 32-bit source
+	// indices are narrowed on the way when needed, and vertices are encoded
+	// as CompactVertex if options.compactVertices. ContinueMeshUpload()
+	// returns true once everything is written.
+	void BeginMeshUpload(std::unique_ptr<LoadedAsset> asset);
+	bool ContinueMeshUpload(uint64_t byteBudget);
+	void FinishMeshUpload();
+	// Occluder meshes of occlusion culling, one per level of the mesh small
+	// enough to be rasterized on the CPU
+	void BuildOccluderMesh(const MeshData& data);
+	// Uniform block and bind group of every material, the default one first
+	void CreateMaterials(const std::vector<Material>& materials);
+	void UploadVertices(const VertexAttributes* vertices, size_t first, size_t count);
+	void UploadIndices(const void* indices, size_t indexStride, size_t first, size_t count);
+
 	bool loadGeometry(const fs::path& path, 
 					std::vector<float>& pointData,
 					std::vector<float>& colorData, 
 					std::vector<uint16_t>& indexData,
 					std::vector<float>& normalData);
 
-	ShaderModule loadShaderModule(const fs::path& path);
-
-	bool loadGeometryFromObj(const fs::path& path, 
-							std::vector<VertexAttributes>& vertexData);
-
-
 private:
 	// We put here all the variables that are shared between init and main loop
-	GLFWwindow *window;
+	RendererOptions options;
+	GLFWwindow *window = nullptr;
 	Device device;
 	Queue queue;
 	Surface surface;
 	std::unique_ptr<ErrorCallback> uncapturedErrorCallbackHandle;
+	std::unique_ptr<WebGpuBackend> backend;
+	std::unique_ptr<PipelineCache> pipelineCache;
+	std::unique_ptr<ShaderVariants> shaderVariants;
+	std::unique_ptr<BufferAllocator> bufferAllocator;
+	std::unique_ptr<StreamingUploader> uploader;
+	std::unique_ptr<AssetLoader> assetLoader;
+	AssetHandle shaderHandle;
+	AssetHandle meshHandle;
+	// Mesh being streamed to the GPU, and how much of it was written
+	std::unique_ptr<LoadedAsset> meshUpload;
+	size_t uploadedVertices = 0;
+	size_t uploadedIndices = 0;
+	PositionDecode positionDecode;
+	// Time to first frame, and to the first frame with the mesh
+	std::chrono::steady_clock::time_point initializeStart;
+	bool firstFrameReported = false;
+	bool firstMeshFrameReported = false;
 	TextureFormat surfaceFormat = TextureFormat::Undefined;
-	RenderPipeline pipeline;
+	Texture offscreenTexture = nullptr;
+	uint64_t frameIndex = 0;
+	uint64_t residentFrameIndex = 0;
+	PipelineLayout pipelineLayout = nullptr;
+	PipelineId pipelineId = InvalidPipelineId;
 	
-	Buffer pointBuffer;
-    Buffer indexBuffer;
+	// Regions of the mesh in the pages of bufferAllocator
+	BufferAllocation vertexAllocation;
+	BufferAllocation indexAllocation;
 	Buffer colorBuffer;
 	Buffer normalBuffer;
+	uint32_t vertexCount;
 	uint32_t indexCount;
+	IndexFormat indexFormat;
+	// Levels of detail of the mesh, and its bounding sphere to select them.
+	// selectionLods has the largest error of every level among the submeshes.
+	std::vector<MeshLod> lods;
+	std::vector<MeshLod> selectionLods;
+	glm::vec4 meshBounds = glm::vec4(0.0f);
+	glm::vec3 meshBoxMin = glm::vec3(0.0f);
+	glm::vec3 meshBoxMax = glm::vec3(0.0f);
+	// Transforms of the model, turning every frame, of the mesh placed in
+	// it, whose world matrix is uniforms.modelMatrix, and of the instances,
+	// copied to the instance batch when they change
+	TransformHierarchy transforms;
+	TransformId modelTransform = InvalidTransform;
+	TransformId meshTransform = InvalidTransform;
+	std::vector<TransformId> instanceTransforms;
+	bool instanceTransformsDirty = false;
+	// Bounds of the instances, rebuilt when they or the mesh change, and
+	// which of them the last frame saw
+	SceneBounds instanceBounds;
+	std::vector<uint8_t> instanceVisibility;
+	bool instanceBoundsDirty = true;
+	// Boxes of the instances, the levels of the mesh that the nearest of
+	// them are drawn with, those that fit the triangle budget, and the depth
+	// buffer they go to, with options.occlusionCulling
+	std::vector<glm::vec3> instanceBoxMin;
+	std::vector<glm::vec3> instanceBoxMax;
+	std::vector<glm::vec3> occluderPositions;
+	std::vector<uint32_t> occluderIndices;
+	std::vector<MeshLod> occluderLods;
+	std::vector<std::pair<float, uint32_t>> occluderOrder;
+	std::unique_ptr<OcclusionCuller> occlusionCuller;
+	// Draw table of the mesh, sorted by material
+	std::vector<Submesh> submeshes;
+	BindGroupLayout materialBindGroupLayout = nullptr; // owned by pipelineCache
+	BufferAllocation materialAllocation;
+	std::vector<BindGroup> materialBindGroups;
+	// Clusters of the full mesh, culled every frame, and the visible ranges
+	// of every submesh
+	std::unique_ptr<MeshletCuller> meshletCuller;
+	std::vector<std::vector<IndexRange>> fullDetailRanges;
 
-	Buffer uniformBuffer;
+	std::unique_ptr<UniformRing> uniformRing;
+	std::unique_ptr<InstanceBatch> instances;
+	// Draws of the frame and the bundles they are recorded into, with
+	// options.renderBundles
+	DrawList drawList;
+	std::unique_ptr<RenderBundles> renderBundles;
+	std::unique_ptr<GpuTimer> gpuTimer;
 	BindGroup bindGroup;
 
 	MyUniforms uniforms;
-	uint32_t* uniformStride;
-
-	Texture depthTexture;
-	TextureView depthTextureView;
 
-	std::vector<VertexAttributes> vertexData;
+	// Passes of a frame, and a texture or buffer per allocation of the
+	// graph, created when it is compiled
+	RenderGraph frameGraph;
+	RenderGraph::ResourceId frameTarget = 0;
+	RenderGraph::PassId scenePass = 0;
+	std::vector<Texture> graphTextures;
+	std::vector<TextureView> graphTextureViews;
+	std::vector<Buffer> graphBuffers;
+	// What the scene pass draws in the frame being encoded, no pipeline
+	// until the shader and the mesh are resident
+	RenderPipeline framePipeline = nullptr;
+	uint32_t frameDynamicOffset = 0;
+	const std::vector<IndexRange>* frameFullDetailRanges = nullptr;
 };
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "alloc-counter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<uint64_t> allocationCount{ 0 };
+
+void* countedAllocate(std::size_t size) {
+	allocationCount.fetch_add(1, std::memory_order_relaxed);
+	if (void* pointer = std::malloc(size == 0 ? 1 : size)) {
+		return pointer;
+	}
+	throw std::bad_alloc();
+}
+
+} // anonymous namespace
+
+
+uint64_t heapAllocationCount() {
+	return allocationCount.load(std::memory_order_relaxed);
+}
+
+
+// With the usual standard libraries, the other forms of new and delete
+// (nothrow) end up in these ones.
+// Over-aligned allocations keep the library's own functions.
+void* operator new(std::size_t size) {
+	return countedAllocate(size);
+}
+
+
+void* operator new[](std::size_t size) {
+	return countedAllocate(size);
+}
+
+
+void operator delete(void* pointer) noexcept {
+	std::free(pointer);
+}
+
+
+void operator delete[](void* pointer) noexcept {
+	std::free(pointer);
+}
+
+
+void operator delete(void* pointer, std::size_t /* size */) noexcept {
+	std::free(pointer);
+}
+
+
+void operator delete[](void* pointer, std::size_t /* size */) noexcept {
+	std::free(pointer);
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Number of heap allocations made by the process so far, counted by a
+ * replacement of the global operator new. The benchmarks compare it before
+ * and after a frame to catch allocations creeping into per-frame code.
+ *
+ * Counting costs a relaxed atomic increment per allocation.
+ */
+uint64_t heapAllocationCount();
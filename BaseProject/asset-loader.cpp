@@ -0,0 +1,92 @@
+#include "asset-loader.h"
+#include "thread-pool.h"
+#include "geometry-codec.h"
+#include "profiler.h"
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+bool MeshData::load(const fs::path& path, const MeshLoaderOptions& options) {
+	// Compressed meshes were processed when they were written, whatever the
+	// options are now
+	if (path.extension() == ".meshz") {
+		cached = false;
+		return readCompressedMesh(path, mesh);
+	}
+	cached = cache.open(path, options);
+	if (cached) {
+		return true;
+	}
+	if (!loadGeometryFromObj(path, mesh, options)) {
+		return false;
+	}
+	cache.store(mesh);
+	return true;
+}
+
+
+AssetLoader::AssetLoader(ThreadPool& pool)
+	: pool(pool)
+{}
+
+
+AssetLoader::~AssetLoader() {
+	std::lock_guard<std::mutex> lock(tasksMutex);
+	for (std::future<void>& task : tasks) {
+		task.wait();
+	}
+}
+
+
+template <typename Load>
+AssetHandle AssetLoader::request(AssetType type, const fs::path& path, Load load) {
+	AssetHandle handle(nextId++, std::make_shared<std::atomic<AssetState>>(AssetState::Loading));
+	pending.fetch_add(1, std::memory_order_acq_rel);
+
+	std::future<void> task = pool.submit([this, handle, type, path, load]() {
+		auto start = std::chrono::steady_clock::now();
+		auto asset = std::make_unique<LoadedAsset>();
+		asset->handle = handle;
+		asset->type = type;
+		asset->path = path;
+		asset->failed = !load(*asset);
+		asset->loadMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		handle.setState(asset->failed ? AssetState::Failed : AssetState::Loaded);
+		finished.push(std::move(asset));
+	});
+
+	std::lock_guard<std::mutex> lock(tasksMutex);
+	tasks.push_back(std::move(task));
+	return handle;
+}
+
+
+AssetHandle AssetLoader::loadShader(const fs::path& path) {
+	return request(AssetType::Shader, path, [path](LoadedAsset& asset) {
+		PROFILE_ZONE("Load shader");
+		return loadShaderSources(path, asset.shaderSources);
+	});
+}
+
+
+AssetHandle AssetLoader::loadMesh(const fs::path& path, const MeshLoaderOptions& options) {
+	return request(AssetType::Mesh, path, [path, options](LoadedAsset& asset) {
+		PROFILE_ZONE("Load mesh");
+		if (!asset.mesh.load(path, options)) {
+			std::cout << "*** ERROR *** Could not load mesh " << path << std::endl;
+			return false;
+		}
+		return true;
+	});
+}
+
+
+bool AssetLoader::poll(std::unique_ptr<LoadedAsset>& asset) {
+	if (!finished.pop(asset)) {
+		return false;
+	}
+	pending.fetch_sub(1, std::memory_order_acq_rel);
+	return true;
+}
@@ -0,0 +1,137 @@
+#pragma once
+
+#include "mesh.h"
+#include "mesh-loader.h"
+#include "mesh-cache.h"
+#include "mpsc-queue.h"
+#include "wgsl-preprocessor.h"
+
+#include <atomic>
+#include <filesystem>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+class ThreadPool;
+
+/**
+ * Loading of assets on the worker threads of a ThreadPool, so that the render
+ * loop never waits for the disk or for the parsers.
+ *
+ *     AssetHandle mesh = loader.loadMesh(path, options);
+ *     ...
+ *     // Every frame, on the render thread
+ *     std::unique_ptr<LoadedAsset> asset;
+ *     while (loader.poll(asset)) { create its GPU objects, upload it }
+ *
+ * Requests return right away with a handle that any thread can query.
+ * Finished assets go through a lock-free queue to the render thread, which
+ * owns the device and uploads them at its own pace.
+ */
+
+enum class AssetState {
+	Loading,
+	Loaded,  // waiting in the queue or being uploaded by the render thread
+	Ready,   // resident on the GPU, set by the render thread
+	Failed,
+};
+
+class AssetHandle {
+public:
+	AssetHandle() = default;
+
+	uint32_t id() const { return assetId; }
+	bool valid() const { return status != nullptr; }
+	AssetState state() const { return status ? status->load(std::memory_order_acquire) : AssetState::Failed; }
+
+	// Render thread, once the asset is usable
+	void setState(AssetState newState) const { if (status) status->store(newState, std::memory_order_release); }
+
+private:
+	friend class AssetLoader;
+	AssetHandle(uint32_t id, std::shared_ptr<std::atomic<AssetState>> status)
+		: assetId(id), status(std::move(status)) {}
+
+	uint32_t assetId = 0;
+	std::shared_ptr<std::atomic<AssetState>> status;
+};
+
+// A mesh either mapped from its cache or freshly parsed, behind the same
+// accessors as MeshCache
+class MeshData {
+public:
+	// Load from the cache if it is up to date, otherwise parse the OBJ and
+	// refresh the cache. A .meshz file is decompressed instead.
+	bool load(const fs::path& path, const MeshLoaderOptions& options);
+
+	bool fromCache() const { return cached; }
+	const VertexAttributes* vertices() const { return cached ? cache.vertices() : mesh.vertices.data(); }
+	size_t vertexCount() const { return cached ? cache.vertexCount() : mesh.vertices.size(); }
+	const void* indexData() const { return cached ? cache.indexData() : mesh.indices.data(); }
+	size_t indexCount() const { return cached ? cache.indexCount() : mesh.indices.size(); }
+	uint32_t indexStride() const { return cached ? cache.indexStride() : uint32_t(sizeof(uint32_t)); }
+	std::vector<MeshLod> lods() const { return cached ? cache.lods() : mesh.lods; }
+	std::vector<Meshlet> meshlets() const { return cached ? cache.meshlets() : mesh.meshlets; }
+	std::vector<Submesh> submeshes() const { return cached ? cache.submeshes() : mesh.submeshes; }
+	std::vector<Material> materials() const { return cached ? cache.materials() : mesh.materials; }
+
+private:
+	MeshCache cache;
+	Mesh mesh;
+	bool cached = false;
+};
+
+enum class AssetType {
+	Shader,
+	Mesh,
+};
+
+// Result of a request, handed to the render thread
+struct LoadedAsset {
+	AssetHandle handle;
+	AssetType type;
+	fs::path path;
+	bool failed = false;
+	double loadMs = 0.0;    // time spent on the worker
+	ShaderSources shaderSources;
+	MeshData mesh;
+};
+
+class AssetLoader {
+public:
+	explicit AssetLoader(ThreadPool& pool);
+
+	// Wait for the requests still running, their results are dropped
+	~AssetLoader();
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	// Read a WGSL file and the files it includes
+	AssetHandle loadShader(const fs::path& path);
+
+	AssetHandle loadMesh(const fs::path& path, const MeshLoaderOptions& options);
+
+	// Render thread: take the next finished request, failed ones included.
+	// Return false if none is finished yet.
+	bool poll(std::unique_ptr<LoadedAsset>& asset);
+
+	// Requests not yet taken by poll()
+	uint32_t pendingCount() const { return pending.load(std::memory_order_acquire); }
+
+private:
+	template <typename Load>
+	AssetHandle request(AssetType type, const fs::path& path, Load load);
+
+	ThreadPool& pool;
+	MpscQueue<std::unique_ptr<LoadedAsset>> finished;
+	std::atomic<uint32_t> pending{ 0 };
+	uint32_t nextId = 1;
+	std::mutex tasksMutex;
+	std::vector<std::future<void>> tasks;
+};
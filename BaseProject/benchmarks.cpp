@@ -0,0 +1,2859 @@
+#include "benchmarks.h"
+
+#include "mesh-loader.h"
+#include "mesh-cache.h"
+#include "obj-parser.h"
+#include "thread-pool.h"
+#include "number-scanner.h"
+#include "staging-ring.h"
+#include "process-stats.h"
+#include "recording-backend.h"
+#include "uniform-ring.h"
+#include "instance-batch.h"
+#include "uniforms.h"
+#include "profiler.h"
+#include "frame-encoder.h"
+#include "alloc-counter.h"
+#include "compact-vertex.h"
+#include "mesh-optimizer.h"
+#include "mesh-simplifier.h"
+#include "lod-selector.h"
+#include "meshlets.h"
+#include "asset-loader.h"
+#include "mpsc-queue.h"
+#include "geometry-codec.h"
+#include "pipeline-cache.h"
+#include "wgsl-preprocessor.h"
+#include "shader-variants.h"
+#include "buddy-allocator.h"
+#include "buffer-allocator.h"
+#include "scene-bounds.h"
+#include "transform-hierarchy.h"
+#include "render-bundles.h"
+#include "render-graph.h"
+#include "occlusion-culler.h"
+
+#include "tiny_obj_loader.h"
+
+#include <iostream>
+#include <chrono>
+#include <functional>
+#include <map>
+#include <algorithm>
+#include <thread>
+#include <random>
+#include <sstream>
+#include <cstring>
+#include <cstdlib>
+#include <cctype>
+#include <cmath>
+#include <deque>
+#include <memory>
+#include <array>
+#include <tuple>
+#include <fstream>
+#include <iomanip>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+double elapsedMs(Clock::time_point start) {
+	return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+const char* DefaultObjPath = "resources/piramide.obj";
+
+// Compare a cold OBJ parse with a warm load from the binary mesh cache, and
+// check that editing a material library invalidates the cache
+int benchmarkMeshCache(const std::vector<std::string>& args) {
+	fs::path objPath = args.empty() ? DefaultObjPath : args[0];
+	MeshLoaderOptions options;
+
+	auto start = Clock::now();
+	Mesh mesh;
+	if (!loadGeometryFromObj(objPath, mesh, options)) {
+		return 1;
+	}
+	double coldMs = elapsedMs(start);
+
+	MeshCache cache;
+	cache.open(objPath, options);
+	if (!cache.store(mesh)) {
+		return 1;
+	}
+	cache.close();
+
+	const int runs = 5;
+	double warmMs = 0.0;
+	for (int run = 0; run < runs; ++run) {
+		start = Clock::now();
+		if (!cache.open(objPath, options)) {
+			std::cout << "*** ERROR *** Freshly written cache is invalid" << std::endl;
+			return 1;
+		}
+		if (cache.lods().size() != mesh.lods.size() || cache.meshlets().size() != mesh.meshlets.size()
+			|| cache.submeshes().size() != mesh.submeshes.size() || cache.materials().size() != mesh.materials.size()) {
+			std::cout << "*** ERROR *** Cached levels of detail or meshlets do not match the mesh" << std::endl;
+			return 1;
+		}
+		// Touch every page, like the upload to the GPU does
+		const uint8_t* bytes = reinterpret_cast<const uint8_t*>(cache.vertices());
+		size_t byteSize = cache.vertexCount() * sizeof(VertexAttributes);
+		volatile uint8_t sink = 0;
+		for (size_t i = 0; i < byteSize; i += 4096) sink = sink + bytes[i];
+		bytes = reinterpret_cast<const uint8_t*>(cache.indexData());
+		byteSize = cache.indexCount() * cache.indexStride();
+		for (size_t i = 0; i < byteSize; i += 4096) sink = sink + bytes[i];
+		double ms = elapsedMs(start);
+		warmMs = run == 0 ? ms : std::min(warmMs, ms);
+		cache.close();
+	}
+
+	// The cache of an OBJ file goes stale with its material library
+	fs::path materialObjPath = fs::temp_directory_path() / "mesh-cache-materials.obj";
+	fs::path materialLibPath = fs::temp_directory_path() / "mesh-cache-materials.mtl";
+	std::ofstream(materialLibPath) << "newmtl red\nKd 1 0 0\n";
+	std::ofstream(materialObjPath) << "mtllib mesh-cache-materials.mtl\nv 0 0 0\nv 1 0 0\nv 0 1 0\nvn 0 0 1\nusemtl red\nf 1//1 2//1 3//1\n";
+	Mesh triangle;
+	bool valid = loadGeometryFromObj(materialObjPath, triangle, options);
+	cache.open(materialObjPath, options);
+	valid = valid && cache.store(triangle) && cache.open(materialObjPath, options);
+	cache.close();
+	std::ofstream(materialLibPath) << "newmtl red\nKd 0 1 0\n";
+	valid = valid && !cache.open(materialObjPath, options);
+	cache.close();
+	if (!valid) {
+		std::cout << "*** ERROR *** The cache outlives an edit of the material library" << std::endl;
+		return 1;
+	}
+
+	std::cout << "mesh-cache: " << objPath << ", " << mesh.vertices.size() << " vertices, "
+		<< mesh.indices.size() << " indices" << std::endl;
+	std::cout << "  cold OBJ parse:   " << coldMs << " ms" << std::endl;
+	std::cout << "  warm cache load:  " << warmMs << " ms (best of " << runs << ")" << std::endl;
+	std::cout << "  speedup:          " << coldMs / warmMs << "x" << std::endl;
+	return 0;
+}
+
+// Throughput of tinyobj::LoadObj against loadObjParallel at 1..N threads
+int benchmarkObjParse(const std::vector<std::string>& args) {
+	fs::path objPath = args.size() < 1 ? DefaultObjPath : args[0];
+	unsigned maxThreads = args.size() < 2 ? std::max(1u, std::thread::hardware_concurrency()) : std::stoul(args[1]);
+
+	std::error_code ec;
+	double megabytes = static_cast<double>(fs::file_size(objPath, ec)) / (1024.0 * 1024.0);
+	if (ec) {
+		std::cout << "*** ERROR *** Cannot open " << objPath << std::endl;
+		return 1;
+	}
+
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+
+	auto start = Clock::now();
+	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, objPath.string().c_str())) {
+		std::cout << err << std::endl;
+		return 1;
+	}
+	double referenceMs = elapsedMs(start);
+	size_t referenceVertices = attrib.vertices.size();
+	size_t referenceCorners = 0;
+	for (const auto& shape : shapes) referenceCorners += shape.mesh.indices.size();
+
+	std::cout << "obj-parse: " << objPath << ", " << megabytes << " MB" << std::endl;
+	std::cout << "  tinyobj::LoadObj:        " << megabytes / (referenceMs / 1000.0) << " MB/s" << std::endl;
+
+	for (unsigned threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(2 * threads, maxThreads) : threads + 1) {
+		ThreadPool pool(threads);
+		warn.clear();
+		err.clear();
+		start = Clock::now();
+		if (!loadObjParallel(objPath, attrib, shapes, materials, warn, err, pool)) {
+			std::cout << err << std::endl;
+			return 1;
+		}
+		double ms = elapsedMs(start);
+
+		size_t corners = 0;
+		for (const auto& shape : shapes) corners += shape.mesh.indices.size();
+		bool same = attrib.vertices.size() == referenceVertices && corners == referenceCorners;
+
+		std::cout << "  loadObjParallel x" << threads << (threads < 10 ? ":   " : ":  ")
+			<< megabytes / (ms / 1000.0) << " MB/s (" << referenceMs / ms << "x)"
+			<< (same ? "" : " *** MISMATCH ***") << std::endl;
+	}
+	return 0;
+}
+
+// Random decimal strings, biased towards what appears in geometry files
+// but also covering long mantissas and extreme exponents.
+std::string randomNumber(std::mt19937_64& rng) {
+	std::uniform_int_distribution<int> percent(0, 99);
+	std::uniform_int_distribution<int> digit(0, 9);
+	std::string text;
+	if (percent(rng) < 40) text += '-';
+	else if (percent(rng) < 5) text += '+';
+	int integerDigits = percent(rng) < 80 ? 1 + percent(rng) % 3 : percent(rng) % 25;
+	int fractionDigits = percent(rng) < 70 ? 1 + percent(rng) % 7 : percent(rng) % 25;
+	for (int i = 0; i < integerDigits; ++i) text += char('0' + digit(rng));
+	if (fractionDigits > 0 || integerDigits == 0) {
+		text += '.';
+		for (int i = 0; i < std::max(1, fractionDigits); ++i) text += char('0' + digit(rng));
+	}
+	if (percent(rng) < 20) {
+		text += percent(rng) < 50 ? 'e' : 'E';
+		if (percent(rng) < 50) text += '-';
+		int range = percent(rng) < 80 ? 40 : 400;
+		text += std::to_string(std::uniform_int_distribution<int>(0, range)(rng));
+	}
+	return text;
+}
+
+// Differential check of scanDouble against strtod, then throughput of the
+// scanner compared to strtod and std::istringstream.
+int benchmarkNumberScan(const std::vector<std::string>& args) {
+	size_t fuzzCount = args.empty() ? 2000000 : std::stoul(args[0]);
+
+	std::mt19937_64 rng(1234);
+	static const char* specialCases[] = {
+		"0", "-0", "0.0", "-0.0", ".5", "5.", "1e22", "1e23", "9007199254740993",
+		"179769313486231570000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000000",
+		"4.9e-324", "2.4703282292062327e-324", "1e-400", "1e400", "0x1p3", "inf", "-nan", "1e", "1e+", "00000000000000000000000000001.5",
+		"0.30000000000000004", "123456789012345678", "1234567890123456789", "12345678901234567890", "3.4028235e38",
+	};
+	size_t mismatches = 0;
+	auto check = [&](const std::string& text) {
+		char* expectedEnd = nullptr;
+		double expected = std::strtod(text.c_str(), &expectedEnd);
+		double actual = 0.0;
+		const char* actualEnd = scanDouble(text.data(), text.data() + text.size(), actual);
+		bool expectedFound = expectedEnd != text.c_str();
+		bool same = expectedFound == (actualEnd != nullptr);
+		if (same && expectedFound) {
+			same = std::memcmp(&expected, &actual, sizeof(double)) == 0 && actualEnd - text.data() == expectedEnd - text.c_str();
+		}
+		if (!same && ++mismatches <= 10) {
+			std::cout << "  MISMATCH on '" << text << "': strtod " << expected << ", scanDouble " << actual << std::endl;
+		}
+	};
+	for (const char* text : specialCases) check(text);
+	for (size_t i = 0; i < fuzzCount; ++i) check(randomNumber(rng));
+	std::cout << "number-scan: " << fuzzCount << " random numbers, " << mismatches << " mismatches against strtod" << std::endl;
+
+	// Throughput on a typical vertex stream
+	std::ostringstream stream;
+	std::uniform_real_distribution<float> coordinate(-1.0f, 1.0f);
+	const size_t valueCount = 3000000;
+	for (size_t i = 0; i < valueCount; ++i) {
+		char number[32];
+		std::snprintf(number, sizeof(number), "%.6f", coordinate(rng));
+		stream << number << ((i % 3 == 2) ? '\n' : ' ');
+	}
+	std::string text = stream.str();
+	double megabytes = static_cast<double>(text.size()) / (1024.0 * 1024.0);
+	std::vector<float> values(valueCount);
+
+	auto start = Clock::now();
+	const char* p = text.data();
+	size_t parsed = 0;
+	while (parsed < valueCount) {
+		size_t count = scanFloats(p, text.data() + text.size(), values.data() + parsed, valueCount - parsed);
+		if (count == 0) ++p; // newline
+		parsed += count;
+	}
+	double scannerMs = elapsedMs(start);
+
+	start = Clock::now();
+	char* q = const_cast<char*>(text.c_str());
+	for (size_t i = 0; i < valueCount; ++i) values[i] = static_cast<float>(std::strtod(q, &q));
+	double strtodMs = elapsedMs(start);
+
+	start = Clock::now();
+	std::istringstream iss(text);
+	for (size_t i = 0; i < valueCount; ++i) iss >> values[i];
+	double streamMs = elapsedMs(start);
+
+	std::cout << "  scanFloats:         " << megabytes / (scannerMs / 1000.0) << " MB/s" << std::endl;
+	std::cout << "  strtod:             " << megabytes / (strtodMs / 1000.0) << " MB/s" << std::endl;
+	std::cout << "  std::istringstream: " << megabytes / (streamMs / 1000.0) << " MB/s" << std::endl;
+	return mismatches == 0 ? 0 : 1;
+}
+
+// Position dependent checksum of bytes meant to land at dstOffset, the same
+// whatever the order and granularity of the copies
+uint64_t placedChecksum(const uint8_t* data, uint64_t size, uint64_t dstOffset) {
+	uint64_t sum = 0;
+	for (uint64_t i = 0; i < size; ++i) {
+		sum += data[i] * (dstOffset + i + 1);
+	}
+	return sum;
+}
+
+// Push a mesh through a StagingRing with a simulated GPU that completes one
+// chunk per poll, and compare the peak host memory with a one-shot copy of
+// the whole mesh (what queue.writeBuffer keeps until the upload is done).
+int benchmarkUploadRing(const std::vector<std::string>& args) {
+	fs::path objPath = args.size() > 0 ? args[0] : DefaultObjPath;
+	uint32_t chunkCount = args.size() > 1 ? static_cast<uint32_t>(std::stoul(args[1])) : 4;
+	uint64_t chunkSize = (args.size() > 2 ? std::stoull(args[2]) : 4096) * 1024;
+
+	Mesh mesh;
+	if (!loadGeometryFromObj(objPath, mesh)) {
+		return 1;
+	}
+	const uint8_t* vertexBytes = reinterpret_cast<const uint8_t*>(mesh.vertices.data());
+	const uint8_t* indexBytes = reinterpret_cast<const uint8_t*>(mesh.indices.data());
+	uint64_t vertexByteSize = mesh.vertices.size() * sizeof(VertexAttributes);
+	uint64_t indexByteSize = mesh.indices.size() * sizeof(uint32_t);
+	uint64_t totalSize = vertexByteSize + indexByteSize;
+	double loadedMiB = peakResidentMiB();
+
+	StagingRing ring(chunkCount, chunkSize);
+	std::vector<std::vector<uint8_t>> staging(ring.chunkCount(), std::vector<uint8_t>(ring.chunkSize()));
+	struct Copy { uint32_t chunk; uint64_t chunkOffset; uint64_t dstOffset; uint64_t size; };
+	std::vector<std::vector<Copy>> copies(ring.chunkCount());
+	std::deque<uint32_t> inFlight;
+	uint64_t gpuChecksum = 0;
+
+	auto gpuComplete = [&]() {
+		uint32_t chunk = inFlight.front();
+		inFlight.pop_front();
+		for (const Copy& copy : copies[chunk]) {
+			gpuChecksum += placedChecksum(staging[chunk].data() + copy.chunkOffset, copy.size, copy.dstOffset);
+		}
+		copies[chunk].clear();
+		ring.recycle(chunk);
+	};
+	auto submit = [&]() {
+		int chunk = ring.submit();
+		if (chunk >= 0) inFlight.push_back(static_cast<uint32_t>(chunk));
+	};
+	auto write = [&](const uint8_t* src, uint64_t dstOffset, uint64_t size) {
+		while (size > 0) {
+			while (ring.acquire() < 0) gpuComplete();
+			uint64_t chunkOffset = 0;
+			uint64_t granted = ring.reserve(size, chunkOffset);
+			if (granted == 0) {
+				submit();
+				continue;
+			}
+			uint32_t chunk = static_cast<uint32_t>(ring.current());
+			std::memcpy(staging[chunk].data() + chunkOffset, src, granted);
+			copies[chunk].push_back({ chunk, chunkOffset, dstOffset, granted });
+			src += granted;
+			dstOffset += granted;
+			size -= granted;
+		}
+	};
+
+	auto start = Clock::now();
+	write(vertexBytes, 0, vertexByteSize);
+	write(indexBytes, vertexByteSize, indexByteSize);
+	submit();
+	while (!inFlight.empty()) gpuComplete();
+	double ringMs = elapsedMs(start);
+	double ringMiB = peakResidentMiB();
+
+	uint64_t expectedChecksum = placedChecksum(vertexBytes, vertexByteSize, 0) + placedChecksum(indexBytes, indexByteSize, vertexByteSize);
+
+	start = Clock::now();
+	std::vector<uint8_t> oneShot(totalSize);
+	std::memcpy(oneShot.data(), vertexBytes, vertexByteSize);
+	std::memcpy(oneShot.data() + vertexByteSize, indexBytes, indexByteSize);
+	double oneShotMs = elapsedMs(start);
+	double oneShotMiB = peakResidentMiB();
+
+	double megabytes = static_cast<double>(totalSize) / (1024.0 * 1024.0);
+	std::cout << "upload-ring: " << objPath << ", " << megabytes << " MiB of vertices and indices" << std::endl;
+	std::cout << "  peak RSS after load:   " << loadedMiB << " MiB" << std::endl;
+	std::cout << "  staging ring:          " << ring.chunkCount() << " x " << ring.chunkSize() / 1024 << " KiB, "
+		<< ring.submittedCount() << " chunks submitted, " << ring.stallCount() << " stalls, "
+		<< megabytes / (ringMs / 1000.0) << " MB/s, peak RSS " << ringMiB << " MiB" << std::endl;
+	std::cout << "  one-shot staging copy: " << megabytes / (oneShotMs / 1000.0) << " MB/s, peak RSS " << oneShotMiB << " MiB" << std::endl;
+	if (gpuChecksum != expectedChecksum) {
+		std::cout << "*** ERROR *** Data uploaded through the ring does not match the mesh" << std::endl;
+		return 1;
+	}
+	return 0;
+}
+
+// CPU cost of encoding a frame that draws many copies of a mesh, with one
+// uniform block and draw call per copy or with a single instanced draw.
+// Commands go to a RecordingBackend, so only the CPU side is measured.
+int benchmarkInstancing(const std::vector<std::string>& args) {
+	uint32_t objectCount = args.empty() ? 10000 : static_cast<uint32_t>(std::stoul(args[0]));
+	const uint32_t indexCount = 36000;
+	const uint32_t uniformAlignment = 256;
+	const int frames = 100;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+	std::vector<glm::mat4x4> transforms(objectCount, glm::mat4x4(1.0f));
+	for (glm::mat4x4& transform : transforms) {
+		transform[3] = glm::vec4(coordinate(rng), coordinate(rng), coordinate(rng), 1.0f);
+	}
+	const glm::vec4 color(0.0f, 1.0f, 0.4f, 1.0f);
+
+	RecordingBackend recorder;
+	UniformRing uniformRing(recorder, uniformAlignment, uint64_t(objectCount) * uniformAlignment);
+	InstanceBatch instances(recorder, objectCount);
+	MyUniforms uniforms = {};
+	std::vector<uint32_t> offsets(objectCount);
+	const MeshLod lod = { 0, indexCount, 0.0f, 0 };
+	SceneBindings scene;
+	scene.lods = &lod;
+	scene.lodCount = 1;
+
+	auto report = [&](const char* name, double ms) {
+		std::cout << "  " << name << ms * 1000.0 / frames << " us/frame, "
+			<< recorder.commands().size() << " commands, "
+			<< recorder.count(RecordingBackend::CommandType::DrawIndexed) << " draws, "
+			<< recorder.bytes(RecordingBackend::CommandType::WriteBuffer) << " bytes written" << std::endl;
+	};
+
+	// One uniform block and one draw call per object
+	auto start = Clock::now();
+	for (int frame = 0; frame < frames; ++frame) {
+		recorder.clear();
+		uniformRing.beginFrame();
+		for (uint32_t i = 0; i < objectCount; ++i) {
+			uniforms.modelMatrix = transforms[i];
+			offsets[i] = uniformRing.push(uniforms);
+		}
+		uniformRing.flush();
+		recorder.setPipeline(nullptr);
+		recorder.setVertexBuffer(0, nullptr, 0, 0);
+		recorder.setIndexBuffer(nullptr, wgpu::IndexFormat::Uint32, 0, 0);
+		for (uint32_t i = 0; i < objectCount; ++i) {
+			recorder.setBindGroup(0, nullptr, 1, &offsets[i]);
+			recorder.drawIndexed(indexCount, 1, 0, 0, 0);
+		}
+	}
+	double perDrawMs = elapsedMs(start);
+	std::cout << "instancing: " << objectCount << " objects, " << frames << " frames" << std::endl;
+	report("per-draw uniforms: ", perDrawMs);
+
+	// Transforms in the instance buffer, one draw call
+	start = Clock::now();
+	for (int frame = 0; frame < frames; ++frame) {
+		recorder.clear();
+		instances.clear();
+		for (uint32_t i = 0; i < objectCount; ++i) {
+			instances.add(transforms[i], color);
+		}
+		uint32_t offset = uploadFrame(uniformRing, instances, uniforms);
+		encodeScene(recorder, scene, offset, instances);
+	}
+	double instancedMs = elapsedMs(start);
+	report("instanced draw:    ", instancedMs);
+	std::cout << "  speedup:           " << perDrawMs / instancedMs << "x" << std::endl;
+	return 0;
+}
+
+// Cost of a profiling zone while the profiler is disabled and enabled, with
+// every thread of the pool recording at the same time
+int benchmarkProfiler(const std::vector<std::string>& args) {
+	size_t zoneCount = args.empty() ? 1000000 : std::stoul(args[0]);
+	ThreadPool& pool = ThreadPool::shared();
+	const size_t batch = 4096; // zones per task, well below the size of a thread ring
+
+	auto run = [&]() {
+		volatile uint64_t sink = 0;
+		auto start = Clock::now();
+		pool.parallelFor((zoneCount + batch - 1) / batch, [&](size_t task) {
+			size_t end = std::min(zoneCount, (task + 1) * batch);
+			for (size_t i = task * batch; i < end; ++i) {
+				PROFILE_ZONE("benchmark zone");
+				sink = sink + i;
+			}
+			// Like a frame loop would, drain the rings before they fill up
+			if (Profiler::enabled()) {
+				Profiler::collect();
+			}
+		});
+		double ms = elapsedMs(start);
+		Profiler::collect();
+		return ms;
+	};
+
+	bool wasEnabled = Profiler::enabled();
+	Profiler::setEnabled(false);
+	double disabledMs = run();
+	Profiler::setEnabled(true);
+	double enabledMs = run();
+	Profiler::setEnabled(wasEnabled);
+
+	std::cout << "profiler: " << zoneCount << " zones on " << pool.threadCount() << " threads" << std::endl;
+	std::cout << "  disabled: " << disabledMs * 1e6 / zoneCount << " ns/zone" << std::endl;
+	std::cout << "  enabled:  " << enabledMs * 1e6 / zoneCount << " ns/zone" << std::endl;
+	Profiler::printStats(std::cout);
+	return 0;
+}
+
+// Per-frame cost of the renderer's CPU side (uniform and instance uploads,
+// render pass encoding) on the recording and null backends, with what every
+// frame sends to the GPU and the heap allocations it makes.
+//     frame-encode [objects] [frames] [--log] [--save file] [--baseline file]
+// --log prints the calls of the last frame (and the buffers released after it),
+// --save writes the results, --baseline compares against saved results and
+// fails when a frame got slower by more than 20% or does more work.
+int benchmarkFrameEncode(const std::vector<std::string>& args) {
+	std::vector<std::string> positional;
+	fs::path savePath;
+	fs::path baselinePath;
+	bool printLog = false;
+	for (size_t i = 0; i < args.size(); ++i) {
+		if (args[i] == "--log") {
+			printLog = true;
+		}
+		else if (args[i] == "--save" && i + 1 < args.size()) {
+			savePath = args[++i];
+		}
+		else if (args[i] == "--baseline" && i + 1 < args.size()) {
+			baselinePath = args[++i];
+		}
+		else {
+			positional.push_back(args[i]);
+		}
+	}
+	uint32_t objectCount = positional.size() > 0 ? static_cast<uint32_t>(std::stoul(positional[0])) : 1000;
+	int frames = positional.size() > 1 ? std::stoi(positional[1]) : 1000;
+	const uint32_t uniformAlignment = 256;
+	const double tolerance = 1.2;
+
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> coordinate(-10.0f, 10.0f);
+	std::vector<glm::mat4x4> transforms(objectCount, glm::mat4x4(1.0f));
+	for (glm::mat4x4& transform : transforms) {
+		transform[3] = glm::vec4(coordinate(rng), coordinate(rng), coordinate(rng), 1.0f);
+	}
+
+	SceneBindings scene;
+	scene.vertexBufferSize = 1 << 20;
+	scene.indexBufferSize = 1 << 20;
+	const MeshLod lod = { 0, 36000, 0.0f, 0 };
+	scene.lods = &lod;
+	scene.lodCount = 1;
+
+	// Frames animate every instance, like a scene whose objects all move
+	auto runFrames = [&](auto& backend, auto beforeFrame, auto afterFrame) {
+		UniformRing uniformRing(backend, uniformAlignment, uint64_t(1024) * uniformAlignment);
+		InstanceBatch instances(backend, objectCount);
+		MyUniforms uniforms = {};
+		std::vector<double> frameUs;
+		frameUs.reserve(frames);
+		for (int frame = 0; frame < frames; ++frame) {
+			beforeFrame();
+			auto start = Clock::now();
+			uniforms.time = static_cast<float>(frame) / 60.0f;
+			glm::vec4 color(0.5f + 0.5f * std::sin(uniforms.time), 1.0f, 0.4f, 1.0f);
+			instances.clear();
+			for (uint32_t i = 0; i < objectCount; ++i) {
+				instances.add(transforms[i], color);
+			}
+			uint32_t offset = uploadFrame(uniformRing, instances, uniforms);
+			encodeScene(backend, scene, offset, instances);
+			frameUs.push_back(elapsedMs(start) * 1000.0);
+			afterFrame();
+		}
+		std::sort(frameUs.begin(), frameUs.end());
+		return frameUs;
+	};
+
+	auto percentile = [](const std::vector<double>& sorted, double fraction) {
+		return sorted[static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5)];
+	};
+
+	NullBackend nullBackend;
+	std::vector<double> nullUs = runFrames(nullBackend, [] {}, [] {});
+
+	// Counters are those of the last frame, the first ones may still allocate
+	using Type = RecordingBackend::CommandType;
+	RecordingBackend recorder;
+	uint64_t allocationsBefore = 0;
+	uint64_t frameAllocations = 0;
+	size_t commands = 0, draws = 0, buffersCreated = 0;
+	uint64_t uploadBytes = 0;
+	std::vector<double> recordingUs = runFrames(recorder,
+		[&] { recorder.clear(); allocationsBefore = heapAllocationCount(); },
+		[&] {
+			frameAllocations = heapAllocationCount() - allocationsBefore;
+			commands = recorder.commands().size();
+			draws = recorder.count(Type::DrawIndexed);
+			buffersCreated = recorder.count(Type::CreateBuffer);
+			uploadBytes = recorder.bytes(Type::WriteBuffer);
+		});
+
+	std::vector<std::pair<std::string, double>> results = {
+		{ "null_p50_us", percentile(nullUs, 0.50) },
+		{ "null_p95_us", percentile(nullUs, 0.95) },
+		{ "recording_p50_us", percentile(recordingUs, 0.50) },
+		{ "recording_p95_us", percentile(recordingUs, 0.95) },
+		{ "commands", static_cast<double>(commands) },
+		{ "draws", static_cast<double>(draws) },
+		{ "buffers_created", static_cast<double>(buffersCreated) },
+		{ "upload_bytes", static_cast<double>(uploadBytes) },
+		{ "heap_allocations", static_cast<double>(frameAllocations) },
+	};
+
+	std::cout << "frame-encode: " << objectCount << " objects, " << frames << " frames" << std::endl;
+	for (const auto& result : results) {
+		std::cout << "  " << std::left << std::setw(18) << result.first << std::right << result.second << std::endl;
+	}
+	if (printLog) {
+		recorder.print(std::cout);
+	}
+
+	if (!savePath.empty()) {
+		std::ofstream file(savePath);
+		for (const auto& result : results) {
+			file << result.first << " " << result.second << std::endl;
+		}
+		if (!file.good()) {
+			std::cout << "*** ERROR *** Could not write " << savePath << std::endl;
+			return 1;
+		}
+	}
+
+	if (baselinePath.empty()) {
+		return 0;
+	}
+	std::ifstream file(baselinePath);
+	if (!file.is_open()) {
+		std::cout << "*** ERROR *** Could not read " << baselinePath << std::endl;
+		return 1;
+	}
+	std::map<std::string, double> baseline;
+	std::string key;
+	double value = 0.0;
+	while (file >> key >> value) {
+		baseline[key] = value;
+	}
+
+	// Times are noisy, counts are exact
+	int regressions = 0;
+	for (const auto& result : results) {
+		auto it = baseline.find(result.first);
+		if (it == baseline.end()) continue;
+		bool isTime = result.first.find("_us") != std::string::npos;
+		double limit = isTime ? it->second * tolerance : it->second;
+		if (result.second > limit) {
+			std::cout << "REGRESSION " << result.first << ": " << result.second << " (baseline " << it->second << ")" << std::endl;
+			++regressions;
+		}
+	}
+	if (regressions == 0) {
+		std::cout << "No regression against " << baselinePath << std::endl;
+	}
+	return regressions == 0 ? 0 : 1;
+}
+
+// Encode the vertices of a mesh, plus random ones covering every direction,
+// as CompactVertex and check the decoded attributes against the float ones:
+// positions within half a unorm16 step of the bounding box, normals within
+// 0.01 degree, colors within half a unorm8 step. Fails otherwise.
+int benchmarkCompactVertex(const std::vector<std::string>& args) {
+	fs::path path = args.empty() ? DefaultObjPath : args[0];
+	Mesh mesh;
+	if (!loadGeometryFromObj(path, mesh)) {
+		std::cout << "*** ERROR *** Could not load " << path << std::endl;
+		return 1;
+	}
+	size_t meshVertexCount = mesh.vertices.size();
+
+	std::mt19937 rng(1234);
+	std::normal_distribution<float> gaussian;
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	glm::vec3 boundsMin(-1.0f), boundsMax(1.0f);
+	if (meshVertexCount > 0) {
+		PositionDecode bounds = computePositionDecode(mesh.vertices.data(), meshVertexCount);
+		boundsMin = bounds.offset;
+		boundsMax = bounds.offset + bounds.scale;
+	}
+	for (int i = 0; i < 100000; ++i) {
+		VertexAttributes vertex;
+		vertex.position = glm::mix(boundsMin, boundsMax, glm::vec3(unit(rng), unit(rng), unit(rng)));
+		vertex.normal = glm::normalize(glm::vec3(gaussian(rng), gaussian(rng), gaussian(rng)));
+		vertex.color = glm::vec3(unit(rng), unit(rng), unit(rng));
+		mesh.vertices.push_back(vertex);
+	}
+	for (glm::vec3 axis : { glm::vec3(1, 0, 0), glm::vec3(0, 1, 0), glm::vec3(0, 0, 1) }) {
+		mesh.vertices.push_back({ boundsMin, axis, glm::vec3(0.0f) });
+		mesh.vertices.push_back({ boundsMax, -axis, glm::vec3(1.0f) });
+	}
+	size_t vertexCount = mesh.vertices.size();
+
+	auto start = Clock::now();
+	PositionDecode decode = computePositionDecode(mesh.vertices.data(), vertexCount);
+	std::vector<CompactVertex> compact(vertexCount);
+	encodeVertices(mesh.vertices.data(), vertexCount, decode, compact.data());
+	double encodeMs = elapsedMs(start);
+
+	glm::vec3 maxPositionError(0.0f);
+	float maxNormalDegrees = 0.0f;
+	float maxColorError = 0.0f;
+	for (size_t i = 0; i < vertexCount; ++i) {
+		const VertexAttributes& original = mesh.vertices[i];
+		VertexAttributes decoded = decodeVertex(compact[i], decode);
+		maxPositionError = glm::max(maxPositionError, glm::abs(decoded.position - original.position));
+		float length = glm::length(original.normal);
+		if (length > 0.0f) {
+			// acos() of a float dot product is too coarse near 0 degrees
+			glm::vec3 normal = original.normal / length;
+			float angle = std::atan2(glm::length(glm::cross(decoded.normal, normal)), glm::dot(decoded.normal, normal));
+			maxNormalDegrees = std::max(maxNormalDegrees, glm::degrees(angle));
+		}
+		glm::vec3 colorError = glm::abs(decoded.color - glm::clamp(original.color, 0.0f, 1.0f));
+		maxColorError = std::max({ maxColorError, colorError.x, colorError.y, colorError.z });
+	}
+
+	// Rounding to the nearest step, plus some float slack
+	glm::vec3 positionBound = decode.scale * (0.5f / 65535.0f) + 1e-6f * glm::max(glm::abs(boundsMin), glm::abs(boundsMax));
+	const float normalBoundDegrees = 0.01f;
+	const float colorBound = 0.5f / 255.0f + 1e-6f;
+	bool positionsOk = glm::all(glm::lessThanEqual(maxPositionError, positionBound));
+	bool normalsOk = maxNormalDegrees <= normalBoundDegrees;
+	bool colorsOk = maxColorError <= colorBound;
+
+	size_t saved = sizeof(VertexAttributes) - sizeof(CompactVertex);
+	std::cout << "compact-vertex: " << meshVertexCount << " vertices from " << path
+		<< ", " << vertexCount - meshVertexCount << " random ones" << std::endl;
+	std::cout << "  " << sizeof(CompactVertex) << " bytes/vertex instead of " << sizeof(VertexAttributes)
+		<< ", " << saved << " saved (" << 100.0 * saved / sizeof(VertexAttributes) << "%)" << std::endl;
+	std::cout << "  encode: " << encodeMs * 1e6 / vertexCount << " ns/vertex" << std::endl;
+	std::cout << "  position error: " << maxPositionError.x << " " << maxPositionError.y << " " << maxPositionError.z
+		<< " (bound " << positionBound.x << " " << positionBound.y << " " << positionBound.z << ")"
+		<< (positionsOk ? "" : " FAILED") << std::endl;
+	std::cout << "  normal error:   " << maxNormalDegrees << " degrees (bound " << normalBoundDegrees << ")"
+		<< (normalsOk ? "" : " FAILED") << std::endl;
+	std::cout << "  color error:    " << maxColorError << " (bound " << colorBound << ")"
+		<< (colorsOk ? "" : " FAILED") << std::endl;
+	return positionsOk && normalsOk && colorsOk ? 0 : 1;
+}
+
+// Triangles of a mesh as sorted vertex triples, rotated to start with their
+// smallest index, to check that reordering only changed their order
+std::vector<std::array<uint32_t, 3>> canonicalTriangles(const std::vector<uint32_t>& indices) {
+	std::vector<std::array<uint32_t, 3>> triangles(indices.size() / 3);
+	for (size_t t = 0; t < triangles.size(); ++t) {
+		std::array<uint32_t, 3> triangle = { indices[3 * t], indices[3 * t + 1], indices[3 * t + 2] };
+		std::rotate(triangle.begin(), std::min_element(triangle.begin(), triangle.end()), triangle.end());
+		triangles[t] = triangle;
+	}
+	std::sort(triangles.begin(), triangles.end());
+	return triangles;
+}
+
+// Run the stages of optimizeMesh() one by one on a mesh, as loaded and with
+// its triangles shuffled, and report the vertex cache and overdraw figures
+// after each of them
+//     vertex-cache [file.obj]
+int benchmarkVertexCache(const std::vector<std::string>& args) {
+	fs::path path = args.empty() ? DefaultObjPath : args[0];
+	// The full mesh alone, as imported before optimizeMesh()
+	MeshLoaderOptions options;
+	options.optimize = false;
+	options.lodLevels = 1;
+	options.meshlets = false;
+	Mesh loaded;
+	if (!loadGeometryFromObj(path, loaded, options)) {
+		std::cout << "*** ERROR *** Could not load " << path << std::endl;
+		return 1;
+	}
+
+	auto report = [](const char* stage, const Mesh& mesh, double ms) {
+		VertexCacheStats fifo = analyzeVertexCache(mesh.indices, mesh.vertices.size(), VertexCacheSize, CacheModel::Fifo);
+		VertexCacheStats lru = analyzeVertexCache(mesh.indices, mesh.vertices.size(), VertexCacheSize, CacheModel::Lru);
+		OverdrawStats overdraw = analyzeOverdraw(mesh.indices, mesh.vertices);
+		std::cout << "  " << std::left << std::setw(14) << stage << std::right << std::fixed << std::setprecision(3)
+			<< " FIFO ACMR " << fifo.acmr << " ATVR " << fifo.atvr
+			<< " | LRU ACMR " << lru.acmr << " ATVR " << lru.atvr
+			<< " | overdraw " << overdraw.overdraw;
+		if (ms > 0.0) std::cout << " | " << ms << " ms";
+		std::cout << std::defaultfloat << std::endl;
+	};
+
+	std::cout << "vertex-cache: " << path << ", " << loaded.vertices.size() << " vertices, "
+		<< loaded.indices.size() / 3 << " triangles, " << VertexCacheSize << "-entry caches" << std::endl;
+
+	Mesh shuffled = loaded;
+	std::vector<uint32_t> order(shuffled.indices.size() / 3);
+	for (uint32_t t = 0; t < order.size(); ++t) order[t] = t;
+	std::shuffle(order.begin(), order.end(), std::mt19937(1234));
+	for (size_t t = 0; t < order.size(); ++t) {
+		std::copy_n(loaded.indices.begin() + 3 * order[t], 3, shuffled.indices.begin() + 3 * t);
+	}
+
+	int result = 0;
+	for (Mesh* mesh : { &loaded, &shuffled }) {
+		std::cout << (mesh == &loaded ? "as loaded:" : "shuffled triangles:") << std::endl;
+		auto triangles = canonicalTriangles(mesh->indices);
+		report("input", *mesh, 0.0);
+
+		auto start = Clock::now();
+		std::vector<uint32_t> clusters = optimizeVertexCache(mesh->indices, mesh->vertices.size());
+		report("vertex cache", *mesh, elapsedMs(start));
+		std::cout << "  " << clusters.size() << " clusters" << std::endl;
+
+		start = Clock::now();
+		optimizeOverdraw(mesh->indices, mesh->vertices, clusters);
+		report("overdraw", *mesh, elapsedMs(start));
+
+		if (canonicalTriangles(mesh->indices) != triangles) {
+			std::cout << "*** ERROR *** The reordered triangles differ from the input ones" << std::endl;
+			result = 1;
+		}
+
+		start = Clock::now();
+		optimizeVertexFetch(*mesh);
+		report("vertex fetch", *mesh, elapsedMs(start));
+	}
+	return result;
+}
+
+// Build the LOD chain of a mesh with 1 to maxThreads threads, report the
+// levels and the simplification rate in source triangles per second, and
+// fail when fewer than 4 levels come out or when the levels of a mesh split
+// in two move the vertices of the border between the halves
+//     simplify [file.obj] [levels] [maxThreads]
+int benchmarkSimplify(const std::vector<std::string>& args) {
+	fs::path path = args.size() < 1 ? DefaultObjPath : args[0];
+	uint32_t levelCount = args.size() < 2 ? 6 : static_cast<uint32_t>(std::stoul(args[1]));
+	unsigned maxThreads = args.size() < 3 ? std::max(1u, std::thread::hardware_concurrency()) : std::stoul(args[2]);
+
+	MeshLoaderOptions options;
+	options.lodLevels = 1;
+	Mesh loaded;
+	if (!loadGeometryFromObj(path, loaded, options)) {
+		std::cout << "*** ERROR *** Could not load " << path << std::endl;
+		return 1;
+	}
+	size_t triangleCount = loaded.indices.size() / 3;
+	std::cout << "simplify: " << path << ", " << loaded.vertices.size() << " vertices, "
+		<< triangleCount << " triangles, " << levelCount << " levels" << std::endl;
+
+	Mesh mesh;
+	for (unsigned threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(2 * threads, maxThreads) : threads + 1) {
+		ThreadPool pool(threads);
+		mesh = loaded;
+		auto start = Clock::now();
+		buildLods(mesh, levelCount, pool);
+		double ms = elapsedMs(start);
+		// Every level is simplified from the full mesh
+		double sourceTriangles = static_cast<double>(triangleCount) * (levelCount - 1);
+		std::cout << "  " << threads << " threads: " << ms << " ms, "
+			<< sourceTriangles / (ms / 1000.0) / 1e6 << " M triangles/s" << std::endl;
+	}
+
+	for (size_t level = 0; level < mesh.lods.size(); ++level) {
+		const MeshLod& lod = mesh.lods[level];
+		std::vector<uint32_t> indices(mesh.indices.begin() + lod.firstIndex, mesh.indices.begin() + lod.firstIndex + lod.indexCount);
+		std::cout << "  LOD " << level << ": " << lod.indexCount / 3 << " triangles, error " << lod.error
+			<< ", ACMR " << analyzeVertexCache(indices, mesh.vertices.size()).acmr << std::endl;
+	}
+
+	// Level drawn at increasing distances, with the projection of the
+	// renderer at 640x480 and one pixel of error allowed
+	const float focalLength = 2.0f;
+	glm::mat4x4 projection(1.0f);
+	projection[1][1] = 640.0f / 480.0f;
+	projection[2][3] = 1.0f / focalLength;
+	projection[3][3] = 0.0f;
+	float errorScale = lodErrorScale(projection, 480.0f);
+	glm::vec4 bounds = meshBoundingSphere(mesh.vertices.data(), mesh.vertices.size());
+	std::cout << "  level by distance (in bounding radii):";
+	for (float distance = 2.0f; distance <= 4096.0f; distance *= 2.0f) {
+		glm::mat4x4 modelView(1.0f);
+		modelView[3] = glm::vec4(-glm::vec3(bounds), 1.0f);
+		modelView[3].z += distance * bounds.w;
+		std::cout << " " << distance << ":" << selectLod(mesh.lods, projection, modelView, bounds, errorScale);
+	}
+	std::cout << std::endl;
+
+	// The chain is only worth its cost with a few levels
+	size_t expectedLevels = std::min<size_t>(levelCount, 4);
+	if (mesh.lods.size() < expectedLevels) {
+		std::cout << "*** ERROR *** " << mesh.lods.size() << " levels of detail, expected at least " << expectedLevels << std::endl;
+		return 1;
+	}
+
+	// The two halves of a grid, simplified apart as the submeshes of two
+	// materials are, must keep every vertex of their borders at every level,
+	// or the levels would crack along the edge they share
+	const uint32_t gridSize = 32;
+	std::vector<VertexAttributes> gridVertices;
+	for (uint32_t y = 0; y <= gridSize; ++y) {
+		for (uint32_t x = 0; x <= gridSize; ++x) {
+			VertexAttributes vertex;
+			vertex.position = glm::vec3(static_cast<float>(x), static_cast<float>(y), 0.0f);
+			vertex.normal = glm::vec3(0.0f, 0.0f, 1.0f);
+			vertex.color = glm::vec3(1.0f);
+			gridVertices.push_back(vertex);
+		}
+	}
+	for (uint32_t half = 0; half < 2; ++half) {
+		Mesh part;
+		part.vertices = gridVertices;
+		for (uint32_t y = 0; y < gridSize; ++y) {
+			for (uint32_t x = half * gridSize / 2; x < (half + 1) * gridSize / 2; ++x) {
+				uint32_t a = y * (gridSize + 1) + x;
+				uint32_t b = a + gridSize + 1;
+				part.indices.insert(part.indices.end(), { a, a + 1, b + 1, a, b + 1, b });
+			}
+		}
+		std::map<uint64_t, uint32_t> edgeUses;
+		for (size_t i = 0; i < part.indices.size(); i += 3) {
+			for (int corner = 0; corner < 3; ++corner) {
+				uint64_t a = part.indices[i + corner];
+				uint64_t b = part.indices[i + (corner + 1) % 3];
+				++edgeUses[std::min(a, b) << 32 | std::max(a, b)];
+			}
+		}
+		buildLods(part, levelCount, ThreadPool::shared());
+		for (size_t level = 1; level < part.lods.size(); ++level) {
+			std::vector<bool> used(part.vertices.size(), false);
+			for (uint32_t i = 0; i < part.lods[level].indexCount; ++i) {
+				used[part.indices[part.lods[level].firstIndex + i]] = true;
+			}
+			for (const auto& edge : edgeUses) {
+				if (edge.second == 1 && (!used[edge.first >> 32] || !used[edge.first & 0xffffffffu])) {
+					std::cout << "*** ERROR *** LOD " << level << " of a grid half moved a border vertex" << std::endl;
+					return 1;
+				}
+			}
+		}
+	}
+	return 0;
+}
+
+// Check the meshlets of a mesh, check that none is culled from the side its
+// normals face, then cull them from cameras orbiting it, with MeshletCuller
+// and with a plain loop over the Meshlet structures, and report the
+// throughput in meshlets per millisecond
+//     meshlet-cull [file.obj] [frames]
+int benchmarkMeshletCull(const std::vector<std::string>& args) {
+	fs::path path = args.size() < 1 ? DefaultObjPath : args[0];
+	int frames = args.size() < 2 ? 1000 : std::stoi(args[1]);
+
+	Mesh mesh;
+	if (!loadGeometryFromObj(path, mesh, MeshLoaderOptions())) {
+		std::cout << "*** ERROR *** Could not load " << path << std::endl;
+		return 1;
+	}
+	if (mesh.meshlets.empty()) {
+		std::cout << "*** ERROR *** The mesh has no meshlets" << std::endl;
+		return 1;
+	}
+
+	// Meshlets must stay within their limits and tile the full mesh in order
+	uint32_t fullIndexCount = mesh.lods.empty() ? static_cast<uint32_t>(mesh.indices.size()) : mesh.lods[0].indexCount;
+	uint32_t nextIndex = 0;
+	uint64_t vertexTotal = 0;
+	uint32_t coneCount = 0;
+	for (const Meshlet& meshlet : mesh.meshlets) {
+		if (meshlet.firstIndex != nextIndex || meshlet.vertexCount > MaxMeshletVertices || meshlet.indexCount / 3 > MaxMeshletTriangles) {
+			std::cout << "*** ERROR *** Invalid meshlet at index " << meshlet.firstIndex << std::endl;
+			return 1;
+		}
+		nextIndex += meshlet.indexCount;
+		vertexTotal += meshlet.vertexCount;
+		coneCount += meshlet.coneCutoff < 1.0f ? 1 : 0;
+	}
+	if (nextIndex != fullIndexCount) {
+		std::cout << "*** ERROR *** Meshlets do not cover the full mesh" << std::endl;
+		return 1;
+	}
+	size_t meshletCount = mesh.meshlets.size();
+	std::cout << "meshlet-cull: " << path << ", " << fullIndexCount / 3 << " triangles, " << meshletCount << " meshlets, "
+		<< static_cast<double>(vertexTotal) / meshletCount << " vertices and "
+		<< static_cast<double>(fullIndexCount / 3) / meshletCount << " triangles per meshlet, "
+		<< coneCount << " with a normal cone" << std::endl;
+
+	// Renderer projection at 640x480, cameras orbiting the mesh at 2.5 radii
+	const float focalLength = 2.0f, near = 0.01f, far = 100.0f;
+	glm::mat4x4 projection(0.0f);
+	projection[0][0] = 1.0f;
+	projection[1][1] = 640.0f / 480.0f;
+	projection[2][2] = far / (focalLength * (far - near));
+	projection[3][2] = -far * near / (focalLength * (far - near));
+	projection[2][3] = 1.0f / focalLength;
+	glm::vec4 bounds = meshBoundingSphere(mesh.vertices.data(), mesh.vertices.size());
+	auto modelViewAt = [&](int frame) {
+		float yaw = 0.0123f * static_cast<float>(frame);
+		float pitch = 0.5f * std::sin(0.0071f * static_cast<float>(frame));
+		glm::mat4x4 rotateY(1.0f), rotateX(1.0f), center(1.0f), back(1.0f);
+		rotateY[0][0] = std::cos(yaw); rotateY[2][0] = std::sin(yaw);
+		rotateY[0][2] = -std::sin(yaw); rotateY[2][2] = std::cos(yaw);
+		rotateX[1][1] = std::cos(pitch); rotateX[2][1] = -std::sin(pitch);
+		rotateX[1][2] = std::sin(pitch); rotateX[2][2] = std::cos(pitch);
+		center[3] = glm::vec4(-glm::vec3(bounds), 1.0f);
+		back[3] = glm::vec4(0.0f, 0.0f, 2.5f * bounds.w, 1.0f);
+		return back * rotateX * rotateY * center;
+	};
+
+	// Straightforward version, one meshlet at a time with early exits
+	auto referenceCull = [&](const glm::mat4x4& mvp, const glm::vec3& camera, std::vector<uint8_t>& visible) {
+		glm::vec4 rows[4];
+		for (int r = 0; r < 4; ++r) rows[r] = glm::vec4(mvp[0][r], mvp[1][r], mvp[2][r], mvp[3][r]);
+		glm::vec4 planes[6] = { rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2] };
+		for (glm::vec4& plane : planes) plane = plane * (1.0f / glm::length(glm::vec3(plane)));
+		for (size_t i = 0; i < meshletCount; ++i) {
+			const Meshlet& meshlet = mesh.meshlets[i];
+			visible[i] = 0;
+			bool outside = false;
+			for (const glm::vec4& plane : planes) {
+				if (glm::dot(glm::vec3(plane), meshlet.center) + plane.w <= -meshlet.radius) {
+					outside = true;
+					break;
+				}
+			}
+			if (outside) continue;
+			glm::vec3 d = meshlet.center - camera;
+			if (glm::dot(d, meshlet.coneAxis) > meshlet.coneCutoff * glm::length(d) + meshlet.radius) continue;
+			visible[i] = 1;
+		}
+	};
+
+	// Culling must be conservative: every triangle of a rejected meshlet
+	// faces away or lies outside of a frustum plane
+	MeshletCuller culler(mesh.meshlets);
+	std::vector<uint8_t> reference(meshletCount);
+	uint32_t mismatches = 0;
+	for (int frame = 0; frame < frames; frame += std::max(1, frames / 16)) {
+		glm::mat4x4 modelView = modelViewAt(frame);
+		glm::mat4x4 mvp = projection * modelView;
+		glm::vec3 camera = glm::vec3(glm::inverse(modelView)[3]);
+		culler.clear();
+		culler.cull(mvp, camera);
+		referenceCull(mvp, camera, reference);
+		for (size_t i = 0; i < meshletCount; ++i) {
+			mismatches += culler.visibility()[i] != reference[i] ? 1 : 0;
+			if (culler.visibility()[i]) continue;
+			const Meshlet& meshlet = mesh.meshlets[i];
+			for (uint32_t k = meshlet.firstIndex; k < meshlet.firstIndex + meshlet.indexCount; k += 3) {
+				glm::vec3 a = mesh.vertices[mesh.indices[k]].position;
+				glm::vec3 b = mesh.vertices[mesh.indices[k + 1]].position;
+				glm::vec3 c = mesh.vertices[mesh.indices[k + 2]].position;
+				bool facing = glm::dot(glm::cross(b - a, c - a), camera - a) > 0.0f;
+				glm::vec4 clip[3] = { mvp * glm::vec4(a, 1.0f), mvp * glm::vec4(b, 1.0f), mvp * glm::vec4(c, 1.0f) };
+				bool outside = false;
+				for (int axis = 0; axis < 2; ++axis) {
+					outside |= clip[0][axis] < -clip[0].w && clip[1][axis] < -clip[1].w && clip[2][axis] < -clip[2].w;
+					outside |= clip[0][axis] > clip[0].w && clip[1][axis] > clip[1].w && clip[2][axis] > clip[2].w;
+				}
+				outside |= clip[0].z < 0.0f && clip[1].z < 0.0f && clip[2].z < 0.0f;
+				outside |= clip[0].z > clip[0].w && clip[1].z > clip[1].w && clip[2].z > clip[2].w;
+				if (facing && !outside) {
+					std::cout << "*** ERROR *** Meshlet " << i << " was culled but has a visible triangle" << std::endl;
+					return 1;
+				}
+			}
+		}
+	}
+	if (mismatches > 0) {
+		std::cout << "  note: " << mismatches << " meshlets differ from the reference, from rounding" << std::endl;
+	}
+
+	// A meshlet seen from the side its vertex normals point to must never
+	// be culled. The normals come from the file, unlike the cones, which
+	// follow the winding. Frustum planes are left out by a projection that
+	// keeps every point inside.
+	glm::mat4x4 everywhere(0.0f);
+	everywhere[3][3] = 1.0f;
+	for (size_t i = 0; i < meshletCount; ++i) {
+		const Meshlet& meshlet = mesh.meshlets[i];
+		glm::vec3 normal(0.0f);
+		for (uint32_t k = meshlet.firstIndex; k < meshlet.firstIndex + meshlet.indexCount; ++k) {
+			normal += mesh.vertices[mesh.indices[k]].normal;
+		}
+		if (glm::length(normal) == 0.0f) continue;
+		glm::vec3 camera = meshlet.center + glm::normalize(normal) * (1000.0f * bounds.w);
+		culler.clear();
+		culler.cull(everywhere, camera);
+		if (!culler.visibility()[i]) {
+			std::cout << "*** ERROR *** Meshlet " << i << " was culled from the side its normals face" << std::endl;
+			return 1;
+		}
+	}
+
+	uint64_t visibleTotal = 0;
+	uint64_t rangeTotal = 0;
+	uint64_t drawnIndices = 0;
+	auto start = Clock::now();
+	for (int frame = 0; frame < frames; ++frame) {
+		glm::mat4x4 modelView = modelViewAt(frame);
+		culler.clear();
+		visibleTotal += culler.cull(projection * modelView, glm::vec3(glm::inverse(modelView)[3]));
+	}
+	double cullerMs = elapsedMs(start);
+	start = Clock::now();
+	for (int frame = 0; frame < frames; ++frame) {
+		glm::mat4x4 modelView = modelViewAt(frame);
+		culler.clear();
+		culler.cull(projection * modelView, glm::vec3(glm::inverse(modelView)[3]));
+		const std::vector<IndexRange>& ranges = culler.compact();
+		rangeTotal += ranges.size();
+		for (const IndexRange& range : ranges) drawnIndices += range.indexCount;
+	}
+	double compactMs = elapsedMs(start) - cullerMs;
+	start = Clock::now();
+	for (int frame = 0; frame < frames; ++frame) {
+		glm::mat4x4 modelView = modelViewAt(frame);
+		referenceCull(projection * modelView, glm::vec3(glm::inverse(modelView)[3]), reference);
+	}
+	double referenceMs = elapsedMs(start);
+
+	double tested = static_cast<double>(meshletCount) * frames;
+	std::cout << "  MeshletCuller:  " << tested / cullerMs << " meshlets/ms" << std::endl;
+	std::cout << "  reference loop: " << tested / referenceMs << " meshlets/ms ("
+		<< referenceMs / cullerMs << "x slower)" << std::endl;
+	std::cout << "  compaction:     " << compactMs * 1000.0 / frames << " us/frame" << std::endl;
+	std::cout << "  visible: " << 100.0 * static_cast<double>(visibleTotal) / tested << "% of the meshlets, "
+		<< 100.0 * static_cast<double>(drawnIndices) / (static_cast<double>(fullIndexCount) * frames) << "% of the triangles drawn in "
+		<< static_cast<double>(rangeTotal) / frames << " ranges per frame" << std::endl;
+	return 0;
+}
+
+// Time to first frame when a mesh is loaded synchronously, as the renderer
+// used to, and through the AssetLoader while frames keep running. Also
+// checks the MPSC queue under contention.
+//     asset-load [file.obj] [frameMs]
+int benchmarkAssetLoad(const std::vector<std::string>& args) {
+	fs::path path = args.size() < 1 ? DefaultObjPath : args[0];
+	double frameMs = args.size() < 2 ? 4.0 : std::stod(args[1]);
+	MeshLoaderOptions options;
+
+	// Stand-in for the CPU and GPU work of a frame
+	auto renderFrame = [frameMs]() {
+		std::this_thread::sleep_for(std::chrono::duration<double, std::milli>(frameMs));
+	};
+
+	// Synchronous: nothing is on screen until the mesh is there
+	auto start = Clock::now();
+	{
+		MeshData mesh;
+		if (!mesh.load(path, options)) {
+			std::cout << "*** ERROR *** Could not load " << path << std::endl;
+			return 1;
+		}
+		std::cout << "asset-load: " << path << (mesh.fromCache() ? " (from cache), " : " (parsed), ")
+			<< mesh.vertexCount() << " vertices, " << mesh.indexCount() << " indices" << std::endl;
+	}
+	renderFrame();
+	double syncFirstFrameMs = elapsedMs(start);
+
+	// Asynchronous: frames run from the start, the mesh shows up when ready
+	start = Clock::now();
+	AssetLoader loader(ThreadPool::shared());
+	AssetHandle handle = loader.loadMesh(path, options);
+	double asyncFirstFrameMs = 0.0;
+	double residentMs = 0.0;
+	double longestFrameMs = 0.0;
+	int loadingFrames = 0;
+	std::unique_ptr<LoadedAsset> asset;
+	for (int frame = 0; residentMs == 0.0; ++frame) {
+		auto frameStart = Clock::now();
+		while (loader.poll(asset)) {
+			handle.setState(AssetState::Ready);
+			residentMs = elapsedMs(start);
+		}
+		renderFrame();
+		longestFrameMs = std::max(longestFrameMs, elapsedMs(frameStart));
+		if (frame == 0) asyncFirstFrameMs = elapsedMs(start);
+		loadingFrames += residentMs == 0.0 ? 1 : 0;
+	}
+	if (!asset || asset->failed || handle.state() != AssetState::Ready) {
+		std::cout << "*** ERROR *** The asynchronous load failed" << std::endl;
+		return 1;
+	}
+	std::cout << "  synchronous:  first frame after " << syncFirstFrameMs << " ms" << std::endl;
+	std::cout << "  asynchronous: first frame after " << asyncFirstFrameMs << " ms, mesh available after "
+		<< residentMs << " ms (" << asset->loadMs << " ms on the worker), " << loadingFrames
+		<< " frames meanwhile, longest " << longestFrameMs << " ms" << std::endl;
+
+	// Every value pushed is popped once, in order for each producer
+	const unsigned producerCount = 4;
+	const uint32_t perProducer = 250000;
+	MpscQueue<uint64_t> queue;
+	start = Clock::now();
+	std::vector<std::thread> producers;
+	for (unsigned p = 0; p < producerCount; ++p) {
+		producers.emplace_back([&queue, p]() {
+			for (uint32_t i = 0; i < perProducer; ++i) {
+				queue.push(uint64_t(p) << 32 | i);
+			}
+		});
+	}
+	std::vector<uint32_t> next(producerCount, 0);
+	uint64_t popped = 0;
+	bool ordered = true;
+	while (popped < uint64_t(producerCount) * perProducer) {
+		uint64_t value;
+		if (!queue.pop(value)) {
+			std::this_thread::yield();
+			continue;
+		}
+		uint32_t producer = static_cast<uint32_t>(value >> 32);
+		ordered = ordered && producer < producerCount && static_cast<uint32_t>(value) == next[producer];
+		if (producer < producerCount) ++next[producer];
+		++popped;
+	}
+	for (std::thread& producer : producers) producer.join();
+	double queueMs = elapsedMs(start);
+	std::cout << "  MpscQueue: " << producerCount << " producers, " << popped / queueMs / 1000.0
+		<< " M values/s, " << (ordered ? "in order" : "OUT OF ORDER") << std::endl;
+	return ordered ? 0 : 1;
+}
+
+// Write an OBJ file of shapeCount spheres, with materials assigned in an
+// order that changes at almost every shape, and its .mtl file
+bool writeShapesObj(const fs::path& path, uint32_t shapeCount, uint32_t materialCount) {
+	fs::path mtlPath = path;
+	mtlPath.replace_extension(".mtl");
+	std::ofstream mtl(mtlPath);
+	std::ofstream obj(path);
+	if (!mtl.is_open() || !obj.is_open()) {
+		std::cout << "*** ERROR *** Could not write " << path << std::endl;
+		return false;
+	}
+	for (uint32_t m = 0; m < materialCount; ++m) {
+		mtl << "newmtl material" << m << "\nKd " << (m % 3) / 2.0 << " " << (m % 5) / 4.0 << " " << (m % 7) / 6.0 << "\nd 1\n";
+	}
+
+	const uint32_t rings = 8;
+	const uint32_t segments = 12;
+	const double pi = 3.14159265358979;
+	obj << "mtllib " << mtlPath.filename().string() << "\n";
+	uint32_t baseVertex = 1;
+	for (uint32_t shape = 0; shape < shapeCount; ++shape) {
+		obj << "o shape" << shape << "\nusemtl material" << (shape * 7) % materialCount << "\n";
+		double cx = 3.0 * (shape % 16);
+		double cy = 3.0 * (shape / 16);
+		for (uint32_t r = 0; r <= rings; ++r) {
+			double theta = pi * r / rings;
+			for (uint32_t s = 0; s <= segments; ++s) {
+				double phi = 2.0 * pi * s / segments;
+				double x = std::sin(theta) * std::cos(phi);
+				double y = std::sin(theta) * std::sin(phi);
+				double z = std::cos(theta);
+				obj << "v " << cx + x << " " << cy + y << " " << z << "\nvn " << x << " " << y << " " << z << "\n";
+			}
+		}
+		for (uint32_t r = 0; r < rings; ++r) {
+			for (uint32_t s = 0; s < segments; ++s) {
+				uint32_t a = baseVertex + r * (segments + 1) + s;
+				uint32_t b = a + segments + 1;
+				obj << "f " << a << "//" << a << " " << b << "//" << b << " " << b + 1 << "//" << b + 1 << "\n";
+				obj << "f " << a << "//" << a << " " << b + 1 << "//" << b + 1 << " " << a + 1 << "//" << a + 1 << "\n";
+			}
+		}
+		baseVertex += (rings + 1) * (segments + 1);
+	}
+	return obj.good() && mtl.good();
+}
+
+// Import a file of many shapes and materials into one vertex and index
+// buffer with a draw table sorted by material, check the table, then compare
+// the encoding of a frame against one buffer pair and draw per shape, in the
+// order of the file
+//     submeshes [shapes] [materials] | submeshes file.obj
+int benchmarkSubmeshes(const std::vector<std::string>& args) {
+	fs::path path;
+	if (!args.empty() && !std::isdigit(static_cast<unsigned char>(args[0][0]))) {
+		path = args[0];
+	}
+	else {
+		uint32_t shapeCount = args.size() < 1 ? 500 : static_cast<uint32_t>(std::stoul(args[0]));
+		uint32_t materialCount = args.size() < 2 ? 32 : static_cast<uint32_t>(std::stoul(args[1]));
+		path = fs::temp_directory_path() / "submeshes-benchmark.obj";
+		if (!writeShapesObj(path, shapeCount, std::max(materialCount, 1u))) {
+			return 1;
+		}
+	}
+
+	// Shapes as the file has them, for the baseline
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn;
+	std::string err;
+	if (!loadObjParallel(path, attrib, shapes, materials, warn, err)) {
+		std::cout << "*** ERROR *** Could not parse " << path << ": " << err << std::endl;
+		return 1;
+	}
+	size_t shapeIndexCount = 0;
+	for (const tinyobj::shape_t& shape : shapes) {
+		shapeIndexCount += shape.mesh.indices.size();
+	}
+
+	MeshLoaderOptions options;
+	auto start = Clock::now();
+	Mesh mesh;
+	if (!loadGeometryFromObj(path, mesh, options)) {
+		return 1;
+	}
+	double importMs = elapsedMs(start);
+
+	// The table covers every triangle once, sorted by material, within the
+	// buffers
+	bool valid = !mesh.submeshes.empty();
+	size_t fullIndexCount = 0;
+	for (size_t i = 0; i < mesh.submeshes.size(); ++i) {
+		const Submesh& submesh = mesh.submeshes[i];
+		fullIndexCount += submesh.indexCount;
+		valid = valid && submesh.firstIndex + submesh.indexCount <= mesh.indices.size()
+			&& submesh.firstLod + submesh.lodCount <= mesh.lods.size()
+			&& submesh.firstMeshlet + submesh.meshletCount <= mesh.meshlets.size()
+			&& submesh.material < static_cast<int32_t>(mesh.materials.size())
+			&& (i == 0 || mesh.submeshes[i - 1].material < submesh.material);
+		for (uint32_t m = submesh.firstMeshlet; m < submesh.firstMeshlet + submesh.meshletCount; ++m) {
+			const Meshlet& meshlet = mesh.meshlets[m];
+			valid = valid && meshlet.firstIndex >= submesh.firstIndex
+				&& meshlet.firstIndex + meshlet.indexCount <= submesh.firstIndex + submesh.indexCount;
+		}
+	}
+	for (uint32_t index : mesh.indices) {
+		valid = valid && index < mesh.vertices.size();
+	}
+	std::cout << "submeshes: " << path << ", " << shapes.size() << " shapes, " << materials.size() << " materials, "
+		<< shapeIndexCount / 3 << " triangles" << std::endl;
+	std::cout << "  imported in " << importMs << " ms: " << mesh.submeshes.size() << " submeshes, "
+		<< fullIndexCount / 3 << " triangles after welding, " << mesh.lods.size() << " levels of detail, "
+		<< mesh.meshlets.size() << " meshlets" << std::endl;
+	if (!valid) {
+		std::cout << "*** ERROR *** Invalid draw table" << std::endl;
+		return 1;
+	}
+
+	const int frames = 2000;
+	RecordingBackend recorder;
+	std::vector<wgpu::BindGroup> materialBindGroups(materials.size() + 1, nullptr);
+	auto report = [&](const char* name, double ms) {
+		std::cout << "  " << name << ms * 1000.0 / frames << " us/frame, "
+			<< recorder.count(RecordingBackend::CommandType::DrawIndexed) << " draws, "
+			<< recorder.count(RecordingBackend::CommandType::SetBindGroup) << " bind groups, "
+			<< recorder.count(RecordingBackend::CommandType::SetVertexBuffer)
+			+ recorder.count(RecordingBackend::CommandType::SetIndexBuffer) << " buffer bindings" << std::endl;
+	};
+
+	// One vertex and index buffer per shape, drawn in the order of the file
+	wgpu::BufferDescriptor bufferDesc;
+	std::vector<wgpu::Buffer> shapeBuffers;
+	for (const tinyobj::shape_t& shape : shapes) {
+		bufferDesc.size = shape.mesh.indices.size() * sizeof(VertexAttributes);
+		shapeBuffers.push_back(recorder.createBuffer(bufferDesc));
+		bufferDesc.size = shape.mesh.indices.size() * sizeof(uint32_t);
+		shapeBuffers.push_back(recorder.createBuffer(bufferDesc));
+	}
+	uint32_t dynamicOffset = 0;
+	start = Clock::now();
+	for (int frame = 0; frame < frames; ++frame) {
+		recorder.clear();
+		recorder.setPipeline(nullptr);
+		recorder.setBindGroup(0, nullptr, 1, &dynamicOffset);
+		int boundMaterial = -2;
+		for (size_t i = 0; i < shapes.size(); ++i) {
+			const tinyobj::mesh_t& shape = shapes[i].mesh;
+			int material = shape.material_ids.empty() ? -1 : shape.material_ids[0];
+			recorder.setVertexBuffer(0, shapeBuffers[2 * i], 0, shape.indices.size() * sizeof(VertexAttributes));
+			recorder.setIndexBuffer(shapeBuffers[2 * i + 1], wgpu::IndexFormat::Uint32, 0, shape.indices.size() * sizeof(uint32_t));
+			if (material != boundMaterial) {
+				recorder.setBindGroup(1, materialBindGroups[material + 1], 0, nullptr);
+				boundMaterial = material;
+			}
+			recorder.drawIndexed(static_cast<uint32_t>(shape.indices.size()), 1, 0, 0, 0);
+		}
+	}
+	double perShapeMs = elapsedMs(start);
+	report("per shape:  ", perShapeMs);
+
+	// Shared buffers and the draw table
+	UniformRing uniformRing(recorder, 256, 256);
+	InstanceBatch instances(recorder, 1);
+	instances.add(glm::mat4x4(1.0f), glm::vec4(1.0f));
+	instances.upload();
+	SceneBindings scene;
+	scene.vertexBufferSize = mesh.vertices.size() * sizeof(VertexAttributes);
+	scene.indexBufferSize = mesh.indices.size() * sizeof(uint32_t);
+	scene.lods = mesh.lods.data();
+	scene.lodCount = mesh.lods.size();
+	scene.submeshes = mesh.submeshes.data();
+	scene.submeshCount = mesh.submeshes.size();
+	scene.materialBindGroups = materialBindGroups.data();
+	start = Clock::now();
+	for (int frame = 0; frame < frames; ++frame) {
+		recorder.clear();
+		encodeScene(recorder, scene, dynamicOffset, instances);
+	}
+	double tableMs = elapsedMs(start);
+	report("draw table: ", tableMs);
+	std::cout << "  speedup:    " << perShapeMs / tableMs << "x" << std::endl;
+	return 0;
+}
+
+// Compress every mesh of a corpus, check the round trip, then report the
+// compression ratio against the OBJ file and the mesh cache, and the decode
+// speed of the streams on one thread and of whole meshes on the pool
+//     geometry-codec [file.obj ...]
+int benchmarkGeometryCodec(const std::vector<std::string>& args) {
+	std::vector<std::string> paths = args.empty() ? std::vector<std::string>{ DefaultObjPath } : args;
+	const int runs = 20;
+	uint64_t totalObjBytes = 0;
+	uint64_t totalCacheBytes = 0;
+	uint64_t totalCompressedBytes = 0;
+	for (const std::string& path : paths) {
+		Mesh mesh;
+		if (!loadGeometryFromObj(path, mesh)) {
+			return 1;
+		}
+		size_t indexSize = fitsUint16Indices(mesh.vertices.size()) ? sizeof(uint16_t) : sizeof(uint32_t);
+		std::error_code ec;
+		uint64_t objBytes = fs::file_size(path, ec);
+		uint64_t cacheBytes = mesh.vertices.size() * sizeof(VertexAttributes) + mesh.indices.size() * indexSize;
+
+		auto start = Clock::now();
+		std::vector<uint8_t> compressed = compressMesh(mesh);
+		double encodeMs = elapsedMs(start);
+
+		// Decoded vertices are the quantized ones, the rest is exact
+		Mesh decoded;
+		if (!decompressMesh(compressed.data(), compressed.size(), decoded)) {
+			std::cout << "*** ERROR *** Could not decompress " << path << std::endl;
+			return 1;
+		}
+		PositionDecode decode = computePositionDecode(mesh.vertices.data(), mesh.vertices.size());
+		std::vector<CompactVertex> quantized(mesh.vertices.size());
+		encodeVertices(mesh.vertices.data(), mesh.vertices.size(), decode, quantized.data());
+		bool exact = decoded.vertices.size() == mesh.vertices.size() && decoded.indices == mesh.indices
+			&& decoded.lods.size() == mesh.lods.size() && decoded.meshlets.size() == mesh.meshlets.size()
+			&& decoded.submeshes.size() == mesh.submeshes.size() && decoded.materials.size() == mesh.materials.size();
+		for (size_t i = 0; exact && i < quantized.size(); ++i) {
+			VertexAttributes expected = decodeVertex(quantized[i], decode);
+			exact = std::memcmp(&expected, &decoded.vertices[i], sizeof(VertexAttributes)) == 0;
+		}
+		bool corruptRejected = true;
+		for (size_t cut : { compressed.size() / 2, compressed.size() - 1 }) {
+			Mesh truncated;
+			corruptRejected = corruptRejected && !decompressMesh(compressed.data(), cut, truncated);
+		}
+		if (!exact || !corruptRejected) {
+			std::cout << "*** ERROR *** " << (exact ? "Truncated data was accepted" : "Round trip differs") << " for " << path << std::endl;
+			return 1;
+		}
+
+		// Streams alone, on this thread, as the workers decode them
+		std::vector<std::vector<uint8_t>> vertexChunks;
+		for (size_t first = 0; first < quantized.size(); first += VertexChunkSize) {
+			vertexChunks.emplace_back();
+			encodeVertexStream(quantized.data() + first, std::min<size_t>(VertexChunkSize, quantized.size() - first), vertexChunks.back());
+		}
+		std::vector<uint8_t> indexStream;
+		encodeIndexStream(mesh.indices.data(), mesh.indices.size(), 0, indexStream);
+		std::vector<CompactVertex> vertexOut(VertexChunkSize);
+		std::vector<uint32_t> indexOut(mesh.indices.size());
+		double vertexMs = 1e30;
+		double indexMs = 1e30;
+		for (int run = 0; run < runs; ++run) {
+			start = Clock::now();
+			for (size_t chunk = 0; chunk < vertexChunks.size(); ++chunk) {
+				size_t count = std::min<size_t>(VertexChunkSize, quantized.size() - chunk * VertexChunkSize);
+				decodeVertexStream(vertexChunks[chunk].data(), vertexChunks[chunk].size(), vertexOut.data(), count);
+			}
+			vertexMs = std::min(vertexMs, elapsedMs(start));
+			start = Clock::now();
+			decodeIndexStream(indexStream.data(), indexStream.size(), indexOut.data(), indexOut.size(), 0);
+			indexMs = std::min(indexMs, elapsedMs(start));
+		}
+
+		// Whole meshes, back to VertexAttributes, on pools of 1..N threads
+		std::cout << "geometry-codec: " << path << ", " << mesh.vertices.size() << " vertices, " << mesh.indices.size() << " indices" << std::endl;
+		std::cout << "  sizes: OBJ " << objBytes / 1024 << " KiB, mesh cache " << cacheBytes / 1024 << " KiB, compressed "
+			<< compressed.size() / 1024 << " KiB (" << double(cacheBytes) / compressed.size() << "x smaller than the cache, "
+			<< double(objBytes) / compressed.size() << "x than the OBJ), encoded in " << encodeMs << " ms" << std::endl;
+		std::cout << "  bits: " << 8.0 * (compressed.size() - indexStream.size()) / std::max<size_t>(mesh.vertices.size(), 1)
+			<< " per vertex (tables included), " << 8.0 * indexStream.size() / std::max<size_t>(mesh.indices.size(), 1) << " per index" << std::endl;
+		std::cout << "  streams on 1 thread: vertices " << quantized.size() * sizeof(CompactVertex) / vertexMs / 1e6 << " GB/s, indices "
+			<< mesh.indices.size() * sizeof(uint32_t) / indexMs / 1e6 << " GB/s of decoded data" << std::endl;
+		unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+		for (unsigned threads = 1; threads <= maxThreads; threads *= 2) {
+			ThreadPool pool(threads);
+			double meshMs = 1e30;
+			for (int run = 0; run < runs; ++run) {
+				Mesh out;
+				start = Clock::now();
+				decompressMesh(compressed.data(), compressed.size(), out, pool);
+				meshMs = std::min(meshMs, elapsedMs(start));
+			}
+			std::cout << "  mesh on " << threads << " thread(s): " << meshMs << " ms, " << cacheBytes / meshMs / 1e6
+				<< " GB/s of mesh cache data" << std::endl;
+		}
+		totalObjBytes += objBytes;
+		totalCacheBytes += cacheBytes;
+		totalCompressedBytes += compressed.size();
+	}
+	if (paths.size() > 1) {
+		std::cout << "corpus: " << paths.size() << " meshes, " << double(totalCacheBytes) / totalCompressedBytes
+			<< "x smaller than the mesh cache, " << double(totalObjBytes) / totalCompressedBytes << "x than the OBJ files" << std::endl;
+	}
+	return 0;
+}
+
+// Pipeline state of a material, as the renderer describes it. The
+// descriptor points into the struct, which must not move.
+struct MaterialPipelineState {
+	std::array<wgpu::VertexAttribute, 3> attributes;
+	wgpu::VertexBufferLayout vertexBuffer;
+	wgpu::BlendState blend;
+	wgpu::ColorTargetState colorTarget;
+	wgpu::FragmentState fragment;
+	wgpu::DepthStencilState depthStencil;
+	wgpu::RenderPipelineDescriptor descriptor;
+
+	// Entry points are copied, so that equal descriptors do not share their
+	// strings
+	std::string vertexEntry = "vs_main";
+	std::string fragmentEntry = "fs_main";
+
+	MaterialPipelineState(wgpu::ShaderModule module, wgpu::PipelineLayout layout, bool compactVertices, bool blended, bool twoSided) {
+		using namespace wgpu;
+		attributes[0].format = compactVertices ? VertexFormat::Unorm16x4 : VertexFormat::Float32x3;
+		attributes[1].format = compactVertices ? VertexFormat::Snorm16x2 : VertexFormat::Float32x3;
+		attributes[2].format = compactVertices ? VertexFormat::Unorm8x4 : VertexFormat::Float32x3;
+		const uint64_t offsets[] = { offsetof(VertexAttributes, position), offsetof(VertexAttributes, normal), offsetof(VertexAttributes, color) };
+		const uint64_t compactOffsets[] = { offsetof(CompactVertex, position), offsetof(CompactVertex, normal), offsetof(CompactVertex, color) };
+		for (uint32_t i = 0; i < attributes.size(); ++i) {
+			attributes[i].shaderLocation = i;
+			attributes[i].offset = compactVertices ? compactOffsets[i] : offsets[i];
+		}
+		vertexBuffer.attributeCount = attributes.size();
+		vertexBuffer.attributes = attributes.data();
+		vertexBuffer.arrayStride = compactVertices ? sizeof(CompactVertex) : sizeof(VertexAttributes);
+		vertexBuffer.stepMode = VertexStepMode::Vertex;
+
+		blend.color.srcFactor = BlendFactor::SrcAlpha;
+		blend.color.dstFactor = BlendFactor::OneMinusSrcAlpha;
+		blend.color.operation = BlendOperation::Add;
+		blend.alpha.srcFactor = BlendFactor::Zero;
+		blend.alpha.dstFactor = BlendFactor::One;
+		blend.alpha.operation = BlendOperation::Add;
+		colorTarget.format = TextureFormat::BGRA8Unorm;
+		colorTarget.blend = blended ? &blend : nullptr;
+		colorTarget.writeMask = ColorWriteMask::All;
+		fragment.module = module;
+		fragment.entryPoint = fragmentEntry.c_str();
+		fragment.targetCount = 1;
+		fragment.targets = &colorTarget;
+		depthStencil.format = TextureFormat::Depth24Plus;
+		depthStencil.depthWriteEnabled = true;
+		depthStencil.depthCompare = CompareFunction::Less;
+
+		descriptor.label = "Material pipeline";
+		descriptor.layout = layout;
+		descriptor.vertex.module = module;
+		descriptor.vertex.entryPoint = vertexEntry.c_str();
+		descriptor.vertex.bufferCount = 1;
+		descriptor.vertex.buffers = &vertexBuffer;
+		descriptor.primitive.topology = PrimitiveTopology::TriangleList;
+		descriptor.primitive.frontFace = FrontFace::CCW;
+		descriptor.primitive.cullMode = twoSided ? CullMode::None : CullMode::Back;
+		descriptor.depthStencil = &depthStencil;
+		descriptor.multisample.count = 1;
+		descriptor.multisample.mask = ~0u;
+		descriptor.fragment = &fragment;
+	}
+
+	MaterialPipelineState(const MaterialPipelineState&) = delete;
+	MaterialPipelineState& operator=(const MaterialPipelineState&) = delete;
+};
+
+
+// Ask for the pipeline of every material every frame, as a renderer that
+// does not track pipelines itself would, with and without the cache
+//     pipeline-cache [materials] [frames]
+int benchmarkPipelineCache(const std::vector<std::string>& args) {
+	uint32_t materialCount = args.size() < 1 ? 256 : static_cast<uint32_t>(std::stoul(args[0]));
+	uint32_t frameCount = args.size() < 2 ? 100 : static_cast<uint32_t>(std::stoul(args[1]));
+	const std::string shaderSource = "@vertex fn vs_main() {} @fragment fn fs_main() {}";
+
+	RecordingBackend backend;
+	PipelineCache cache(backend);
+
+	// Every material makes its own layouts and module; the cache hands out
+	// the same objects, so that equal states make equal keys
+	wgpu::BindGroupLayoutEntry entry;
+	entry.binding = 0;
+	entry.visibility = wgpu::ShaderStage::Vertex | wgpu::ShaderStage::Fragment;
+	entry.buffer.type = wgpu::BufferBindingType::Uniform;
+	entry.buffer.minBindingSize = 16;
+	wgpu::BindGroupLayoutDescriptor layoutDesc;
+	layoutDesc.entryCount = 1;
+	layoutDesc.entries = &entry;
+	std::vector<std::unique_ptr<MaterialPipelineState>> states;
+	for (uint32_t i = 0; i < materialCount; ++i) {
+		wgpu::ShaderModule module = cache.shaderModule(shaderSource);
+		std::array<wgpu::BindGroupLayout, 2> layouts = { cache.bindGroupLayout(layoutDesc), cache.bindGroupLayout(layoutDesc) };
+		wgpu::PipelineLayout layout = cache.pipelineLayout(layouts.data(), layouts.size());
+		// 8 distinct states among the materials
+		states.push_back(std::make_unique<MaterialPipelineState>(module, layout, i % 2 == 1, i % 4 >= 2, i % 8 >= 4));
+	}
+
+	// Every frame asks for the pipeline of every material, which would
+	// create as many pipelines without the cache
+	std::vector<PipelineId> ids(materialCount);
+	std::vector<double> frameUs;
+	frameUs.reserve(frameCount);
+	uint64_t allocationsBefore = 0;
+	for (uint32_t frame = 0; frame < frameCount; ++frame) {
+		if (frame == 1) {
+			allocationsBefore = heapAllocationCount();
+		}
+		auto start = Clock::now();
+		for (uint32_t i = 0; i < materialCount; ++i) {
+			ids[i] = cache.requestRenderPipeline(states[i]->descriptor);
+		}
+		frameUs.push_back(elapsedMs(start) * 1000.0);
+	}
+	uint64_t steadyAllocations = frameCount > 1 ? heapAllocationCount() - allocationsBefore : 0;
+	size_t created = backend.count(RecordingBackend::CommandType::CreateRenderPipeline);
+	bool valid = true;
+	for (uint32_t i = 0; i < materialCount; ++i) {
+		valid = valid && cache.renderPipeline(ids[i]) && ids[i] == ids[i % 8];
+	}
+
+	// Equal states share an id whatever their labels and string addresses,
+	// and any field that differs makes another pipeline
+	MaterialPipelineState reference(cache.shaderModule(shaderSource), states[0]->descriptor.layout, false, false, false);
+	reference.descriptor.label = "Another label";
+	PipelineId first = cache.requestRenderPipeline(states[0]->descriptor);
+	valid = valid && cache.requestRenderPipeline(reference.descriptor) == first;
+	reference.depthStencil.depthBias = 1;
+	valid = valid && cache.requestRenderPipeline(reference.descriptor) != first;
+	reference.depthStencil.depthBias = 0;
+	reference.fragmentEntry = "fs_other";
+	reference.fragment.entryPoint = reference.fragmentEntry.c_str();
+	valid = valid && cache.requestRenderPipeline(reference.descriptor) != first;
+
+	uint64_t requests = uint64_t(materialCount) * frameCount;
+	std::sort(frameUs.begin(), frameUs.end());
+	std::cout << "pipeline-cache: " << materialCount << " materials, " << frameCount << " frames, "
+		<< (valid ? "keys valid" : "*** ERROR *** keys invalid") << std::endl;
+	std::cout << "  without cache: " << requests << " pipelines created" << std::endl;
+	std::cout << "  with cache:    " << created << " pipelines created, "
+		<< frameUs[frameUs.size() / 2] * 1000.0 / materialCount << " ns per request (median frame "
+		<< frameUs[frameUs.size() / 2] << " us), " << steadyAllocations << " heap allocations after the first frame" << std::endl;
+	std::cout << "  ";
+	cache.printStats(std::cout);
+	return valid ? 0 : 1;
+}
+
+
+// Preprocess a shader for every set of features, check the preprocessor on
+// small sources, and count the modules the variants share
+//     shader-variants [file.wgsl]
+int benchmarkShaderVariants(const std::vector<std::string>& args) {
+	fs::path shaderPath = args.empty() ? fs::path("resources/shaders2.wgsl") : fs::path(args[0]);
+
+	// Directives on sources held in memory
+	auto preprocess = [](const std::map<std::string, std::string>& files, const ShaderDefines& defines, std::string& out) {
+		ShaderSources sources;
+		sources.mainName = "main.wgsl";
+		sources.files = files;
+		std::string error;
+		return preprocessWgsl(sources, defines, out, error);
+	};
+	std::string out;
+	bool valid = true;
+	valid = valid && preprocess({ { "main.wgsl", "#include \"a.wgsl\"\n#include \"a.wgsl\"\nb" }, { "a.wgsl", "a" } }, {}, out)
+		&& out == "a\nb\n";
+	valid = valid && !preprocess({ { "main.wgsl", "#include \"a.wgsl\"" }, { "a.wgsl", "#include \"main.wgsl\"" } }, {}, out);
+	valid = valid && !preprocess({ { "main.wgsl", "#include \"missing.wgsl\"" } }, {}, out);
+	valid = valid && preprocess({ { "main.wgsl", "#ifdef A\na\n#ifndef B\nnotB\n#endif\n#else\nnotA\n#endif" } }, { { "A", "" } }, out)
+		&& out == "a\nnotB\n";
+	valid = valid && preprocess({ { "main.wgsl", "#ifdef A\na\n#else\nnotA\n#endif" } }, {}, out) && out == "notA\n";
+	valid = valid && preprocess({ { "main.wgsl", "#define N 4u\nvar<private> x: array<f32, N>; // N2 N_\n#undef N\nN" } }, {}, out)
+		&& out == "var<private> x: array<f32, 4u>; // N2 N_\nN\n";
+	valid = valid && !preprocess({ { "main.wgsl", "#ifdef A\na" } }, {}, out);
+	valid = valid && !preprocess({ { "main.wgsl", "#endif" } }, {}, out);
+	valid = valid && !preprocess({ { "main.wgsl", "#else\n#endif" } }, {}, out);
+
+	ShaderSources sources;
+	if (!loadShaderSources(shaderPath, sources)) {
+		return 1;
+	}
+
+	// Every combination of features
+	const ShaderFeatures allFeatures = ShaderFeatureCompactVertices | ShaderFeatureVertexColors;
+	std::vector<ShaderFeatures> featureSets;
+	for (ShaderFeatures features = 0; features <= allFeatures; ++features) {
+		if ((features & ~allFeatures) == 0) {
+			featureSets.push_back(features);
+		}
+	}
+
+	const int repeats = 200;
+	std::string error;
+	auto start = Clock::now();
+	for (int i = 0; i < repeats; ++i) {
+		for (ShaderFeatures features : featureSets) {
+			if (!preprocessWgsl(sources, ShaderVariants::defines(features), out, error)) {
+				std::cout << "*** ERROR *** " << error << std::endl;
+				return 1;
+			}
+		}
+	}
+	double preprocessUs = elapsedMs(start) * 1000.0 / (repeats * featureSets.size());
+
+	std::cout << "shader-variants: " << shaderPath << ", " << sources.files.size() << " file(s), "
+		<< featureSets.size() << " feature sets, " << (valid ? "preprocessor valid" : "*** ERROR *** preprocessor invalid") << std::endl;
+	std::cout << "  preprocess: " << preprocessUs << " us per variant" << std::endl;
+
+	// Prewarm, serially and on the pool. Modules come from the cache, so
+	// the variants that differ by override constants only share theirs.
+	unsigned maxThreads = std::max(1u, std::thread::hardware_concurrency());
+	for (unsigned threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(2 * threads, maxThreads) : threads + 1) {
+		ThreadPool pool(threads);
+		double prewarmMs = 0.0;
+		size_t modules = 0;
+		for (int i = 0; i < repeats; ++i) {
+			RecordingBackend backend;
+			PipelineCache cache(backend);
+			ShaderVariants variants(cache, sources);
+			start = Clock::now();
+			variants.prewarm(featureSets, pool);
+			prewarmMs += elapsedMs(start);
+			modules = backend.count(RecordingBackend::CommandType::CreateShaderModule);
+			for (ShaderFeatures features : featureSets) {
+				const ShaderVariant& variant = variants.variant(features);
+				valid = valid && variant.module && variant.constants.size() == 1
+					&& (variant.constants[0].value != 0.0) == ((features & ShaderFeatureCompactVertices) != 0);
+			}
+			valid = valid && variants.variantCount() == featureSets.size();
+		}
+		std::cout << "  prewarm on " << threads << " thread(s): " << prewarmMs * 1000.0 / repeats << " us for "
+			<< featureSets.size() << " variants, " << modules << " shader modules" << std::endl;
+	}
+	if (!valid) {
+		std::cout << "*** ERROR *** variants invalid" << std::endl;
+	}
+	return valid ? 0 : 1;
+}
+
+
+// Churn of mesh and material sized regions through the buffer allocator,
+// against one buffer per resource
+//     buffer-alloc [resources] [rounds]
+int benchmarkBufferAlloc(const std::vector<std::string>& args) {
+	uint32_t resourceCount = args.size() < 1 ? 4096 : static_cast<uint32_t>(std::stoul(args[0]));
+	uint32_t roundCount = args.size() < 2 ? 20 : static_cast<uint32_t>(std::stoul(args[1]));
+
+	// Sizes spread log-uniformly from 64 bytes to 1 MiB, every fourth one a
+	// uniform block at the offset alignment
+	std::mt19937_64 rng(42);
+	std::uniform_real_distribution<double> logSize(6.0, 20.0);
+	const BufferClass classes[] = { BufferClass::Vertex, BufferClass::Index, BufferClass::Vertex, BufferClass::Uniform };
+	auto randomSize = [&] { return static_cast<uint64_t>(std::exp2(logSize(rng))); };
+
+	// The buddy allocator alone: no overlap, alignment kept, everything merges
+	// back into one block
+	bool valid = true;
+	{
+		BuddyAllocator buddy(1 << 20, 256);
+		std::vector<std::pair<uint64_t, uint64_t>> ranges;
+		for (uint64_t offset; (offset = buddy.allocate(std::uniform_int_distribution<uint64_t>(1, 20000)(rng), 1024)) != BuddyAllocator::InvalidOffset;) {
+			ranges.push_back({ offset, buddy.blockSize(offset) });
+			valid = valid && offset % 1024 == 0;
+		}
+		std::sort(ranges.begin(), ranges.end());
+		for (size_t i = 1; i < ranges.size(); ++i) {
+			valid = valid && ranges[i - 1].first + ranges[i - 1].second <= ranges[i].first;
+		}
+		std::shuffle(ranges.begin(), ranges.end(), rng);
+		for (const auto& range : ranges) {
+			buddy.free(range.first);
+		}
+		valid = valid && buddy.allocationCount() == 0 && buddy.freeBlockCount() == 1 && buddy.largestFreeBlock() == buddy.capacity();
+	}
+
+	RecordingBackend backend;
+	BufferAllocator allocator(backend);
+	std::vector<BufferAllocation> allocations(resourceCount);
+	std::vector<uint64_t> sizes(resourceCount);
+	for (uint32_t i = 0; i < resourceCount; ++i) {
+		sizes[i] = randomSize();
+	}
+	auto start = Clock::now();
+	for (uint32_t i = 0; i < resourceCount; ++i) {
+		allocations[i] = allocator.allocate(classes[i % 4], sizes[i]);
+	}
+	double fillMs = elapsedMs(start);
+	size_t perResourceBuffers = resourceCount;
+
+	// Every round replaces half of the resources, as streaming would
+	double allocateMs = 0.0;
+	double freeMs = 0.0;
+	uint64_t operations = 0;
+	std::vector<uint32_t> replaced(resourceCount);
+	for (uint32_t i = 0; i < resourceCount; ++i) {
+		replaced[i] = i;
+	}
+	for (uint32_t round = 0; round < roundCount; ++round) {
+		std::shuffle(replaced.begin(), replaced.end(), rng);
+		start = Clock::now();
+		for (uint32_t i = 0; i < resourceCount / 2; ++i) {
+			allocator.free(allocations[replaced[i]]);
+		}
+		freeMs += elapsedMs(start);
+		for (uint32_t i = 0; i < resourceCount / 2; ++i) {
+			sizes[replaced[i]] = randomSize();
+		}
+		start = Clock::now();
+		for (uint32_t i = 0; i < resourceCount / 2; ++i) {
+			allocations[replaced[i]] = allocator.allocate(classes[replaced[i] % 4], sizes[replaced[i]]);
+		}
+		allocateMs += elapsedMs(start);
+		operations += resourceCount / 2;
+		perResourceBuffers += resourceCount / 2;
+	}
+
+	// Regions of a class do not overlap and keep its alignment
+	std::vector<std::tuple<uintptr_t, uint64_t, uint64_t>> regions;
+	for (uint32_t i = 0; i < resourceCount; ++i) {
+		const BufferAllocation& allocation = allocations[i];
+		valid = valid && allocation && allocation.size >= sizes[i] && allocation.offset % allocator.alignment(allocation.bufferClass) == 0;
+		regions.emplace_back(reinterpret_cast<uintptr_t>(static_cast<WGPUBuffer>(allocation.buffer)), allocation.offset, allocation.size);
+	}
+	std::sort(regions.begin(), regions.end());
+	for (size_t i = 1; i < regions.size(); ++i) {
+		valid = valid && (std::get<0>(regions[i - 1]) != std::get<0>(regions[i])
+			|| std::get<1>(regions[i - 1]) + std::get<2>(regions[i - 1]) <= std::get<1>(regions[i]));
+	}
+
+	std::cout << "buffer-alloc: " << resourceCount << " resources, " << roundCount << " rounds replacing half of them, "
+		<< (valid ? "allocations valid" : "*** ERROR *** allocations invalid") << std::endl;
+	std::cout << "  one buffer per resource: " << perResourceBuffers << " buffers created" << std::endl;
+	std::cout << "  sub-allocated:           " << backend.count(RecordingBackend::CommandType::CreateBuffer) << " buffers created, "
+		<< fillMs * 1e6 / resourceCount << " ns per allocate while filling (pages created), then "
+		<< allocateMs * 1e6 / std::max<uint64_t>(operations, 1) << " ns per allocate, "
+		<< freeMs * 1e6 / std::max<uint64_t>(operations, 1) << " ns per free" << std::endl;
+	allocator.printStats(std::cout);
+	BufferClassStats vertexStats = allocator.stats(BufferClass::Vertex);
+	std::cout << "  vertex blocks " << double(vertexStats.requestedBytes) / vertexStats.allocatedBytes * 100.0
+		<< "% used by the requests" << std::endl;
+
+	for (BufferAllocation& allocation : allocations) {
+		allocator.free(allocation);
+	}
+	for (size_t i = 0; i < BufferClassCount; ++i) {
+		BufferClassStats classStats = allocator.stats(static_cast<BufferClass>(i));
+		valid = valid && classStats.allocationCount == 0 && classStats.pageCount <= 1;
+	}
+	if (!valid) {
+		std::cout << "*** ERROR *** pages not released" << std::endl;
+	}
+	return valid ? 0 : 1;
+}
+
+
+// Frustum culling of synthetic scenes of boxes spread in a cube around a
+// turning camera: one object at a time, over the SoA bounds, and through
+// the hierarchy
+//     frustum-cull [objects] [frames]
+int benchmarkFrustumCull(const std::vector<std::string>& args) {
+	std::vector<uint32_t> objectCounts = { 1000, 10000, 100000, 1000000 };
+	if (args.size() >= 1) {
+		objectCounts = { static_cast<uint32_t>(std::stoul(args[0])) };
+	}
+	int frames = args.size() < 2 ? 64 : std::stoi(args[1]);
+
+	// Renderer projection at 640x480, as in meshlet-cull
+	const float focalLength = 2.0f, near = 0.01f, far = 1000.0f;
+	glm::mat4x4 projection(0.0f);
+	projection[0][0] = 1.0f;
+	projection[1][1] = 640.0f / 480.0f;
+	projection[2][2] = far / (focalLength * (far - near));
+	projection[3][2] = -far * near / (focalLength * (far - near));
+	projection[2][3] = 1.0f / focalLength;
+	auto viewProjectionAt = [&](int frame) {
+		float yaw = 6.2831853f * static_cast<float>(frame) / static_cast<float>(frames);
+		glm::mat4x4 rotateY(1.0f);
+		rotateY[0][0] = std::cos(yaw); rotateY[2][0] = std::sin(yaw);
+		rotateY[0][2] = -std::sin(yaw); rotateY[2][2] = std::cos(yaw);
+		return projection * rotateY;
+	};
+
+	bool valid = true;
+	for (uint32_t objectCount : objectCounts) {
+		// Same density whatever the count, objects of 0.5 to 2 units
+		std::mt19937_64 rng(7);
+		float halfSide = 0.5f * std::cbrt(static_cast<float>(objectCount)) * 8.0f;
+		std::uniform_real_distribution<float> position(-halfSide, halfSide);
+		std::uniform_real_distribution<float> size(0.25f, 1.0f);
+		std::vector<std::pair<glm::vec3, glm::vec3>> boxes(objectCount);
+		SceneBounds bounds;
+		for (auto& box : boxes) {
+			glm::vec3 center(position(rng), position(rng), position(rng));
+			glm::vec3 extent(size(rng), size(rng), size(rng));
+			box = { center - extent, center + extent };
+			bounds.add(box.first, box.second);
+		}
+
+		// One object at a time, stopping at the first plane it is behind
+		std::vector<uint8_t> reference(objectCount);
+		auto referenceCull = [&](const FrustumPlanes& planes) {
+			for (uint32_t i = 0; i < objectCount; ++i) {
+				const glm::vec3& lower = boxes[i].first;
+				const glm::vec3& upper = boxes[i].second;
+				glm::vec3 center = (lower + upper) * 0.5f;
+				float radius = glm::length(upper - center);
+				reference[i] = 1;
+				for (int p = 0; p < 6; ++p) {
+					glm::vec3 normal(planes.x[p], planes.y[p], planes.z[p]);
+					glm::vec3 corner(normal.x > 0.0f ? upper.x : lower.x, normal.y > 0.0f ? upper.y : lower.y, normal.z > 0.0f ? upper.z : lower.z);
+					if (glm::dot(normal, center) + planes.w[p] <= -radius || glm::dot(normal, corner) + planes.w[p] < 0.0f) {
+						reference[i] = 0;
+						break;
+					}
+				}
+			}
+		};
+
+		std::vector<uint8_t> visible;
+		uint64_t visibleTotal = 0;
+		uint32_t mismatches = 0;
+		auto start = Clock::now();
+		for (int frame = 0; frame < frames; ++frame) {
+			referenceCull(FrustumPlanes(viewProjectionAt(frame)));
+		}
+		double referenceMs = elapsedMs(start);
+
+		start = Clock::now();
+		for (int frame = 0; frame < frames; ++frame) {
+			visibleTotal += bounds.cullLinear(FrustumPlanes(viewProjectionAt(frame)), visible);
+		}
+		double linearMs = elapsedMs(start);
+		referenceCull(FrustumPlanes(viewProjectionAt(frames - 1)));
+		for (uint32_t i = 0; i < objectCount; ++i) {
+			mismatches += visible[i] != reference[i] ? 1 : 0;
+		}
+
+		start = Clock::now();
+		bounds.buildHierarchy();
+		double buildMs = elapsedMs(start);
+		size_t nodeTests = 0;
+		size_t objectTests = 0;
+		start = Clock::now();
+		for (int frame = 0; frame < frames; ++frame) {
+			bounds.cull(FrustumPlanes(viewProjectionAt(frame)), visible);
+			nodeTests += bounds.lastNodeTests();
+			objectTests += bounds.lastObjectTests();
+		}
+		double hierarchyMs = elapsedMs(start);
+		for (uint32_t i = 0; i < objectCount; ++i) {
+			mismatches += visible[i] != reference[i] ? 1 : 0;
+		}
+
+		std::vector<uint32_t> visibleIds;
+		start = Clock::now();
+		for (int frame = 0; frame < frames; ++frame) {
+			bounds.cull(FrustumPlanes(viewProjectionAt(frame)), visibleIds);
+		}
+		double idsMs = elapsedMs(start);
+		for (uint32_t id : visibleIds) {
+			mismatches += reference[id] ? 0 : 1;
+		}
+		mismatches += static_cast<uint32_t>(std::abs(std::count(reference.begin(), reference.end(), uint8_t(1)) - static_cast<long>(visibleIds.size())));
+		valid = valid && mismatches == 0;
+
+		double objectsPerFrame = static_cast<double>(objectCount);
+		std::cout << "frustum-cull: " << objectCount << " objects, " << frames << " frames, "
+			<< 100.0 * visibleTotal / (objectsPerFrame * frames) << "% visible, "
+			<< (mismatches == 0 ? "results match" : "*** ERROR *** results differ") << std::endl;
+		std::cout << "  one at a time:  " << objectsPerFrame * frames / (referenceMs * 1000.0) << " objects/us" << std::endl;
+		std::cout << "  SoA, all:       " << objectsPerFrame * frames / (linearMs * 1000.0) << " objects/us" << std::endl;
+		std::cout << "  hierarchy:      " << objectsPerFrame * frames / (hierarchyMs * 1000.0) << " objects/us, "
+			<< bounds.nodeCount() << " nodes built in " << buildMs << " ms, " << nodeTests / frames << " nodes and "
+			<< objectTests / frames << " objects tested per frame" << std::endl;
+		std::cout << "  hierarchy, ids: " << objectsPerFrame * frames / (idsMs * 1000.0) << " objects/us" << std::endl;
+	}
+	return valid ? 0 : 1;
+}
+
+
+// Node of the pointer-based scene graph the transform hierarchy replaces
+struct PointerNode {
+	glm::mat4x4 local;
+	glm::mat4x4 world;
+	bool dirty = true;
+	std::vector<std::unique_ptr<PointerNode>> children;
+};
+
+// Recompute the dirty nodes of a pointer-based tree and their subtrees,
+// return how many were recomputed
+size_t updatePointerNode(PointerNode& node, const glm::mat4x4* parentWorld, bool parentChanged) {
+	bool changed = node.dirty || parentChanged;
+	node.dirty = false;
+	size_t count = 0;
+	if (changed) {
+		node.world = parentWorld ? *parentWorld * node.local : node.local;
+		count = 1;
+	}
+	for (auto& child : node.children) {
+		count += updatePointerNode(*child, &node.world, changed);
+	}
+	return count;
+}
+
+// Forests of nodes with 8 children each, added depth first as a scene file
+// would list them: world matrices of the transform hierarchy, on 1 to
+// maxThreads threads, against a tree of individually allocated nodes, when
+// every root moves, when 1% of the subtrees 3 levels down move, and when a
+// single leaf moves
+//     scene-graph [nodes] [rounds] [maxThreads]
+int benchmarkSceneGraph(const std::vector<std::string>& args) {
+	uint32_t nodeCount = args.size() < 1 ? 1000000 : static_cast<uint32_t>(std::stoul(args[0]));
+	int rounds = args.size() < 2 ? 8 : std::stoi(args[1]);
+	unsigned maxThreads = args.size() < 3 ? std::max(1u, std::thread::hardware_concurrency()) : std::stoul(args[2]);
+	const uint32_t rootCount = std::min(16u, nodeCount);
+	const uint32_t fanout = 8;
+
+	// Parent of node i, breadth first, and its children
+	std::vector<uint32_t> parentOf(nodeCount, InvalidTransform);
+	std::vector<std::vector<uint32_t>> childrenOf(nodeCount);
+	std::vector<uint32_t> depthOf(nodeCount, 0);
+	for (uint32_t i = rootCount; i < nodeCount; ++i) {
+		parentOf[i] = (i - rootCount) / fanout;
+		childrenOf[parentOf[i]].push_back(i);
+		depthOf[i] = depthOf[parentOf[i]] + 1;
+	}
+
+	// Small rotations, translations and scales, different for every node
+	std::mt19937_64 rng(11);
+	std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+	auto randomLocal = [&]() {
+		float angle = 0.5f * unit(rng);
+		float scale = 1.0f + 0.1f * unit(rng);
+		glm::mat4x4 local(1.0f);
+		local[0][0] = scale * std::cos(angle); local[2][0] = scale * std::sin(angle);
+		local[0][2] = -scale * std::sin(angle); local[2][2] = scale * std::cos(angle);
+		local[1][1] = scale;
+		local[3] = glm::vec4(unit(rng), unit(rng), unit(rng), 1.0f);
+		return local;
+	};
+
+	// Add both trees depth first, from every root
+	TransformHierarchy hierarchy;
+	std::vector<TransformId> transformOf(nodeCount);
+	std::vector<std::unique_ptr<PointerNode>> roots;
+	std::vector<PointerNode*> pointerOf(nodeCount);
+	auto start = Clock::now();
+	std::vector<uint32_t> stack;
+	for (uint32_t root = 0; root < rootCount; ++root) {
+		stack.push_back(root);
+		while (!stack.empty()) {
+			uint32_t i = stack.back();
+			stack.pop_back();
+			glm::mat4x4 local = randomLocal();
+			transformOf[i] = hierarchy.add(i < rootCount ? InvalidTransform : transformOf[parentOf[i]], local);
+			auto node = std::make_unique<PointerNode>();
+			node->local = local;
+			pointerOf[i] = node.get();
+			if (i < rootCount) {
+				roots.push_back(std::move(node));
+			}
+			else {
+				pointerOf[parentOf[i]]->children.push_back(std::move(node));
+			}
+			stack.insert(stack.end(), childrenOf[i].rbegin(), childrenOf[i].rend());
+		}
+	}
+	double buildMs = elapsedMs(start);
+	start = Clock::now();
+	hierarchy.update();
+	double sortMs = elapsedMs(start);
+	for (auto& root : roots) {
+		updatePointerNode(*root, nullptr, false);
+	}
+	std::cout << "scene-graph: " << nodeCount << " nodes, " << hierarchy.depthCount() << " depths, "
+		<< rounds << " rounds, built in " << buildMs << " ms, sorted and updated in " << sortMs << " ms" << std::endl;
+
+	// Nodes moved by every scenario
+	std::vector<uint32_t> someSubtrees;
+	for (uint32_t i = 0; i < nodeCount; ++i) {
+		if (depthOf[i] == 3 && i % 100 == 0) {
+			someSubtrees.push_back(i);
+		}
+	}
+	struct Scenario {
+		const char* name;
+		std::vector<uint32_t> moved;
+	};
+	std::vector<Scenario> scenarios = {
+		{ "every root", {} },
+		{ "1% of subtrees", someSubtrees },
+		{ "one leaf", { nodeCount - 1 } },
+	};
+	for (uint32_t root = 0; root < rootCount; ++root) {
+		scenarios[0].moved.push_back(root);
+	}
+
+	bool valid = true;
+	for (const Scenario& scenario : scenarios) {
+		std::vector<glm::mat4x4> locals(scenario.moved.size());
+		for (auto& local : locals) {
+			local = randomLocal();
+		}
+
+		size_t recomputed = 0;
+		start = Clock::now();
+		for (int round = 0; round < rounds; ++round) {
+			for (size_t m = 0; m < scenario.moved.size(); ++m) {
+				PointerNode& node = *pointerOf[scenario.moved[m]];
+				node.local = locals[m];
+				node.dirty = true;
+			}
+			recomputed = 0;
+			for (auto& root : roots) {
+				recomputed += updatePointerNode(*root, nullptr, false);
+			}
+		}
+		double pointerMs = elapsedMs(start) / rounds;
+		std::cout << "  " << scenario.name << ", " << recomputed << " nodes recomputed" << std::endl;
+		std::cout << "    pointer tree: " << pointerMs << " ms, " << nodeCount / (pointerMs * 1000.0) << " M nodes/s" << std::endl;
+
+		for (unsigned threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(2 * threads, maxThreads) : threads + 1) {
+			ThreadPool pool(threads);
+			size_t hierarchyRecomputed = 0;
+			start = Clock::now();
+			for (int round = 0; round < rounds; ++round) {
+				for (size_t m = 0; m < scenario.moved.size(); ++m) {
+					hierarchy.setLocal(transformOf[scenario.moved[m]], locals[m]);
+				}
+				hierarchyRecomputed = hierarchy.update(pool);
+			}
+			double hierarchyMs = elapsedMs(start) / rounds;
+			std::cout << "    hierarchy, " << threads << " threads: " << hierarchyMs << " ms, "
+				<< nodeCount / (hierarchyMs * 1000.0) << " M nodes/s, " << pointerMs / hierarchyMs << "x" << std::endl;
+			valid = valid && hierarchyRecomputed == recomputed;
+		}
+
+		// Both trees multiply in the same order, so they agree to the bit
+		uint32_t mismatches = 0;
+		for (uint32_t i = 0; i < nodeCount; ++i) {
+			mismatches += std::memcmp(&hierarchy.world(transformOf[i]), &pointerOf[i]->world, sizeof(glm::mat4x4)) == 0 ? 0 : 1;
+		}
+		if (mismatches != 0) {
+			std::cout << "*** ERROR *** " << mismatches << " world matrices differ" << std::endl;
+			valid = false;
+		}
+	}
+
+	// Dropping the nodes added after the first roots leaves them intact
+	TransformId keep = transformOf[rootCount > 1 ? 1 : 0];
+	glm::mat4x4 kept = hierarchy.world(keep);
+	hierarchy.truncate(keep + 1);
+	hierarchy.setLocal(keep, hierarchy.local(keep));
+	valid = valid && hierarchy.nodeCount() == keep + 1u && hierarchy.update() == 1 
+		&& std::memcmp(&hierarchy.world(keep), &kept, sizeof(kept)) == 0;
+	if (!valid) {
+		std::cout << "*** ERROR *** Transform hierarchy and pointer tree disagree" << std::endl;
+	}
+	return valid ? 0 : 1;
+}
+
+
+// Encoding of a scene of many submeshes, each its own draw: straight into
+// the pass, then into render bundles recorded on 1 to maxThreads threads,
+// without and with the bundle cache. The cache is tried on static content,
+// whose bundles only differ by the uniform ring region, and on content where
+// one submesh changes every frame.
+//     render-bundles [draws] [frames] [maxThreads]
+int benchmarkRenderBundles(const std::vector<std::string>& args) {
+	uint32_t drawCount = args.size() < 1 ? 20000 : static_cast<uint32_t>(std::stoul(args[0]));
+	int frames = args.size() < 2 ? 100 : std::stoi(args[1]);
+	unsigned maxThreads = args.size() < 3 ? std::max(1u, std::thread::hardware_concurrency()) : std::stoul(args[2]);
+	const uint32_t uniformAlignment = 256;
+	const uint32_t materialCount = 64;
+
+	// One level of detail per submesh and one instance, so that every
+	// submesh is a draw, with materials in runs of 4 submeshes
+	RecordingBackend backend;
+	UniformRing uniformRing(backend, uniformAlignment, uint64_t(16) * uniformAlignment);
+	InstanceBatch instances(backend, 1);
+	instances.add(glm::mat4x4(1.0f), glm::vec4(1.0f));
+	std::vector<MeshLod> lods(drawCount);
+	std::vector<Submesh> submeshes(drawCount);
+	for (uint32_t i = 0; i < drawCount; ++i) {
+		lods[i] = { 36 * i, 36, 0.0f, 0 };
+		submeshes[i] = { 36 * i, 36, i, 1, 0, 0, static_cast<int32_t>(i / 4 % materialCount), 0 };
+	}
+	std::vector<wgpu::BindGroup> materialBindGroups(materialCount + 1);
+	for (uint32_t i = 0; i <= materialCount; ++i) {
+		materialBindGroups[i] = wgpu::BindGroup(reinterpret_cast<WGPUBindGroup>(static_cast<uintptr_t>(i + 1)));
+	}
+	SceneBindings scene;
+	scene.vertexBuffer = backend.createBuffer(wgpu::BufferDescriptor());
+	scene.vertexBufferSize = 1 << 20;
+	scene.indexBuffer = backend.createBuffer(wgpu::BufferDescriptor());
+	scene.indexBufferSize = 1 << 20;
+	scene.lods = lods.data();
+	scene.lodCount = lods.size();
+	scene.submeshes = submeshes.data();
+	scene.submeshCount = submeshes.size();
+	scene.materialBindGroups = materialBindGroups.data();
+
+	// Indices of every draw, in order, as the pass would run them
+	using Type = RecordingBackend::CommandType;
+	auto drawsOf = [&](const std::vector<RecordingBackend::Command>& commands, std::vector<uint32_t>& out) {
+		for (const auto& command : commands) {
+			if (command.type == Type::DrawIndexed) out.push_back(command.count);
+		}
+	};
+
+	MyUniforms uniforms = {};
+	uint32_t dynamicOffset = uploadFrame(uniformRing, instances, uniforms);
+	auto start = Clock::now();
+	for (int frame = 0; frame < frames; ++frame) {
+		backend.clear();
+		encodeScene(backend, scene, dynamicOffset, instances);
+	}
+	double directUs = elapsedMs(start) * 1000.0 / frames;
+	std::vector<uint32_t> expected;
+	drawsOf(backend.commands(), expected);
+
+	DrawList drawList;
+	start = Clock::now();
+	for (int frame = 0; frame < frames; ++frame) {
+		drawList.clear();
+		encodeScene(drawList, scene, dynamicOffset, instances);
+	}
+	double captureUs = elapsedMs(start) * 1000.0 / frames;
+
+	std::cout << "render-bundles: " << drawCount << " draws, " << frames << " frames" << std::endl;
+	std::cout << "  into the pass:        " << directUs << " us/frame" << std::endl;
+	std::cout << "  into a draw list:     " << captureUs << " us/frame" << std::endl;
+
+	// A frame: capture, record and execute, like Renderer::MainLoop
+	bool valid = true;
+	RenderBundles renderBundles(backend, 0, 0);
+	auto runFrame = [&](ThreadPool& pool) {
+		drawList.clear();
+		encodeScene(drawList, scene, dynamicOffset, instances);
+		const std::vector<wgpu::RenderBundle>& bundles = renderBundles.record(drawList, &pool);
+		backend.clear();
+		backend.executeBundles(bundles.size(), bundles.data());
+		return bundles;
+	};
+	auto check = [&](const std::vector<wgpu::RenderBundle>& bundles) {
+		std::vector<uint32_t> actual;
+		for (wgpu::RenderBundle bundle : bundles) {
+			drawsOf(backend.bundleCommands(bundle), actual);
+		}
+		valid = valid && actual == expected;
+	};
+
+	for (unsigned threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(2 * threads, maxThreads) : threads + 1) {
+		ThreadPool pool(threads);
+		start = Clock::now();
+		for (int frame = 0; frame < frames; ++frame) {
+			renderBundles.clear();
+			runFrame(pool);
+		}
+		double uncachedUs = elapsedMs(start) * 1000.0 / frames;
+		check(runFrame(pool));
+		size_t bundleCount = renderBundles.lastRecorded() + renderBundles.lastReused();
+		renderBundles.clear();
+
+		// Static content, the uniform ring region changing every frame
+		start = Clock::now();
+		for (int frame = 0; frame < frames; ++frame) {
+			dynamicOffset = uniformAlignment * (frame % 3);
+			runFrame(pool);
+		}
+		double staticUs = elapsedMs(start) * 1000.0 / frames;
+		uint32_t staticRecorded = renderBundles.lastRecorded();
+		renderBundles.clear();
+
+		// One submesh changes every frame
+		dynamicOffset = 0;
+		start = Clock::now();
+		for (int frame = 0; frame < frames; ++frame) {
+			lods[drawCount / 2].indexCount = 36 + 3 * frame;
+			runFrame(pool);
+		}
+		double changingUs = elapsedMs(start) * 1000.0 / frames;
+		uint32_t changingRecorded = renderBundles.lastRecorded();
+		lods[drawCount / 2].indexCount = 36;
+		check(runFrame(pool));
+		renderBundles.clear();
+
+		std::cout << "  " << threads << " threads, " << bundleCount << " bundles:" << std::endl;
+		std::cout << "    recorded every frame: " << uncachedUs << " us/frame, " << directUs / uncachedUs << "x" << std::endl;
+		std::cout << "    static, cached:       " << staticUs << " us/frame, " << staticRecorded << " bundles recorded in the last frame" << std::endl;
+		std::cout << "    one change, cached:   " << changingUs << " us/frame, " << changingRecorded << " bundles recorded in the last frame" << std::endl;
+	}
+	valid = valid && backend.liveBundles() == 0;
+	if (!valid) {
+		std::cout << "*** ERROR *** Bundles do not draw what the pass does" << std::endl;
+	}
+	return valid ? 0 : 1;
+}
+
+
+// A deferred frame at 1080p declared as a render graph: shadow cascades,
+// G-buffer, ambient occlusion, lighting, a bloom chain and extraPasses
+// post-process passes ping-ponging between HDR targets, plus a debug view
+// and a picking readback that nothing uses. Compile time, culled passes and
+// the memory aliasing saves, against one allocation per resource.
+//     render-graph [extraPasses] [rounds]
+int benchmarkRenderGraph(const std::vector<std::string>& args) {
+	uint32_t extraPasses = args.size() < 1 ? 16 : static_cast<uint32_t>(std::stoul(args[0]));
+	int rounds = args.size() < 2 ? 100 : std::stoi(args[1]);
+	const uint32_t width = 1920;
+	const uint32_t height = 1080;
+	const uint32_t cascadeCount = 4;
+	const uint32_t bloomLevels = 5;
+	const WGPUFlags target = wgpu::TextureUsage::RenderAttachment | wgpu::TextureUsage::TextureBinding;
+
+	using ResourceId = RenderGraph::ResourceId;
+	using PassId = RenderGraph::PassId;
+	RenderGraph graph;
+	std::vector<GraphTextureDesc> textureDescs;
+	auto texture = [&](const std::string& name, uint32_t w, uint32_t h, WGPUTextureFormat format) {
+		ResourceId id = graph.createTexture(name, { w, h, format, target, 1, 1 });
+		textureDescs.resize(id + 1);
+		textureDescs[id] = { w, h, format, target, 1, 1 };
+		return id;
+	};
+	auto pass = [&](const std::string& name, std::initializer_list<ResourceId> reads) {
+		PassId id = graph.addPass(name, nullptr);
+		for (ResourceId resource : reads) {
+			graph.read(id, resource);
+		}
+		return id;
+	};
+
+	ResourceId surface = graph.importTexture("Surface");
+	std::vector<ResourceId> shadows;
+	for (uint32_t c = 0; c < cascadeCount; ++c) {
+		shadows.push_back(texture("Shadow cascade " + std::to_string(c), 2048, 2048, wgpu::TextureFormat::Depth32Float));
+		graph.depthAttachment(pass("Shadow cascade " + std::to_string(c), {}), shadows.back());
+	}
+	ResourceId depth = texture("Depth", width, height, wgpu::TextureFormat::Depth24Plus);
+	ResourceId albedo = texture("Albedo", width, height, wgpu::TextureFormat::RGBA8Unorm);
+	ResourceId normals = texture("Normals", width, height, wgpu::TextureFormat::RGBA16Float);
+	ResourceId material = texture("Material", width, height, wgpu::TextureFormat::RGBA8Unorm);
+	PassId gbuffer = pass("G-buffer", {});
+	graph.depthAttachment(gbuffer, depth);
+	graph.colorAttachment(gbuffer, albedo);
+	graph.colorAttachment(gbuffer, normals);
+	graph.colorAttachment(gbuffer, material);
+
+	ResourceId lights = graph.createBuffer("Light lists", { 8u << 20, wgpu::BufferUsage::Storage });
+	graph.write(pass("Light culling", { depth }), lights);
+	ResourceId aoRaw = texture("AO raw", width, height, wgpu::TextureFormat::R8Unorm);
+	ResourceId ao = texture("AO", width, height, wgpu::TextureFormat::R8Unorm);
+	graph.colorAttachment(pass("SSAO", { depth, normals }), aoRaw);
+	graph.colorAttachment(pass("SSAO blur", { aoRaw }), ao);
+
+	ResourceId hdr = texture("HDR", width, height, wgpu::TextureFormat::RGBA16Float);
+	PassId lighting = pass("Lighting", { albedo, normals, material, depth, ao, lights });
+	for (ResourceId shadow : shadows) {
+		graph.read(lighting, shadow);
+	}
+	graph.colorAttachment(lighting, hdr);
+
+	// Post-process chain, ping-ponging between two HDR targets
+	ResourceId post = hdr;
+	for (uint32_t p = 0; p < extraPasses; ++p) {
+		ResourceId next = texture("Post " + std::to_string(p), width, height, wgpu::TextureFormat::RGBA16Float);
+		graph.colorAttachment(pass("Post " + std::to_string(p), { post }), next);
+		post = next;
+	}
+
+	std::vector<ResourceId> bloom;
+	ResourceId bloomSource = post;
+	for (uint32_t level = 0; level < bloomLevels; ++level) {
+		bloom.push_back(texture("Bloom " + std::to_string(level), width >> (level + 1), height >> (level + 1), wgpu::TextureFormat::RGBA16Float));
+		graph.colorAttachment(pass("Bloom down " + std::to_string(level), { bloomSource }), bloom.back());
+		bloomSource = bloom.back();
+	}
+	for (uint32_t level = bloomLevels - 1; level-- > 0;) {
+		graph.colorAttachment(pass("Bloom up " + std::to_string(level), { bloom[level + 1] }), bloom[level]);
+	}
+
+	ResourceId histogram = graph.createBuffer("Luminance histogram", { 1024, wgpu::BufferUsage::Storage });
+	graph.write(pass("Luminance", { post }), histogram);
+	ResourceId ldr = texture("LDR", width, height, wgpu::TextureFormat::RGBA8Unorm);
+	graph.colorAttachment(pass("Tone mapping", { post, bloom[0], histogram }), ldr);
+	graph.colorAttachment(pass("UI", {}), ldr);
+	graph.colorAttachment(pass("Output", { ldr }), surface);
+
+	// Nothing reads these
+	ResourceId debugView = texture("Debug view", width, height, wgpu::TextureFormat::RGBA8Unorm);
+	PassId debug = pass("Debug normals", { normals });
+	graph.colorAttachment(debug, debugView);
+	ResourceId pickingIds = texture("Picking ids", width, height, wgpu::TextureFormat::R32Float);
+	ResourceId pickingReadback = graph.createBuffer("Picking readback", { 4, wgpu::BufferUsage::MapRead | wgpu::BufferUsage::CopyDst });
+	PassId picking = pass("Picking", {});
+	graph.colorAttachment(picking, pickingIds);
+	PassId pickingCopy = pass("Picking copy", { pickingIds });
+	graph.write(pickingCopy, pickingReadback);
+
+	bool valid = graph.compile();
+	auto start = Clock::now();
+	for (int round = 0; round < rounds; ++round) {
+		valid = valid && graph.compile();
+	}
+	double compileUs = elapsedMs(start) * 1000.0 / rounds;
+	if (!valid) {
+		std::cout << "*** ERROR *** The render graph does not compile" << std::endl;
+		return 1;
+	}
+	const RenderGraphStats& stats = graph.stats();
+	std::cout << "render-graph: " << graph.passCount() << " passes, " << graph.resourceCount() << " resources, "
+		<< rounds << " rounds" << std::endl;
+	std::cout << "  compiled in:      " << compileUs << " us" << std::endl;
+	std::cout << "  passes run:       " << stats.passCount - stats.culledPassCount << ", " << stats.culledPassCount << " culled" << std::endl;
+	std::cout << "  allocations:      " << stats.allocationCount << " for " << stats.resourceCount - stats.culledResourceCount
+		<< " transient resources, " << stats.culledResourceCount << " unused" << std::endl;
+	std::cout << "  memory:           " << stats.allocatedBytes / (1024.0 * 1024.0) << " MiB instead of "
+		<< stats.requestedBytes / (1024.0 * 1024.0) << " MiB, " << 100.0 * stats.savedBytes() / stats.requestedBytes << "% saved" << std::endl;
+
+	// The unused passes are culled, and only them
+	valid = valid && graph.culled(debug) && graph.culled(picking) && graph.culled(pickingCopy)
+		&& stats.culledPassCount == 3 && stats.culledResourceCount == 3;
+
+	// Resources sharing an allocation have disjoint lifetimes and, for
+	// textures, the same shape
+	std::vector<uint32_t> firstUse(graph.resourceCount(), UINT32_MAX);
+	std::vector<uint32_t> lastUse(graph.resourceCount(), 0);
+	const std::vector<PassId>& order = graph.passOrder();
+	for (uint32_t index = 0; index < order.size(); ++index) {
+		for (const RenderGraph::Access& access : graph.accesses(order[index])) {
+			valid = valid && access.first == (firstUse[access.resource] == UINT32_MAX);
+			firstUse[access.resource] = std::min(firstUse[access.resource], index);
+			lastUse[access.resource] = index;
+		}
+	}
+	for (ResourceId a = 0; a < graph.resourceCount(); ++a) {
+		uint32_t allocation = graph.allocation(a);
+		valid = valid && (allocation == RenderGraph::NoAllocation) == (graph.imported(a) || firstUse[a] == UINT32_MAX);
+		if (allocation == RenderGraph::NoAllocation) {
+			continue;
+		}
+		const RenderGraph::Allocation& shared = graph.allocations()[allocation];
+		if (shared.texture) {
+			valid = valid && shared.textureDesc.width == textureDescs[a].width && shared.textureDesc.format == textureDescs[a].format;
+		}
+		for (ResourceId b = a + 1; b < graph.resourceCount(); ++b) {
+			if (graph.allocation(b) == allocation) {
+				valid = valid && (lastUse[a] < firstUse[b] || lastUse[b] < firstUse[a]);
+			}
+		}
+	}
+
+	// Kept passes and their inputs run, and reading what nothing wrote fails
+	graph.keepPass(pickingCopy);
+	valid = valid && !graph.compiled() && graph.compile() && !graph.culled(picking) && graph.stats().culledPassCount == 1;
+	std::cout << "  with picking kept: " << graph.stats().allocatedBytes / (1024.0 * 1024.0) << " MiB" << std::endl;
+	ResourceId missing = texture("Never written", width, height, wgpu::TextureFormat::RGBA8Unorm);
+	graph.read(lighting, missing);
+	std::cout << "  an invalid graph is rejected:" << std::endl;
+	valid = valid && !graph.compile() && !graph.compiled();
+
+	if (!valid) {
+		std::cout << "*** ERROR *** The compiled render graph is inconsistent" << std::endl;
+	}
+	return valid ? 0 : 1;
+}
+
+
+// Rows of walls in front of a camera, drawn as 12-triangle occluders in the
+// 160x120 depth buffer of a 640x480 view, and boxes scattered among them:
+// occluder triangles/ms on 1 to maxThreads threads, boxes tested/ms, and
+// checks of the depth buffer against a double-precision reference, of the
+// pyramid, of every box found hidden and of the levels of a torus picked as
+// occluders, which must not hide more than a texel beyond the full torus
+//     occlusion-cull [occluders] [queries] [rounds] [maxThreads]
+int benchmarkOcclusionCull(const std::vector<std::string>& args) {
+	uint32_t occluderCount = args.size() < 1 ? 2000 : static_cast<uint32_t>(std::stoul(args[0]));
+	uint32_t queryCount = args.size() < 2 ? 100000 : static_cast<uint32_t>(std::stoul(args[1]));
+	int rounds = args.size() < 3 ? 20 : std::stoi(args[2]);
+	unsigned maxThreads = args.size() < 4 ? std::max(1u, std::thread::hardware_concurrency()) : std::stoul(args[3]);
+
+	// Renderer projection at 640x480, as in meshlet-cull, looking down +z
+	const float focalLength = 2.0f, near = 0.01f, far = 300.0f;
+	glm::mat4x4 projection(0.0f);
+	projection[0][0] = 1.0f;
+	projection[1][1] = 640.0f / 480.0f;
+	projection[2][2] = far / (focalLength * (far - near));
+	projection[3][2] = -far * near / (focalLength * (far - near));
+	projection[2][3] = 1.0f / focalLength;
+
+	// Unit cube, the shape of every occluder
+	const std::vector<glm::vec3> cube = {
+		{ 0, 0, 0 }, { 1, 0, 0 }, { 0, 1, 0 }, { 1, 1, 0 }, { 0, 0, 1 }, { 1, 0, 1 }, { 0, 1, 1 }, { 1, 1, 1 },
+	};
+	const std::vector<uint32_t> cubeIndices = {
+		0, 2, 1, 1, 2, 3,  4, 5, 6, 5, 7, 6,  0, 1, 4, 1, 5, 4,
+		2, 6, 3, 3, 6, 7,  0, 4, 2, 2, 4, 6,  1, 3, 5, 3, 7, 5,
+	};
+	auto boxMatrix = [](const glm::vec3& boxMin, const glm::vec3& boxMax) {
+		glm::mat4x4 matrix(1.0f);
+		matrix[0][0] = boxMax.x - boxMin.x;
+		matrix[1][1] = boxMax.y - boxMin.y;
+		matrix[2][2] = boxMax.z - boxMin.z;
+		matrix[3] = glm::vec4(boxMin, 1.0f);
+		return matrix;
+	};
+
+	// Walls standing on the ground 1.5 below the eye, and boxes among them
+	std::mt19937_64 rng(29);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	std::vector<glm::vec3> wallMin(occluderCount), wallMax(occluderCount);
+	for (uint32_t i = 0; i < occluderCount; ++i) {
+		glm::vec3 base(-150.0f + 300.0f * unit(rng), -1.5f, 5.0f + 250.0f * unit(rng));
+		glm::vec3 size = unit(rng) < 0.5f ? glm::vec3(4.0f + 8.0f * unit(rng), 3.0f + 6.0f * unit(rng), 0.4f)
+			: glm::vec3(0.4f, 3.0f + 6.0f * unit(rng), 4.0f + 8.0f * unit(rng));
+		wallMin[i] = base;
+		wallMax[i] = base + size;
+	}
+	std::vector<glm::vec3> queryMin(queryCount), queryMax(queryCount);
+	for (uint32_t i = 0; i < queryCount; ++i) {
+		glm::vec3 base(-150.0f + 300.0f * unit(rng), -1.5f + 2.0f * unit(rng), 5.0f + 250.0f * unit(rng));
+		queryMin[i] = base;
+		queryMax[i] = base + glm::vec3(0.5f + unit(rng), 0.5f + unit(rng), 0.5f + unit(rng));
+	}
+
+	OcclusionCuller culler(160, 120);
+	auto addWalls = [&]() {
+		culler.clear();
+		for (uint32_t i = 0; i < occluderCount; ++i) {
+			culler.addOccluder(projection * boxMatrix(wallMin[i], wallMax[i]), cube.data(), cubeIndices.data(), cubeIndices.size());
+		}
+	};
+	addWalls();
+	culler.render(nullptr);
+	std::vector<float> reference(culler.depth(0), culler.depth(0) + size_t(culler.width()) * culler.height());
+	std::cout << "occlusion-cull: " << occluderCount << " occluders, " << culler.queuedTriangleCount() << " triangles, "
+		<< culler.lastRasterizedCount() << " rasterized, " << culler.width() << "x" << culler.height() << " pixels, "
+		<< culler.levelCount() << " levels" << std::endl;
+
+	bool valid = true;
+	for (unsigned threads = 1; threads <= maxThreads; threads = threads < maxThreads ? std::min(2 * threads, maxThreads) : threads + 1) {
+		ThreadPool pool(threads);
+		auto start = Clock::now();
+		for (int round = 0; round < rounds; ++round) {
+			addWalls();
+			culler.render(&pool);
+		}
+		double renderMs = elapsedMs(start) / rounds;
+		std::cout << "  rasterized on " << threads << " threads: " << renderMs << " ms, "
+			<< culler.lastRasterizedCount() / renderMs << " triangles/ms" << std::endl;
+		// Tiles do not depend on the threads
+		valid = valid && std::memcmp(reference.data(), culler.depth(0), reference.size() * sizeof(float)) == 0;
+	}
+
+	// Every pixel lies between the nearest depth of the triangles covering
+	// its center with some margin and that of those covering it at all, the
+	// vertices snapped as the culler snaps them
+	uint32_t width = culler.width();
+	uint32_t height = culler.height();
+	std::vector<double> tightDepth(size_t(width) * height, 1.0), looseDepth(size_t(width) * height, 1.0);
+	for (uint32_t i = 0; i < occluderCount; ++i) {
+		glm::mat4x4 clipFromObject = projection * boxMatrix(wallMin[i], wallMax[i]);
+		for (size_t t = 0; t < cubeIndices.size(); t += 3) {
+			double x[3], y[3], z[3];
+			bool clipped = false;
+			for (int k = 0; k < 3; ++k) {
+				glm::vec4 clip = clipFromObject * glm::vec4(cube[cubeIndices[t + k]], 1.0f);
+				clipped = clipped || clip.w <= 0.0f || clip.z < 0.0f;
+				float inverseW = 1.0f / clip.w;
+				x[k] = std::round((clip.x * inverseW * 0.5f + 0.5f) * float(width) * 16.0f) / 16.0;
+				y[k] = std::round((0.5f - clip.y * inverseW * 0.5f) * float(height) * 16.0f) / 16.0;
+				z[k] = std::min(double(clip.z) / clip.w, 1.0);
+			}
+			double area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+			if (clipped || std::abs(area) < 1.0 / 64.0) {
+				continue;
+			}
+			int x0 = std::max(0, int(std::floor(std::min({ x[0], x[1], x[2] }))) - 1);
+			int x1 = std::min(int(width) - 1, int(std::ceil(std::max({ x[0], x[1], x[2] }))) + 1);
+			int y0 = std::max(0, int(std::floor(std::min({ y[0], y[1], y[2] }))) - 1);
+			int y1 = std::min(int(height) - 1, int(std::ceil(std::max({ y[0], y[1], y[2] }))) + 1);
+			for (int py = y0; py <= y1; ++py) {
+				for (int px = x0; px <= x1; ++px) {
+					// Distances to the edges in pixels, positive inside
+					double cx = px + 0.5, cy = py + 0.5;
+					double l[3], distance = INFINITY;
+					for (int k = 0; k < 3; ++k) {
+						int a = (k + 1) % 3, b = (k + 2) % 3;
+						double edge = (x[b] - x[a]) * (cy - y[a]) - (y[b] - y[a]) * (cx - x[a]);
+						l[k] = edge / area;
+						distance = std::min(distance, (area > 0 ? edge : -edge) / std::hypot(x[b] - x[a], y[b] - y[a]));
+					}
+					double depth = l[0] * z[0] + l[1] * z[1] + l[2] * z[2];
+					size_t pixel = size_t(py) * width + px;
+					if (distance >= 0.01) tightDepth[pixel] = std::min(tightDepth[pixel], depth);
+					if (distance >= -0.01) looseDepth[pixel] = std::min(looseDepth[pixel], depth);
+				}
+			}
+		}
+	}
+	uint32_t badPixels = 0;
+	for (size_t pixel = 0; pixel < reference.size(); ++pixel) {
+		badPixels += reference[pixel] < looseDepth[pixel] - 1e-4 || reference[pixel] > tightDepth[pixel] + 1e-4;
+	}
+	if (badPixels != 0) {
+		std::cout << "*** ERROR *** " << badPixels << " pixels differ from the reference rasterization" << std::endl;
+		valid = false;
+	}
+
+	// Every texel of the pyramid is the farthest of the pixels it covers
+	for (uint32_t level = 1; level < culler.levelCount(); ++level) {
+		for (uint32_t ty = 0; ty < culler.levelHeight(level); ++ty) {
+			for (uint32_t tx = 0; tx < culler.levelWidth(level); ++tx) {
+				float farthest = 0.0f;
+				for (uint32_t py = ty << level; py < std::min(height, (ty + 1) << level); ++py) {
+					for (uint32_t px = tx << level; px < std::min(width, (tx + 1) << level); ++px) {
+						farthest = std::max(farthest, reference[size_t(py) * width + px]);
+					}
+				}
+				valid = valid && culler.depth(level)[size_t(ty) * culler.levelWidth(level) + tx] == farthest;
+			}
+		}
+	}
+
+	std::vector<uint8_t> visible(queryCount, 1);
+	uint32_t visibleCount = 0;
+	auto start = Clock::now();
+	for (int round = 0; round < rounds; ++round) {
+		std::fill(visible.begin(), visible.end(), uint8_t(1));
+		visibleCount = culler.cull(projection, queryMin.data(), queryMax.data(), queryCount, visible.data());
+	}
+	double queryMs = elapsedMs(start) / rounds;
+	std::cout << "  boxes tested:        " << queryMs << " ms, " << queryCount / queryMs << " boxes/ms, "
+		<< 100.0 * (queryCount - visibleCount) / queryCount << "% hidden" << std::endl;
+
+	// A box found hidden is behind every pixel it touches
+	uint32_t wrongHidden = 0;
+	for (uint32_t i = 0; i < queryCount; ++i) {
+		if (visible[i]) {
+			continue;
+		}
+		double minX = INFINITY, maxX = -INFINITY, minY = INFINITY, maxY = -INFINITY, nearest = INFINITY;
+		for (int corner = 0; corner < 8; ++corner) {
+			glm::vec3 point((corner & 1) ? queryMax[i].x : queryMin[i].x, (corner & 2) ? queryMax[i].y : queryMin[i].y,
+							(corner & 4) ? queryMax[i].z : queryMin[i].z);
+			glm::vec4 clip = projection * glm::vec4(point, 1.0f);
+			minX = std::min(minX, (double(clip.x) / clip.w * 0.5 + 0.5) * width);
+			maxX = std::max(maxX, (double(clip.x) / clip.w * 0.5 + 0.5) * width);
+			minY = std::min(minY, (0.5 - double(clip.y) / clip.w * 0.5) * height);
+			maxY = std::max(maxY, (0.5 - double(clip.y) / clip.w * 0.5) * height);
+			nearest = std::min(nearest, double(clip.z) / clip.w);
+		}
+		for (int py = std::max(0, int(std::floor(minY))); py <= std::min(int(height) - 1, int(std::floor(maxY))); ++py) {
+			for (int px = std::max(0, int(std::floor(minX))); px <= std::min(int(width) - 1, int(std::floor(maxX))); ++px) {
+				if (reference[size_t(py) * width + px] >= nearest + 1e-6) {
+					++wrongHidden;
+					py = int(height);
+					break;
+				}
+			}
+		}
+	}
+	if (wrongHidden != 0) {
+		std::cout << "*** ERROR *** " << wrongHidden << " boxes found hidden are not" << std::endl;
+		valid = false;
+	}
+
+	// A wall 10 ahead hides what is behind it, not what is in front of it,
+	// beside it or across the near plane
+	culler.clear();
+	glm::mat4x4 wall = projection * boxMatrix(glm::vec3(-20.0f, -20.0f, 10.0f), glm::vec3(20.0f, 20.0f, 10.5f));
+	culler.addOccluder(wall, cube.data(), cubeIndices.data(), cubeIndices.size());
+	culler.render(nullptr);
+	valid = valid && !culler.visible(projection, glm::vec3(-1.0f, -1.0f, 20.0f), glm::vec3(1.0f, 1.0f, 22.0f))
+		&& culler.visible(projection, glm::vec3(-1.0f, -1.0f, 5.0f), glm::vec3(1.0f, 1.0f, 6.0f))
+		&& culler.visible(projection, glm::vec3(50.0f, -1.0f, 20.0f), glm::vec3(52.0f, 1.0f, 22.0f))
+		&& culler.visible(projection, glm::vec3(-1.0f, -1.0f, -1.0f), glm::vec3(1.0f, 1.0f, 30.0f))
+		&& culler.visible(projection, glm::vec3(-1.0f, -1.0f, 9.0f), glm::vec3(1.0f, 1.0f, 11.0f));
+
+	// The levels of a torus facing the camera as occluders, at distances in
+	// bounding radii, over a grid of boxes a radius behind it: the level
+	// picked by selectOccluderLod() may only hide boxes within a texel of
+	// what the full torus covers, where the coarsest level, its hole filled
+	// in, hides more
+	const uint32_t rings = 96, sides = 32;
+	const float pi = 3.14159265f;
+	Mesh torus;
+	for (uint32_t ring = 0; ring < rings; ++ring) {
+		float u = 2.0f * pi * ring / rings;
+		for (uint32_t side = 0; side < sides; ++side) {
+			float v = 2.0f * pi * side / sides;
+			glm::vec3 axis(std::cos(u), std::sin(u), 0.0f);
+			VertexAttributes vertex;
+			vertex.normal = std::cos(v) * axis + glm::vec3(0.0f, 0.0f, std::sin(v));
+			vertex.position = axis + 0.35f * vertex.normal;
+			vertex.color = glm::vec3(1.0f);
+			torus.vertices.push_back(vertex);
+			uint32_t a = ring * sides + side, b = (ring + 1) % rings * sides + side;
+			uint32_t c = ring * sides + (side + 1) % sides, d = (ring + 1) % rings * sides + (side + 1) % sides;
+			torus.indices.insert(torus.indices.end(), { a, b, d, a, d, c });
+		}
+	}
+	buildLods(torus, MaxLodLevels, ThreadPool::shared());
+	std::vector<glm::vec3> positions(torus.vertices.size());
+	for (size_t i = 0; i < positions.size(); ++i) {
+		positions[i] = torus.vertices[i].position;
+	}
+	glm::vec4 bounds = meshBoundingSphere(torus.vertices.data(), torus.vertices.size());
+	float errorScale = lodErrorScale(projection, static_cast<float>(culler.height()));
+	const uint32_t grid = 64;
+	OcclusionCuller fine(4 * culler.width(), 4 * culler.height());
+	auto hiddenBy = [&](uint32_t lodIndex, const glm::mat4x4& modelView, std::vector<uint8_t>& hidden) {
+		const MeshLod& lod = torus.lods[lodIndex];
+		culler.clear();
+		culler.addOccluder(projection * modelView, positions.data(), torus.indices.data() + lod.firstIndex, lod.indexCount);
+		culler.render(nullptr);
+		std::vector<uint8_t> boxVisible(hidden.size(), 1);
+		culler.cull(projection, queryMin.data(), queryMax.data(), hidden.size(), boxVisible.data());
+		for (size_t i = 0; i < hidden.size(); ++i) hidden[i] = boxVisible[i] ^ 1;
+	};
+	std::cout << "  torus levels as occluders (distance:level, boxes hidden beyond a texel of the torus by it/by the coarsest):";
+	uint32_t coarsestBeyond = 0;
+	for (float distance = 1.5f; distance <= 96.0f; distance *= 2.0f) {
+		glm::mat4x4 modelView(1.0f);
+		modelView[3] = glm::vec4(-glm::vec3(bounds) + glm::vec3(0.0f, 0.0f, distance * bounds.w), 1.0f);
+		uint32_t level = selectOccluderLod(torus.lods, projection, modelView, bounds, errorScale);
+
+		// Boxes of about a texel across covering the torus, a radius behind it
+		float depth = (distance + 1.0f) * bounds.w;
+		float extent = 1.2f * bounds.w * depth / (distance * bounds.w);
+		float boxSize = 2.0f * extent / grid;
+		queryMin.resize(grid * grid);
+		queryMax.resize(grid * grid);
+		for (uint32_t y = 0; y < grid; ++y) {
+			for (uint32_t x = 0; x < grid; ++x) {
+				glm::vec3 corner(-extent + x * boxSize, -extent + y * boxSize, depth);
+				queryMin[y * grid + x] = corner;
+				queryMax[y * grid + x] = corner + glm::vec3(boxSize, boxSize, 0.1f * bounds.w);
+			}
+		}
+
+		// Texels within one of the full torus, found on a four times finer
+		// buffer that a tube thinner than a texel still covers
+		std::vector<uint8_t> full(grid * grid);
+		hiddenBy(0, modelView, full);
+		fine.clear();
+		fine.addOccluder(projection * modelView, positions.data(), torus.indices.data(), torus.lods[0].indexCount);
+		fine.render(nullptr);
+		const float* fineDepth = fine.depth(0);
+		int w = static_cast<int>(culler.width()), h = static_cast<int>(culler.height());
+		std::vector<uint8_t> nearTorus(size_t(w) * h, 0);
+		for (int y = 0; y < 4 * h; ++y) {
+			for (int x = 0; x < 4 * w; ++x) {
+				if (fineDepth[y * 4 * w + x] == 1.0f) continue;
+				for (int ny = std::max(0, y / 4 - 1); ny <= std::min(h - 1, y / 4 + 1); ++ny) {
+					for (int nx = std::max(0, x / 4 - 1); nx <= std::min(w - 1, x / 4 + 1); ++nx) nearTorus[ny * w + nx] = 1;
+				}
+			}
+		}
+		// A hidden box that reaches a texel farther from the torus is wrong
+		auto beyondTorus = [&](const std::vector<uint8_t>& hidden) {
+			uint32_t count = 0;
+			for (size_t i = 0; i < hidden.size(); ++i) {
+				if (!hidden[i] || full[i]) continue;
+				glm::vec4 low = projection * glm::vec4(queryMin[i], 1.0f), high = projection * glm::vec4(queryMax[i].x, queryMax[i].y, queryMin[i].z, 1.0f);
+				int x0 = std::max(0, static_cast<int>(std::floor((low.x / low.w * 0.5f + 0.5f) * w)));
+				int x1 = std::min(w - 1, static_cast<int>(std::floor((high.x / high.w * 0.5f + 0.5f) * w)));
+				int y0 = std::max(0, static_cast<int>(std::floor((0.5f - high.y / high.w * 0.5f) * h)));
+				int y1 = std::min(h - 1, static_cast<int>(std::floor((0.5f - low.y / low.w * 0.5f) * h)));
+				bool beyond = false;
+				for (int y = y0; y <= y1; ++y) {
+					for (int x = x0; x <= x1; ++x) beyond = beyond || !nearTorus[y * w + x];
+				}
+				count += beyond ? 1 : 0;
+			}
+			return count;
+		};
+
+		std::vector<uint8_t> picked(grid * grid, 0), coarsest(grid * grid);
+		if (level != NoOccluderLod) {
+			hiddenBy(level, modelView, picked);
+		}
+		hiddenBy(static_cast<uint32_t>(torus.lods.size() - 1), modelView, coarsest);
+		uint32_t pickedBeyond = beyondTorus(picked), beyondCoarsest = beyondTorus(coarsest);
+		coarsestBeyond += beyondCoarsest;
+		std::cout << " " << distance << ":" << (level == NoOccluderLod ? std::string("none") : std::to_string(level))
+			<< " " << pickedBeyond << "/" << beyondCoarsest;
+		if (pickedBeyond != 0) {
+			valid = false;
+		}
+	}
+	std::cout << std::endl;
+	// Without the full level, as when it exceeds the triangle budget, the
+	// torus right in front of the camera occludes nothing
+	std::vector<MeshLod> withoutFull(torus.lods.begin() + 1, torus.lods.end());
+	glm::mat4x4 close(1.0f);
+	close[3] = glm::vec4(-glm::vec3(bounds) + glm::vec3(0.0f, 0.0f, 1.5f * bounds.w), 1.0f);
+	if (selectOccluderLod(withoutFull, projection, close, bounds, errorScale) != NoOccluderLod) {
+		std::cout << "*** ERROR *** A close occluder got a level coarser than a texel" << std::endl;
+		valid = false;
+	}
+	if (coarsestBeyond == 0) {
+		std::cout << "*** ERROR *** The coarsest torus level hid nothing the full one leaves visible, the check above proves nothing" << std::endl;
+		valid = false;
+	}
+
+	if (!valid) {
+		std::cout << "*** ERROR *** Occlusion culling is wrong" << std::endl;
+	}
+	return valid ? 0 : 1;
+}
+
+} // anonymous namespace
+
+
+int runBenchmarks(const std::vector<std::string>& args) {
+	using Benchmark = std::function<int(const std::vector<std::string>&)>;
+	static const std::map<std::string, Benchmark> benchmarks = {
+		{ "mesh-cache", benchmarkMeshCache },
+		{ "obj-parse", benchmarkObjParse },
+		{ "number-scan", benchmarkNumberScan },
+		{ "upload-ring", benchmarkUploadRing },
+		{ "instancing", benchmarkInstancing },
+		{ "profiler", benchmarkProfiler },
+		{ "frame-encode", benchmarkFrameEncode },
+		{ "compact-vertex", benchmarkCompactVertex },
+		{ "vertex-cache", benchmarkVertexCache },
+		{ "simplify", benchmarkSimplify },
+		{ "meshlet-cull", benchmarkMeshletCull },
+		{ "asset-load", benchmarkAssetLoad },
+		{ "submeshes", benchmarkSubmeshes },
+		{ "geometry-codec", benchmarkGeometryCodec },
+		{ "pipeline-cache", benchmarkPipelineCache },
+		{ "shader-variants", benchmarkShaderVariants },
+		{ "buffer-alloc", benchmarkBufferAlloc },
+		{ "frustum-cull", benchmarkFrustumCull },
+		{ "scene-graph", benchmarkSceneGraph },
+		{ "render-bundles", benchmarkRenderBundles },
+		{ "render-graph", benchmarkRenderGraph },
+		{ "occlusion-cull", benchmarkOcclusionCull },
+	};
+
+	auto it = args.empty() ? benchmarks.end() : benchmarks.find(args[0]);
+	if (it == benchmarks.end()) {
+		std::cout << "Usage: App --benchmark <name> [arguments...]" << std::endl;
+		std::cout << "Available benchmarks:" << std::endl;
+		for (const auto& entry : benchmarks) {
+			std::cout << "  " << entry.first << std::endl;
+		}
+		return args.empty() ? 0 : 1;
+	}
+
+	return it->second(std::vector<std::string>(args.begin() + 1, args.end()));
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/**
+ * CPU-side benchmarks, run from the command line with
+ *     App --benchmark <name> [arguments...]
+ * Calling it with no name lists the available benchmarks.
+ * Returns the process exit code.
+ */
+int runBenchmarks(const std::vector<std::string>& args);
@@ -0,0 +1,149 @@
+#include "buddy-allocator.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+uint64_t ceilToPowerOfTwo(uint64_t value) {
+	uint64_t result = 1;
+	while (result < value) {
+		result <<= 1;
+	}
+	return result;
+}
+
+} // anonymous namespace
+
+
+BuddyAllocator::BuddyAllocator(uint64_t capacity, uint64_t minBlockSize)
+	: minBlock(ceilToPowerOfTwo(std::max<uint64_t>(minBlockSize, 1)))
+	, maxOrder(0)
+{
+	// Block indices are 32-bit
+	while (maxOrder < 31 && (minBlock << (maxOrder + 1)) <= capacity) {
+		++maxOrder;
+	}
+	size_t blockCount = size_t(1) << maxOrder;
+	blockState.assign(blockCount, 0);
+	nextFree.reset(new uint32_t[blockCount]);
+	previousFree.reset(new uint32_t[blockCount]);
+	requestedSize.reset(new uint64_t[blockCount]);
+	freeHeads.assign(maxOrder + 1, None);
+	pushFree(0, maxOrder);
+}
+
+
+uint32_t BuddyAllocator::orderFor(uint64_t size) const {
+	uint32_t order = 0;
+	while (order <= maxOrder && (minBlock << order) < size) {
+		++order;
+	}
+	return order;
+}
+
+
+void BuddyAllocator::pushFree(uint32_t block, uint32_t order) {
+	blockState[block] = static_cast<uint8_t>(order) | FreeBit;
+	previousFree[block] = None;
+	nextFree[block] = freeHeads[order];
+	if (freeHeads[order] != None) {
+		previousFree[freeHeads[order]] = block;
+	}
+	freeHeads[order] = block;
+	freeOrders |= uint64_t(1) << order;
+	++freeBlocks;
+}
+
+
+void BuddyAllocator::removeFree(uint32_t block, uint32_t order) {
+	if (previousFree[block] != None) {
+		nextFree[previousFree[block]] = nextFree[block];
+	}
+	else {
+		freeHeads[order] = nextFree[block];
+		if (freeHeads[order] == None) {
+			freeOrders &= ~(uint64_t(1) << order);
+		}
+	}
+	if (nextFree[block] != None) {
+		previousFree[nextFree[block]] = previousFree[block];
+	}
+	blockState[block] &= ~FreeBit;
+	--freeBlocks;
+}
+
+
+uint64_t BuddyAllocator::allocate(uint64_t size, uint64_t alignment) {
+	assert((alignment & (alignment - 1)) == 0);
+	uint32_t order = orderFor(std::max({ size, alignment, uint64_t(1) }));
+	uint64_t candidates = order > maxOrder ? 0 : freeOrders >> order;
+	if (candidates == 0) {
+		return InvalidOffset;
+	}
+	uint32_t available = order;
+	while ((candidates & 1) == 0) {
+		candidates >>= 1;
+		++available;
+	}
+
+	// Split the block until it has the right size, keeping the upper halves
+	uint32_t block = freeHeads[available];
+	removeFree(block, available);
+	while (available > order) {
+		--available;
+		pushFree(block + (1u << available), available);
+	}
+	blockState[block] = static_cast<uint8_t>(order);
+	requestedSize[block] = size;
+	allocated += minBlock << order;
+	requested += size;
+	++allocations;
+	return block * minBlock;
+}
+
+
+void BuddyAllocator::free(uint64_t offset) {
+	assert(offset % minBlock == 0 && offset < capacity());
+	uint32_t block = static_cast<uint32_t>(offset / minBlock);
+	assert((blockState[block] & FreeBit) == 0);
+	uint32_t order = blockState[block];
+	allocated -= minBlock << order;
+	requested -= requestedSize[block];
+	--allocations;
+
+	// Merge with the buddy for as long as it is free and whole
+	while (order < maxOrder) {
+		uint32_t buddy = block ^ (1u << order);
+		if (blockState[buddy] != (order | FreeBit)) {
+			break;
+		}
+		removeFree(buddy, order);
+		block = std::min(block, buddy);
+		++order;
+	}
+	pushFree(block, order);
+}
+
+
+uint64_t BuddyAllocator::blockSize(uint64_t offset) const {
+	return minBlock << (blockState[offset / minBlock] & ~FreeBit);
+}
+
+
+uint64_t BuddyAllocator::largestFreeBlock() const {
+	if (freeOrders == 0) {
+		return 0;
+	}
+	uint32_t order = 63;
+	while ((freeOrders >> order) == 0) {
+		--order;
+	}
+	return minBlock << order;
+}
+
+
+double BuddyAllocator::fragmentation() const {
+	uint64_t freeTotal = freeBytes();
+	return freeTotal == 0 ? 0.0 : 1.0 - double(largestFreeBlock()) / double(freeTotal);
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Buddy allocator over a range of offsets, without any GPU object, so that
+ * the way BufferAllocator carves its backing buffers can be driven and
+ * measured on its own.
+ *
+ * The range is split in blocks of minBlockSize << order bytes. An
+ * allocation takes the smallest free block that fits, splitting larger
+ * ones in halves (buddies) on the way, and freeing a block merges it back
+ * with its buddy while both are free. A block of size s starts at a
+ * multiple of s, so any alignment up to the block size comes for free.
+ *
+ * Free blocks are kept in one intrusive list per order, threaded through
+ * arrays indexed by the first min block of every block: allocate() and
+ * free() never touch the heap and cost at most one step per order. Only
+ * the state byte of those arrays is cleared up front, so that a new
+ * allocator of a large range is cheap to make.
+ */
+class BuddyAllocator {
+public:
+	static constexpr uint64_t InvalidOffset = UINT64_MAX;
+
+	// capacity is rounded down to minBlockSize times a power of two, and
+	// minBlockSize up to a power of two
+	BuddyAllocator(uint64_t capacity, uint64_t minBlockSize);
+
+	// Offset of size bytes aligned to alignment (a power of two), or
+	// InvalidOffset if no free block is large enough
+	uint64_t allocate(uint64_t size, uint64_t alignment = 1);
+
+	// Give back an offset returned by allocate()
+	void free(uint64_t offset);
+
+	// Size of the block behind an allocation
+	uint64_t blockSize(uint64_t offset) const;
+
+	uint64_t capacity() const { return minBlock << maxOrder; }
+	uint64_t minBlockSize() const { return minBlock; }
+	// Bytes of the allocated blocks, and the part of them that was asked for
+	uint64_t allocatedBytes() const { return allocated; }
+	uint64_t requestedBytes() const { return requested; }
+	uint64_t freeBytes() const { return capacity() - allocated; }
+	uint32_t allocationCount() const { return allocations; }
+	uint32_t freeBlockCount() const { return freeBlocks; }
+	// Largest allocation that would succeed right now
+	uint64_t largestFreeBlock() const;
+	// Share of the free bytes that are not in the largest free block: 0 when
+	// they are all in one piece, close to 1 when they are scattered
+	double fragmentation() const;
+
+private:
+	static constexpr uint32_t None = UINT32_MAX;
+	// Bit of blockState set on free blocks, the order in the others
+	static constexpr uint8_t FreeBit = 0x80;
+
+	uint32_t orderFor(uint64_t size) const;
+	void pushFree(uint32_t block, uint32_t order);
+	void removeFree(uint32_t block, uint32_t order);
+
+	uint64_t minBlock;
+	uint32_t maxOrder;
+	// Per min block, meaningful at the first min block of a block only. The
+	// other arrays are left uninitialized until a block starts there.
+	std::vector<uint8_t> blockState;
+	std::unique_ptr<uint32_t[]> nextFree;
+	std::unique_ptr<uint32_t[]> previousFree;
+	std::unique_ptr<uint64_t[]> requestedSize;
+	// First free block of every order, and a bit per order that has one
+	std::vector<uint32_t> freeHeads;
+	uint64_t freeOrders = 0;
+	uint64_t allocated = 0;
+	uint64_t requested = 0;
+	uint32_t allocations = 0;
+	uint32_t freeBlocks = 0;
+};
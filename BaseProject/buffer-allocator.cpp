@@ -0,0 +1,207 @@
+#include "buffer-allocator.h"
+
+#include <algorithm>
+#include <cassert>
+#include <iostream>
+
+using namespace wgpu;
+
+namespace {
+
+const char* const ClassNames[BufferClassCount] = { "vertex", "index", "uniform", "storage" };
+
+} // anonymous namespace
+
+
+BufferAllocator::BufferAllocator(GpuBackend& backend, const BufferAllocatorLimits& limits)
+	: backend(backend)
+	, limits(limits)
+{
+	// Pages are whole buddy ranges
+	uint64_t pageSize = 64 << 10;
+	while (pageSize * 2 <= limits.pageSize) {
+		pageSize *= 2;
+	}
+	this->limits.pageSize = pageSize;
+}
+
+
+BufferAllocator::~BufferAllocator() {
+	// Dedicated buffers belong to their allocations, which free them
+	for (ClassPool& pool : pools) {
+		for (std::unique_ptr<Page>& page : pool.pages) {
+			if (page) {
+				backend.destroyBuffer(page->buffer);
+			}
+		}
+	}
+}
+
+
+uint64_t BufferAllocator::alignment(BufferClass bufferClass) const {
+	// Vertex and index offsets only need 4 bytes, but blocks below 256 bytes
+	// would make the bookkeeping larger than what it saves
+	switch (bufferClass) {
+	case BufferClass::Uniform:
+		return std::max<uint64_t>(limits.minUniformBufferOffsetAlignment, 256);
+	case BufferClass::Storage:
+		return std::max<uint64_t>(limits.minStorageBufferOffsetAlignment, 256);
+	default:
+		return 256;
+	}
+}
+
+
+Buffer BufferAllocator::createBuffer(BufferClass bufferClass, uint64_t size) {
+	static const char* const Labels[BufferClassCount] = { "Vertex pool", "Index pool", "Uniform pool", "Storage pool" };
+	BufferDescriptor bufferDesc;
+	bufferDesc.label = Labels[static_cast<size_t>(bufferClass)];
+	bufferDesc.size = size;
+	bufferDesc.mappedAtCreation = false;
+	switch (bufferClass) {
+	case BufferClass::Vertex:
+		bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Vertex;
+		break;
+	case BufferClass::Index:
+		bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Index;
+		break;
+	case BufferClass::Uniform:
+		bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Uniform;
+		break;
+	case BufferClass::Storage:
+		bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Storage;
+		break;
+	}
+	return backend.createBuffer(bufferDesc);
+}
+
+
+BufferAllocation BufferAllocator::allocate(BufferClass bufferClass, uint64_t size) {
+	ClassPool& pool = pools[static_cast<size_t>(bufferClass)];
+	BufferAllocation allocation;
+	allocation.bufferClass = bufferClass;
+	allocation.size = (std::max<uint64_t>(size, 1) + 3) & ~uint64_t(3);
+
+	if (allocation.size > limits.pageSize) {
+		allocation.buffer = createBuffer(bufferClass, allocation.size);
+		if (!allocation.buffer) {
+			std::cout << "*** ERROR *** Could not create a " << ClassNames[static_cast<size_t>(bufferClass)]
+				<< " buffer of " << allocation.size << " bytes" << std::endl;
+			return BufferAllocation();
+		}
+		allocation.page = BufferAllocation::DedicatedPage;
+		++pool.dedicatedCount;
+		pool.dedicatedBytes += allocation.size;
+		return allocation;
+	}
+
+	// First page with room, the oldest pages fill first
+	uint32_t freeSlot = BufferAllocation::DedicatedPage;
+	for (uint32_t i = 0; i < pool.pages.size(); ++i) {
+		if (!pool.pages[i]) {
+			freeSlot = std::min(freeSlot, i);
+			continue;
+		}
+		uint64_t offset = pool.pages[i]->blocks.allocate(allocation.size);
+		if (offset != BuddyAllocator::InvalidOffset) {
+			allocation.buffer = pool.pages[i]->buffer;
+			allocation.offset = offset;
+			allocation.page = i;
+			return allocation;
+		}
+	}
+
+	Buffer buffer = createBuffer(bufferClass, limits.pageSize);
+	if (!buffer) {
+		std::cout << "*** ERROR *** Could not create a " << ClassNames[static_cast<size_t>(bufferClass)]
+			<< " page of " << limits.pageSize << " bytes" << std::endl;
+		return BufferAllocation();
+	}
+	if (freeSlot == BufferAllocation::DedicatedPage) {
+		freeSlot = static_cast<uint32_t>(pool.pages.size());
+		pool.pages.emplace_back();
+	}
+	pool.pages[freeSlot] = std::make_unique<Page>(buffer, limits.pageSize, alignment(bufferClass));
+	allocation.buffer = buffer;
+	allocation.offset = pool.pages[freeSlot]->blocks.allocate(allocation.size);
+	allocation.page = freeSlot;
+	assert(allocation.offset != BuddyAllocator::InvalidOffset);
+	return allocation;
+}
+
+
+void BufferAllocator::free(BufferAllocation& allocation) {
+	if (!allocation) {
+		return;
+	}
+	ClassPool& pool = pools[static_cast<size_t>(allocation.bufferClass)];
+	if (allocation.page == BufferAllocation::DedicatedPage) {
+		backend.destroyBuffer(allocation.buffer);
+		--pool.dedicatedCount;
+		pool.dedicatedBytes -= allocation.size;
+		allocation = BufferAllocation();
+		return;
+	}
+
+	assert(allocation.page < pool.pages.size() && pool.pages[allocation.page]);
+	Page& page = *pool.pages[allocation.page];
+	page.blocks.free(allocation.offset);
+
+	// Release empty pages, but keep one spare so that a resource replaced by
+	// another does not release and create the same page again
+	if (page.blocks.allocationCount() == 0) {
+		bool spare = std::any_of(pool.pages.begin(), pool.pages.end(), [&](const std::unique_ptr<Page>& other) {
+			return other && other.get() != &page && other->blocks.allocationCount() == 0;
+		});
+		if (spare) {
+			backend.destroyBuffer(page.buffer);
+			pool.pages[allocation.page].reset();
+		}
+	}
+	allocation = BufferAllocation();
+}
+
+
+BufferClassStats BufferAllocator::stats(BufferClass bufferClass) const {
+	const ClassPool& pool = pools[static_cast<size_t>(bufferClass)];
+	BufferClassStats stats;
+	stats.dedicatedCount = pool.dedicatedCount;
+	stats.dedicatedBytes = pool.dedicatedBytes;
+	stats.allocationCount = pool.dedicatedCount;
+	uint64_t freeBytes = 0;
+	for (const std::unique_ptr<Page>& page : pool.pages) {
+		if (!page) {
+			continue;
+		}
+		const BuddyAllocator& blocks = page->blocks;
+		++stats.pageCount;
+		stats.allocationCount += blocks.allocationCount();
+		stats.capacity += blocks.capacity();
+		stats.allocatedBytes += blocks.allocatedBytes();
+		stats.requestedBytes += blocks.requestedBytes();
+		stats.largestFreeBlock = std::max(stats.largestFreeBlock, blocks.largestFreeBlock());
+		stats.fragmentation += blocks.fragmentation() * blocks.freeBytes();
+		freeBytes += blocks.freeBytes();
+	}
+	stats.fragmentation = freeBytes == 0 ? 0.0 : stats.fragmentation / freeBytes;
+	return stats;
+}
+
+
+void BufferAllocator::printStats(std::ostream& out) const {
+	for (size_t i = 0; i < BufferClassCount; ++i) {
+		BufferClassStats classStats = stats(static_cast<BufferClass>(i));
+		if (classStats.pageCount == 0 && classStats.dedicatedCount == 0) {
+			continue;
+		}
+		out << "Buffer pool " << ClassNames[i] << ": " << classStats.allocationCount << " allocations in "
+			<< classStats.pageCount << " page(s) of " << limits.pageSize / 1024 << " KiB, "
+			<< classStats.occupancy() * 100.0 << "% occupied, " << classStats.requestedBytes / 1024 << " KiB requested, "
+			<< "largest free block " << classStats.largestFreeBlock / 1024 << " KiB, fragmentation "
+			<< classStats.fragmentation * 100.0 << "%";
+		if (classStats.dedicatedCount > 0) {
+			out << ", " << classStats.dedicatedCount << " dedicated buffer(s) of " << classStats.dedicatedBytes / 1024 << " KiB";
+		}
+		out << std::endl;
+	}
+}
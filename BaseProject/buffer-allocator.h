@@ -0,0 +1,119 @@
+#pragma once
+
+#include "gpu-backend.h"
+#include "buddy-allocator.h"
+
+#include <webgpu/webgpu.hpp>
+
+#include <array>
+#include <iosfwd>
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Sub-allocates GPU buffers out of a few large backing buffers, one set per
+ * usage class, rather than creating a buffer per resource.
+ *
+ *     BufferAllocator allocator(backend, limits);
+ *     BufferAllocation vertices = allocator.allocate(BufferClass::Vertex, byteSize);
+ *     uploader.write(vertices.buffer, vertices.offset + first, data, size);
+ *     pass.setVertexBuffer(0, vertices.buffer, vertices.offset, vertices.size);
+ *     allocator.free(vertices);
+ *
+ * Every class has pages of pageSize bytes, carved by a BuddyAllocator whose
+ * blocks are aligned to the offset alignment of the class (for instance
+ * minUniformBufferOffsetAlignment for uniforms). A new page is created when
+ * none has room and released when it empties, unless it is the only empty
+ * page of the class. Requests larger than a page get a dedicated buffer.
+ */
+
+enum class BufferClass {
+	Vertex,
+	Index,
+	Uniform,
+	Storage,
+};
+
+constexpr size_t BufferClassCount = 4;
+
+// Offset alignments of the device, and the size of the backing buffers
+struct BufferAllocatorLimits {
+	uint64_t minUniformBufferOffsetAlignment = 256;
+	uint64_t minStorageBufferOffsetAlignment = 256;
+	// Rounded down to a power of two, 64 KiB at least
+	uint64_t pageSize = 16 << 20;
+};
+
+struct BufferAllocation {
+	wgpu::Buffer buffer = nullptr;
+	uint64_t offset = 0;
+	uint64_t size = 0;
+	BufferClass bufferClass = BufferClass::Vertex;
+	// Page of the class, or DedicatedPage
+	uint32_t page = 0;
+
+	static constexpr uint32_t DedicatedPage = UINT32_MAX;
+
+	explicit operator bool() const { return buffer != nullptr; }
+};
+
+struct BufferClassStats {
+	uint32_t pageCount = 0;
+	uint32_t dedicatedCount = 0;
+	uint32_t allocationCount = 0;
+	// Bytes of the pages, of the blocks handed out and of the requests
+	uint64_t capacity = 0;
+	uint64_t allocatedBytes = 0;
+	uint64_t requestedBytes = 0;
+	uint64_t dedicatedBytes = 0;
+	uint64_t largestFreeBlock = 0;
+	// Mean of BuddyAllocator::fragmentation() over the pages, weighted by
+	// their free bytes
+	double fragmentation = 0.0;
+
+	double occupancy() const { return capacity == 0 ? 0.0 : double(allocatedBytes) / double(capacity); }
+};
+
+class BufferAllocator {
+public:
+	BufferAllocator(GpuBackend& backend, const BufferAllocatorLimits& limits = BufferAllocatorLimits());
+	~BufferAllocator();
+
+	BufferAllocator(const BufferAllocator&) = delete;
+	BufferAllocator& operator=(const BufferAllocator&) = delete;
+
+	// A region of size bytes, rounded up to a multiple of 4 as copies
+	// require. Returns an empty allocation if the backend could not create
+	// a buffer.
+	BufferAllocation allocate(BufferClass bufferClass, uint64_t size);
+
+	// Give back an allocation, which may no longer be used by the GPU
+	void free(BufferAllocation& allocation);
+
+	BufferClassStats stats(BufferClass bufferClass) const;
+	void printStats(std::ostream& out) const;
+
+	uint64_t alignment(BufferClass bufferClass) const;
+
+private:
+	struct Page {
+		wgpu::Buffer buffer = nullptr;
+		BuddyAllocator blocks;
+
+		Page(wgpu::Buffer buffer, uint64_t size, uint64_t alignment) : buffer(buffer), blocks(size, alignment) {}
+	};
+
+	struct ClassPool {
+		// Null for the pages released, whose index is reused
+		std::vector<std::unique_ptr<Page>> pages;
+		uint32_t dedicatedCount = 0;
+		uint64_t dedicatedBytes = 0;
+	};
+
+	wgpu::Buffer createBuffer(BufferClass bufferClass, uint64_t size);
+
+	GpuBackend& backend;
+	BufferAllocatorLimits limits;
+	std::array<ClassPool, BufferClassCount> pools;
+};
@@ -0,0 +1,113 @@
+#include "compact-vertex.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Conversions to the normalized formats, as defined by WebGPU, rounding to
+// the nearest step
+uint16_t toUnorm16(float value) {
+	return static_cast<uint16_t>(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+int16_t toSnorm16(float value) {
+	return static_cast<int16_t>(std::floor(std::clamp(value, -1.0f, 1.0f) * 32767.0f + 0.5f));
+}
+
+uint8_t toUnorm8(float value) {
+	return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+float fromSnorm16(int16_t value) {
+	return std::max(static_cast<float>(value) / 32767.0f, -1.0f);
+}
+
+float signNotZero(float value) {
+	return value >= 0.0f ? 1.0f : -1.0f;
+}
+
+} // anonymous namespace
+
+
+PositionDecode computePositionDecode(const VertexAttributes* vertices, size_t vertexCount) {
+	PositionDecode decode;
+	if (vertexCount == 0) {
+		return decode;
+	}
+	glm::vec3 boundsMin = vertices[0].position;
+	glm::vec3 boundsMax = vertices[0].position;
+	for (size_t i = 1; i < vertexCount; ++i) {
+		boundsMin = glm::min(boundsMin, vertices[i].position);
+		boundsMax = glm::max(boundsMax, vertices[i].position);
+	}
+	decode.offset = boundsMin;
+	decode.scale = boundsMax - boundsMin;
+	return decode;
+}
+
+
+void encodeVertices(const VertexAttributes* vertices, size_t vertexCount,
+					const PositionDecode& decode, CompactVertex* compactVertices) {
+	// A flat axis has a zero scale, all its positions encode to 0
+	glm::vec3 inverseScale;
+	for (int axis = 0; axis < 3; ++axis) {
+		inverseScale[axis] = decode.scale[axis] > 0.0f ? 1.0f / decode.scale[axis] : 0.0f;
+	}
+
+	for (size_t i = 0; i < vertexCount; ++i) {
+		const VertexAttributes& vertex = vertices[i];
+		CompactVertex& compact = compactVertices[i];
+
+		glm::vec3 position = (vertex.position - decode.offset) * inverseScale;
+		compact.position[0] = toUnorm16(position.x);
+		compact.position[1] = toUnorm16(position.y);
+		compact.position[2] = toUnorm16(position.z);
+		compact.position[3] = 0;
+
+		glm::vec2 normal = octahedralEncode(vertex.normal);
+		compact.normal[0] = toSnorm16(normal.x);
+		compact.normal[1] = toSnorm16(normal.y);
+
+		compact.color[0] = toUnorm8(vertex.color.x);
+		compact.color[1] = toUnorm8(vertex.color.y);
+		compact.color[2] = toUnorm8(vertex.color.z);
+		compact.color[3] = 255;
+	}
+}
+
+
+VertexAttributes decodeVertex(const CompactVertex& vertex, const PositionDecode& decode) {
+	VertexAttributes attributes;
+	glm::vec3 position(vertex.position[0], vertex.position[1], vertex.position[2]);
+	attributes.position = decode.offset + position / 65535.0f * decode.scale;
+	attributes.normal = octahedralDecode(glm::vec2(fromSnorm16(vertex.normal[0]), fromSnorm16(vertex.normal[1])));
+	attributes.color = glm::vec3(vertex.color[0], vertex.color[1], vertex.color[2]) / 255.0f;
+	return attributes;
+}
+
+
+glm::vec2 octahedralEncode(glm::vec3 normal) {
+	float length1 = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+	if (length1 == 0.0f) {
+		return glm::vec2(0.0f);
+	}
+	normal /= length1;
+	if (normal.z >= 0.0f) {
+		return glm::vec2(normal.x, normal.y);
+	}
+	// Fold the lower hemisphere over the diagonals
+	return glm::vec2(
+		(1.0f - std::abs(normal.y)) * signNotZero(normal.x),
+		(1.0f - std::abs(normal.x)) * signNotZero(normal.y)
+	);
+}
+
+
+glm::vec3 octahedralDecode(glm::vec2 encoded) {
+	glm::vec3 normal(encoded.x, encoded.y, 1.0f - std::abs(encoded.x) - std::abs(encoded.y));
+	float fold = std::max(-normal.z, 0.0f);
+	normal.x += normal.x >= 0.0f ? -fold : fold;
+	normal.y += normal.y >= 0.0f ? -fold : fold;
+	return glm::normalize(normal);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * 16-byte alternative to VertexAttributes (36 bytes), for meshes where
+ * vertex bandwidth and memory matter more than exact attributes:
+ *  - position as unorm16x4, relative to the bounding box of the mesh,
+ *  - normal as snorm16x2, with an octahedral encoding,
+ *  - color as unorm8x4.
+ * The vertex shader decodes them; decodeVertex() does the same on the CPU.
+ */
+struct CompactVertex {
+	uint16_t position[4]; // w is unused
+	int16_t normal[2];
+	uint8_t color[4];     // a is unused
+};
+static_assert(sizeof(CompactVertex) == 16, "CompactVertex must match the vertex buffer layout");
+
+// Affine map from unorm positions back to the mesh coordinates:
+// position = offset + unorm * scale
+struct PositionDecode {
+	glm::vec3 offset = glm::vec3(0.0f);
+	glm::vec3 scale = glm::vec3(1.0f);
+};
+
+// Bounding box of the positions, as a PositionDecode
+PositionDecode computePositionDecode(const VertexAttributes* vertices, size_t vertexCount);
+
+void encodeVertices(const VertexAttributes* vertices, size_t vertexCount,
+					const PositionDecode& decode, CompactVertex* compactVertices);
+
+VertexAttributes decodeVertex(const CompactVertex& vertex, const PositionDecode& decode);
+
+// Unit vector to a point of the [-1, 1] square, and back
+glm::vec2 octahedralEncode(glm::vec3 normal);
+glm::vec3 octahedralDecode(glm::vec2 encoded);
@@ -0,0 +1,50 @@
+#include "frame-encoder.h"
+#include "profiler.h"
+
+uint32_t uploadFrame(UniformRing& uniformRing, InstanceBatch& instances, const MyUniforms& uniforms) {
+	PROFILE_ZONE("Uniform writes");
+	// Pack the uniforms of every object drawn this frame, then upload them
+	// with a single write into this frame's region of the ring
+	uniformRing.beginFrame();
+	uint32_t dynamicOffset = uniformRing.push(uniforms);
+	uniformRing.flush();
+	instances.upload();
+	return dynamicOffset;
+}
+
+
+void encodeScene(RenderPassCommands& pass, const SceneBindings& scene,
+				uint32_t dynamicOffset, const InstanceBatch& instances) {
+	// Select which render pipeline to use
+	pass.setPipeline(scene.pipeline);
+
+	// Set vertex buffer while encoding the render pass
+	pass.setVertexBuffer(0, scene.vertexBuffer, scene.vertexBufferOffset, scene.vertexBufferSize);
+	pass.setIndexBuffer(scene.indexBuffer, scene.indexFormat, scene.indexBufferOffset, scene.indexBufferSize);
+
+	// Set binding group
+	pass.setBindGroup(0, scene.bindGroup, 1, &dynamicOffset);
+
+	// A mesh without a draw table is a single submesh
+	Submesh single = { 0, 0, 0, static_cast<uint32_t>(scene.lodCount), 0, 0, -1, 0 };
+	const Submesh* submeshes = scene.submeshes ? scene.submeshes : &single;
+	size_t submeshCount = scene.submeshes ? scene.submeshCount : (scene.lodCount > 0 ? 1 : 0);
+
+	int32_t boundMaterial = 0;
+	for (size_t i = 0; i < submeshCount; ++i) {
+		const Submesh& submesh = submeshes[i];
+		if (scene.materialBindGroups && (i == 0 || submesh.material != boundMaterial)) {
+			pass.setBindGroup(1, scene.materialBindGroups[submesh.material + 1], 0, nullptr);
+			boundMaterial = submesh.material;
+		}
+
+		// Without levels of detail, the full detail is the only level
+		MeshLod fullDetail = { submesh.firstIndex, submesh.indexCount, 0.0f, 0 };
+		const MeshLod* lods = submesh.lodCount > 0 ? scene.lods + submesh.firstLod : &fullDetail;
+		size_t lodCount = submesh.lodCount > 0 ? submesh.lodCount : 1;
+
+		// One draw call per level of detail in use, and per visible range of
+		// the full detail
+		instances.draw(pass, lods, lodCount, scene.fullDetailRanges ? &scene.fullDetailRanges[i] : nullptr);
+	}
+}
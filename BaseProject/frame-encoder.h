@@ -0,0 +1,54 @@
+#pragma once
+
+#include "gpu-backend.h"
+#include "uniform-ring.h"
+#include "instance-batch.h"
+#include "uniforms.h"
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * The part of a frame that only depends on the backend: upload the uniforms
+ * and instances of the frame, then record the draw commands of the scene.
+ *
+ * Renderer::MainLoop runs it against the WebGPU backend and a real render
+ * pass, the frame-encode benchmark against a RecordingBackend, so that the
+ * benchmark measures the code the renderer actually runs.
+ */
+
+// Objects the scene is drawn with
+struct SceneBindings {
+	wgpu::RenderPipeline pipeline = nullptr;
+	wgpu::BindGroup bindGroup = nullptr;
+	// Vertex and index regions, which may be part of larger buffers
+	wgpu::Buffer vertexBuffer = nullptr;
+	uint64_t vertexBufferOffset = 0;
+	uint64_t vertexBufferSize = 0;
+	wgpu::Buffer indexBuffer = nullptr;
+	wgpu::IndexFormat indexFormat = wgpu::IndexFormat::Uint32;
+	uint64_t indexBufferOffset = 0;
+	uint64_t indexBufferSize = 0;
+	// Levels of detail of the mesh, instances pick theirs in InstanceBatch
+	const MeshLod* lods = nullptr;
+	size_t lodCount = 0;
+	// Draw table, sorted by material, and the bind group of every material
+	// (at group 1) indexed by Submesh::material + 1, the default material
+	// first. Without a table, the levels of detail are those of the whole
+	// mesh; without bind groups, group 1 is left as it is.
+	const Submesh* submeshes = nullptr;
+	size_t submeshCount = 0;
+	const wgpu::BindGroup* materialBindGroups = nullptr;
+	// Visible parts of the full detail of every submesh when the meshlets
+	// were culled (one vector per submesh), null to draw them all
+	const std::vector<IndexRange>* fullDetailRanges = nullptr;
+};
+
+// Upload the uniforms and the instances of this frame. Returns the dynamic
+// offset of the uniforms, to bind them with.
+uint32_t uploadFrame(UniformRing& uniformRing, InstanceBatch& instances, const MyUniforms& uniforms);
+
+// Record the commands that draw every instance of the scene, switching
+// material only between submeshes that do not share it
+void encodeScene(RenderPassCommands& pass, const SceneBindings& scene,
+				uint32_t dynamicOffset, const InstanceBatch& instances);
@@ -0,0 +1,563 @@
+#include "geometry-codec.h"
+#include "mapped-file.h"
+#include "profiler.h"
+
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iterator>
+
+namespace {
+
+constexpr char Magic[8] = { 'W', 'G', 'P', 'U', 'M', 'S', 'H', 'Z' };
+constexpr uint32_t Version = 1;
+
+// Layout of the beginning of a .meshz file. The level, meshlet, submesh and
+// material tables follow, then the end offset of every vertex chunk and
+// every index chunk (relative to the first chunk), then the chunks.
+struct CompressedMeshHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t vertexChunkSize;
+	uint32_t indexChunkSize;
+	uint32_t lodCount;
+	uint32_t meshletCount;
+	uint32_t submeshCount;
+	uint32_t materialCount;
+	uint32_t _pad;
+	uint64_t vertexCount;
+	uint64_t indexCount;
+	float positionOffset[3];
+	float positionScale[3];
+};
+
+const uint32_t GroupSize = 16;
+
+// Bits per value of a group, by selector
+constexpr uint32_t GroupWidths[] = { 0, 1, 2, 4, 6, 8, 12, 16, 32 };
+
+// Recently used vertices an index can refer to, codes 1 to 15
+const uint32_t IndexFifoSize = 15;
+
+// Bytes of CompactVertex coded as one channel each
+struct Channel {
+	uint32_t offset;
+	uint32_t bytes;
+};
+constexpr Channel VertexChannels[] = {
+	{ 0, 2 }, { 2, 2 }, { 4, 2 },   // position
+	{ 8, 2 }, { 10, 2 },            // normal
+	{ 12, 1 }, { 13, 1 }, { 14, 1 } // color
+};
+
+uint32_t groupCount(size_t count) {
+	return static_cast<uint32_t>((count + GroupSize - 1) / GroupSize);
+}
+
+uint32_t zigzag16(uint16_t delta) {
+	int16_t value = static_cast<int16_t>(delta);
+	return static_cast<uint16_t>((value * 2) ^ (value >> 15));
+}
+
+uint16_t unzigzag16(uint32_t value) {
+	return static_cast<uint16_t>((value >> 1) ^ (0u - (value & 1)));
+}
+
+uint32_t zigzag32(uint32_t delta) {
+	int32_t value = static_cast<int32_t>(delta);
+	return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+}
+
+uint32_t unzigzag32(uint32_t value) {
+	return (value >> 1) ^ (0u - (value & 1));
+}
+
+// Values of a stream, by groups of 16: a selector per group (two per byte)
+// then the bits of every group, whole bytes since 16 values of any width
+// make 2 * width bytes
+void packValues(const uint32_t* values, size_t count, std::vector<uint8_t>& out) {
+	uint32_t groups = groupCount(count);
+	size_t selectorStart = out.size();
+	out.resize(out.size() + (groups + 1) / 2, 0);
+	for (uint32_t group = 0; group < groups; ++group) {
+		uint32_t padded[GroupSize] = {};
+		size_t first = size_t(group) * GroupSize;
+		size_t groupValues = std::min<size_t>(GroupSize, count - first);
+		std::copy(values + first, values + first + groupValues, padded);
+
+		uint32_t largest = *std::max_element(padded, padded + GroupSize);
+		uint32_t selector = 0;
+		while (GroupWidths[selector] < 32 && (largest >> GroupWidths[selector]) != 0) {
+			++selector;
+		}
+		out[selectorStart + group / 2] |= static_cast<uint8_t>(selector << (4 * (group % 2)));
+
+		uint32_t width = GroupWidths[selector];
+		size_t payloadStart = out.size();
+		out.resize(out.size() + 2 * width, 0);
+		uint8_t* payload = out.data() + payloadStart;
+		for (uint32_t i = 0; i < GroupSize; ++i) {
+			uint64_t bit = uint64_t(i) * width;
+			uint64_t value = uint64_t(padded[i]) << (bit % 8);
+			for (uint64_t byte = bit / 8; value != 0; ++byte, value >>= 8) {
+				payload[byte] |= static_cast<uint8_t>(value);
+			}
+		}
+	}
+}
+
+template <uint32_t Width>
+void unpackGroup(const uint8_t* in, uint32_t* out) {
+	if constexpr (Width == 0) {
+		std::fill(out, out + GroupSize, 0u);
+	}
+	else if constexpr (Width == 6) {
+		// 4 values in every 3 bytes
+		for (uint32_t i = 0; i < GroupSize; i += 4, in += 3) {
+			uint32_t bits = in[0] | uint32_t(in[1]) << 8 | uint32_t(in[2]) << 16;
+			out[i] = bits & 63;
+			out[i + 1] = (bits >> 6) & 63;
+			out[i + 2] = (bits >> 12) & 63;
+			out[i + 3] = bits >> 18;
+		}
+	}
+	else if constexpr (Width < 8) {
+		const uint32_t mask = (1u << Width) - 1;
+		for (uint32_t i = 0; i < GroupSize; ++i) {
+			out[i] = (in[i * Width / 8] >> (i * Width % 8)) & mask;
+		}
+	}
+	else if constexpr (Width == 12) {
+		// 2 values in every 3 bytes
+		for (uint32_t i = 0; i < GroupSize; i += 2, in += 3) {
+			out[i] = in[0] | uint32_t(in[1] & 15) << 8;
+			out[i + 1] = in[1] >> 4 | uint32_t(in[2]) << 4;
+		}
+	}
+	else if constexpr (Width == 8) {
+		for (uint32_t i = 0; i < GroupSize; ++i) {
+			out[i] = in[i];
+		}
+	}
+	else if constexpr (Width == 16) {
+		for (uint32_t i = 0; i < GroupSize; ++i) {
+			out[i] = in[2 * i] | uint32_t(in[2 * i + 1]) << 8;
+		}
+	}
+	else {
+		for (uint32_t i = 0; i < GroupSize; ++i) {
+			out[i] = in[4 * i] | uint32_t(in[4 * i + 1]) << 8 | uint32_t(in[4 * i + 2]) << 16 | uint32_t(in[4 * i + 3]) << 24;
+		}
+	}
+}
+
+// Decode the packed values of a stream group by group, handing each group
+// to consume(groupValues, first, count). Returns the bytes read, 0 if the
+// data is too short.
+template <typename Consume>
+size_t unpackValues(const uint8_t* data, size_t size, size_t count, Consume consume) {
+	uint32_t groups = groupCount(count);
+	size_t selectorBytes = (groups + 1) / 2;
+	if (size < selectorBytes) {
+		return 0;
+	}
+	// Check the whole payload at once rather than every group
+	size_t payloadBytes = 0;
+	for (uint32_t group = 0; group < groups; ++group) {
+		uint32_t selector = (data[group / 2] >> (4 * (group % 2))) & 15;
+		if (selector >= std::size(GroupWidths)) {
+			return 0;
+		}
+		payloadBytes += 2 * GroupWidths[selector];
+	}
+	if (size - selectorBytes < payloadBytes) {
+		return 0;
+	}
+
+	const uint8_t* payload = data + selectorBytes;
+	uint32_t values[GroupSize];
+	for (uint32_t group = 0; group < groups; ++group) {
+		uint32_t selector = (data[group / 2] >> (4 * (group % 2))) & 15;
+		switch (selector) {
+		case 0: unpackGroup<0>(payload, values); break;
+		case 1: unpackGroup<1>(payload, values); break;
+		case 2: unpackGroup<2>(payload, values); break;
+		case 3: unpackGroup<4>(payload, values); break;
+		case 4: unpackGroup<6>(payload, values); break;
+		case 5: unpackGroup<8>(payload, values); break;
+		case 6: unpackGroup<12>(payload, values); break;
+		case 7: unpackGroup<16>(payload, values); break;
+		default: unpackGroup<32>(payload, values); break;
+		}
+		payload += 2 * GroupWidths[selector];
+		size_t first = size_t(group) * GroupSize;
+		consume(values, first, std::min<size_t>(GroupSize, count - first));
+	}
+	return selectorBytes + payloadBytes;
+}
+
+// Decode one channel straight into its bytes of every vertex
+template <typename T>
+size_t decodeChannel(const uint8_t* data, size_t size, CompactVertex* vertices, size_t offset, size_t count) {
+	uint8_t* field = reinterpret_cast<uint8_t*>(vertices) + offset;
+	uint16_t previous = 0;
+	return unpackValues(data, size, count, [&](const uint32_t* values, size_t first, size_t groupValues) {
+		uint8_t* out = field + first * sizeof(CompactVertex);
+		for (size_t i = 0; i < groupValues; ++i, out += sizeof(CompactVertex)) {
+			previous = static_cast<uint16_t>(previous + unzigzag16(values[i]));
+			T value = static_cast<T>(previous);
+			std::memcpy(out, &value, sizeof(T));
+		}
+	});
+}
+
+
+// Check that [first, first + count) lies within a buffer or table of size
+// entries
+bool rangeFits(uint32_t first, uint32_t count, size_t size) {
+	return first <= size && count <= size - first;
+}
+
+// Check the ranges the tables of a decoded mesh refer to
+bool tablesValid(const Mesh& mesh) {
+	size_t indexCount = mesh.indices.size();
+	for (const MeshLod& lod : mesh.lods) {
+		if (!rangeFits(lod.firstIndex, lod.indexCount, indexCount)) return false;
+	}
+	for (const Meshlet& meshlet : mesh.meshlets) {
+		if (!rangeFits(meshlet.firstIndex, meshlet.indexCount, indexCount)) return false;
+	}
+	for (const Submesh& submesh : mesh.submeshes) {
+		bool fits = rangeFits(submesh.firstIndex, submesh.indexCount, indexCount)
+			&& rangeFits(submesh.firstLod, submesh.lodCount, mesh.lods.size())
+			&& rangeFits(submesh.firstMeshlet, submesh.meshletCount, mesh.meshlets.size())
+			&& submesh.material >= -1 && submesh.material < static_cast<int64_t>(mesh.materials.size());
+		if (!fits) return false;
+	}
+	return true;
+}
+
+template <typename T>
+void appendTable(std::vector<uint8_t>& out, const std::vector<T>& table) {
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(table.data());
+	out.insert(out.end(), bytes, bytes + table.size() * sizeof(T));
+}
+
+// Read count entries of a table, return false if the data is too short
+template <typename T>
+bool readTable(const uint8_t*& data, const uint8_t* end, size_t count, std::vector<T>& table) {
+	if (static_cast<size_t>(end - data) / sizeof(T) < count) {
+		return false;
+	}
+	table.resize(count);
+	std::memcpy(table.data(), data, count * sizeof(T));
+	data += count * sizeof(T);
+	return true;
+}
+
+} // anonymous namespace
+
+
+void encodeVertexStream(const CompactVertex* vertices, size_t count, std::vector<uint8_t>& out) {
+	std::vector<uint32_t> values(count);
+	for (const Channel& channel : VertexChannels) {
+		uint16_t previous = 0;
+		for (size_t i = 0; i < count; ++i) {
+			const uint8_t* field = reinterpret_cast<const uint8_t*>(&vertices[i]) + channel.offset;
+			uint16_t value = field[0];
+			if (channel.bytes == 2) {
+				std::memcpy(&value, field, 2);
+			}
+			values[i] = zigzag16(static_cast<uint16_t>(value - previous));
+			previous = value;
+		}
+		packValues(values.data(), count, out);
+	}
+}
+
+
+size_t decodeVertexStream(const uint8_t* data, size_t size, CompactVertex* vertices, size_t count) {
+	// Unused lanes, as encodeVertices() sets them
+	for (size_t i = 0; i < count; ++i) {
+		vertices[i].position[3] = 0;
+		vertices[i].color[3] = 255;
+	}
+	size_t read = 0;
+	for (const Channel& channel : VertexChannels) {
+		size_t channelBytes = channel.bytes == 2
+			? decodeChannel<uint16_t>(data + read, size - read, vertices, channel.offset, count)
+			: decodeChannel<uint8_t>(data + read, size - read, vertices, channel.offset, count);
+		if (channelBytes == 0 && count > 0) {
+			return 0;
+		}
+		read += channelBytes;
+	}
+	return read;
+}
+
+
+// Index codes: 0 for the first vertex not used yet, 1 to 14 for a vertex in
+// the FIFO of the last vertices that were not already in it (the vertex
+// cache order keeps most indices there), 15 for any other vertex. The codes
+// then take 4 bits, and the other vertices follow in a second stream, as
+// the zigzag delta to the previous index, so that they do not widen the
+// groups of codes.
+void encodeIndexStream(const uint32_t* indices, size_t count, uint32_t nextVertex, std::vector<uint8_t>& out) {
+	std::vector<uint32_t> codes(count);
+	std::vector<uint32_t> escapes;
+	uint32_t fifo[IndexFifoSize + 1] = {};
+	uint32_t fifoHead = 0;
+	uint32_t previous = 0;
+	for (size_t i = 0; i < count; ++i) {
+		uint32_t index = indices[i];
+		uint32_t code = 0;
+		if (index != nextVertex) {
+			for (uint32_t age = 1; age < IndexFifoSize && code == 0; ++age) {
+				code = fifo[(fifoHead - age) & IndexFifoSize] == index ? age : 0;
+			}
+			if (code == 0) {
+				code = IndexFifoSize;
+				escapes.push_back(zigzag32(index - previous));
+			}
+		}
+		if (code == 0 || code == IndexFifoSize) {
+			fifo[fifoHead++ & IndexFifoSize] = index;
+		}
+		codes[i] = code;
+		nextVertex = std::max(nextVertex, index + 1);
+		previous = index;
+	}
+	uint32_t escapeCount = static_cast<uint32_t>(escapes.size());
+	const uint8_t* countBytes = reinterpret_cast<const uint8_t*>(&escapeCount);
+	out.insert(out.end(), countBytes, countBytes + sizeof(escapeCount));
+	packValues(codes.data(), count, out);
+	packValues(escapes.data(), escapes.size(), out);
+}
+
+
+size_t decodeIndexStream(const uint8_t* data, size_t size, uint32_t* indices, size_t count, uint32_t nextVertex) {
+	uint32_t escapeCount;
+	if (size < sizeof(escapeCount)) {
+		return 0;
+	}
+	std::memcpy(&escapeCount, data, sizeof(escapeCount));
+	if (escapeCount > count) {
+		return 0;
+	}
+
+	// Codes first, into the output, then the escapes where they go
+	size_t read = sizeof(escapeCount);
+	size_t codeBytes = unpackValues(data + read, size - read, count, [&](const uint32_t* values, size_t first, size_t groupValues) {
+		std::copy(values, values + groupValues, indices + first);
+	});
+	if (codeBytes == 0 && count > 0) {
+		return 0;
+	}
+	read += codeBytes;
+	std::vector<uint32_t> escapes(escapeCount);
+	size_t escapeBytes = unpackValues(data + read, size - read, escapeCount, [&](const uint32_t* values, size_t first, size_t groupValues) {
+		std::copy(values, values + groupValues, escapes.data() + first);
+	});
+	if (escapeBytes == 0 && escapeCount > 0) {
+		return 0;
+	}
+	read += escapeBytes;
+
+	uint32_t fifo[IndexFifoSize + 1] = {};
+	uint32_t fifoHead = 0;
+	uint32_t previous = 0;
+	size_t escape = 0;
+	for (size_t i = 0; i < count; ++i) {
+		// New vertices and FIFO hits are most indices, and branches on them
+		// predict well enough to beat selects
+		uint32_t code = indices[i];
+		uint32_t index;
+		if (code == 0) {
+			index = nextVertex++;
+			fifo[fifoHead++ & IndexFifoSize] = index;
+		}
+		else if (code < IndexFifoSize) {
+			index = fifo[(fifoHead - code) & IndexFifoSize];
+		}
+		else {
+			if (escape == escapeCount) {
+				return 0;
+			}
+			index = previous + unzigzag32(escapes[escape++]);
+			fifo[fifoHead++ & IndexFifoSize] = index;
+			nextVertex = std::max(nextVertex, index + 1);
+		}
+		indices[i] = index;
+		previous = index;
+	}
+	return escape == escapeCount ? read : 0;
+}
+
+
+std::vector<uint8_t> compressMesh(const Mesh& mesh) {
+	PositionDecode decode = computePositionDecode(mesh.vertices.data(), mesh.vertices.size());
+	std::vector<CompactVertex> compactVertices(mesh.vertices.size());
+	encodeVertices(mesh.vertices.data(), mesh.vertices.size(), decode, compactVertices.data());
+
+	CompressedMeshHeader header = {};
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.vertexChunkSize = VertexChunkSize;
+	header.indexChunkSize = IndexChunkSize;
+	header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+	header.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+	header.submeshCount = static_cast<uint32_t>(mesh.submeshes.size());
+	header.materialCount = static_cast<uint32_t>(mesh.materials.size());
+	header.vertexCount = mesh.vertices.size();
+	header.indexCount = mesh.indices.size();
+	for (int axis = 0; axis < 3; ++axis) {
+		header.positionOffset[axis] = decode.offset[axis];
+		header.positionScale[axis] = decode.scale[axis];
+	}
+
+	std::vector<uint8_t> out(sizeof(header));
+	std::memcpy(out.data(), &header, sizeof(header));
+	appendTable(out, mesh.lods);
+	appendTable(out, mesh.meshlets);
+	appendTable(out, mesh.submeshes);
+	appendTable(out, mesh.materials);
+
+	// Chunks are coded on their own, the table of their end offsets comes
+	// first so that the decoder can find all of them
+	std::vector<uint8_t> chunks;
+	std::vector<uint64_t> chunkEnds;
+	for (size_t first = 0; first < compactVertices.size(); first += VertexChunkSize) {
+		size_t count = std::min<size_t>(VertexChunkSize, compactVertices.size() - first);
+		encodeVertexStream(compactVertices.data() + first, count, chunks);
+		chunkEnds.push_back(chunks.size());
+	}
+	uint32_t nextVertex = 0;
+	for (size_t first = 0; first < mesh.indices.size(); first += IndexChunkSize) {
+		size_t count = std::min<size_t>(IndexChunkSize, mesh.indices.size() - first);
+		// The first vertex not used yet starts every chunk
+		const uint8_t* next = reinterpret_cast<const uint8_t*>(&nextVertex);
+		chunks.insert(chunks.end(), next, next + sizeof(nextVertex));
+		encodeIndexStream(mesh.indices.data() + first, count, nextVertex, chunks);
+		chunkEnds.push_back(chunks.size());
+		for (size_t i = first; i < first + count; ++i) {
+			nextVertex = std::max(nextVertex, mesh.indices[i] + 1);
+		}
+	}
+	appendTable(out, chunkEnds);
+	out.insert(out.end(), chunks.begin(), chunks.end());
+	return out;
+}
+
+
+bool decompressMesh(const uint8_t* data, size_t size, Mesh& mesh, ThreadPool& pool) {
+	PROFILE_ZONE("Decompress mesh");
+	const uint8_t* end = data + size;
+	CompressedMeshHeader header;
+	if (size < sizeof(header)) {
+		return false;
+	}
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, Magic, sizeof(Magic)) != 0 || header.version != Version
+		|| header.vertexChunkSize == 0 || header.indexChunkSize == 0 || header.indexCount > UINT32_MAX) {
+		return false;
+	}
+	// Even all-zero groups take a selector, so that larger counts cannot be
+	// real and would only make us allocate for nothing
+	if (header.vertexCount / 4 > size || header.indexCount / 32 > size) {
+		return false;
+	}
+	const uint8_t* cursor = data + sizeof(header);
+
+	size_t vertexChunks = static_cast<size_t>((header.vertexCount + header.vertexChunkSize - 1) / header.vertexChunkSize);
+	size_t indexChunks = static_cast<size_t>((header.indexCount + header.indexChunkSize - 1) / header.indexChunkSize);
+	std::vector<uint64_t> chunkEnds;
+	bool tablesRead =
+		readTable(cursor, end, header.lodCount, mesh.lods) &&
+		readTable(cursor, end, header.meshletCount, mesh.meshlets) &&
+		readTable(cursor, end, header.submeshCount, mesh.submeshes) &&
+		readTable(cursor, end, header.materialCount, mesh.materials) &&
+		readTable(cursor, end, vertexChunks + indexChunks, chunkEnds);
+	if (!tablesRead) {
+		return false;
+	}
+	const uint8_t* chunks = cursor;
+	size_t chunksSize = static_cast<size_t>(end - chunks);
+	for (size_t i = 0; i < chunkEnds.size(); ++i) {
+		if (chunkEnds[i] > chunksSize || (i > 0 && chunkEnds[i] < chunkEnds[i - 1])) {
+			return false;
+		}
+	}
+
+	PositionDecode decode;
+	for (int axis = 0; axis < 3; ++axis) {
+		decode.offset[axis] = header.positionOffset[axis];
+		decode.scale[axis] = header.positionScale[axis];
+	}
+	mesh.vertices.resize(static_cast<size_t>(header.vertexCount));
+	mesh.indices.resize(static_cast<size_t>(header.indexCount));
+
+	std::atomic<bool> valid{ true };
+	pool.parallelFor(vertexChunks + indexChunks, [&](size_t chunk) {
+		const uint8_t* chunkData = chunks + (chunk == 0 ? 0 : chunkEnds[chunk - 1]);
+		size_t chunkSize = static_cast<size_t>(chunks + chunkEnds[chunk] - chunkData);
+		if (chunk < vertexChunks) {
+			size_t first = chunk * header.vertexChunkSize;
+			size_t count = std::min<size_t>(header.vertexChunkSize, mesh.vertices.size() - first);
+			std::vector<CompactVertex> compactVertices(count);
+			if (decodeVertexStream(chunkData, chunkSize, compactVertices.data(), count) != chunkSize) {
+				valid = false;
+				return;
+			}
+			for (size_t i = 0; i < count; ++i) {
+				mesh.vertices[first + i] = decodeVertex(compactVertices[i], decode);
+			}
+		}
+		else {
+			size_t first = (chunk - vertexChunks) * header.indexChunkSize;
+			size_t count = std::min<size_t>(header.indexChunkSize, mesh.indices.size() - first);
+			uint32_t nextVertex;
+			if (chunkSize < sizeof(nextVertex)) {
+				valid = false;
+				return;
+			}
+			std::memcpy(&nextVertex, chunkData, sizeof(nextVertex));
+			uint32_t* indices = mesh.indices.data() + first;
+			size_t read = decodeIndexStream(chunkData + sizeof(nextVertex), chunkSize - sizeof(nextVertex), indices, count, nextVertex);
+			// Every index must be one of the vertices
+			uint32_t largest = count > 0 ? *std::max_element(indices, indices + count) : 0;
+			if (read + sizeof(nextVertex) != chunkSize || (count > 0 && largest >= mesh.vertices.size())) {
+				valid = false;
+			}
+		}
+	});
+	return valid && tablesValid(mesh);
+}
+
+
+bool writeCompressedMesh(const fs::path& path, const Mesh& mesh) {
+	std::vector<uint8_t> data = compressMesh(mesh);
+	std::ofstream out(path, std::ios::binary | std::ios::trunc);
+	out.write(reinterpret_cast<const char*>(data.data()), data.size());
+	if (!out.good()) {
+		std::cout << "*** ERROR *** Could not write compressed mesh " << path << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+bool readCompressedMesh(const fs::path& path, Mesh& mesh, ThreadPool& pool) {
+	MappedFile file;
+	if (!file.open(path)) {
+		std::cout << "*** ERROR *** Could not open compressed mesh " << path << std::endl;
+		return false;
+	}
+	if (!decompressMesh(file.data(), file.size(), mesh, pool)) {
+		std::cout << "*** ERROR *** Compressed mesh is corrupt: " << path << std::endl;
+		mesh = Mesh();
+		return false;
+	}
+	return true;
+}
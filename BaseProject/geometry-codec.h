@@ -0,0 +1,57 @@
+#pragma once
+
+#include "mesh.h"
+#include "compact-vertex.h"
+#include "thread-pool.h"
+
+#include <filesystem>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace fs = std::filesystem;
+
+/**
+ * Compressed geometry, the form meshes are shipped in (".meshz" files) when
+ * reading them costs more than decoding them, as on network file systems.
+ *
+ * Vertices are quantized as CompactVertex, which is the only loss. Each of
+ * their channels (position xyz, octahedral normal, color rgb) is coded as
+ * the zigzag delta to the previous vertex. Indices are coded in 4 bits: 0
+ * for the first vertex not used yet, 1 to 14 for one of the last vertices
+ * pushed to a small FIFO, which the vertex cache order keeps most of them
+ * in, and 15 for any other, whose delta to the previous index follows in a
+ * stream of its own.
+ *
+ * The entropy stage packs these values by groups of 16, each group with the
+ * fewest bits (0, 1, 2, 4, 6, 8, 12, 16 or 32) that hold its largest value.
+ * Groups of small deltas take a few bytes, and the few widths decode with
+ * shifts and masks only. There is no LZ stage: it would not get near the
+ * decode speed, and the deltas leave little redundancy for it.
+ *
+ * Both streams are cut into chunks coded independently, so that they
+ * decode in parallel. The tables of levels of detail, meshlets, submeshes
+ * and materials follow the header as they are.
+ */
+
+// Vertices and indices per chunk, the unit of parallel decoding
+const uint32_t VertexChunkSize = 16384;
+const uint32_t IndexChunkSize = 3 * 16384;
+
+// Compress a mesh, as stored in a .meshz file
+std::vector<uint8_t> compressMesh(const Mesh& mesh);
+
+// Decode data produced by compressMesh(), chunks in parallel on the pool.
+// Returns false if the data is truncated or corrupt.
+bool decompressMesh(const uint8_t* data, size_t size, Mesh& mesh, ThreadPool& pool = ThreadPool::shared());
+
+bool writeCompressedMesh(const fs::path& path, const Mesh& mesh);
+bool readCompressedMesh(const fs::path& path, Mesh& mesh, ThreadPool& pool = ThreadPool::shared());
+
+// Streams of a single chunk, exposed for the benchmarks. Decoders return
+// the number of bytes read, 0 if the data does not hold count values.
+void encodeVertexStream(const CompactVertex* vertices, size_t count, std::vector<uint8_t>& out);
+size_t decodeVertexStream(const uint8_t* data, size_t size, CompactVertex* vertices, size_t count);
+// nextVertex is the first vertex not used by the indices before these ones
+void encodeIndexStream(const uint32_t* indices, size_t count, uint32_t nextVertex, std::vector<uint8_t>& out);
+size_t decodeIndexStream(const uint8_t* data, size_t size, uint32_t* indices, size_t count, uint32_t nextVertex);
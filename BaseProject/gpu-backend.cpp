@@ -0,0 +1,172 @@
+#include "gpu-backend.h"
+
+#include <iostream>
+#include <string>
+
+using namespace wgpu;
+
+Buffer WebGpuBackend::createBuffer(const BufferDescriptor& descriptor) {
+	return device.createBuffer(descriptor);
+}
+
+
+void WebGpuBackend::destroyBuffer(Buffer buffer) {
+	if (buffer) {
+		buffer.destroy();
+		buffer.release();
+	}
+}
+
+
+void WebGpuBackend::writeBuffer(Buffer buffer, uint64_t offset, const void* data, size_t size) {
+	queue.writeBuffer(buffer, offset, data, size);
+}
+
+
+ShaderModule WebGpuBackend::createShaderModule(const ShaderModuleDescriptor& descriptor) {
+	return device.createShaderModule(descriptor);
+}
+
+
+BindGroupLayout WebGpuBackend::createBindGroupLayout(const BindGroupLayoutDescriptor& descriptor) {
+	return device.createBindGroupLayout(descriptor);
+}
+
+
+PipelineLayout WebGpuBackend::createPipelineLayout(const PipelineLayoutDescriptor& descriptor) {
+	return device.createPipelineLayout(descriptor);
+}
+
+
+void WebGpuBackend::createRenderPipelineAsync(const RenderPipelineDescriptor& descriptor,
+											std::function<void(RenderPipeline)> done) {
+#ifdef WEBGPU_BACKEND_WGPU
+	// wgpu-native does not implement the asynchronous call, errors go to
+	// the uncaptured error callback
+	done(device.createRenderPipeline(descriptor));
+#else
+	pendingPipelines.remove_if([](const PendingPipeline& pending) { return pending.finished; });
+	pendingPipelines.emplace_back();
+	PendingPipeline& pending = pendingPipelines.back();
+	pending.callback = device.createRenderPipelineAsync(descriptor, [&pending, done](CreatePipelineAsyncStatus status, RenderPipeline pipeline, char const* message) {
+		pending.finished = true;
+		if (status != CreatePipelineAsyncStatus::Success) {
+			std::cout << "*** ERROR *** Could not create render pipeline: status " << status;
+			std::cout << (message ? std::string(", ") + message : std::string()) << std::endl;
+			done(nullptr);
+			return;
+		}
+		done(pipeline);
+	});
+#endif // WEBGPU_BACKEND_WGPU
+}
+
+
+void WebGpuBackend::release(ShaderModule shaderModule) {
+	shaderModule.release();
+}
+
+
+void WebGpuBackend::release(BindGroupLayout bindGroupLayout) {
+	bindGroupLayout.release();
+}
+
+
+void WebGpuBackend::release(PipelineLayout pipelineLayout) {
+	pipelineLayout.release();
+}
+
+
+void WebGpuBackend::release(RenderPipeline pipeline) {
+	if (pipeline) {
+		pipeline.release();
+	}
+}
+
+
+std::unique_ptr<RenderBundleRecorder> WebGpuBackend::createRenderBundleRecorder(const RenderBundleEncoderDescriptor& descriptor) {
+	return std::make_unique<WebGpuRenderBundle>(device.createRenderBundleEncoder(descriptor));
+}
+
+
+void WebGpuBackend::release(RenderBundle bundle) {
+	if (bundle) {
+		bundle.release();
+	}
+}
+
+
+void WebGpuRenderPass::setPipeline(RenderPipeline pipeline) {
+	encoder.setPipeline(pipeline);
+}
+
+
+void WebGpuRenderPass::setBindGroup(uint32_t groupIndex, BindGroup group,
+									uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) {
+	encoder.setBindGroup(groupIndex, group, dynamicOffsetCount, dynamicOffsets);
+}
+
+
+void WebGpuRenderPass::setVertexBuffer(uint32_t slot, Buffer buffer, uint64_t offset, uint64_t size) {
+	encoder.setVertexBuffer(slot, buffer, offset, size);
+}
+
+
+void WebGpuRenderPass::setIndexBuffer(Buffer buffer, IndexFormat format, uint64_t offset, uint64_t size) {
+	encoder.setIndexBuffer(buffer, format, offset, size);
+}
+
+
+void WebGpuRenderPass::drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+								uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) {
+	encoder.drawIndexed(indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+}
+
+
+void WebGpuRenderPass::executeBundles(size_t bundleCount, const RenderBundle* bundles) {
+	encoder.executeBundles(bundleCount, bundles);
+}
+
+
+WebGpuRenderBundle::~WebGpuRenderBundle() {
+	if (encoder) {
+		encoder.release();
+	}
+}
+
+
+void WebGpuRenderBundle::setPipeline(RenderPipeline pipeline) {
+	encoder.setPipeline(pipeline);
+}
+
+
+void WebGpuRenderBundle::setBindGroup(uint32_t groupIndex, BindGroup group,
+									uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) {
+	encoder.setBindGroup(groupIndex, group, dynamicOffsetCount, dynamicOffsets);
+}
+
+
+void WebGpuRenderBundle::setVertexBuffer(uint32_t slot, Buffer buffer, uint64_t offset, uint64_t size) {
+	encoder.setVertexBuffer(slot, buffer, offset, size);
+}
+
+
+void WebGpuRenderBundle::setIndexBuffer(Buffer buffer, IndexFormat format, uint64_t offset, uint64_t size) {
+	encoder.setIndexBuffer(buffer, format, offset, size);
+}
+
+
+void WebGpuRenderBundle::drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+									uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) {
+	encoder.drawIndexed(indexCount, instanceCount, firstIndex, baseVertex, firstInstance);
+}
+
+
+RenderBundle WebGpuRenderBundle::finish() {
+	RenderBundleDescriptor bundleDesc = {};
+	bundleDesc.label = "Scene bundle";
+	RenderBundle bundle = encoder.finish(bundleDesc);
+	encoder.release();
+	encoder = nullptr;
+	return bundle;
+}
@@ -0,0 +1,152 @@
+#pragma once
+
+#include <webgpu/webgpu.hpp>
+
+#include <functional>
+#include <list>
+#include <memory>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Thin layer between the renderer's per-frame code and WebGPU, so that this
+ * code can also run against RecordingBackend or NullBackend on machines
+ * without a GPU.
+ *
+ * Only the calls made on hot paths go through it: buffer creation and
+ * writes, the commands of a render pass or bundle, and the objects
+ * PipelineCache creates. Bind groups and textures are still created on
+ * the wgpu::Device directly; the recording backend treats their handles
+ * as opaque values.
+ */
+
+// Commands recorded into a render pass or a render bundle
+class RenderPassCommands {
+public:
+	virtual ~RenderPassCommands() = default;
+
+	virtual void setPipeline(wgpu::RenderPipeline pipeline) = 0;
+	virtual void setBindGroup(uint32_t groupIndex, wgpu::BindGroup group,
+							uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) = 0;
+	virtual void setVertexBuffer(uint32_t slot, wgpu::Buffer buffer, uint64_t offset, uint64_t size) = 0;
+	virtual void setIndexBuffer(wgpu::Buffer buffer, wgpu::IndexFormat format, uint64_t offset, uint64_t size) = 0;
+	virtual void drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+							uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) = 0;
+};
+
+// Commands recorded into a render bundle, that render passes then replay
+// with executeBundles()
+class RenderBundleRecorder : public RenderPassCommands {
+public:
+	// Stop recording and return the bundle, to give back with
+	// GpuBackend::release()
+	virtual wgpu::RenderBundle finish() = 0;
+};
+
+// Device and queue operations
+class GpuBackend {
+public:
+	virtual ~GpuBackend() = default;
+
+	virtual wgpu::Buffer createBuffer(const wgpu::BufferDescriptor& descriptor) = 0;
+	// Destroy and release a buffer returned by createBuffer
+	virtual void destroyBuffer(wgpu::Buffer buffer) = 0;
+	virtual void writeBuffer(wgpu::Buffer buffer, uint64_t offset, const void* data, size_t size) = 0;
+
+	// Objects of the render pipelines, see PipelineCache
+	virtual wgpu::ShaderModule createShaderModule(const wgpu::ShaderModuleDescriptor& descriptor) = 0;
+	virtual wgpu::BindGroupLayout createBindGroupLayout(const wgpu::BindGroupLayoutDescriptor& descriptor) = 0;
+	virtual wgpu::PipelineLayout createPipelineLayout(const wgpu::PipelineLayoutDescriptor& descriptor) = 0;
+	// Create a pipeline without waiting for the driver to compile it. done()
+	// receives it, or a null pipeline if creation failed, from a later
+	// device poll, or before this returns when the backend cannot do better.
+	virtual void createRenderPipelineAsync(const wgpu::RenderPipelineDescriptor& descriptor,
+										std::function<void(wgpu::RenderPipeline)> done) = 0;
+	virtual void release(wgpu::ShaderModule shaderModule) = 0;
+	virtual void release(wgpu::BindGroupLayout bindGroupLayout) = 0;
+	virtual void release(wgpu::PipelineLayout pipelineLayout) = 0;
+	virtual void release(wgpu::RenderPipeline pipeline) = 0;
+
+	// Render bundles. Several threads may create recorders and record into
+	// them at once, each recorder being used by one thread at a time.
+	virtual std::unique_ptr<RenderBundleRecorder> createRenderBundleRecorder(
+		const wgpu::RenderBundleEncoderDescriptor& descriptor) = 0;
+	virtual void release(wgpu::RenderBundle bundle) = 0;
+};
+
+
+// Forwards everything to a real device and queue
+class WebGpuBackend : public GpuBackend {
+public:
+	WebGpuBackend(wgpu::Device device, wgpu::Queue queue) : device(device), queue(queue) {}
+
+	wgpu::Buffer createBuffer(const wgpu::BufferDescriptor& descriptor) override;
+	void destroyBuffer(wgpu::Buffer buffer) override;
+	void writeBuffer(wgpu::Buffer buffer, uint64_t offset, const void* data, size_t size) override;
+
+	wgpu::ShaderModule createShaderModule(const wgpu::ShaderModuleDescriptor& descriptor) override;
+	wgpu::BindGroupLayout createBindGroupLayout(const wgpu::BindGroupLayoutDescriptor& descriptor) override;
+	wgpu::PipelineLayout createPipelineLayout(const wgpu::PipelineLayoutDescriptor& descriptor) override;
+	void createRenderPipelineAsync(const wgpu::RenderPipelineDescriptor& descriptor,
+								std::function<void(wgpu::RenderPipeline)> done) override;
+	void release(wgpu::ShaderModule shaderModule) override;
+	void release(wgpu::BindGroupLayout bindGroupLayout) override;
+	void release(wgpu::PipelineLayout pipelineLayout) override;
+	void release(wgpu::RenderPipeline pipeline) override;
+	std::unique_ptr<RenderBundleRecorder> createRenderBundleRecorder(
+		const wgpu::RenderBundleEncoderDescriptor& descriptor) override;
+	void release(wgpu::RenderBundle bundle) override;
+
+private:
+	wgpu::Device device;
+	wgpu::Queue queue;
+
+	// Callbacks of the pipelines being created, kept alive until they ran
+	struct PendingPipeline {
+		std::unique_ptr<wgpu::CreateRenderPipelineAsyncCallback> callback;
+		bool finished = false;
+	};
+	std::list<PendingPipeline> pendingPipelines;
+};
+
+
+// Forwards everything to a real render pass encoder
+class WebGpuRenderPass : public RenderPassCommands {
+public:
+	explicit WebGpuRenderPass(wgpu::RenderPassEncoder encoder) : encoder(encoder) {}
+
+	void setPipeline(wgpu::RenderPipeline pipeline) override;
+	void setBindGroup(uint32_t groupIndex, wgpu::BindGroup group,
+					uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) override;
+	void setVertexBuffer(uint32_t slot, wgpu::Buffer buffer, uint64_t offset, uint64_t size) override;
+	void setIndexBuffer(wgpu::Buffer buffer, wgpu::IndexFormat format, uint64_t offset, uint64_t size) override;
+	void drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+					uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) override;
+
+	// Replay render bundles, which leave the pipeline, bind groups and
+	// buffers unset
+	void executeBundles(size_t bundleCount, const wgpu::RenderBundle* bundles);
+
+private:
+	wgpu::RenderPassEncoder encoder;
+};
+
+
+// Forwards everything to a real render bundle encoder
+class WebGpuRenderBundle : public RenderBundleRecorder {
+public:
+	explicit WebGpuRenderBundle(wgpu::RenderBundleEncoder encoder) : encoder(encoder) {}
+	~WebGpuRenderBundle();
+
+	void setPipeline(wgpu::RenderPipeline pipeline) override;
+	void setBindGroup(uint32_t groupIndex, wgpu::BindGroup group,
+					uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) override;
+	void setVertexBuffer(uint32_t slot, wgpu::Buffer buffer, uint64_t offset, uint64_t size) override;
+	void setIndexBuffer(wgpu::Buffer buffer, wgpu::IndexFormat format, uint64_t offset, uint64_t size) override;
+	void drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+					uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) override;
+	wgpu::RenderBundle finish() override;
+
+private:
+	wgpu::RenderBundleEncoder encoder;
+};
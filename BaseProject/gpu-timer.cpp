@@ -0,0 +1,106 @@
+#include "gpu-timer.h"
+#include "profiler.h"
+
+#include <algorithm>
+
+using namespace wgpu;
+
+namespace {
+
+// Two timestamps of 8 bytes, at the beginning and end of the pass
+const uint64_t TimestampBytes = 2 * sizeof(uint64_t);
+
+} // anonymous namespace
+
+
+GpuTimer::GpuTimer(Device device, const char* zoneName, uint32_t readbackCount)
+	: zoneName(zoneName)
+	, readbacks(std::max(readbackCount, 1u))
+{
+	QuerySetDescriptor querySetDesc;
+	querySetDesc.label = "Pass Timestamps";
+	querySetDesc.type = QueryType::Timestamp;
+	querySetDesc.count = 2;
+	querySet = device.createQuerySet(querySetDesc);
+
+	BufferDescriptor bufferDesc;
+	bufferDesc.label = "Timestamp Resolve";
+	bufferDesc.size = TimestampBytes;
+	bufferDesc.usage = BufferUsage::QueryResolve | BufferUsage::CopySrc;
+	bufferDesc.mappedAtCreation = false;
+	resolveBuffer = device.createBuffer(bufferDesc);
+
+	bufferDesc.label = "Timestamp Readback";
+	bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::MapRead;
+	for (Readback& readback : readbacks) {
+		readback.buffer = device.createBuffer(bufferDesc);
+	}
+
+	writes.querySet = querySet;
+	writes.beginningOfPassWriteIndex = 0;
+	writes.endOfPassWriteIndex = 1;
+}
+
+
+GpuTimer::~GpuTimer() {
+	for (Readback& readback : readbacks) {
+		readback.buffer.destroy();
+		readback.buffer.release();
+	}
+	resolveBuffer.destroy();
+	resolveBuffer.release();
+	querySet.destroy();
+	querySet.release();
+}
+
+
+const WGPURenderPassTimestampWrites* GpuTimer::timestampWrites() {
+	current = -1;
+	if (!Profiler::enabled()) {
+		return nullptr;
+	}
+	for (size_t i = 0; i < readbacks.size(); ++i) {
+		if (readbacks[i].state == SlotState::Free) {
+			current = static_cast<int>(i);
+			return &writes;
+		}
+	}
+	return nullptr;
+}
+
+
+void GpuTimer::resolve(CommandEncoder encoder) {
+	if (current < 0) {
+		return;
+	}
+	Readback& readback = readbacks[current];
+	encoder.resolveQuerySet(querySet, 0, 2, resolveBuffer, 0);
+	encoder.copyBufferToBuffer(resolveBuffer, 0, readback.buffer, 0, TimestampBytes);
+	readback.state = SlotState::Resolving;
+	readback.submitNs = Profiler::now();
+}
+
+
+void GpuTimer::afterSubmit() {
+	if (current < 0) {
+		return;
+	}
+	Readback& readback = readbacks[current];
+	current = -1;
+	if (readback.state != SlotState::Resolving) {
+		return;
+	}
+	readback.state = SlotState::Mapping;
+	readback.mapCallback = readback.buffer.mapAsync(MapMode::Read, 0, TimestampBytes, [this, &readback](BufferMapAsyncStatus status) {
+		if (status == BufferMapAsyncStatus::Success) {
+			const uint64_t* timestamps = static_cast<const uint64_t*>(readback.buffer.getConstMappedRange(0, TimestampBytes));
+			// Timestamps are in nanoseconds. Discard the sample if the
+			// counter went backwards (it may be reset on power changes).
+			if (timestamps[1] >= timestamps[0]) {
+				Profiler::recordGpu(zoneName, readback.submitNs, timestamps[1] - timestamps[0]);
+			}
+			readback.buffer.unmap();
+		}
+		readback.state = SlotState::Free;
+	});
+}
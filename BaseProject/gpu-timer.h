@@ -0,0 +1,56 @@
+#pragma once
+
+#include <webgpu/webgpu.hpp>
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Duration of a render pass measured with GPU timestamp queries, reported to
+ * the Profiler as a GPU zone once the result reaches the CPU.
+ *
+ * The device must have been created with FeatureName::TimestampQuery. Every
+ * frame:
+ *     renderPassDesc.timestampWrites = timer.timestampWrites();
+ *     ... encode and end the pass ...
+ *     timer.resolve(encoder);
+ *     queue.submit(...);
+ *     timer.afterSubmit();
+ * Results are read back through a few buffers used in turn. When all of them
+ * are still waiting to be mapped, the frame is simply not measured.
+ */
+class GpuTimer {
+public:
+	GpuTimer(wgpu::Device device, const char* zoneName, uint32_t readbackCount = 3);
+	~GpuTimer();
+
+	GpuTimer(const GpuTimer&) = delete;
+	GpuTimer& operator=(const GpuTimer&) = delete;
+
+	// Timestamp writes for this frame's pass, or nullptr if it is not measured
+	const WGPURenderPassTimestampWrites* timestampWrites();
+
+	// Copy the timestamps of the pass to a readback buffer, after the pass ended
+	void resolve(wgpu::CommandEncoder encoder);
+
+	// Start reading back the timestamps, once the encoder was submitted
+	void afterSubmit();
+
+private:
+	enum class SlotState { Free, Resolving, Mapping };
+
+	struct Readback {
+		wgpu::Buffer buffer = nullptr;
+		SlotState state = SlotState::Free;
+		uint64_t submitNs = 0;
+		std::unique_ptr<wgpu::BufferMapCallback> mapCallback;
+	};
+
+	const char* zoneName;
+	wgpu::QuerySet querySet = nullptr;
+	wgpu::Buffer resolveBuffer = nullptr;
+	wgpu::RenderPassTimestampWrites writes;
+	std::vector<Readback> readbacks;
+	int current = -1;
+};
@@ -0,0 +1,121 @@
+#include "instance-batch.h"
+
+#include <iostream>
+#include <algorithm>
+
+using namespace wgpu;
+
+InstanceBatch::InstanceBatch(GpuBackend& backend, uint32_t capacity)
+	: backend(backend)
+	, maxInstances(std::max(capacity, 1u))
+{
+	instances.reserve(maxInstances);
+	levels.reserve(maxInstances);
+	sorted.reserve(maxInstances);
+
+	BufferDescriptor bufferDesc;
+	bufferDesc.label = "Instance Data";
+	bufferDesc.size = bufferSize();
+	bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Storage;
+	bufferDesc.mappedAtCreation = false;
+	storageBuffer = backend.createBuffer(bufferDesc);
+}
+
+
+InstanceBatch::~InstanceBatch() {
+	backend.destroyBuffer(storageBuffer);
+}
+
+
+void InstanceBatch::clear() {
+	dirty = dirty || !instances.empty();
+	instances.clear();
+	levels.clear();
+}
+
+
+bool InstanceBatch::add(const glm::mat4x4& modelMatrix, const glm::vec4& color) {
+	if (instances.size() >= maxInstances) {
+		if (!overflowReported) {
+			std::cout << "*** ERROR *** Instance batch is full (" << maxInstances << " instances)" << std::endl;
+			overflowReported = true;
+		}
+		return false;
+	}
+	instances.push_back({ modelMatrix, color });
+	levels.push_back(0);
+	dirty = true;
+	return true;
+}
+
+
+void InstanceBatch::setModelMatrix(uint32_t index, const glm::mat4x4& modelMatrix) {
+	instances[index].modelMatrix = modelMatrix;
+	dirty = true;
+}
+
+
+void InstanceBatch::setLevel(uint32_t index, uint32_t level) {
+	uint8_t clamped = static_cast<uint8_t>(std::min(level, MaxLodLevels - 1));
+	if (levels[index] != clamped) {
+		levels[index] = clamped;
+		dirty = true;
+	}
+}
+
+
+void InstanceBatch::hide(uint32_t index) {
+	if (levels[index] != HiddenLevel) {
+		levels[index] = static_cast<uint8_t>(HiddenLevel);
+		dirty = true;
+	}
+}
+
+
+void InstanceBatch::upload() {
+	if (!dirty) {
+		return;
+	}
+	// Counting sort by level, stable so that instances keep their order
+	levelStart.fill(0);
+	for (uint8_t level : levels) {
+		++levelStart[level + 1];
+	}
+	for (size_t level = 1; level < levelStart.size(); ++level) {
+		levelStart[level] += levelStart[level - 1];
+	}
+	sorted.resize(instances.size());
+	std::array<uint32_t, HiddenLevel + 2> next = levelStart;
+	for (size_t i = 0; i < instances.size(); ++i) {
+		sorted[next[levels[i]]++] = instances[i];
+	}
+
+	// Hidden instances are sorted but not uploaded
+	if (drawnCount() > 0) {
+		backend.writeBuffer(storageBuffer, 0, sorted.data(), drawnCount() * sizeof(InstanceData));
+	}
+	dirty = false;
+}
+
+
+void InstanceBatch::draw(RenderPassCommands& pass, const MeshLod* lods, size_t lodCount,
+						const std::vector<IndexRange>* fullDetailRanges) const {
+	if (lodCount == 0) {
+		return;
+	}
+	for (size_t level = 0; level < MaxLodLevels; ++level) {
+		uint32_t first = levelStart[level];
+		uint32_t count = levelStart[level + 1] - first;
+		if (count == 0) {
+			continue;
+		}
+		if (level == 0 && fullDetailRanges) {
+			for (const IndexRange& range : *fullDetailRanges) {
+				pass.drawIndexed(range.indexCount, count, range.firstIndex, 0, first);
+			}
+			continue;
+		}
+		const MeshLod& lod = lods[std::min(level, lodCount - 1)];
+		pass.drawIndexed(lod.indexCount, count, lod.firstIndex, 0, first);
+	}
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include "gpu-backend.h"
+#include "mesh.h"
+#include "meshlets.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+#include <cstdint>
+
+// Per-instance data, laid out like InstanceData in the shader (std430)
+struct InstanceData {
+	glm::mat4x4 modelMatrix;
+	glm::vec4 color;
+};
+static_assert(sizeof(InstanceData) == 80, "InstanceData must match the shader layout");
+
+/**
+ * Copies of one mesh drawn with a single instanced draw call. The transform
+ * and color of every instance live in a storage buffer that vs_main indexes
+ * with @builtin(instance_index).
+ *
+ * Every instance is drawn with a level of detail of the mesh, see
+ * setLevel(), or not at all once hidden, see hide(). The buffer holds the
+ * drawn instances grouped by level, so that each level in use costs one
+ * instanced draw call.
+ *
+ * Instances stay until clear(). upload() only writes the buffer again when
+ * they or their levels changed since the last upload.
+ */
+class InstanceBatch {
+public:
+	InstanceBatch(GpuBackend& backend, uint32_t capacity);
+	~InstanceBatch();
+
+	InstanceBatch(const InstanceBatch&) = delete;
+	InstanceBatch& operator=(const InstanceBatch&) = delete;
+
+	void clear();
+
+	// Return false if the batch is already at capacity
+	bool add(const glm::mat4x4& modelMatrix, const glm::vec4& color);
+
+	// Replace the transform of an instance
+	void setModelMatrix(uint32_t index, const glm::mat4x4& modelMatrix);
+
+	// Level of detail of an instance, 0 (the full mesh) by default
+	void setLevel(uint32_t index, uint32_t level);
+	uint32_t level(uint32_t index) const { return levels[index]; }
+
+	// Leave an instance out of the buffer and the draws until its next
+	// setLevel(), when it is out of view. level() is then HiddenLevel.
+	void hide(uint32_t index);
+	static constexpr uint32_t HiddenLevel = MaxLodLevels;
+	uint32_t drawnCount() const { return levelStart[HiddenLevel]; }
+
+	// Write the instances to the storage buffer, in one writeBuffer
+	void upload();
+
+	// Draw every instance of a mesh whose vertex and index buffers are bound,
+	// with one call per level in use. Levels past the end of lods fall back to
+	// the last one. When fullDetailRanges is given, the instances at level 0
+	// only draw these ranges, with one call per range (see MeshletCuller).
+	void draw(RenderPassCommands& pass, const MeshLod* lods, size_t lodCount,
+			const std::vector<IndexRange>* fullDetailRanges = nullptr) const;
+
+	const InstanceData& instance(uint32_t index) const { return instances[index]; }
+	uint32_t instanceCount() const { return static_cast<uint32_t>(instances.size()); }
+	uint32_t capacity() const { return maxInstances; }
+	wgpu::Buffer buffer() const { return storageBuffer; }
+	uint64_t bufferSize() const { return uint64_t(maxInstances) * sizeof(InstanceData); }
+
+private:
+	GpuBackend& backend;
+	wgpu::Buffer storageBuffer = nullptr;
+	std::vector<InstanceData> instances;
+	std::vector<uint8_t> levels;
+	// Instances sorted by level, as uploaded, and where each level starts,
+	// the hidden ones last
+	std::vector<InstanceData> sorted;
+	std::array<uint32_t, HiddenLevel + 2> levelStart = {};
+	uint32_t maxInstances;
+	bool dirty = false;
+	bool overflowReported = false;
+};
@@ -0,0 +1,81 @@
+#include "lod-selector.h"
+
+#include <algorithm>
+#include <cmath>
+
+float lodErrorScale(const glm::mat4x4& projection, float viewportHeight) {
+	// NDC spans 2 units over the height of the viewport
+	return std::abs(projection[1][1]) * viewportHeight * 0.5f;
+}
+
+
+glm::vec4 meshBoundingSphere(const VertexAttributes* vertices, size_t vertexCount) {
+	if (vertexCount == 0) {
+		return glm::vec4(0.0f);
+	}
+	// Center of the bounding box, which is close enough to the smallest
+	// sphere for distance estimates
+	glm::vec3 lower = vertices[0].position;
+	glm::vec3 upper = vertices[0].position;
+	for (size_t i = 1; i < vertexCount; ++i) {
+		lower = glm::min(lower, vertices[i].position);
+		upper = glm::max(upper, vertices[i].position);
+	}
+	glm::vec3 center = (lower + upper) * 0.5f;
+	float radius = 0.0f;
+	for (size_t i = 0; i < vertexCount; ++i) {
+		glm::vec3 d = vertices[i].position - center;
+		radius = std::max(radius, glm::dot(d, d));
+	}
+	return glm::vec4(center, std::sqrt(radius));
+}
+
+
+float maxLodError(const glm::mat4x4& projection, const glm::mat4x4& modelView, const glm::vec4& bounds,
+				float errorScale, float maxPixelError)
+{
+	// Errors scale with the largest axis of the transform
+	float scale = std::sqrt(std::max({
+		glm::dot(glm::vec3(modelView[0]), glm::vec3(modelView[0])),
+		glm::dot(glm::vec3(modelView[1]), glm::vec3(modelView[1])),
+		glm::dot(glm::vec3(modelView[2]), glm::vec3(modelView[2]))
+	}));
+
+	// clip.w of the point of the bounding sphere closest to the camera
+	glm::vec4 center = modelView * glm::vec4(glm::vec3(bounds), 1.0f);
+	float w = projection[2][3] * center.z + projection[3][3];
+	w -= std::abs(projection[2][3]) * bounds.w * scale;
+	if (w <= 0.0f) {
+		return 0.0f;
+	}
+	return maxPixelError * w / (errorScale * scale);
+}
+
+
+uint32_t selectLod(const std::vector<MeshLod>& lods, const glm::mat4x4& projection,
+				const glm::mat4x4& modelView, const glm::vec4& bounds,
+				float errorScale, float maxPixelError)
+{
+	if (lods.size() <= 1) {
+		return 0;
+	}
+	float maxError = maxLodError(projection, modelView, bounds, errorScale, maxPixelError);
+	uint32_t level = 0;
+	while (level + 1 < lods.size() && lods[level + 1].error <= maxError) {
+		++level;
+	}
+	return level;
+}
+
+
+uint32_t selectOccluderLod(const std::vector<MeshLod>& lods, const glm::mat4x4& projection,
+						const glm::mat4x4& modelView, const glm::vec4& bounds,
+						float errorScale, float maxPixelError)
+{
+	float maxError = maxLodError(projection, modelView, bounds, errorScale, maxPixelError);
+	uint32_t level = NoOccluderLod;
+	while (level + 1 < lods.size() && lods[level + 1].error <= maxError) {
+		++level;
+	}
+	return level;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * Choice of the level of detail an object is drawn with, from the error of
+ * each level projected on screen: the coarsest level whose error covers at
+ * most maxPixelError pixels is used.
+ *
+ * The projection is only used through clip.w and the vertical scale, so this
+ * works with the renderer's own projection matrix (clip.w = z / focalLength)
+ * as well as with the usual glm::perspective one.
+ */
+
+// Pixels covered by one unit of view space at clip.w = 1, vertically
+float lodErrorScale(const glm::mat4x4& projection, float viewportHeight);
+
+// Bounding sphere of the vertices, used to measure how far an object is
+glm::vec4 meshBoundingSphere(const VertexAttributes* vertices, size_t vertexCount);
+
+// Largest error, in mesh units, that covers at most maxPixelError pixels on
+// an object. modelView maps mesh coordinates to view space, bounds is
+// meshBoundingSphere(). 0 for objects that reach the camera plane.
+float maxLodError(const glm::mat4x4& projection, const glm::mat4x4& modelView, const glm::vec4& bounds,
+				float errorScale, float maxPixelError = 1.0f);
+
+// Index into lods of the level to draw an object with. Objects that reach
+// the camera plane always get the full mesh.
+uint32_t selectLod(const std::vector<MeshLod>& lods, const glm::mat4x4& projection,
+				const glm::mat4x4& modelView, const glm::vec4& bounds,
+				float errorScale, float maxPixelError = 1.0f);
+
+// Same for an occluder, whose levels may not start with the full mesh:
+// NoOccluderLod when even the first one is off by more than maxPixelError
+// pixels, as the coarser levels fill concavities and push the silhouette
+// outward, which would hide what is actually visible
+const uint32_t NoOccluderLod = UINT32_MAX;
+uint32_t selectOccluderLod(const std::vector<MeshLod>& lods, const glm::mat4x4& projection,
+						const glm::mat4x4& modelView, const glm::vec4& bounds,
+						float errorScale, float maxPixelError = 1.0f);
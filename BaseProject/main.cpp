@@ -1,11 +1,222 @@
 // Include the C++ wrapper instead of the raw header(s)
 #define WEBGPU_CPP_IMPLEMENTATION
 #include "Renderer.h"
+#include "benchmarks.h"
+#include "profiler.h"
+#include "mesh-loader.h"
+#include "geometry-codec.h"
+
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace {
+
+// Profiling flags, accepted by the windowed and headless modes:
+//     --profile             print per-zone frame statistics on exit
+//     --trace trace.json    also save the zones in Chrome trace format
+struct ProfilingOptions {
+	bool enabled = false;
+	std::string tracePath;
+};
+
+// Remove the profiling flags from args
+ProfilingOptions extractProfilingOptions(std::vector<std::string>& args) {
+	ProfilingOptions profiling;
+	for (size_t i = 0; i < args.size();) {
+		if (args[i] == "--profile") {
+			profiling.enabled = true;
+			args.erase(args.begin() + i);
+		}
+		else if (args[i] == "--trace" && i + 1 < args.size()) {
+			profiling.enabled = true;
+			profiling.tracePath = args[i + 1];
+			args.erase(args.begin() + i, args.begin() + i + 2);
+		}
+		else {
+			++i;
+		}
+	}
+	if (profiling.enabled) {
+		Profiler::setEnabled(true);
+		Profiler::setCapture(!profiling.tracePath.empty());
+	}
+	return profiling;
+}
+
+void reportProfiling(const ProfilingOptions& profiling) {
+	if (!profiling.enabled) {
+		return;
+	}
+	Profiler::collect();
+	Profiler::printStats(std::cout);
+	if (!profiling.tracePath.empty()) {
+		if (Profiler::writeChromeTrace(profiling.tracePath)) {
+			std::cout << "Trace saved to " << profiling.tracePath << std::endl;
+		}
+		else {
+			std::cout << "*** ERROR *** Could not write trace " << profiling.tracePath << std::endl;
+		}
+	}
+}
+
+// Remove a flag from args, return whether it was there
+bool extractFlag(std::vector<std::string>& args, const std::string& flag) {
+	auto it = std::find(args.begin(), args.end(), flag);
+	if (it == args.end()) {
+		return false;
+	}
+	args.erase(it);
+	return true;
+}
+
+// Remove a flag and the value after it from args, return whether it was there
+bool extractOption(std::vector<std::string>& args, const std::string& flag, std::string& value) {
+	auto it = std::find(args.begin(), args.end(), flag);
+	if (it == args.end() || it + 1 == args.end()) {
+		return false;
+	}
+	value = *(it + 1);
+	args.erase(it, it + 2);
+	return true;
+}
+
+// Render a fixed number of frames without any window, report the frame times
+// and save the last frame.
+//     App --headless [--frames N] [--size WxH] [--capture frame.ppm] [--cpu]
+int runHeadless(const std::vector<std::string>& args, RendererOptions options, const ProfilingOptions& profiling) {
+	options.headless = true;
+	int frameCount = 60;
+	std::string capturePath = "frame.ppm";
+	for (size_t i = 0; i < args.size(); ++i) {
+		bool hasValue = i + 1 < args.size();
+		if (args[i] == "--frames" && hasValue) {
+			frameCount = std::max(1, std::stoi(args[++i]));
+		}
+		else if (args[i] == "--size" && hasValue) {
+			const std::string& size = args[++i];
+			size_t separator = size.find('x');
+			if (separator == std::string::npos) {
+				std::cout << "*** ERROR *** Expected --size WIDTHxHEIGHT" << std::endl;
+				return 1;
+			}
+			options.width = static_cast<uint32_t>(std::stoul(size.substr(0, separator)));
+			options.height = static_cast<uint32_t>(std::stoul(size.substr(separator + 1)));
+		}
+		else if (args[i] == "--capture" && hasValue) {
+			capturePath = args[++i];
+		}
+		else if (args[i] == "--cpu") {
+			options.forceFallbackAdapter = true;
+		}
+		else {
+			std::cout << "Usage: App --headless [--frames N] [--size WxH] [--capture frame.ppm] [--cpu]" << std::endl;
+			return 1;
+		}
+	}
 
-int main() {
 	Renderer app;
+	if (!app.Initialize(options)) {
+		return 1;
+	}
+
+	// Frames render while the assets load; the measured ones start once
+	// everything is resident, so that captures are reproducible
+	int loadingFrames = 0;
+	while (app.IsLoading()) {
+		app.MainLoop();
+		++loadingFrames;
+	}
+	std::cout << loadingFrames << " frames rendered while loading" << std::endl;
+	if (app.LoadFailed()) {
+		std::cout << "*** ERROR *** The scene could not be loaded, see --resources and --mesh" << std::endl;
+		app.Terminate();
+		return 1;
+	}
 
-	if (!app.Initialize()) {
+	std::vector<double> frameTimes;
+	for (int frame = 0; frame < frameCount; ++frame) {
+		auto start = std::chrono::steady_clock::now();
+		app.MainLoop();
+		frameTimes.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+	bool captured = app.CaptureFrame(capturePath);
+	app.PrintPipelineCacheStats(std::cout);
+	app.PrintBufferPoolStats(std::cout);
+	app.Terminate();
+
+	std::sort(frameTimes.begin(), frameTimes.end());
+	std::cout << frameCount << " frames at " << options.width << "x" << options.height
+		<< ": median " << frameTimes[frameTimes.size() / 2] << " ms, min " << frameTimes.front()
+		<< " ms, max " << frameTimes.back() << " ms" << std::endl;
+	if (captured) {
+		std::cout << "Last frame saved to " << capturePath << std::endl;
+	}
+	reportProfiling(profiling);
+	return captured ? 0 : 1;
+}
+
+// Import an OBJ file with the default loader options and save it compressed
+// next to it, where the renderer looks for it first
+//     App --compress-mesh file.obj [file.meshz]
+int compressMeshFile(const std::vector<std::string>& args) {
+	if (args.empty()) {
+		std::cout << "Usage: App --compress-mesh file.obj [file.meshz]" << std::endl;
+		return 1;
+	}
+	fs::path objPath = args[0];
+	fs::path compressedPath = args.size() > 1 ? fs::path(args[1]) : fs::path(objPath).replace_extension(".meshz");
+	Mesh mesh;
+	if (!loadGeometryFromObj(objPath, mesh) || !writeCompressedMesh(compressedPath, mesh)) {
+		return 1;
+	}
+	std::error_code ec;
+	std::cout << "Compressed " << objPath << " (" << fs::file_size(objPath, ec) / 1024 << " KiB) to " << compressedPath
+		<< " (" << fs::file_size(compressedPath, ec) / 1024 << " KiB)" << std::endl;
+	return 0;
+}
+
+} // anonymous namespace
+
+int main(int argc, char* argv[]) {
+	std::vector<std::string> args(argv + 1, argv + argc);
+	if (!args.empty() && args[0] == "--benchmark") {
+		return runBenchmarks(std::vector<std::string>(args.begin() + 1, args.end()));
+	}
+	if (!args.empty() && args[0] == "--compress-mesh") {
+		return compressMeshFile(std::vector<std::string>(args.begin() + 1, args.end()));
+	}
+	ProfilingOptions profiling = extractProfilingOptions(args);
+
+	// Flags accepted by the windowed and headless modes:
+	//     --compact-vertices    upload the mesh as CompactVertex
+	//     --vertex-colors       shade with the vertex colors
+	//     --render-bundles      record the draws into render bundles on worker threads
+	//     --occlusion-culling   skip the instances the nearest ones hide, from a CPU depth buffer
+	//     --resources DIR       directory of the shaders and of the default mesh
+	//     --mesh file.obj       mesh to draw rather than mammoth.obj of the resources
+	RendererOptions options;
+	options.gpuTimestamps = profiling.enabled;
+	options.compactVertices = extractFlag(args, "--compact-vertices");
+	options.vertexColors = extractFlag(args, "--vertex-colors");
+	options.renderBundles = extractFlag(args, "--render-bundles");
+	options.occlusionCulling = extractFlag(args, "--occlusion-culling");
+	std::string path;
+	if (extractOption(args, "--resources", path)) {
+		options.resourceDirectory = path;
+	}
+	if (extractOption(args, "--mesh", path)) {
+		options.meshPath = path;
+	}
+
+	if (!args.empty() && args[0] == "--headless") {
+		return runHeadless(std::vector<std::string>(args.begin() + 1, args.end()), options, profiling);
+	}
+
+	Renderer app;
+	if (!app.Initialize(options)) {
 		return 1;
 	}
 
@@ -21,6 +232,7 @@ int main() {
 		app.MainLoop();
 	}
 	app.Terminate();
+	reportProfiling(profiling);
 #endif // __EMSCRIPTEN__
 
 	return 0;
@@ -0,0 +1,137 @@
+#include "mapped-file.h"
+
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  include <windows.h>
+#elif defined(__EMSCRIPTEN__)
+#  include <fstream>
+#else
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <fcntl.h>
+#  include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#if defined(_WIN32)
+
+bool MappedFile::open(const fs::path& path) {
+	close();
+
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mapping == nullptr) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (view == nullptr) {
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mapping;
+	mappedData = static_cast<const uint8_t*>(view);
+	mappedSize = static_cast<size_t>(fileSize.QuadPart);
+	return true;
+}
+
+void MappedFile::close() {
+	if (mappedData) UnmapViewOfFile(mappedData);
+	if (mappingHandle) CloseHandle(mappingHandle);
+	if (fileHandle) CloseHandle(fileHandle);
+	mappedData = nullptr;
+	mappedSize = 0;
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+}
+
+#elif defined(__EMSCRIPTEN__)
+
+bool MappedFile::open(const fs::path& path) {
+	close();
+
+	// The virtual file system of Emscripten lives in memory anyways, so we
+	// simply read the file.
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open()) {
+		return false;
+	}
+	size_t size = static_cast<size_t>(file.tellg());
+	if (size == 0) {
+		return false;
+	}
+	fileContent.resize(size);
+	file.seekg(0);
+	file.read(reinterpret_cast<char*>(fileContent.data()), size);
+
+	mappedData = fileContent.data();
+	mappedSize = size;
+	return true;
+}
+
+void MappedFile::close() {
+	fileContent.clear();
+	fileContent.shrink_to_fit();
+	mappedData = nullptr;
+	mappedSize = 0;
+}
+
+#else // POSIX
+
+bool MappedFile::open(const fs::path& path) {
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) != 0 || fileStat.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	size_t size = static_cast<size_t>(fileStat.st_size);
+	void* view = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping keeps its own reference to the file
+	::close(fd);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+
+	// We read the file front to back, both when hashing and when uploading
+	madvise(view, size, MADV_SEQUENTIAL);
+
+	mappedData = static_cast<const uint8_t*>(view);
+	mappedSize = size;
+	return true;
+}
+
+void MappedFile::close() {
+	if (mappedData) {
+		munmap(const_cast<uint8_t*>(mappedData), mappedSize);
+	}
+	mappedData = nullptr;
+	mappedSize = 0;
+}
+
+#endif
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <filesystem>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace fs = std::filesystem;
+
+/**
+ * Read-only view of a whole file. The file is memory-mapped when the platform
+ * allows it, so that its content can be handed to the GPU without any
+ * intermediate copy. On Emscripten the file is read into memory instead.
+ */
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Map the file, return false if it could not be opened
+	bool open(const fs::path& path);
+
+	// Unmap the file, pointers previously returned by data() become invalid
+	void close();
+
+	bool isOpen() const { return mappedData != nullptr; }
+	const uint8_t* data() const { return mappedData; }
+	size_t size() const { return mappedSize; }
+
+private:
+	const uint8_t* mappedData = nullptr;
+	size_t mappedSize = 0;
+
+#if defined(_WIN32)
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#elif defined(__EMSCRIPTEN__)
+	std::vector<uint8_t> fileContent;
+#endif
+};
@@ -0,0 +1,321 @@
+#include "mesh-cache.h"
+#include "mesh-optimizer.h"
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cctype>
+#include <cstring>
+
+namespace {
+
+constexpr char Magic[8] = { 'W', 'G', 'P', 'U', 'M', 'E', 'S', 'H' };
+
+// Layout of the beginning of a cache file. The vertex data, index data,
+// level table, meshlet table, draw table and material table start at
+// vertexOffset, indexOffset, lodOffset, meshletOffset, submeshOffset and
+// materialOffset, which are kept 16-byte aligned within the (page aligned)
+// mapping.
+struct MeshCacheHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t optionsKey;
+	uint64_t sourceHash;
+	uint64_t sourceSize;
+	uint64_t vertexCount;
+	uint64_t vertexOffset;
+	uint64_t indexCount;
+	uint64_t indexOffset;
+	uint32_t vertexStride;
+	uint32_t indexStride;
+	uint32_t lodCount;
+	uint32_t meshletCount;
+	uint64_t lodOffset;
+	uint64_t meshletOffset;
+	uint32_t submeshCount;
+	uint32_t materialCount;
+	uint64_t submeshOffset;
+	uint64_t materialOffset;
+	uint64_t _pad;
+};
+static_assert(sizeof(MeshCacheHeader) % 16 == 0, "vertex data must stay aligned");
+
+uint64_t alignTo16(uint64_t offset) {
+	return (offset + 15) & ~uint64_t(15);
+}
+
+// Check that [offset, offset + count * stride) lies within the file
+bool rangeFits(uint64_t offset, uint64_t count, uint64_t stride, uint64_t fileSize) {
+	return offset % 16 == 0 && offset <= fileSize && count <= (fileSize - offset) / stride;
+}
+
+// Check that [first, first + count) lies within the index buffer, or within
+// another table of indexCount entries
+bool indexRangeFits(uint32_t first, uint32_t count, size_t indexCount) {
+	return first <= indexCount && count <= indexCount - first;
+}
+
+uint64_t mixHash(uint64_t h, uint64_t value) {
+	h = (h ^ value) * 0x100000001b3ull;
+	return h ^ (h >> 32);
+}
+
+// Hash of the material libraries that the mtllib statements of an OBJ file
+// name, relative to its directory, 0 when there are none. A library that
+// does not exist counts as well, creating it changes the materials.
+uint64_t hashMaterialLibraries(const uint8_t* data, size_t size, const fs::path& directory) {
+	const char* text = reinterpret_cast<const char*>(data);
+	const char* end = text + size;
+	const char keyword[] = "mtllib";
+	const size_t keywordLength = sizeof(keyword) - 1;
+	uint64_t h = 0;
+	for (const char* line = text; line < end;) {
+		const char* lineEnd = static_cast<const char*>(std::memchr(line, '\n', end - line));
+		lineEnd = lineEnd ? lineEnd : end;
+		const char* p = line;
+		while (p < lineEnd && (*p == ' ' || *p == '\t')) ++p;
+		if (static_cast<size_t>(lineEnd - p) > keywordLength && std::memcmp(p, keyword, keywordLength) == 0
+			&& std::isspace(static_cast<unsigned char>(p[keywordLength]))) {
+			// Names are separated by spaces, like tinyobj::LoadObj reads them
+			p += keywordLength;
+			while (p < lineEnd) {
+				while (p < lineEnd && std::isspace(static_cast<unsigned char>(*p))) ++p;
+				const char* nameEnd = p;
+				while (nameEnd < lineEnd && !std::isspace(static_cast<unsigned char>(*nameEnd))) ++nameEnd;
+				if (nameEnd == p) break;
+				std::string name(p, nameEnd);
+				h = mixHash(h, hashBytes(reinterpret_cast<const uint8_t*>(name.data()), name.size()));
+				MappedFile library;
+				h = mixHash(h, library.open(directory / name) ? hashBytes(library.data(), library.size()) : 0);
+				p = nameEnd;
+			}
+		}
+		line = lineEnd + 1;
+	}
+	return h;
+}
+
+} // anonymous namespace
+
+
+uint64_t hashBytes(const uint8_t* data, size_t size) {
+	// FNV-1a applied on 8-byte words, with an extra shift to spread high bits
+	const uint64_t prime = 0x100000001b3ull;
+	uint64_t h = 0xcbf29ce484222325ull ^ size;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, data + i, 8);
+		h = (h ^ word) * prime;
+		h ^= h >> 32;
+	}
+	for (; i < size; ++i) {
+		h = (h ^ data[i]) * prime;
+	}
+	return h;
+}
+
+
+fs::path MeshCache::cachePath(const fs::path& sourcePath) {
+	fs::path path = sourcePath;
+	path += ".meshcache";
+	return path;
+}
+
+
+bool MeshCache::open(const fs::path& path, const MeshLoaderOptions& options) {
+	close();
+	sourcePath = path;
+	optionsKey = options.key();
+	sourceHash = 0;
+	sourceSize = 0;
+
+	// Key the cache by the content of the source file and of its materials
+	{
+		MappedFile source;
+		if (!source.open(sourcePath)) {
+			return false;
+		}
+		sourceHash = hashBytes(source.data(), source.size());
+		sourceHash ^= hashMaterialLibraries(source.data(), source.size(), sourcePath.parent_path());
+		sourceSize = source.size();
+	}
+
+	if (!file.open(cachePath(sourcePath))) {
+		return false;
+	}
+
+	MeshCacheHeader header;
+	if (file.size() < sizeof(header)) {
+		close();
+		return false;
+	}
+	std::memcpy(&header, file.data(), sizeof(header));
+
+	bool valid =
+		std::memcmp(header.magic, Magic, sizeof(Magic)) == 0 &&
+		header.version == Version &&
+		header.optionsKey == optionsKey &&
+		header.sourceHash == sourceHash &&
+		header.sourceSize == sourceSize &&
+		header.vertexStride == sizeof(VertexAttributes) &&
+		header.indexStride == (fitsUint16Indices(header.vertexCount) ? sizeof(uint16_t) : sizeof(uint32_t)) &&
+		rangeFits(header.vertexOffset, header.vertexCount, header.vertexStride, file.size()) &&
+		rangeFits(header.indexOffset, header.indexCount, header.indexStride, file.size()) &&
+		rangeFits(header.lodOffset, header.lodCount, sizeof(MeshLod), file.size()) &&
+		rangeFits(header.meshletOffset, header.meshletCount, sizeof(Meshlet), file.size()) &&
+		rangeFits(header.submeshOffset, header.submeshCount, sizeof(Submesh), file.size()) &&
+		rangeFits(header.materialOffset, header.materialCount, sizeof(Material), file.size());
+
+	if (!valid) {
+		std::cout << "Mesh cache is outdated: " << cachePath(sourcePath) << std::endl;
+		close();
+		return false;
+	}
+
+	cachedVertices = reinterpret_cast<const VertexAttributes*>(file.data() + header.vertexOffset);
+	cachedVertexCount = static_cast<size_t>(header.vertexCount);
+	cachedIndices = file.data() + header.indexOffset;
+	cachedIndexCount = static_cast<size_t>(header.indexCount);
+	cachedIndexStride = header.indexStride;
+	cachedLods = reinterpret_cast<const MeshLod*>(file.data() + header.lodOffset);
+	cachedLodCount = header.lodCount;
+	cachedMeshlets = reinterpret_cast<const Meshlet*>(file.data() + header.meshletOffset);
+	cachedMeshletCount = header.meshletCount;
+	cachedSubmeshes = reinterpret_cast<const Submesh*>(file.data() + header.submeshOffset);
+	cachedSubmeshCount = header.submeshCount;
+	cachedMaterials = reinterpret_cast<const Material*>(file.data() + header.materialOffset);
+	cachedMaterialCount = header.materialCount;
+	bool rangesValid = true;
+	for (size_t i = 0; i < cachedLodCount; ++i) {
+		rangesValid = rangesValid && indexRangeFits(cachedLods[i].firstIndex, cachedLods[i].indexCount, cachedIndexCount);
+	}
+	for (size_t i = 0; i < cachedMeshletCount; ++i) {
+		rangesValid = rangesValid && indexRangeFits(cachedMeshlets[i].firstIndex, cachedMeshlets[i].indexCount, cachedIndexCount);
+	}
+	for (size_t i = 0; i < cachedSubmeshCount; ++i) {
+		const Submesh& submesh = cachedSubmeshes[i];
+		rangesValid = rangesValid &&
+			indexRangeFits(submesh.firstIndex, submesh.indexCount, cachedIndexCount) &&
+			indexRangeFits(submesh.firstLod, submesh.lodCount, cachedLodCount) &&
+			indexRangeFits(submesh.firstMeshlet, submesh.meshletCount, cachedMeshletCount) &&
+			submesh.material >= -1 && submesh.material < static_cast<int64_t>(cachedMaterialCount);
+	}
+	if (!rangesValid) {
+		std::cout << "Mesh cache is outdated: " << cachePath(sourcePath) << std::endl;
+		close();
+		return false;
+	}
+	return true;
+}
+
+
+bool MeshCache::store(const Mesh& mesh) const {
+	if (sourceSize == 0) {
+		return false;
+	}
+
+	MeshCacheHeader header = {};
+	std::memcpy(header.magic, Magic, sizeof(Magic));
+	header.version = Version;
+	header.optionsKey = optionsKey;
+	header.sourceHash = sourceHash;
+	header.sourceSize = sourceSize;
+	header.vertexCount = mesh.vertices.size();
+	header.vertexOffset = sizeof(MeshCacheHeader);
+	header.vertexStride = sizeof(VertexAttributes);
+	header.indexCount = mesh.indices.size();
+	header.indexOffset = alignTo16(header.vertexOffset + header.vertexCount * header.vertexStride);
+	header.indexStride = fitsUint16Indices(mesh.vertices.size()) ? sizeof(uint16_t) : sizeof(uint32_t);
+	header.lodCount = static_cast<uint32_t>(mesh.lods.size());
+	header.lodOffset = alignTo16(header.indexOffset + header.indexCount * header.indexStride);
+	header.meshletCount = static_cast<uint32_t>(mesh.meshlets.size());
+	header.meshletOffset = header.lodOffset + header.lodCount * sizeof(MeshLod);
+	header.submeshCount = static_cast<uint32_t>(mesh.submeshes.size());
+	header.submeshOffset = header.meshletOffset + header.meshletCount * sizeof(Meshlet);
+	header.materialCount = static_cast<uint32_t>(mesh.materials.size());
+	header.materialOffset = header.submeshOffset + header.submeshCount * sizeof(Submesh);
+
+	std::vector<uint16_t> narrow;
+	const void* indexData = mesh.indices.data();
+	if (header.indexStride == sizeof(uint16_t)) {
+		narrow = narrowIndices(mesh.indices);
+		indexData = narrow.data();
+	}
+	const char padding[16] = {};
+	size_t paddingSize = header.indexOffset - (header.vertexOffset + header.vertexCount * header.vertexStride);
+	size_t lodPaddingSize = header.lodOffset - (header.indexOffset + header.indexCount * header.indexStride);
+
+	// Write to a temporary file first so that a concurrent reader or a crash
+	// never leaves a truncated cache behind.
+	fs::path finalPath = cachePath(sourcePath);
+	fs::path tmpPath = finalPath;
+	tmpPath += ".tmp";
+	{
+		std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+		if (!out.is_open()) {
+			std::cout << "*** ERROR *** Could not write mesh cache " << tmpPath << std::endl;
+			return false;
+		}
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(mesh.vertices.data()), header.vertexCount * header.vertexStride);
+		out.write(padding, paddingSize);
+		out.write(reinterpret_cast<const char*>(indexData), header.indexCount * header.indexStride);
+		out.write(padding, lodPaddingSize);
+		out.write(reinterpret_cast<const char*>(mesh.lods.data()), header.lodCount * sizeof(MeshLod));
+		out.write(reinterpret_cast<const char*>(mesh.meshlets.data()), header.meshletCount * sizeof(Meshlet));
+		out.write(reinterpret_cast<const char*>(mesh.submeshes.data()), header.submeshCount * sizeof(Submesh));
+		out.write(reinterpret_cast<const char*>(mesh.materials.data()), header.materialCount * sizeof(Material));
+		if (!out.good()) {
+			std::cout << "*** ERROR *** Could not write mesh cache " << tmpPath << std::endl;
+			return false;
+		}
+	}
+
+	std::error_code ec;
+	fs::rename(tmpPath, finalPath, ec);
+	if (ec) {
+		std::cout << "*** ERROR *** Could not write mesh cache " << finalPath << ": " << ec.message() << std::endl;
+		fs::remove(tmpPath, ec);
+		return false;
+	}
+	return true;
+}
+
+
+void MeshCache::close() {
+	file.close();
+	cachedVertices = nullptr;
+	cachedVertexCount = 0;
+	cachedIndices = nullptr;
+	cachedIndexCount = 0;
+	cachedIndexStride = 0;
+	cachedLods = nullptr;
+	cachedLodCount = 0;
+	cachedMeshlets = nullptr;
+	cachedMeshletCount = 0;
+	cachedSubmeshes = nullptr;
+	cachedSubmeshCount = 0;
+	cachedMaterials = nullptr;
+	cachedMaterialCount = 0;
+}
+
+
+std::vector<MeshLod> MeshCache::lods() const {
+	return std::vector<MeshLod>(cachedLods, cachedLods + cachedLodCount);
+}
+
+
+std::vector<Meshlet> MeshCache::meshlets() const {
+	return std::vector<Meshlet>(cachedMeshlets, cachedMeshlets + cachedMeshletCount);
+}
+
+
+std::vector<Submesh> MeshCache::submeshes() const {
+	return std::vector<Submesh>(cachedSubmeshes, cachedSubmeshes + cachedSubmeshCount);
+}
+
+
+std::vector<Material> MeshCache::materials() const {
+	return std::vector<Material>(cachedMaterials, cachedMaterials + cachedMaterialCount);
+}
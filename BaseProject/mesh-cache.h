@@ -0,0 +1,84 @@
+#pragma once
+
+#include "mesh.h"
+#include "mesh-loader.h"
+#include "mapped-file.h"
+
+#include <filesystem>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+/**
+ * Binary cache of an imported mesh, stored next to the source file as
+ * "<source>.meshcache". A cache entry is only valid for the exact content of
+ * the source file and of the material libraries it names, and for the loader
+ * options it was built with.
+ *
+ * When valid, the cache is memory-mapped and vertices()/indexData() point
+ * directly into the mapping, so they can be handed to queue.writeBuffer
+ * without any copy. Indices are stored 16-bit whenever the vertex count
+ * allows it, see fitsUint16Indices(). The tables of levels of detail, of
+ * meshlets, of submeshes and of materials, if any, follow the indices.
+ */
+class MeshCache {
+public:
+	// Bump whenever the layout of the file or of VertexAttributes changes, or
+	// the loader turns the same source into different data
+	static constexpr uint32_t Version = 7;
+
+	// Return true if a valid cache exists for this source and these options.
+	// Even when it returns false, the key is remembered for store().
+	bool open(const fs::path& sourcePath, const MeshLoaderOptions& options);
+
+	// Write the cache for the source given to the last call to open()
+	bool store(const Mesh& mesh) const;
+
+	// Release the mapping, vertices() and indexData() become invalid
+	void close();
+
+	const VertexAttributes* vertices() const { return cachedVertices; }
+	size_t vertexCount() const { return cachedVertexCount; }
+
+	// Either uint16_t or uint32_t values, depending on indexStride()
+	const void* indexData() const { return cachedIndices; }
+	size_t indexCount() const { return cachedIndexCount; }
+	uint32_t indexStride() const { return cachedIndexStride; }
+
+	// Levels of detail stored after the indices, empty for a single level
+	std::vector<MeshLod> lods() const;
+
+	// Meshlets of the full mesh, stored after the levels of detail
+	std::vector<Meshlet> meshlets() const;
+
+	// Draw table and the materials it refers to, stored after the meshlets
+	std::vector<Submesh> submeshes() const;
+	std::vector<Material> materials() const;
+
+	static fs::path cachePath(const fs::path& sourcePath);
+
+private:
+	fs::path sourcePath;
+	uint32_t optionsKey = 0;
+	uint64_t sourceHash = 0;
+	uint64_t sourceSize = 0;
+
+	MappedFile file;
+	const VertexAttributes* cachedVertices = nullptr;
+	size_t cachedVertexCount = 0;
+	const void* cachedIndices = nullptr;
+	size_t cachedIndexCount = 0;
+	uint32_t cachedIndexStride = 0;
+	const MeshLod* cachedLods = nullptr;
+	size_t cachedLodCount = 0;
+	const Meshlet* cachedMeshlets = nullptr;
+	size_t cachedMeshletCount = 0;
+	const Submesh* cachedSubmeshes = nullptr;
+	size_t cachedSubmeshCount = 0;
+	const Material* cachedMaterials = nullptr;
+	size_t cachedMaterialCount = 0;
+};
+
+// Fast non-cryptographic 64-bit hash, used to key caches by file content
+uint64_t hashBytes(const uint8_t* data, size_t size);
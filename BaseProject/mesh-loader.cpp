@@ -0,0 +1,237 @@
+#include "mesh-loader.h"
+#include "mesh-optimizer.h"
+#include "obj-parser.h"
+#include "mesh-simplifier.h"
+#include "meshlets.h"
+#include "thread-pool.h"
+
+#define TINYOBJLOADER_IMPLEMENTATION // add this to exactly 1 of your C++ files
+#include "tiny_obj_loader.h"
+
+#include <iostream>
+#include <algorithm>
+#include <map>
+
+uint32_t MeshLoaderOptions::key() const {
+	uint32_t bits = 0;
+	if (swapYZ) bits |= 1u << 0;
+	if (weld) bits |= 1u << 1;
+	if (parallelParse) bits |= 1u << 2;
+	if (optimize) bits |= 1u << 3;
+	bits |= std::min(lodLevels, MaxLodLevels) << 4;
+	if (meshlets) bits |= 1u << 8;
+	return bits;
+}
+
+
+namespace {
+
+// Welded, optimized and simplified mesh of one material, with the figures
+// reported once the whole file is imported
+struct SubmeshStats {
+	size_t cornerCount = 0;
+	uint64_t missesBefore = 0;
+	uint64_t missesAfter = 0;
+};
+
+void processSubmesh(const std::vector<VertexAttributes>& corners, const MeshLoaderOptions& options,
+					Mesh& part, SubmeshStats& stats) {
+	stats.cornerCount += corners.size();
+	if (!options.weld) {
+		part.indices.resize(corners.size());
+		for (size_t i = 0; i < part.indices.size(); ++i) {
+			part.indices[i] = static_cast<uint32_t>(i);
+		}
+		part.vertices = corners;
+		return;
+	}
+
+	weldVertices(corners.data(), corners.size(), part);
+
+	if (options.optimize) {
+		stats.missesBefore += analyzeVertexCache(part.indices, part.vertices.size()).transformedVertices;
+		optimizeMesh(part);
+		stats.missesAfter += analyzeVertexCache(part.indices, part.vertices.size()).transformedVertices;
+	}
+
+	if (options.lodLevels > 1) {
+		buildLods(part, std::min(options.lodLevels, MaxLodLevels), ThreadPool::shared());
+	}
+
+	if (options.meshlets) {
+		size_t fullIndexCount = part.lods.empty() ? part.indices.size() : part.lods[0].indexCount;
+		part.meshlets = buildMeshlets(part.vertices, part.indices.data(), fullIndexCount);
+	}
+}
+
+// Move a submesh into the shared vertex and index buffers of the mesh, and
+// add its entry to the draw table
+void appendSubmesh(Mesh& part, int32_t material, Mesh& mesh) {
+	uint32_t baseVertex = static_cast<uint32_t>(mesh.vertices.size());
+	uint32_t baseIndex = static_cast<uint32_t>(mesh.indices.size());
+
+	Submesh submesh = wholeMesh(part.lods, part.indices.size(), part.meshlets.size());
+	submesh.firstIndex = baseIndex;
+	submesh.firstLod = static_cast<uint32_t>(mesh.lods.size());
+	submesh.firstMeshlet = static_cast<uint32_t>(mesh.meshlets.size());
+	submesh.material = material;
+	mesh.submeshes.push_back(submesh);
+
+	for (uint32_t index : part.indices) {
+		mesh.indices.push_back(baseVertex + index);
+	}
+	for (MeshLod lod : part.lods) {
+		lod.firstIndex += baseIndex;
+		mesh.lods.push_back(lod);
+	}
+	for (Meshlet meshlet : part.meshlets) {
+		meshlet.firstIndex += baseIndex;
+		mesh.meshlets.push_back(meshlet);
+	}
+	mesh.vertices.insert(mesh.vertices.end(), part.vertices.begin(), part.vertices.end());
+}
+
+} // anonymous namespace
+
+
+bool loadGeometryFromObj(const fs::path& path,
+						Mesh& mesh,
+						const MeshLoaderOptions& options)
+{
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+
+	std::string warn;
+	std::string err;
+
+	bool ret = options.parallelParse
+		? loadObjParallel(path, attrib, shapes, materials, warn, err)
+		: tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, path.string().c_str());
+
+	if (!warn.empty()) {
+		std::cout << warn << std::endl;
+	}
+
+	if (!err.empty()) {
+		std::cerr << err << std::endl;
+	}
+
+	if (!ret) {
+		std::cout << "FAIL - loadGeometryFromObj" << std::endl;
+		return false;
+	}
+
+	// Index of the OBJ coordinate that ends up in our y and z. Swapping them
+	// is a reflection, which turns the triangles inside out unless their
+	// corners are reversed too.
+	const int iy = options.swapYZ ? 2 : 1;
+	const int iz = options.swapYZ ? 1 : 2;
+
+	// Triangle corners of every shape, grouped by material. The map keeps
+	// the materials sorted, which is the order of the draw table.
+	std::map<int32_t, std::vector<VertexAttributes>> cornersByMaterial;
+	size_t cornerCount = 0;
+	for (const tinyobj::shape_t& shape : shapes) {
+		const std::vector<tinyobj::index_t>& indices = shape.mesh.indices;
+		for (size_t i = 0; i < indices.size(); ++i) {
+			// Faces are triangulated, the material is per face
+			int32_t material = shape.mesh.material_ids.empty() ? -1 : shape.mesh.material_ids[i / 3];
+			if (material < 0 || static_cast<size_t>(material) >= materials.size()) {
+				material = -1;
+			}
+			size_t corner = options.swapYZ ? i - i % 3 + (3 - i % 3) % 3 : i;
+			const tinyobj::index_t& idx = indices[corner];
+			VertexAttributes vertex;
+
+			vertex.position = {
+				attrib.vertices[3 * idx.vertex_index + 0],
+				attrib.vertices[3 * idx.vertex_index + iy],
+				attrib.vertices[3 * idx.vertex_index + iz]
+			};
+
+			// Corners without a normal get that of their face below
+			vertex.normal = glm::vec3(0.0f);
+			if (idx.normal_index >= 0) {
+				vertex.normal = {
+					attrib.normals[3 * idx.normal_index + 0],
+					attrib.normals[3 * idx.normal_index + iy],
+					attrib.normals[3 * idx.normal_index + iz]
+				};
+			}
+
+			vertex.color = {
+				attrib.colors[3 * idx.vertex_index + 0],
+				attrib.colors[3 * idx.vertex_index + iy],
+				attrib.colors[3 * idx.vertex_index + iz]
+			};
+			std::vector<VertexAttributes>& corners = cornersByMaterial[material];
+			corners.push_back(vertex);
+
+			if (i % 3 == 2) {
+				VertexAttributes* face = &corners[corners.size() - 3];
+				glm::vec3 normal = glm::cross(face[1].position - face[0].position, face[2].position - face[0].position);
+				float length = glm::length(normal);
+				for (size_t k = 0; k < 3; ++k) {
+					size_t source = options.swapYZ ? i - 2 + (3 - k) % 3 : i - 2 + k;
+					if (indices[source].normal_index < 0 && length > 0.0f) {
+						face[k].normal = normal / length;
+					}
+				}
+			}
+		}
+		cornerCount += indices.size();
+	}
+
+	std::cout << "Mesh indices " << cornerCount << " in " << shapes.size() << " shapes, "
+		<< cornersByMaterial.size() << " materials used" << std::endl;
+
+	for (const tinyobj::material_t& material : materials) {
+		mesh.materials.push_back({ glm::vec4(material.diffuse[0], material.diffuse[1], material.diffuse[2], material.dissolve) });
+	}
+
+	// Every material is welded, optimized and simplified on its own, so that
+	// each submesh is a contiguous part of the index buffer
+	SubmeshStats stats;
+	for (auto& entry : cornersByMaterial) {
+		Mesh part;
+		processSubmesh(entry.second, options, part, stats);
+		std::vector<VertexAttributes>().swap(entry.second);
+		appendSubmesh(part, entry.first, mesh);
+	}
+
+	if (options.weld) {
+		size_t indexSize = fitsUint16Indices(mesh.vertices.size()) ? sizeof(uint16_t) : sizeof(uint32_t);
+		size_t bytesBefore = stats.cornerCount * sizeof(VertexAttributes);
+		size_t bytesAfter = mesh.vertices.size() * sizeof(VertexAttributes) + mesh.indices.size() * indexSize;
+		std::cout << "Welded " << stats.cornerCount << " -> " << mesh.vertices.size() << " vertices, "
+			<< bytesBefore / 1024 << " KB -> " << bytesAfter / 1024 << " KB (with "
+			<< 8 * indexSize << "-bit indices)" << std::endl;
+
+		if (options.optimize) {
+			double triangleCount = static_cast<double>(std::max<size_t>(stats.cornerCount / 3, 1));
+			double vertexCount = static_cast<double>(std::max<size_t>(mesh.vertices.size(), 1));
+			std::cout << "Optimized for a " << VertexCacheSize << "-entry FIFO cache: ACMR "
+				<< stats.missesBefore / triangleCount << " -> " << stats.missesAfter / triangleCount
+				<< ", ATVR " << stats.missesBefore / vertexCount << " -> " << stats.missesAfter / vertexCount << std::endl;
+		}
+
+		if (options.lodLevels > 1 && mesh.submeshes.size() == 1 && !mesh.lods.empty()) {
+			std::cout << "Levels of detail:";
+			for (const MeshLod& lod : mesh.lods) {
+				std::cout << " " << lod.indexCount / 3;
+			}
+			std::cout << " triangles, largest error " << mesh.lods.back().error << std::endl;
+		}
+		else if (options.lodLevels > 1) {
+			std::cout << "Levels of detail: " << mesh.lods.size() << " in " << mesh.submeshes.size() << " submeshes" << std::endl;
+		}
+
+		if (options.meshlets) {
+			std::cout << "Meshlets: " << mesh.meshlets.size() << " of up to " << MaxMeshletVertices << " vertices and "
+				<< MaxMeshletTriangles << " triangles" << std::endl;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <filesystem>
+#include <vector>
+#include <cstdint>
+
+namespace fs = std::filesystem;
+
+// Options that affect the vertex data produced from an OBJ file. They are
+// part of the mesh cache key, so any new option must be reflected in key().
+struct MeshLoaderOptions {
+	// OBJ files are Y-up while our scene is Z-up
+	bool swapYZ = true;
+	// Merge identical vertices and index them, rather than emitting one
+	// vertex per face corner
+	bool weld = true;
+	// Parse with loadObjParallel() rather than tinyobj::LoadObj
+	bool parallelParse = true;
+	// Reorder the welded mesh for the vertex caches and overdraw, see
+	// optimizeMesh()
+	bool optimize = true;
+	// Levels of detail to build from the welded mesh, the full mesh included
+	// (see buildLods()); 1 disables simplification
+	uint32_t lodLevels = 6;
+	// Split the welded full mesh into meshlets for cluster culling, see
+	// buildMeshlets()
+	bool meshlets = true;
+
+	uint32_t key() const;
+};
+
+bool loadGeometryFromObj(const fs::path& path,
+						Mesh& mesh,
+						const MeshLoaderOptions& options = {});
@@ -0,0 +1,457 @@
+#include "mesh-optimizer.h"
+
+#include <cstring>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace {
+
+// Bit pattern of a float, with -0 folded onto +0 so that they weld together
+uint32_t floatBits(float value) {
+	if (value == 0.0f) return 0;
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+uint64_t hashVertex(const VertexAttributes& v) {
+	const float* components = &v.position.x;
+	uint64_t h = 0xcbf29ce484222325ull;
+	for (int i = 0; i < 9; ++i) {
+		h = (h ^ floatBits(components[i])) * 0x100000001b3ull;
+	}
+	return h ^ (h >> 29);
+}
+
+bool sameVertex(const VertexAttributes& a, const VertexAttributes& b) {
+	const float* ca = &a.position.x;
+	const float* cb = &b.position.x;
+	for (int i = 0; i < 9; ++i) {
+		if (floatBits(ca[i]) != floatBits(cb[i])) return false;
+	}
+	return true;
+}
+
+// FIFO post-transform cache, simulated with one timestamp per vertex: a
+// vertex is in the cache if fewer than cacheSize misses happened since its
+// own miss
+class FifoCache {
+public:
+	FifoCache(size_t vertexCount, uint32_t cacheSize)
+		: cacheTime(vertexCount, 0)
+		, cacheSize(cacheSize)
+		, time(cacheSize + 1)
+	{}
+
+	// Whether the vertex must be transformed, in which case it enters the cache
+	bool miss(uint32_t vertex) {
+		if (time - cacheTime[vertex] > cacheSize) {
+			cacheTime[vertex] = time++;
+			return true;
+		}
+		return false;
+	}
+
+	// Number of misses since the vertex entered the cache
+	uint32_t age(uint32_t vertex) const { return time - cacheTime[vertex]; }
+
+	void reset() { time += cacheSize + 1; }
+
+private:
+	std::vector<uint32_t> cacheTime;
+	uint32_t cacheSize;
+	uint32_t time;
+};
+
+// Area-weighted normal of a triangle, turned to the side its vertex normals
+// point to so that the result does not depend on the winding
+glm::vec3 facingNormal(const VertexAttributes& a, const VertexAttributes& b, const VertexAttributes& c) {
+	glm::vec3 normal = glm::cross(b.position - a.position, c.position - a.position);
+	return glm::dot(normal, a.normal + b.normal + c.normal) < 0.0f ? -normal : normal;
+}
+
+} // anonymous namespace
+
+
+void weldVertices(const VertexAttributes* vertices, size_t vertexCount, Mesh& mesh) {
+	static_assert(sizeof(VertexAttributes) == 9 * sizeof(float), "weldVertices expects 9 packed floats");
+
+	mesh.vertices.clear();
+	mesh.indices.resize(vertexCount);
+
+	// Open addressing hash table of indices into mesh.vertices, kept at most
+	// half full so that probe sequences stay short.
+	const uint32_t empty = ~0u;
+	size_t capacity = 16;
+	while (capacity < 2 * vertexCount) capacity *= 2;
+	std::vector<uint32_t> table(capacity, empty);
+	const size_t mask = capacity - 1;
+
+	for (size_t i = 0; i < vertexCount; ++i) {
+		const VertexAttributes& v = vertices[i];
+		size_t slot = static_cast<size_t>(hashVertex(v)) & mask;
+		while (table[slot] != empty && !sameVertex(mesh.vertices[table[slot]], v)) {
+			slot = (slot + 1) & mask;
+		}
+		if (table[slot] == empty) {
+			table[slot] = static_cast<uint32_t>(mesh.vertices.size());
+			mesh.vertices.push_back(v);
+		}
+		mesh.indices[i] = table[slot];
+	}
+
+	mesh.vertices.shrink_to_fit();
+}
+
+
+std::vector<uint16_t> narrowIndices(const std::vector<uint32_t>& indices) {
+	std::vector<uint16_t> narrow(indices.size());
+	for (size_t i = 0; i < indices.size(); ++i) {
+		narrow[i] = static_cast<uint16_t>(indices[i]);
+	}
+	return narrow;
+}
+
+
+std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize) {
+	std::vector<uint32_t> clusters;
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0) {
+		return clusters;
+	}
+
+	// Triangles around every vertex, in compressed rows, and how many of
+	// them are not emitted yet
+	std::vector<uint32_t> liveCount(vertexCount, 0);
+	for (uint32_t index : indices) {
+		++liveCount[index];
+	}
+	std::vector<uint32_t> adjacencyStart(vertexCount + 1, 0);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		adjacencyStart[v + 1] = adjacencyStart[v] + liveCount[v];
+	}
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; ++i) {
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	FifoCache cache(vertexCount, cacheSize);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnds;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+	size_t cursor = 0;
+	clusters.push_back(0);
+
+	int64_t fanning = 0;
+	while (fanning >= 0) {
+		// Emit every remaining triangle around the fanning vertex
+		candidates.clear();
+		uint32_t f = static_cast<uint32_t>(fanning);
+		for (uint32_t a = adjacencyStart[f]; a < adjacencyStart[f + 1]; ++a) {
+			uint32_t triangle = adjacency[a];
+			if (emitted[triangle]) continue;
+			emitted[triangle] = true;
+			for (int corner = 0; corner < 3; ++corner) {
+				uint32_t v = indices[3 * triangle + corner];
+				output.push_back(v);
+				deadEnds.push_back(v);
+				candidates.push_back(v);
+				--liveCount[v];
+				cache.miss(v);
+			}
+		}
+
+		// Fan around the vertex that would leave the cache first, as long as
+		// its remaining triangles fit before it does
+		fanning = -1;
+		int64_t bestPriority = -1;
+		for (uint32_t v : candidates) {
+			if (liveCount[v] == 0) continue;
+			int64_t priority = 0;
+			if (cache.age(v) + 2 * liveCount[v] <= cacheSize) {
+				priority = cache.age(v);
+			}
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				fanning = v;
+			}
+		}
+		if (fanning >= 0) continue;
+
+		// Dead end: restart from a recent vertex, or from any vertex left
+		while (!deadEnds.empty() && fanning < 0) {
+			uint32_t v = deadEnds.back();
+			deadEnds.pop_back();
+			if (liveCount[v] > 0) fanning = v;
+		}
+		while (cursor < vertexCount && fanning < 0) {
+			if (liveCount[cursor] > 0) fanning = static_cast<int64_t>(cursor);
+			else ++cursor;
+		}
+		uint32_t emittedTriangles = static_cast<uint32_t>(output.size() / 3);
+		if (fanning >= 0 && emittedTriangles > clusters.back()) {
+			clusters.push_back(emittedTriangles);
+		}
+	}
+
+	indices.swap(output);
+	return clusters;
+}
+
+
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<VertexAttributes>& vertices,
+					const std::vector<uint32_t>& clusters, float threshold, uint32_t cacheSize) {
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0 || clusters.empty()) {
+		return;
+	}
+
+	// Split every cluster where the triangles drawn since its start already
+	// reuse the cache about as well as the whole cluster does. Smaller
+	// clusters give the sort more freedom.
+	FifoCache cache(vertices.size(), cacheSize);
+	std::vector<uint32_t> starts;
+	for (size_t c = 0; c < clusters.size(); ++c) {
+		uint32_t start = clusters[c];
+		uint32_t end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+		cache.reset();
+		uint32_t clusterMisses = 0;
+		for (uint32_t i = 3 * start; i < 3 * end; ++i) {
+			clusterMisses += cache.miss(indices[i]) ? 1 : 0;
+		}
+		float acmrThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+		cache.reset();
+		starts.push_back(start);
+		uint32_t runStart = start;
+		uint32_t runMisses = 0;
+		for (uint32_t t = start; t < end; ++t) {
+			for (int corner = 0; corner < 3; ++corner) {
+				runMisses += cache.miss(indices[3 * t + corner]) ? 1 : 0;
+			}
+			if (t + 1 < end && static_cast<float>(runMisses) <= acmrThreshold * static_cast<float>(t + 1 - runStart)) {
+				starts.push_back(t + 1);
+				runStart = t + 1;
+				runMisses = 0;
+				cache.reset();
+			}
+		}
+	}
+
+	// Area-weighted centroid and normal of the clusters and of the mesh
+	struct Cluster {
+		uint32_t start;
+		uint32_t end;
+		glm::vec3 centroid;
+		glm::vec3 normal;
+		float outwardness;
+	};
+	std::vector<Cluster> sorted(starts.size());
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+	for (size_t i = 0; i < starts.size(); ++i) {
+		Cluster& cluster = sorted[i];
+		cluster.start = starts[i];
+		cluster.end = i + 1 < starts.size() ? starts[i + 1] : triangleCount;
+		cluster.centroid = glm::vec3(0.0f);
+		cluster.normal = glm::vec3(0.0f);
+		float area = 0.0f;
+		for (uint32_t t = cluster.start; t < cluster.end; ++t) {
+			const VertexAttributes& a = vertices[indices[3 * t + 0]];
+			const VertexAttributes& b = vertices[indices[3 * t + 1]];
+			const VertexAttributes& c = vertices[indices[3 * t + 2]];
+			glm::vec3 normal = facingNormal(a, b, c);
+			float triangleArea = glm::length(normal);
+			cluster.centroid += (a.position + b.position + c.position) * (triangleArea / 3.0f);
+			cluster.normal += normal;
+			area += triangleArea;
+		}
+		meshCentroid += cluster.centroid;
+		meshArea += area;
+		if (area > 0.0f) {
+			cluster.centroid /= area;
+		}
+	}
+	if (meshArea > 0.0f) {
+		meshCentroid /= meshArea;
+	}
+
+	// Clusters on the outside of the mesh, facing away from its center,
+	// occlude the others from most points of view: draw them first
+	for (Cluster& cluster : sorted) {
+		float length = glm::length(cluster.normal);
+		cluster.outwardness = length > 0.0f
+			? glm::dot(cluster.centroid - meshCentroid, cluster.normal / length)
+			: -std::numeric_limits<float>::max();
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) {
+		return a.outwardness > b.outwardness;
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	for (const Cluster& cluster : sorted) {
+		output.insert(output.end(), indices.begin() + 3 * cluster.start, indices.begin() + 3 * cluster.end);
+	}
+	indices.swap(output);
+}
+
+
+void optimizeVertexFetch(Mesh& mesh) {
+	const uint32_t unused = ~0u;
+	std::vector<uint32_t> remap(mesh.vertices.size(), unused);
+	std::vector<VertexAttributes> vertices;
+	vertices.reserve(mesh.vertices.size());
+	for (uint32_t& index : mesh.indices) {
+		if (remap[index] == unused) {
+			remap[index] = static_cast<uint32_t>(vertices.size());
+			vertices.push_back(mesh.vertices[index]);
+		}
+		index = remap[index];
+	}
+	mesh.vertices.swap(vertices);
+}
+
+
+void optimizeMesh(Mesh& mesh) {
+	// Meshes exported in strips or grids may already use the cache better
+	// than Tipsify does, and the overdraw sort gives some of it back: keep
+	// each reordering only if the cache misses go down
+	std::vector<uint32_t> original = mesh.indices;
+	uint64_t originalMisses = analyzeVertexCache(original, mesh.vertices.size()).transformedVertices;
+	std::vector<uint32_t> clusters = optimizeVertexCache(mesh.indices, mesh.vertices.size());
+	std::vector<uint32_t> cacheOrder = mesh.indices;
+	uint64_t cacheMisses = analyzeVertexCache(cacheOrder, mesh.vertices.size()).transformedVertices;
+	optimizeOverdraw(mesh.indices, mesh.vertices, clusters);
+	if (analyzeVertexCache(mesh.indices, mesh.vertices.size()).transformedVertices >= originalMisses) {
+		mesh.indices.swap(cacheMisses < originalMisses ? cacheOrder : original);
+	}
+	optimizeVertexFetch(mesh);
+}
+
+
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+									uint32_t cacheSize, CacheModel model) {
+	VertexCacheStats stats = {};
+	std::vector<bool> referenced(vertexCount, false);
+	size_t referencedCount = 0;
+	for (uint32_t index : indices) {
+		if (!referenced[index]) {
+			referenced[index] = true;
+			++referencedCount;
+		}
+	}
+
+	if (model == CacheModel::Fifo) {
+		FifoCache cache(vertexCount, cacheSize);
+		for (uint32_t index : indices) {
+			stats.transformedVertices += cache.miss(index) ? 1 : 0;
+		}
+	}
+	else {
+		// Most recently used first
+		std::vector<uint32_t> cache;
+		cache.reserve(cacheSize + 1);
+		for (uint32_t index : indices) {
+			auto it = std::find(cache.begin(), cache.end(), index);
+			if (it == cache.end()) {
+				++stats.transformedVertices;
+				if (cache.size() == cacheSize) cache.pop_back();
+			}
+			else {
+				cache.erase(it);
+			}
+			cache.insert(cache.begin(), index);
+		}
+	}
+
+	size_t triangleCount = indices.size() / 3;
+	stats.acmr = triangleCount > 0 ? static_cast<double>(stats.transformedVertices) / triangleCount : 0.0;
+	stats.atvr = referencedCount > 0 ? static_cast<double>(stats.transformedVertices) / referencedCount : 0.0;
+	return stats;
+}
+
+
+OverdrawStats analyzeOverdraw(const std::vector<uint32_t>& indices, const std::vector<VertexAttributes>& vertices,
+							uint32_t resolution) {
+	OverdrawStats stats = {};
+	if (vertices.empty() || indices.size() < 3 || resolution == 0) {
+		return stats;
+	}
+
+	glm::vec3 boundsMin = vertices[0].position;
+	glm::vec3 boundsMax = vertices[0].position;
+	for (const VertexAttributes& vertex : vertices) {
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
+	}
+	float extent = std::max({ boundsMax.x - boundsMin.x, boundsMax.y - boundsMin.y, boundsMax.z - boundsMin.z });
+	float toPixels = extent > 0.0f ? static_cast<float>(resolution) / extent : 0.0f;
+
+	std::vector<float> depth(size_t(resolution) * resolution);
+	std::vector<glm::vec3> projected(vertices.size());
+	for (int axis = 0; axis < 3; ++axis) {
+		for (float direction : { 1.0f, -1.0f }) {
+			// Screen x and y are the two other axes, depth grows along direction
+			int axisU = (axis + 1) % 3;
+			int axisV = (axis + 2) % 3;
+			for (size_t i = 0; i < vertices.size(); ++i) {
+				glm::vec3 p = vertices[i].position - boundsMin;
+				projected[i] = glm::vec3(p[axisU] * toPixels, p[axisV] * toPixels, direction * p[axis]);
+			}
+			std::fill(depth.begin(), depth.end(), std::numeric_limits<float>::infinity());
+
+			for (size_t t = 0; t + 2 < indices.size(); t += 3) {
+				const glm::vec3& a = projected[indices[t + 0]];
+				const glm::vec3& b = projected[indices[t + 1]];
+				const glm::vec3& c = projected[indices[t + 2]];
+				float area = (b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x);
+				if (area == 0.0f) continue;
+
+				// Cull the triangles whose normal points away from the viewer
+				glm::vec3 normal = facingNormal(vertices[indices[t + 0]], vertices[indices[t + 1]], vertices[indices[t + 2]]);
+				if (direction * normal[axis] >= 0.0f) continue;
+
+				int x0 = std::max(0, static_cast<int>(std::floor(std::min({ a.x, b.x, c.x }))));
+				int x1 = std::min(static_cast<int>(resolution) - 1, static_cast<int>(std::ceil(std::max({ a.x, b.x, c.x }))));
+				int y0 = std::max(0, static_cast<int>(std::floor(std::min({ a.y, b.y, c.y }))));
+				int y1 = std::min(static_cast<int>(resolution) - 1, static_cast<int>(std::ceil(std::max({ a.y, b.y, c.y }))));
+				for (int y = y0; y <= y1; ++y) {
+					for (int x = x0; x <= x1; ++x) {
+						float px = static_cast<float>(x) + 0.5f;
+						float py = static_cast<float>(y) + 0.5f;
+						// Barycentric weights, of the sign of area inside the triangle
+						float ua = (c.x - b.x) * (py - b.y) - (c.y - b.y) * (px - b.x);
+						float ub = (a.x - c.x) * (py - c.y) - (a.y - c.y) * (px - c.x);
+						float uc = (b.x - a.x) * (py - a.y) - (b.y - a.y) * (px - a.x);
+						if (area < 0.0f) {
+							ua = -ua;
+							ub = -ub;
+							uc = -uc;
+						}
+						if (ua < 0.0f || ub < 0.0f || uc < 0.0f) continue;
+
+						float z = (ua * a.z + ub * b.z + uc * c.z) / std::abs(area);
+						float& stored = depth[size_t(y) * resolution + x];
+						if (z < stored) {
+							stored = z;
+							++stats.pixelsShaded;
+						}
+					}
+				}
+			}
+
+			for (float z : depth) {
+				if (z != std::numeric_limits<float>::infinity()) ++stats.pixelsCovered;
+			}
+		}
+	}
+
+	stats.overdraw = stats.pixelsCovered > 0 ? static_cast<double>(stats.pixelsShaded) / stats.pixelsCovered : 0.0;
+	return stats;
+}
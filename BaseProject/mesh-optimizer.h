@@ -0,0 +1,83 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Merge the vertices of a non-indexed triangle list that share the same
+ * position, normal and color, and build the matching index buffer. Unique
+ * vertices keep their order of first appearance.
+ */
+void weldVertices(const VertexAttributes* vertices, size_t vertexCount, Mesh& mesh);
+
+// Copy 32-bit indices into 16-bit ones, only valid if fitsUint16Indices()
+std::vector<uint16_t> narrowIndices(const std::vector<uint32_t>& indices);
+
+
+/**
+ * Index and vertex reordering for the GPU caches, in the order they are
+ * meant to run (optimizeMesh() runs all three):
+ *  1. optimizeVertexCache() reorders triangles for post-transform cache
+ *     reuse (Tipsify, Sander et al. 2007), and returns the boundaries of the
+ *     clusters it produced,
+ *  2. optimizeOverdraw() reorders these clusters so that those facing out
+ *     of the mesh are drawn first, which lets the depth test reject more
+ *     of the fragments behind them,
+ *  3. optimizeVertexFetch() renumbers vertices in order of first use, for
+ *     pre-transform cache and memory locality.
+ */
+
+// Size of the post-transform cache the triangles are ordered for
+const uint32_t VertexCacheSize = 16;
+
+// Returns the index of the first triangle of every cluster, starting with 0.
+// Clusters end where Tipsify had to jump to a vertex outside of the cache.
+std::vector<uint32_t> optimizeVertexCache(std::vector<uint32_t>& indices, size_t vertexCount,
+										uint32_t cacheSize = VertexCacheSize);
+
+// Split the clusters further wherever the cache efficiency allows it (the
+// running ACMR of a cluster is within threshold of that of the whole
+// cluster), then sort them by how much they face out of the mesh. Facing
+// follows the vertex normals rather than the winding.
+void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<VertexAttributes>& vertices,
+					const std::vector<uint32_t>& clusters, float threshold = 1.05f,
+					uint32_t cacheSize = VertexCacheSize);
+
+// Renumber vertices in order of first use; unused vertices are dropped
+void optimizeVertexFetch(Mesh& mesh);
+
+// Run the three stages, but keep the triangle order of the input, or that of
+// optimizeVertexCache(), when the next stage does not miss the cache less
+// often than it
+void optimizeMesh(Mesh& mesh);
+
+
+enum class CacheModel {
+	Fifo, // most GPUs
+	Lru,
+};
+
+struct VertexCacheStats {
+	uint64_t transformedVertices; // cache misses
+	double acmr;                  // misses per triangle, 0.5 at best on large grids, 3 at worst
+	double atvr;                  // misses per referenced vertex, 1 at best
+};
+
+// Simulate a post-transform cache of cacheSize entries over the index buffer
+VertexCacheStats analyzeVertexCache(const std::vector<uint32_t>& indices, size_t vertexCount,
+									uint32_t cacheSize = VertexCacheSize, CacheModel model = CacheModel::Fifo);
+
+struct OverdrawStats {
+	uint64_t pixelsCovered;
+	uint64_t pixelsShaded; // fragments that passed the depth test
+	double overdraw;       // shaded / covered, 1 at best
+};
+
+// Rasterize the mesh in index order from the 6 axis-aligned directions,
+// culling the faces whose vertex normals point away, and count the
+// fragments that pass the depth test
+OverdrawStats analyzeOverdraw(const std::vector<uint32_t>& indices, const std::vector<VertexAttributes>& vertices,
+							uint32_t resolution = 256);
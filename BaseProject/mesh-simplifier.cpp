@@ -0,0 +1,370 @@
+#include "mesh-simplifier.h"
+#include "mesh-optimizer.h"
+#include "thread-pool.h"
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+namespace {
+
+// Sum of squared distances to a set of planes, as a symmetric 4x4 matrix
+// (upper triangle, row by row) and the total weight of the planes
+struct Quadric {
+	double a00, a01, a02, a03;
+	double a11, a12, a13;
+	double a22, a23;
+	double a33;
+	double weight;
+
+	static Quadric fromPlane(const glm::dvec3& n, double d, double w) {
+		return {
+			w * n.x * n.x, w * n.x * n.y, w * n.x * n.z, w * n.x * d,
+			w * n.y * n.y, w * n.y * n.z, w * n.y * d,
+			w * n.z * n.z, w * n.z * d,
+			w * d * d,
+			w
+		};
+	}
+
+	Quadric& operator+=(const Quadric& q) {
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+		a11 += q.a11; a12 += q.a12; a13 += q.a13;
+		a22 += q.a22; a23 += q.a23;
+		a33 += q.a33;
+		weight += q.weight;
+		return *this;
+	}
+
+	// Mean squared distance from p to the planes
+	double error(const glm::dvec3& p) const {
+		if (weight <= 0.0) return 0.0;
+		double e =
+			a00 * p.x * p.x + a11 * p.y * p.y + a22 * p.z * p.z
+			+ 2.0 * (a01 * p.x * p.y + a02 * p.x * p.z + a12 * p.y * p.z)
+			+ 2.0 * (a03 * p.x + a13 * p.y + a23 * p.z)
+			+ a33;
+		return std::max(e, 0.0) / weight;
+	}
+};
+
+struct Collapse {
+	uint32_t from;
+	uint32_t to;
+	double cost;
+};
+
+struct PositionHash {
+	size_t operator()(const glm::vec3& p) const {
+		uint32_t bits[3];
+		std::memcpy(bits, &p.x, sizeof(bits));
+		return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+	}
+};
+
+struct PositionEqual {
+	bool operator()(const glm::vec3& a, const glm::vec3& b) const {
+		return a.x == b.x && a.y == b.y && a.z == b.z;
+	}
+};
+
+} // anonymous namespace
+
+
+std::vector<uint32_t> simplifyMesh(const std::vector<VertexAttributes>& vertices,
+								const uint32_t* sourceIndices, size_t indexCount,
+								size_t targetIndexCount, float maxError,
+								float* resultError, const SimplifyOptions& options) {
+	std::vector<uint32_t> indices(sourceIndices, sourceIndices + indexCount);
+	if (resultError) *resultError = 0.0f;
+	size_t vertexCount = vertices.size();
+	if (indices.size() <= targetIndexCount || vertexCount == 0) {
+		return indices;
+	}
+
+	// Work in a unit-sized box, so that errors and attribute weights do not
+	// depend on the scale of the mesh
+	glm::vec3 boundsMin = vertices[0].position;
+	glm::vec3 boundsMax = vertices[0].position;
+	for (const VertexAttributes& vertex : vertices) {
+		boundsMin = glm::min(boundsMin, vertex.position);
+		boundsMax = glm::max(boundsMax, vertex.position);
+	}
+	glm::vec3 extent = boundsMax - boundsMin;
+	double meshSize = std::max({ extent.x, extent.y, extent.z, 1e-20f });
+	std::vector<glm::dvec3> positions(vertexCount);
+	for (size_t v = 0; v < vertexCount; ++v) {
+		positions[v] = glm::dvec3(vertices[v].position - boundsMin) / meshSize;
+	}
+
+	// Vertices that share a position are one point of the surface, known by
+	// its first vertex. Edges are counted on these points, so that attribute
+	// seams are not seen as holes, and points collapse with all their
+	// vertices, so that seams do not open.
+	const uint32_t NoVertex = UINT32_MAX;
+	std::vector<uint32_t> point(vertexCount);
+	std::vector<uint32_t> nextAtPoint(vertexCount, NoVertex);
+	{
+		std::unordered_map<glm::vec3, uint32_t, PositionHash, PositionEqual> firstVertex;
+		std::vector<uint32_t> lastAtPoint(vertexCount, NoVertex);
+		firstVertex.reserve(vertexCount);
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			point[v] = firstVertex.emplace(vertices[v].position, v).first->second;
+			if (lastAtPoint[point[v]] != NoVertex) {
+				nextAtPoint[lastAtPoint[point[v]]] = v;
+			}
+			lastAtPoint[point[v]] = v;
+		}
+	}
+
+	// Triangles with two corners at one point have no area to keep
+	{
+		size_t kept = 0;
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			uint32_t a = indices[i], b = indices[i + 1], c = indices[i + 2];
+			if (point[a] == point[b] || point[b] == point[c] || point[c] == point[a]) continue;
+			indices[kept++] = a;
+			indices[kept++] = b;
+			indices[kept++] = c;
+		}
+		indices.resize(kept);
+	}
+
+	// Planes of the triangles around every point, weighted by area
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (size_t i = 0; i < indices.size(); i += 3) {
+		const glm::dvec3& a = positions[indices[i]];
+		const glm::dvec3& b = positions[indices[i + 1]];
+		const glm::dvec3& c = positions[indices[i + 2]];
+		glm::dvec3 normal = glm::cross(b - a, c - a);
+		double length = glm::length(normal);
+		if (length == 0.0) continue;
+		normal /= length;
+		Quadric plane = Quadric::fromPlane(normal, -glm::dot(normal, a), length * 0.5);
+		for (int corner = 0; corner < 3; ++corner) {
+			quadrics[point[indices[i + corner]]] += plane;
+		}
+	}
+
+	auto attributeCost = [&](uint32_t from, uint32_t to) {
+		glm::vec3 dn = vertices[from].normal - vertices[to].normal;
+		glm::vec3 dc = vertices[from].color - vertices[to].color;
+		return static_cast<double>(options.attributeWeight) * (glm::dot(dn, dn) + glm::dot(dc, dc));
+	};
+
+	double maxCost = static_cast<double>(maxError) * maxError;
+	double reachedDistance = 0.0;
+	std::vector<uint32_t> adjacencyStart(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> best(vertexCount);
+	std::vector<Collapse> collapses;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> touched(vertexCount);
+	std::vector<uint32_t> ring;
+
+	auto referenced = [&](uint32_t v) {
+		return adjacencyStart[v + 1] > adjacencyStart[v];
+	};
+	// Points on open borders and on non-manifold edges are locked. Other
+	// points may collapse onto them, which keeps borders in place: the
+	// edges a submesh shares with its neighbours, simplified on their own,
+	// stay the same on both sides.
+	std::vector<bool> locked(vertexCount, false);
+	// Vertex of point to that vertex from becomes when its point collapses
+	// there: the one with the closest attributes, which is the one across
+	// the collapsed edge along a seam
+	auto collapseTarget = [&](uint32_t from, uint32_t to, double& cost) {
+		uint32_t target = to;
+		cost = INFINITY;
+		for (uint32_t w = to; w != NoVertex; w = nextAtPoint[w]) {
+			double wCost = referenced(w) ? attributeCost(from, w) : INFINITY;
+			if (wCost < cost) {
+				cost = wCost;
+				target = w;
+			}
+		}
+		return target;
+	};
+	// Distance to the planes of the point, and the largest attribute change
+	// among its vertices
+	auto collapseCost = [&](uint32_t from, uint32_t to, double bound) {
+		double distance = quadrics[from].error(positions[to]);
+		double attributes = 0.0;
+		for (uint32_t v = from; v != NoVertex && distance + attributes < bound; v = nextAtPoint[v]) {
+			if (referenced(v)) {
+				double vCost = 0.0;
+				collapseTarget(v, to, vCost);
+				attributes = std::max(attributes, vCost);
+			}
+		}
+		return distance + attributes;
+	};
+
+	// Every pass collapses a set of independent edges, cheapest first, then
+	// rebuilds the index buffer
+	while (indices.size() > targetIndexCount) {
+		size_t triangleCount = indices.size() / 3;
+
+		// Triangles around every vertex
+		std::fill(adjacencyStart.begin(), adjacencyStart.end(), 0);
+		for (uint32_t index : indices) ++adjacencyStart[index + 1];
+		for (size_t v = 0; v < vertexCount; ++v) adjacencyStart[v + 1] += adjacencyStart[v];
+		adjacency.resize(indices.size());
+		std::vector<uint32_t> fill(adjacencyStart.begin(), adjacencyStart.end() - 1);
+		for (size_t i = 0; i < indices.size(); ++i) {
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		// Lock the points with an edge used once or more than twice, from
+		// the points around them, each listed once per triangle of the edge
+		for (uint32_t p = 0; p < vertexCount; ++p) {
+			if (point[p] != p || locked[p]) continue;
+			ring.clear();
+			for (uint32_t v = p; v != NoVertex; v = nextAtPoint[v]) {
+				for (uint32_t a = adjacencyStart[v]; a < adjacencyStart[v + 1]; ++a) {
+					const uint32_t* triangle = &indices[3 * adjacency[a]];
+					for (int corner = 0; corner < 3; ++corner) {
+						if (point[triangle[corner]] != p) ring.push_back(point[triangle[corner]]);
+					}
+				}
+			}
+			for (uint32_t neighbour : ring) {
+				auto uses = std::count(ring.begin(), ring.end(), neighbour);
+				locked[p] = locked[p] || uses != 2;
+			}
+		}
+
+		// Cheapest collapse of every free point along one of its edges
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			best[v] = { v, v, 0.0 };
+		}
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			for (int corner = 0; corner < 3; ++corner) {
+				uint32_t a = point[indices[i + corner]];
+				uint32_t b = point[indices[i + (corner + 1) % 3]];
+				for (int direction = 0; direction < 2; ++direction) {
+					uint32_t from = direction == 0 ? a : b;
+					uint32_t to = direction == 0 ? b : a;
+					if (from == to || locked[from]) continue;
+					bool first = best[from].to == from;
+					double cost = collapseCost(from, to, first ? INFINITY : best[from].cost);
+					if (first || cost < best[from].cost) {
+						best[from] = { from, to, cost };
+					}
+				}
+			}
+		}
+		collapses.clear();
+		for (uint32_t v = 0; v < vertexCount; ++v) {
+			if (best[v].to != v && best[v].cost <= maxCost) collapses.push_back(best[v]);
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+			return a.cost < b.cost;
+		});
+
+		// A collapse removes about two triangles, do not overshoot the target
+		size_t targetTriangles = targetIndexCount / 3;
+		size_t collapseBudget = (triangleCount - targetTriangles) / 2 + 1;
+		for (uint32_t v = 0; v < vertexCount; ++v) remap[v] = v;
+		std::fill(touched.begin(), touched.end(), false);
+		size_t collapsed = 0;
+
+		for (const Collapse& collapse : collapses) {
+			if (collapsed >= collapseBudget) break;
+			uint32_t from = collapse.from;
+			uint32_t to = collapse.to;
+			if (touched[from] || touched[to]) continue;
+
+			// Reject collapses that turn a triangle around, or that involve a
+			// neighbourhood already changed during this pass
+			bool rejected = false;
+			for (uint32_t v = from; v != NoVertex && !rejected; v = nextAtPoint[v]) {
+				for (uint32_t a = adjacencyStart[v]; a < adjacencyStart[v + 1] && !rejected; ++a) {
+					const uint32_t* triangle = &indices[3 * adjacency[a]];
+					int corner = triangle[0] == v ? 0 : triangle[1] == v ? 1 : 2;
+					uint32_t next = triangle[(corner + 1) % 3];
+					uint32_t previous = triangle[(corner + 2) % 3];
+					if (touched[point[next]] || touched[point[previous]]) {
+						rejected = true;
+					}
+					else if (point[next] != to && point[previous] != to) {
+						glm::dvec3 before = glm::cross(positions[next] - positions[v], positions[previous] - positions[v]);
+						glm::dvec3 after = glm::cross(positions[next] - positions[to], positions[previous] - positions[to]);
+						rejected = glm::dot(before, after) <= 0.0;
+					}
+				}
+			}
+			if (rejected) continue;
+
+			for (uint32_t v = from; v != NoVertex; v = nextAtPoint[v]) {
+				if (!referenced(v)) continue;
+				double vCost = 0.0;
+				remap[v] = collapseTarget(v, to, vCost);
+				for (uint32_t a = adjacencyStart[v]; a < adjacencyStart[v + 1]; ++a) {
+					const uint32_t* triangle = &indices[3 * adjacency[a]];
+					touched[point[triangle[0]]] = touched[point[triangle[1]]] = touched[point[triangle[2]]] = true;
+				}
+			}
+			reachedDistance = std::max(reachedDistance, quadrics[from].error(positions[to]));
+			quadrics[to] += quadrics[from];
+			++collapsed;
+		}
+		if (collapsed == 0) {
+			break;
+		}
+
+		// Drop the triangles that lost an edge
+		size_t kept = 0;
+		for (size_t i = 0; i < indices.size(); i += 3) {
+			uint32_t a = remap[indices[i]];
+			uint32_t b = remap[indices[i + 1]];
+			uint32_t c = remap[indices[i + 2]];
+			if (point[a] == point[b] || point[b] == point[c] || point[c] == point[a]) continue;
+			indices[kept++] = a;
+			indices[kept++] = b;
+			indices[kept++] = c;
+		}
+		indices.resize(kept);
+	}
+
+	if (resultError) {
+		*resultError = static_cast<float>(std::sqrt(reachedDistance) * meshSize);
+	}
+	return indices;
+}
+
+
+void buildLods(Mesh& mesh, uint32_t levelCount, ThreadPool& pool) {
+	uint32_t fullIndexCount = static_cast<uint32_t>(mesh.indices.size());
+	mesh.lods.assign(1, MeshLod{ 0, fullIndexCount, 0.0f, 0 });
+	if (levelCount <= 1 || fullIndexCount == 0) {
+		return;
+	}
+
+	// Levels are independent of each other, simplify them all at once
+	struct Level {
+		std::vector<uint32_t> indices;
+		float error = 0.0f;
+	};
+	std::vector<Level> levels(std::min(levelCount, MaxLodLevels) - 1);
+	pool.parallelFor(levels.size(), [&](size_t i) {
+		size_t target = static_cast<size_t>(std::ldexp(static_cast<double>(fullIndexCount / 3), -static_cast<int>(i + 1))) * 3;
+		levels[i].indices = simplifyMesh(mesh.vertices, mesh.indices.data(), fullIndexCount, target, 1.0f, &levels[i].error);
+		optimizeVertexCache(levels[i].indices, mesh.vertices.size());
+	});
+
+	float error = 0.0f;
+	for (Level& level : levels) {
+		// Stop when the simplifier could not remove a tenth of the previous level
+		const MeshLod& previous = mesh.lods.back();
+		if (level.indices.empty() || level.indices.size() * 10 > size_t(previous.indexCount) * 9) {
+			break;
+		}
+		error = std::max(error, level.error);
+		mesh.lods.push_back({ static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(level.indices.size()), error, 0 });
+		mesh.indices.insert(mesh.indices.end(), level.indices.begin(), level.indices.end());
+	}
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class ThreadPool;
+
+/**
+ * Mesh simplification by edge collapses ordered by quadric error (Garland and
+ * Heckbert 1997). Every collapse moves a vertex onto one of its neighbours,
+ * so a simplified mesh is only a new index buffer over the same vertices,
+ * which lets all the levels of detail share one vertex buffer.
+ *
+ * Vertices at the same position, on attribute seams like the welded corners
+ * of flat-shaded faces, collapse together, each onto the vertex with the
+ * closest attributes at the other end of the edge, so that seams do not
+ * open. Vertices on open borders and on non-manifold edges are locked, so
+ * that meshes simplified apart still meet along the borders they share.
+ */
+struct SimplifyOptions {
+	// Weight of the squared normal and color differences of a collapse,
+	// relative to the squared distance in units of the mesh size
+	float attributeWeight = 0.01f;
+};
+
+// Collapse edges until at most targetIndexCount indices remain, or until the
+// next collapse would move the surface by more than maxError, relative to
+// the size of the mesh. resultError receives the largest distance reached,
+// in mesh units.
+std::vector<uint32_t> simplifyMesh(const std::vector<VertexAttributes>& vertices,
+								const uint32_t* indices, size_t indexCount,
+								size_t targetIndexCount, float maxError,
+								float* resultError = nullptr,
+								const SimplifyOptions& options = SimplifyOptions());
+
+// Fill mesh.lods with up to levelCount levels, the full mesh first and each
+// next one with about half as many triangles. Levels are simplified from the
+// full mesh in parallel and ordered for the vertex cache. Fewer levels are
+// produced when the simplifier gets stuck (too many locked vertices).
+void buildLods(Mesh& mesh, uint32_t levelCount, ThreadPool& pool);
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+struct VertexAttributes {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec3 color;
+};
+
+// Level of detail: a range of the index buffer that draws a simplified
+// version of the mesh, with the same vertices
+struct MeshLod {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	float error;    // largest distance to the full mesh, in mesh units
+	uint32_t _pad;
+};
+static_assert(sizeof(MeshLod) == 16, "MeshLod is stored as is in mesh caches");
+
+// Most levels of detail a mesh can have
+constexpr uint32_t MaxLodLevels = 15;
+
+// Cluster of neighbouring triangles, a range of the index buffer with its
+// bounding sphere and the cone that bounds the normals of its triangles
+struct Meshlet {
+	glm::vec3 center;
+	float radius;
+	glm::vec3 coneAxis;
+	float coneCutoff;  // sine of the cone half-angle, 1 when there is no cone
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	uint32_t vertexCount;
+	uint32_t _pad;
+};
+static_assert(sizeof(Meshlet) == 48, "Meshlet is stored as is in mesh caches");
+
+// Surface properties of a material, from the diffuse color (Kd) and the
+// dissolve (d) of the .mtl file
+struct Material {
+	glm::vec4 diffuse;
+};
+static_assert(sizeof(Material) == 16, "Material is stored as is in mesh caches");
+
+// Part of a mesh drawn with a single material, one entry of the draw table.
+// Its levels of detail and meshlets are ranges of the tables of the mesh;
+// without levels of detail, firstIndex and indexCount are the only level.
+struct Submesh {
+	uint32_t firstIndex;    // of the full detail triangles
+	uint32_t indexCount;
+	uint32_t firstLod;
+	uint32_t lodCount;
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	int32_t material;       // index in Mesh::materials, -1 for the default material
+	uint32_t _pad;
+};
+static_assert(sizeof(Submesh) == 32, "Submesh is stored as is in mesh caches");
+
+// Indexed triangle list. Indices are always 32-bit on the CPU side, they are
+// narrowed at upload time when the vertex count allows it.
+//
+// When lods is not empty, lods[0] is the full mesh and the next levels are
+// stored after it in indices, each coarser than the previous one. Otherwise
+// all the indices make a single level. Meshlets, if any, split the full
+// mesh (the first level).
+//
+// A mesh imported from several shapes or materials has submeshes, sorted
+// by material: each one owns a contiguous part of indices laid out as above
+// (full detail, then its coarser levels), and its own ranges of lods and
+// meshlets. All of them index the same vertices.
+struct Mesh {
+	std::vector<VertexAttributes> vertices;
+	std::vector<uint32_t> indices;
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+	std::vector<Submesh> submeshes;
+	std::vector<Material> materials;
+};
+
+// The single submesh of a mesh that has no draw table
+inline Submesh wholeMesh(const std::vector<MeshLod>& lods, size_t indexCount, size_t meshletCount) {
+	uint32_t fullIndexCount = lods.empty() ? static_cast<uint32_t>(indexCount) : lods[0].indexCount;
+	return { 0, fullIndexCount, 0, static_cast<uint32_t>(lods.size()), 0, static_cast<uint32_t>(meshletCount), -1, 0 };
+}
+
+// Whether a mesh with this many vertices can use 16-bit indices
+inline bool fitsUint16Indices(size_t vertexCount) {
+	return vertexCount <= 0xFFFF;
+}
@@ -0,0 +1,233 @@
+#include "meshlets.h"
+#include "scene-bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Bounding sphere and normal cone of the triangles [first, first + count)
+void computeBounds(Meshlet& meshlet, const std::vector<VertexAttributes>& vertices,
+				const uint32_t* indices, size_t first, size_t count)
+{
+	glm::vec3 lower(INFINITY);
+	glm::vec3 upper(-INFINITY);
+	for (size_t i = first; i < first + count; ++i) {
+		lower = glm::min(lower, vertices[indices[i]].position);
+		upper = glm::max(upper, vertices[indices[i]].position);
+	}
+	meshlet.center = (lower + upper) * 0.5f;
+	float radius = 0.0f;
+	for (size_t i = first; i < first + count; ++i) {
+		glm::vec3 d = vertices[indices[i]].position - meshlet.center;
+		radius = std::max(radius, glm::dot(d, d));
+	}
+	meshlet.radius = std::sqrt(radius);
+
+	// Geometric normals, the vertex normals may be smoothed across edges
+	std::vector<glm::vec3> normals;
+	normals.reserve(count / 3);
+	glm::vec3 sum(0.0f);
+	for (size_t i = first; i + 2 < first + count; i += 3) {
+		const glm::vec3& a = vertices[indices[i]].position;
+		const glm::vec3& b = vertices[indices[i + 1]].position;
+		const glm::vec3& c = vertices[indices[i + 2]].position;
+		glm::vec3 n = glm::cross(b - a, c - a);
+		float length = glm::length(n);
+		if (length > 0.0f) {
+			normals.push_back(n / length);
+			sum += normals.back();
+		}
+	}
+
+	// No cone when the normals spread over a half-space or more
+	meshlet.coneAxis = glm::vec3(0.0f, 0.0f, 1.0f);
+	meshlet.coneCutoff = 1.0f;
+	float sumLength = glm::length(sum);
+	if (normals.empty() || sumLength == 0.0f) {
+		return;
+	}
+	glm::vec3 axis = sum / sumLength;
+	float minDot = 1.0f;
+	for (const glm::vec3& n : normals) {
+		minDot = std::min(minDot, glm::dot(n, axis));
+	}
+	if (minDot <= 0.0f) {
+		return;
+	}
+	meshlet.coneAxis = axis;
+	meshlet.coneCutoff = std::sqrt(1.0f - minDot * minDot);
+}
+
+} // anonymous namespace
+
+
+std::vector<Meshlet> buildMeshlets(const std::vector<VertexAttributes>& vertices,
+								const uint32_t* indices, size_t indexCount,
+								uint32_t maxVertices, uint32_t maxTriangles)
+{
+	std::vector<Meshlet> meshlets;
+	// Meshlet that last used each vertex, offset by one
+	std::vector<uint32_t> lastUse(vertices.size(), 0);
+
+	Meshlet current = {};
+	auto finish = [&]() {
+		if (current.indexCount > 0) {
+			computeBounds(current, vertices, indices, current.firstIndex, current.indexCount);
+			meshlets.push_back(current);
+		}
+		current = {};
+	};
+
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		uint32_t stamp = static_cast<uint32_t>(meshlets.size()) + 1;
+		// A vertex repeated within the triangle is only new once
+		const uint32_t* triangle = indices + i;
+		uint32_t newVertices = 0;
+		newVertices += lastUse[triangle[0]] != stamp ? 1 : 0;
+		newVertices += lastUse[triangle[1]] != stamp && triangle[1] != triangle[0] ? 1 : 0;
+		newVertices += lastUse[triangle[2]] != stamp && triangle[2] != triangle[0] && triangle[2] != triangle[1] ? 1 : 0;
+		if (current.indexCount > 0 && (current.vertexCount + newVertices > maxVertices || current.indexCount / 3 >= maxTriangles)) {
+			finish();
+			stamp = static_cast<uint32_t>(meshlets.size()) + 1;
+		}
+		if (current.indexCount == 0) {
+			current.firstIndex = static_cast<uint32_t>(i);
+		}
+		for (size_t k = 0; k < 3; ++k) {
+			uint32_t& use = lastUse[indices[i + k]];
+			if (use != stamp) {
+				use = stamp;
+				++current.vertexCount;
+			}
+		}
+		current.indexCount += 3;
+	}
+	finish();
+	return meshlets;
+}
+
+
+MeshletCuller::MeshletCuller(const std::vector<Meshlet>& meshlets)
+{
+	size_t count = meshlets.size();
+	for (std::vector<float>* column : { &centerX, &centerY, &centerZ, &radius, &axisX, &axisY, &axisZ, &cutoff }) {
+		column->resize(count);
+	}
+	firstIndex.resize(count);
+	indexCount.resize(count);
+	runStart.resize(count);
+	visible.assign(count, 0);
+	ranges.reserve(count);
+	for (size_t i = 0; i < count; ++i) {
+		const Meshlet& meshlet = meshlets[i];
+		centerX[i] = meshlet.center.x;
+		centerY[i] = meshlet.center.y;
+		centerZ[i] = meshlet.center.z;
+		radius[i] = meshlet.radius;
+		axisX[i] = meshlet.coneAxis.x;
+		axisY[i] = meshlet.coneAxis.y;
+		axisZ[i] = meshlet.coneAxis.z;
+		cutoff[i] = meshlet.coneCutoff;
+		firstIndex[i] = meshlet.firstIndex;
+		indexCount[i] = meshlet.indexCount;
+		// Meshlets of different submeshes are not contiguous in the index
+		// buffer, ranges must not span them
+		bool contiguous = i > 0 && meshlet.firstIndex == firstIndex[i - 1] + indexCount[i - 1];
+		runStart[i] = contiguous ? runStart[i - 1] : static_cast<uint32_t>(i);
+	}
+}
+
+
+void MeshletCuller::clear() {
+	std::fill(visible.begin(), visible.end(), uint8_t(0));
+}
+
+
+uint32_t MeshletCuller::cull(const glm::mat4x4& m, const glm::vec3& camera) {
+	// Frustum planes in mesh coordinates
+	FrustumPlanes planes(m);
+	float px[6], py[6], pz[6], pw[6];
+	std::copy(planes.x, planes.x + 6, px);
+	std::copy(planes.y, planes.y + 6, py);
+	std::copy(planes.z, planes.z + 6, pz);
+	std::copy(planes.w, planes.w + 6, pw);
+
+	const size_t count = meshletCount();
+	const float* cx = centerX.data();
+	const float* cy = centerY.data();
+	const float* cz = centerZ.data();
+	const float* r = radius.data();
+	const float* ax = axisX.data();
+	const float* ay = axisY.data();
+	const float* az = axisZ.data();
+	const float* cut = cutoff.data();
+	uint8_t* out = visible.data();
+	// Locals, which stores to out cannot alias
+	const float cameraX = camera.x, cameraY = camera.y, cameraZ = camera.z;
+	uint32_t passed = 0;
+
+	// Branch-free, without short-circuits, so that the compiler turns it
+	// into SIMD code
+	for (size_t i = 0; i < count; ++i) {
+		int inside = 1;
+		for (int p = 0; p < 6; ++p) {
+			inside &= px[p] * cx[i] + py[p] * cy[i] + pz[p] * cz[i] + pw[p] > -r[i] ? 1 : 0;
+		}
+
+		// Every triangle faces away when the direction to the camera stays
+		// out of the cone widened by 90 degrees, for every point of the
+		// sphere: dot(d, axis) - radius > cutoff * |d|, squared to avoid a
+		// square root
+		float dx = cx[i] - cameraX;
+		float dy = cy[i] - cameraY;
+		float dz = cz[i] - cameraZ;
+		float margin = dx * ax[i] + dy * ay[i] + dz * az[i] - r[i];
+		int backFacing = (margin > 0.0f ? 1 : 0) & (margin * margin > cut[i] * cut[i] * (dx * dx + dy * dy + dz * dz) ? 1 : 0);
+
+		int pass = inside & (backFacing ^ 1);
+		out[i] |= static_cast<uint8_t>(pass);
+		passed += static_cast<uint32_t>(pass);
+	}
+	return passed;
+}
+
+
+const std::vector<IndexRange>& MeshletCuller::compact(uint32_t maxHiddenGap) {
+	ranges.clear();
+	size_t lastVisible = 0;
+	for (size_t i = 0; i < meshletCount(); ++i) {
+		if (!visible[i]) {
+			continue;
+		}
+		// Draw a few hidden meshlets rather than start another range
+		if (!ranges.empty() && i - lastVisible <= size_t(maxHiddenGap) + 1 && runStart[i] == runStart[lastVisible]) {
+			ranges.back().indexCount = firstIndex[i] + indexCount[i] - ranges.back().firstIndex;
+		}
+		else {
+			ranges.push_back({ firstIndex[i], indexCount[i] });
+		}
+		lastVisible = i;
+	}
+	return ranges;
+}
+
+
+void MeshletCuller::compact(const std::vector<Submesh>& submeshes, std::vector<std::vector<IndexRange>>& submeshRanges,
+							uint32_t maxHiddenGap) {
+	// The vectors are kept from frame to frame, to reuse their storage
+	submeshRanges.resize(submeshes.size());
+	for (std::vector<IndexRange>& submeshRange : submeshRanges) {
+		submeshRange.clear();
+	}
+	size_t submesh = 0;
+	for (const IndexRange& range : compact(maxHiddenGap)) {
+		while (submesh < submeshes.size() && range.firstIndex >= submeshes[submesh].firstIndex + submeshes[submesh].indexCount) {
+			++submesh;
+		}
+		if (submesh == submeshes.size()) {
+			break;
+		}
+		submeshRanges[submesh].push_back(range);
+	}
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "mesh.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Meshlets split a mesh into small clusters that can be culled on their own,
+ * against the view frustum and, through the cone that bounds their normals,
+ * when all their triangles face away from the camera.
+ *
+ * Without mesh shaders a meshlet is drawn as a range of the index buffer, so
+ * meshlets are consecutive runs of the triangles, which keeps the order
+ * optimizeMesh() chose. The culler then merges the visible meshlets that
+ * follow each other into as few draw ranges as possible.
+ */
+
+const uint32_t MaxMeshletVertices = 64;
+const uint32_t MaxMeshletTriangles = 124;
+
+// Split indices[0, indexCount) into meshlets of at most maxVertices unique
+// vertices and maxTriangles triangles
+std::vector<Meshlet> buildMeshlets(const std::vector<VertexAttributes>& vertices,
+								const uint32_t* indices, size_t indexCount,
+								uint32_t maxVertices = MaxMeshletVertices,
+								uint32_t maxTriangles = MaxMeshletTriangles);
+
+// Range of the index buffer to draw
+struct IndexRange {
+	uint32_t firstIndex;
+	uint32_t indexCount;
+};
+
+/**
+ * Per-frame culling of the meshlets of one mesh. Bounds are kept as
+ * structure of arrays so that the tests run on several meshlets at once;
+ * the loops are written for the compiler to vectorize them (SSE, NEON or
+ * WebAssembly SIMD) rather than with intrinsics of one instruction set.
+ *
+ *     culler.clear();
+ *     for (every instance) culler.cull(viewProjection * model, cameraInModelSpace);
+ *     draw(culler.compact());
+ *
+ * A meshlet stays visible as soon as one of the instances sees it, so that
+ * all the instances can share the same draw ranges.
+ */
+class MeshletCuller {
+public:
+	explicit MeshletCuller(const std::vector<Meshlet>& meshlets);
+
+	// Mark every meshlet as hidden
+	void clear();
+
+	// Mark the meshlets visible from a camera. modelViewProjection maps mesh
+	// coordinates to clip space (WebGPU depth range, 0 to w), cameraPosition
+	// is the camera in mesh coordinates. Returns how many meshlets pass.
+	uint32_t cull(const glm::mat4x4& modelViewProjection, const glm::vec3& cameraPosition);
+
+	// Ranges of the index buffer covering the visible meshlets. Ranges
+	// separated by up to maxHiddenGap hidden meshlets are merged, as a draw
+	// call costs more than a few culled triangles. Ranges never span two
+	// runs of meshlets that are not contiguous in the index buffer, such as
+	// those of two submeshes.
+	const std::vector<IndexRange>& compact(uint32_t maxHiddenGap = 1);
+
+	// Same, split by submesh: submeshRanges[i] covers the visible meshlets of
+	// submeshes[i]. Submeshes are in the order of the index buffer.
+	void compact(const std::vector<Submesh>& submeshes, std::vector<std::vector<IndexRange>>& submeshRanges,
+				uint32_t maxHiddenGap = 1);
+
+	size_t meshletCount() const { return firstIndex.size(); }
+	const std::vector<uint8_t>& visibility() const { return visible; }
+
+private:
+	std::vector<float> centerX, centerY, centerZ, radius;
+	std::vector<float> axisX, axisY, axisZ, cutoff;
+	std::vector<uint32_t> firstIndex, indexCount;
+	// First meshlet of the run of contiguous meshlets each one belongs to
+	std::vector<uint32_t> runStart;
+	std::vector<uint8_t> visible;
+	std::vector<IndexRange> ranges;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+/**
+ * Unbounded lock-free queue with any number of producer threads and a
+ * single consumer thread (Vyukov's intrusive MPSC queue, with a stub node).
+ *
+ * push() is wait-free: an exchange and a store. pop() never blocks either;
+ * it may report the queue as empty while a push is halfway done, and the
+ * value then shows up on a later pop().
+ */
+template <typename T>
+class MpscQueue {
+public:
+	MpscQueue()
+		: head(new Node())
+		, tail(head.load(std::memory_order_relaxed))
+	{}
+
+	~MpscQueue() {
+		T value;
+		while (pop(value)) {}
+		delete tail;
+	}
+
+	MpscQueue(const MpscQueue&) = delete;
+	MpscQueue& operator=(const MpscQueue&) = delete;
+
+	// Any thread
+	void push(T value) {
+		Node* node = new Node();
+		node->value = std::move(value);
+		Node* previous = head.exchange(node, std::memory_order_acq_rel);
+		previous->next.store(node, std::memory_order_release);
+	}
+
+	// Consumer thread only. Return false if there is nothing to pop yet.
+	bool pop(T& value) {
+		Node* next = tail->next.load(std::memory_order_acquire);
+		if (!next) {
+			return false;
+		}
+		// next becomes the new stub, its value moves out
+		value = std::move(next->value);
+		delete tail;
+		tail = next;
+		return true;
+	}
+
+private:
+	struct Node {
+		std::atomic<Node*> next{ nullptr };
+		T value{};
+	};
+
+	std::atomic<Node*> head; // last pushed node, producers side
+	Node* tail;              // stub node, consumer side
+};
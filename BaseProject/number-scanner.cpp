@@ -0,0 +1,279 @@
+#include "number-scanner.h"
+
+#include <cfloat>
+#include <climits>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#if defined(__AVX2__)
+#  include <immintrin.h>
+#  define NUMBER_SCANNER_AVX2
+#  define NUMBER_SCANNER_SSE2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  include <emmintrin.h>
+#  define NUMBER_SCANNER_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#endif
+
+// The exact fast path relies on double operations being rounded once, to
+// double precision. This does not hold with x87 extended precision.
+#if defined(FLT_EVAL_METHOD) && FLT_EVAL_METHOD != 0
+#  define NUMBER_SCANNER_NO_FAST_PATH
+#endif
+
+namespace {
+
+inline bool isBlank(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline bool isDigit(char c) {
+	return static_cast<unsigned char>(c - '0') < 10;
+}
+
+inline unsigned countTrailingZeros(uint32_t mask) {
+#if defined(_MSC_VER)
+	unsigned long index;
+	_BitScanForward(&index, mask);
+	return static_cast<unsigned>(index);
+#else
+	return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// Number of consecutive digits at p, looking at no more than end - p bytes
+inline size_t digitRun(const char* p, const char* end) {
+	size_t run = 0;
+#ifdef NUMBER_SCANNER_SSE2
+	const __m128i zero = _mm_set1_epi8('0');
+	const __m128i nine = _mm_set1_epi8(9);
+	while (end - (p + run) >= 16) {
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + run));
+		// After subtracting '0', digits are exactly the bytes <= 9 (unsigned)
+		__m128i shifted = _mm_sub_epi8(chunk, zero);
+		__m128i digits = _mm_cmpeq_epi8(_mm_max_epu8(shifted, nine), nine);
+		uint32_t nonDigits = ~static_cast<uint32_t>(_mm_movemask_epi8(digits)) & 0xFFFF;
+		if (nonDigits) {
+			return run + countTrailingZeros(nonDigits);
+		}
+		run += 16;
+	}
+#endif
+	while (p + run < end && isDigit(p[run])) ++run;
+	return run;
+}
+
+// Value of 8 ASCII digits, converted in parallel within a 64-bit register
+inline uint64_t parseEightDigits(const char* p) {
+	uint64_t chunk;
+	std::memcpy(&chunk, p, 8); // little-endian: first digit in the low byte
+	chunk = ((chunk & 0x0F0F0F0F0F0F0F0Full) * 2561) >> 8;
+	chunk = ((chunk & 0x00FF00FF00FF00FFull) * 6553601) >> 16;
+	return ((chunk & 0x0000FFFF0000FFFFull) * 42949672960001ull) >> 32;
+}
+
+// Accumulate a run of digits into mantissa. Digits that no longer fit are
+// counted in dropped, so that the caller knows the value is not exact.
+inline void accumulateDigits(const char* p, size_t run, uint64_t& mantissa, size_t& dropped) {
+	size_t i = 0;
+	while (run - i >= 8 && mantissa < 100000000000ull) {
+		mantissa = mantissa * 100000000ull + parseEightDigits(p + i);
+		i += 8;
+	}
+	for (; i < run; ++i) {
+		if (mantissa < 1000000000000000000ull) {
+			mantissa = mantissa * 10 + static_cast<uint64_t>(p[i] - '0');
+		}
+		else {
+			++dropped;
+		}
+	}
+}
+
+// Powers of ten that are exactly representable as doubles
+const double ExactPowersOfTen[] = {
+	1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+	1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+};
+
+const uint64_t MaxExactMantissa = uint64_t(1) << 53;
+
+// Call strtod on a copy of the token, the range may not be null-terminated
+const char* scanDoubleSlow(const char* p, const char* end, double& value) {
+	const char* tokenEnd = p;
+	while (tokenEnd < end && !isBlank(*tokenEnd) && *tokenEnd != '\n') ++tokenEnd;
+
+	char buffer[64];
+	std::string longToken;
+	const char* text = buffer;
+	size_t length = static_cast<size_t>(tokenEnd - p);
+	if (length < sizeof(buffer)) {
+		std::memcpy(buffer, p, length);
+		buffer[length] = '\0';
+	}
+	else {
+		longToken.assign(p, tokenEnd);
+		text = longToken.c_str();
+	}
+
+	char* parsedEnd = nullptr;
+	double result = std::strtod(text, &parsedEnd);
+	if (parsedEnd == text) return nullptr;
+	value = result;
+	return p + (parsedEnd - text);
+}
+
+} // anonymous namespace
+
+
+const char* scanDouble(const char* p, const char* end, double& value) {
+	while (p < end && isBlank(*p)) ++p;
+	const char* start = p;
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		++p;
+	}
+
+	uint64_t mantissa = 0;
+	size_t dropped = 0;
+	int exponent = 0;
+
+	size_t integerDigits = digitRun(p, end);
+	accumulateDigits(p, integerDigits, mantissa, dropped);
+	exponent += static_cast<int>(dropped);
+	p += integerDigits;
+
+	size_t fractionDigits = 0;
+	if (p < end && *p == '.') {
+		++p;
+		fractionDigits = digitRun(p, end);
+		size_t droppedBefore = dropped;
+		accumulateDigits(p, fractionDigits, mantissa, dropped);
+		exponent -= static_cast<int>(fractionDigits - (dropped - droppedBefore));
+		p += fractionDigits;
+	}
+
+	if (integerDigits + fractionDigits == 0 || (p < end && (*p == 'x' || *p == 'X'))) {
+		// inf, nan, hexadecimal floats or no number at all
+		return scanDoubleSlow(start, end, value);
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E')) {
+		const char* q = p + 1;
+		bool negativeExponent = false;
+		if (q < end && (*q == '-' || *q == '+')) {
+			negativeExponent = *q == '-';
+			++q;
+		}
+		if (q < end && isDigit(*q)) {
+			int explicitExponent = 0;
+			for (; q < end && isDigit(*q); ++q) {
+				if (explicitExponent < 100000) explicitExponent = explicitExponent * 10 + (*q - '0');
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+			p = q;
+		}
+	}
+
+#ifndef NUMBER_SCANNER_NO_FAST_PATH
+	if (dropped == 0 && mantissa <= MaxExactMantissa) {
+		double result;
+		bool exact = true;
+		if (mantissa == 0) {
+			result = 0.0;
+		}
+		else if (exponent >= 0 && exponent <= 22) {
+			result = static_cast<double>(mantissa) * ExactPowersOfTen[exponent];
+		}
+		else if (exponent < 0 && exponent >= -22) {
+			result = static_cast<double>(mantissa) / ExactPowersOfTen[-exponent];
+		}
+		else if (exponent > 22 && exponent <= 22 + 15) {
+			// Move some of the exponent into the mantissa while it stays exact
+			uint64_t shifted = mantissa;
+			for (int i = 22; i < exponent && exact; ++i) {
+				shifted *= 10;
+				exact = shifted <= MaxExactMantissa;
+			}
+			result = static_cast<double>(shifted) * 1e22;
+		}
+		else {
+			exact = false;
+			result = 0.0;
+		}
+		if (exact) {
+			value = negative ? -result : result;
+			return p;
+		}
+	}
+#endif
+
+	return scanDoubleSlow(start, end, value);
+}
+
+
+const char* scanFloat(const char* p, const char* end, float& value) {
+	double result;
+	p = scanDouble(p, end, result);
+	if (p) value = static_cast<float>(result);
+	return p;
+}
+
+
+const char* scanInt(const char* p, const char* end, int& value) {
+	while (p < end && isBlank(*p)) ++p;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+')) {
+		negative = *p == '-';
+		++p;
+	}
+	size_t run = digitRun(p, end);
+	if (run == 0 || run > 10) return nullptr;
+	uint64_t magnitude = 0;
+	size_t dropped = 0;
+	accumulateDigits(p, run, magnitude, dropped);
+	if (magnitude > (negative ? uint64_t(INT_MAX) + 1 : uint64_t(INT_MAX))) return nullptr;
+	value = negative ? static_cast<int>(-static_cast<int64_t>(magnitude)) : static_cast<int>(magnitude);
+	return p + run;
+}
+
+
+size_t scanFloats(const char*& p, const char* end, float* values, size_t maxCount) {
+	size_t count = 0;
+	while (count < maxCount) {
+		const char* next = scanFloat(p, end, values[count]);
+		if (!next) break;
+		p = next;
+		++count;
+	}
+	return count;
+}
+
+
+const char* findNewline(const char* p, const char* end) {
+#if defined(NUMBER_SCANNER_AVX2)
+	const __m256i newline = _mm256_set1_epi8('\n');
+	for (; end - p >= 32; p += 32) {
+		__m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+		uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, newline)));
+		if (mask) return p + countTrailingZeros(mask);
+	}
+#endif
+#if defined(NUMBER_SCANNER_SSE2)
+	const __m128i newline16 = _mm_set1_epi8('\n');
+	for (; end - p >= 16; p += 16) {
+		__m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+		uint32_t mask = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, newline16)));
+		if (mask) return p + countTrailingZeros(mask);
+	}
+#endif
+	const void* found = p < end ? std::memchr(p, '\n', static_cast<size_t>(end - p)) : nullptr;
+	return found ? static_cast<const char*>(found) : end;
+}
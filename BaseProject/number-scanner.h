@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Fast conversion of ASCII text to numbers, shared by the text geometry
+ * loaders. Results are bit-identical to strtod: the common short decimals
+ * take an exact fast path (digit runs are located with SSE2/AVX2 and
+ * converted 8 at a time), anything else falls back to strtod itself.
+ *
+ * All functions work on a [p, end) range that does not need to be
+ * null-terminated, and skip leading spaces and tabs.
+ */
+
+// Parse a floating point number. Return a pointer past it, or nullptr if
+// there is no number at p (value is then left untouched).
+const char* scanDouble(const char* p, const char* end, double& value);
+
+// Same as scanDouble, with the result rounded to float like (float)strtod()
+const char* scanFloat(const char* p, const char* end, float& value);
+
+// Parse a signed decimal integer. Return nullptr if there is none or if it
+// does not fit in an int.
+const char* scanInt(const char* p, const char* end, int& value);
+
+// Parse up to maxCount whitespace separated floats, return how many were
+// read. p is moved past the last one.
+size_t scanFloats(const char*& p, const char* end, float* values, size_t maxCount);
+
+// Position of the next '\n' in [p, end), or end if there is none
+const char* findNewline(const char* p, const char* end);
@@ -0,0 +1,486 @@
+#include "obj-parser.h"
+#include "mapped-file.h"
+#include "number-scanner.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+
+namespace {
+
+// Indices of a face corner are stored per chunk as:
+//  - a 0-based absolute index (>= 0) when the file uses a positive index,
+//  - -1 when the attribute is missing,
+//  - RelativeBias + i for relative indices, where i is counted from the
+//    beginning of the chunk and may be negative. The chunk base is only known
+//    once every chunk has been parsed.
+constexpr int RelativeBias = -(1 << 30);
+
+enum class EventType {
+	Group,     // 'o' or 'g', starts a new shape
+	Material,  // 'usemtl'
+	Smoothing, // 's'
+};
+
+// Change of parser state, applied before face number faceIndex of the chunk
+struct Event {
+	EventType type;
+	size_t faceIndex;
+	std::string name;
+	unsigned int smoothingId;
+};
+
+struct Chunk {
+	const char* begin;
+	const char* end;
+
+	std::vector<tinyobj::real_t> positions;
+	std::vector<tinyobj::real_t> colors;
+	std::vector<tinyobj::real_t> normals;
+	std::vector<tinyobj::real_t> texcoords;
+
+	std::vector<tinyobj::index_t> corners;
+	std::vector<uint32_t> faceSizes;
+	std::vector<Event> events;
+	std::vector<std::string> mtllibs;
+
+	std::string warn;
+	std::string err;
+	bool skippedStatements = false;
+
+	// Filled by the merge step
+	size_t positionBase = 0;
+	size_t normalBase = 0;
+	size_t texcoordBase = 0;
+	int startMaterial = -1;
+	unsigned int startSmoothing = 0;
+
+	// Faces [faceBegin, faceEnd) go to shape shapeIndex, starting at
+	// triangle firstTriangle of that shape.
+	struct Segment {
+		size_t faceBegin;
+		size_t faceEnd;
+		size_t shapeIndex;
+		size_t firstTriangle;
+	};
+	std::vector<Segment> segments;
+};
+
+inline bool isSpace(char c) {
+	return c == ' ' || c == '\t' || c == '\r';
+}
+
+inline const char* skipSpaces(const char* p, const char* end) {
+	while (p < end && isSpace(*p)) ++p;
+	return p;
+}
+
+// Parse a floating point number starting at p, as strtod would
+inline bool parseReal(const char*& p, const char* end, tinyobj::real_t& value) {
+	float parsed;
+	const char* next = scanFloat(p, end, parsed);
+	if (!next) return false;
+	value = static_cast<tinyobj::real_t>(parsed);
+	p = next;
+	return true;
+}
+
+// Parse a signed decimal integer starting at p, small enough to be encoded
+// by encodeIndex()
+inline bool parseInt(const char*& p, const char* end, int& value) {
+	const char* next = scanInt(p, end, value);
+	if (!next || value > (1 << 29) || value < -(1 << 29)) return false;
+	p = next;
+	return true;
+}
+
+// Turn an OBJ index (1-based, or negative for relative) into the chunk
+// encoding described at RelativeBias.
+bool encodeIndex(int raw, size_t countInChunk, int& encoded) {
+	if (raw > 0) {
+		encoded = raw - 1;
+		return true;
+	}
+	if (raw < 0) {
+		encoded = RelativeBias + static_cast<int>(countInChunk) + raw;
+		return true;
+	}
+	return false; // 0 is not a valid OBJ index
+}
+
+// Remaining text of the line, without surrounding spaces
+std::string restOfLine(const char* p, const char* end) {
+	p = skipSpaces(p, end);
+	while (end > p && isSpace(end[-1])) --end;
+	return std::string(p, end);
+}
+
+std::string firstWord(const char* p, const char* end) {
+	p = skipSpaces(p, end);
+	const char* wordEnd = p;
+	while (wordEnd < end && !isSpace(*wordEnd)) ++wordEnd;
+	return std::string(p, wordEnd);
+}
+
+bool startsWith(const char* p, const char* end, const char* keyword) {
+	size_t length = std::strlen(keyword);
+	return static_cast<size_t>(end - p) > length && std::memcmp(p, keyword, length) == 0 && isSpace(p[length]);
+}
+
+void parseChunk(Chunk& chunk) {
+	const char* p = chunk.begin;
+	while (p < chunk.end && chunk.err.empty()) {
+		const char* lineEnd = findNewline(p, chunk.end);
+		const char* token = skipSpaces(p, lineEnd);
+		const char* lineStart = p;
+		p = lineEnd + 1;
+
+		if (token >= lineEnd || *token == '#') continue;
+
+		if (startsWith(token, lineEnd, "v")) {
+			token += 2;
+			tinyobj::real_t values[6];
+			int count = 0;
+			while (count < 6 && parseReal(token, lineEnd, values[count])) ++count;
+			if (count < 3) {
+				chunk.err = "Failed to parse `v' line at byte " + std::to_string(lineStart - chunk.begin) + " of its chunk.\n";
+				break;
+			}
+			chunk.positions.insert(chunk.positions.end(), values, values + 3);
+			if (count == 6) {
+				chunk.colors.insert(chunk.colors.end(), values + 3, values + 6);
+			}
+			else {
+				chunk.colors.insert(chunk.colors.end(), { 1.0f, 1.0f, 1.0f });
+			}
+		}
+		else if (startsWith(token, lineEnd, "vn")) {
+			token += 3;
+			tinyobj::real_t values[3] = { 0.0f, 0.0f, 0.0f };
+			for (int i = 0; i < 3; ++i) parseReal(token, lineEnd, values[i]);
+			chunk.normals.insert(chunk.normals.end(), values, values + 3);
+		}
+		else if (startsWith(token, lineEnd, "vt")) {
+			token += 3;
+			tinyobj::real_t values[2] = { 0.0f, 0.0f };
+			for (int i = 0; i < 2; ++i) parseReal(token, lineEnd, values[i]);
+			chunk.texcoords.insert(chunk.texcoords.end(), values, values + 2);
+		}
+		else if (startsWith(token, lineEnd, "f")) {
+			token += 2;
+			uint32_t cornerCount = 0;
+			for (token = skipSpaces(token, lineEnd); token < lineEnd; token = skipSpaces(token, lineEnd)) {
+				tinyobj::index_t corner = { -1, -1, -1 };
+				int raw = 0;
+				bool ok = parseInt(token, lineEnd, raw) && encodeIndex(raw, chunk.positions.size() / 3, corner.vertex_index);
+				if (ok && token < lineEnd && *token == '/') {
+					++token;
+					if (token < lineEnd && *token != '/') {
+						ok = parseInt(token, lineEnd, raw) && encodeIndex(raw, chunk.texcoords.size() / 2, corner.texcoord_index);
+					}
+					if (ok && token < lineEnd && *token == '/') {
+						++token;
+						ok = parseInt(token, lineEnd, raw) && encodeIndex(raw, chunk.normals.size() / 3, corner.normal_index);
+					}
+				}
+				if (!ok || (token < lineEnd && !isSpace(*token))) {
+					chunk.err = "Failed to parse `f' line (e.g. a zero value for vertex index) at byte "
+						+ std::to_string(lineStart - chunk.begin) + " of its chunk.\n";
+					break;
+				}
+				chunk.corners.push_back(corner);
+				++cornerCount;
+			}
+			chunk.faceSizes.push_back(cornerCount);
+		}
+		else if (startsWith(token, lineEnd, "o") || startsWith(token, lineEnd, "g")) {
+			chunk.events.push_back({ EventType::Group, chunk.faceSizes.size(), restOfLine(token + 2, lineEnd), 0 });
+		}
+		else if (startsWith(token, lineEnd, "usemtl")) {
+			chunk.events.push_back({ EventType::Material, chunk.faceSizes.size(), firstWord(token + 7, lineEnd), 0 });
+		}
+		else if (startsWith(token, lineEnd, "s")) {
+			std::string value = firstWord(token + 2, lineEnd);
+			unsigned int smoothingId = 0;
+			if (value != "off") {
+				const char* q = value.c_str();
+				int parsed = 0;
+				if (parseInt(q, q + value.size(), parsed) && parsed > 0) {
+					smoothingId = static_cast<unsigned int>(parsed);
+				}
+			}
+			chunk.events.push_back({ EventType::Smoothing, chunk.faceSizes.size(), std::string(), smoothingId });
+		}
+		else if (startsWith(token, lineEnd, "mtllib")) {
+			chunk.mtllibs.push_back(restOfLine(token + 7, lineEnd));
+		}
+		else {
+			// Lines, points, skin weights, tags, or unknown statements
+			chunk.skippedStatements = true;
+		}
+	}
+}
+
+// Resolve an index encoded by encodeIndex(), return false if out of range
+inline bool decodeIndex(int encoded, size_t base, size_t count, int& index) {
+	if (encoded == -1) {
+		index = -1;
+		return true;
+	}
+	long long global = encoded >= 0
+		? static_cast<long long>(encoded)
+		: static_cast<long long>(base) + (encoded - RelativeBias);
+	if (global < 0 || global >= static_cast<long long>(count)) return false;
+	index = static_cast<int>(global);
+	return true;
+}
+
+size_t triangleCount(uint32_t faceSize) {
+	return faceSize >= 3 ? faceSize - 2 : 0;
+}
+
+template <typename T>
+void append(std::vector<T>& dst, const std::vector<T>& src, size_t offset) {
+	std::copy(src.begin(), src.end(), dst.begin() + offset);
+}
+
+} // anonymous namespace
+
+
+bool loadObjParallel(const fs::path& path,
+					tinyobj::attrib_t& attrib,
+					std::vector<tinyobj::shape_t>& shapes,
+					std::vector<tinyobj::material_t>& materials,
+					std::string& warn,
+					std::string& err,
+					ThreadPool& pool)
+{
+	attrib = tinyobj::attrib_t();
+	shapes.clear();
+	materials.clear();
+
+	MappedFile file;
+	if (!file.open(path)) {
+		err += "Cannot open file [" + path.string() + "]\n";
+		return false;
+	}
+
+	// Split the file in line-aligned chunks, a few per thread for balancing
+	const char* text = reinterpret_cast<const char*>(file.data());
+	const char* textEnd = text + file.size();
+	size_t targetSize = std::max<size_t>(256 * 1024, file.size() / (8 * pool.threadCount()) + 1);
+	std::vector<Chunk> chunks;
+	for (const char* begin = text; begin < textEnd;) {
+		const char* end = begin + std::min<size_t>(targetSize, textEnd - begin);
+		const char* newline = findNewline(end, textEnd);
+		end = newline < textEnd ? newline + 1 : textEnd;
+		chunks.emplace_back();
+		chunks.back().begin = begin;
+		chunks.back().end = end;
+		begin = end;
+	}
+
+	pool.parallelFor(chunks.size(), [&](size_t i) { parseChunk(chunks[i]); });
+
+	bool skippedStatements = false;
+	for (const Chunk& chunk : chunks) {
+		warn += chunk.warn;
+		if (!chunk.err.empty()) {
+			err += chunk.err;
+			return false;
+		}
+		skippedStatements |= chunk.skippedStatements;
+	}
+	if (skippedStatements) {
+		warn += "Unsupported statements (l, p, vw, t...) were skipped\n";
+	}
+
+	// Materials, loaded relative to the OBJ file like tinyobj::LoadObj does
+	std::map<std::string, int> materialMap;
+	{
+		tinyobj::MaterialFileReader reader(path.parent_path().string() + "/");
+		for (const Chunk& chunk : chunks) {
+			for (const std::string& mtllib : chunk.mtllibs) {
+				std::string mtlWarn, mtlErr;
+				if (!reader(mtllib, &materials, &materialMap, &mtlWarn, &mtlErr)) {
+					warn += "Failed to load material file(s). Use default material.\n";
+				}
+				warn += mtlWarn;
+				err += mtlErr;
+			}
+		}
+	}
+
+	// Walk the chunks in file order to compute attribute bases, the state at
+	// the start of each chunk and which shape each range of faces goes to.
+	struct ShapeInfo {
+		std::string name;
+		size_t triangleCount = 0;
+	};
+	std::vector<ShapeInfo> shapeInfos(1);
+	size_t positionCount = 0, normalCount = 0, texcoordCount = 0;
+	int material = -1;
+	unsigned int smoothing = 0;
+	for (Chunk& chunk : chunks) {
+		chunk.positionBase = positionCount;
+		chunk.normalBase = normalCount;
+		chunk.texcoordBase = texcoordCount;
+		positionCount += chunk.positions.size() / 3;
+		normalCount += chunk.normals.size() / 3;
+		texcoordCount += chunk.texcoords.size() / 2;
+		chunk.startMaterial = material;
+		chunk.startSmoothing = smoothing;
+
+		size_t face = 0;
+		auto closeSegment = [&](size_t faceEnd) {
+			size_t triangles = 0;
+			for (size_t f = face; f < faceEnd; ++f) triangles += triangleCount(chunk.faceSizes[f]);
+			if (triangles > 0) {
+				ShapeInfo& shape = shapeInfos.back();
+				chunk.segments.push_back({ face, faceEnd, shapeInfos.size() - 1, shape.triangleCount });
+				shape.triangleCount += triangles;
+			}
+			face = faceEnd;
+		};
+		for (const Event& event : chunk.events) {
+			if (event.type == EventType::Group) {
+				closeSegment(event.faceIndex);
+				// Same as tinyobj: a shape without faces is dropped
+				if (shapeInfos.back().triangleCount > 0) {
+					shapeInfos.emplace_back();
+				}
+				shapeInfos.back().name = event.name;
+			}
+			else if (event.type == EventType::Material) {
+				auto it = materialMap.find(event.name);
+				if (it == materialMap.end()) {
+					warn += "material [ '" + event.name + "' ] not found in .mtl\n";
+				}
+				material = it != materialMap.end() ? it->second : -1;
+			}
+			else {
+				smoothing = event.smoothingId;
+			}
+		}
+		closeSegment(chunk.faceSizes.size());
+	}
+
+	// Concatenate vertex attributes
+	attrib.vertices.resize(3 * positionCount);
+	attrib.colors.resize(3 * positionCount);
+	attrib.vertex_weights.assign(positionCount, 1.0f);
+	attrib.normals.resize(3 * normalCount);
+	attrib.texcoords.resize(2 * texcoordCount);
+	pool.parallelFor(chunks.size(), [&](size_t i) {
+		const Chunk& chunk = chunks[i];
+		append(attrib.vertices, chunk.positions, 3 * chunk.positionBase);
+		append(attrib.colors, chunk.colors, 3 * chunk.positionBase);
+		append(attrib.normals, chunk.normals, 3 * chunk.normalBase);
+		append(attrib.texcoords, chunk.texcoords, 2 * chunk.texcoordBase);
+	});
+
+	// Allocate shapes then fill them from every chunk in parallel
+	for (const ShapeInfo& info : shapeInfos) {
+		if (info.triangleCount == 0) continue;
+		shapes.emplace_back();
+		tinyobj::shape_t& shape = shapes.back();
+		shape.name = info.name;
+		shape.mesh.indices.resize(3 * info.triangleCount);
+		shape.mesh.num_face_vertices.assign(info.triangleCount, 3);
+		shape.mesh.material_ids.resize(info.triangleCount);
+		shape.mesh.smoothing_group_ids.resize(info.triangleCount);
+	}
+	std::vector<size_t> shapeSlot(shapeInfos.size());
+	for (size_t i = 0, slot = 0; i < shapeInfos.size(); ++i) {
+		shapeSlot[i] = slot;
+		if (shapeInfos[i].triangleCount > 0) ++slot;
+	}
+
+	std::vector<std::string> chunkErrors(chunks.size());
+	pool.parallelFor(chunks.size(), [&](size_t c) {
+		const Chunk& chunk = chunks[c];
+		int currentMaterial = chunk.startMaterial;
+		unsigned int currentSmoothing = chunk.startSmoothing;
+		size_t nextEvent = 0;
+		std::vector<size_t> cornerOffsets(chunk.faceSizes.size() + 1, 0);
+		for (size_t f = 0; f < chunk.faceSizes.size(); ++f) {
+			cornerOffsets[f + 1] = cornerOffsets[f] + chunk.faceSizes[f];
+		}
+
+		for (const Chunk::Segment& segment : chunk.segments) {
+			tinyobj::mesh_t& mesh = shapes[shapeSlot[segment.shapeIndex]].mesh;
+			size_t triangle = segment.firstTriangle;
+			for (size_t f = segment.faceBegin; f < segment.faceEnd; ++f) {
+				for (; nextEvent < chunk.events.size() && chunk.events[nextEvent].faceIndex <= f; ++nextEvent) {
+					const Event& event = chunk.events[nextEvent];
+					if (event.type == EventType::Material) {
+						auto it = materialMap.find(event.name);
+						currentMaterial = it != materialMap.end() ? it->second : -1;
+					}
+					else if (event.type == EventType::Smoothing) {
+						currentSmoothing = event.smoothingId;
+					}
+				}
+
+				uint32_t faceSize = chunk.faceSizes[f];
+				tinyobj::index_t corners[4];
+				std::vector<tinyobj::index_t> polygon;
+				tinyobj::index_t* resolved = corners;
+				if (faceSize > 4) {
+					polygon.resize(faceSize);
+					resolved = polygon.data();
+				}
+				for (uint32_t k = 0; k < faceSize; ++k) {
+					const tinyobj::index_t& raw = chunk.corners[cornerOffsets[f] + k];
+					bool ok =
+						decodeIndex(raw.vertex_index, chunk.positionBase, positionCount, resolved[k].vertex_index) &&
+						decodeIndex(raw.normal_index, chunk.normalBase, normalCount, resolved[k].normal_index) &&
+						decodeIndex(raw.texcoord_index, chunk.texcoordBase, texcoordCount, resolved[k].texcoord_index);
+					if (!ok) {
+						chunkErrors[c] = "Face with invalid vertex index found.\n";
+						return;
+					}
+				}
+
+				// Same quad split as tinyobj: cut along the shortest diagonal
+				auto emit = [&](uint32_t i0, uint32_t i1, uint32_t i2) {
+					mesh.indices[3 * triangle + 0] = resolved[i0];
+					mesh.indices[3 * triangle + 1] = resolved[i1];
+					mesh.indices[3 * triangle + 2] = resolved[i2];
+					mesh.material_ids[triangle] = currentMaterial;
+					mesh.smoothing_group_ids[triangle] = currentSmoothing;
+					++triangle;
+				};
+				if (faceSize == 4) {
+					auto position = [&](int k) { return &attrib.vertices[3 * resolved[k].vertex_index]; };
+					auto squaredDistance = [](const tinyobj::real_t* a, const tinyobj::real_t* b) {
+						tinyobj::real_t dx = b[0] - a[0], dy = b[1] - a[1], dz = b[2] - a[2];
+						return dx * dx + dy * dy + dz * dz;
+					};
+					if (squaredDistance(position(0), position(2)) < squaredDistance(position(1), position(3))) {
+						emit(0, 1, 2);
+						emit(0, 2, 3);
+					}
+					else {
+						emit(0, 1, 3);
+						emit(1, 2, 3);
+					}
+				}
+				else {
+					for (uint32_t k = 2; k < faceSize; ++k) {
+						emit(0, k - 1, k);
+					}
+				}
+			}
+		}
+	});
+
+	for (const std::string& chunkError : chunkErrors) {
+		if (!chunkError.empty()) {
+			err += chunkError;
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "thread-pool.h"
+
+#include "tiny_obj_loader.h"
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * Parallel replacement for tinyobj::LoadObj, meant for large files.
+ *
+ * The file is split into line-aligned chunks that are parsed concurrently on
+ * the thread pool, then merged into the same attrib_t/shape_t/material_t
+ * structures that tinyobj::LoadObj fills, with faces triangulated and vertex
+ * colors defaulting to white. Relative (negative) indices are supported.
+ *
+ * Supported statements are v, vn, vt, f, o, g, s, usemtl and mtllib. Lines
+ * (l), points (p), skin weights (vw) and subdivision tags (t) are skipped
+ * with a warning: use tinyobj::LoadObj for files that need them. Polygons
+ * with more than 4 corners are fan-triangulated.
+ */
+bool loadObjParallel(const fs::path& path,
+					tinyobj::attrib_t& attrib,
+					std::vector<tinyobj::shape_t>& shapes,
+					std::vector<tinyobj::material_t>& materials,
+					std::string& warn,
+					std::string& err,
+					ThreadPool& pool = ThreadPool::shared());
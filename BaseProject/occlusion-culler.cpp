@@ -0,0 +1,322 @@
+#include "occlusion-culler.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace {
+
+// Boxes tested per task by cull()
+constexpr size_t QueryChunk = 1024;
+
+// Vertices are snapped to 1/SubpixelSteps of a pixel, as GPUs do, which
+// keeps the edge functions exact near the triangle, and triangles whose
+// doubled area is below MinDoubleArea square pixels are left out: their
+// edges could not be evaluated reliably, and they cover hardly any pixel
+// center
+constexpr float SubpixelSteps = 16.0f;
+constexpr float MinDoubleArea = 1.0f / 64.0f;
+
+float snapToSubpixel(float coordinate) {
+	return std::round(coordinate * SubpixelSteps) / SubpixelSteps;
+}
+
+} // anonymous namespace
+
+
+OcclusionCuller::OcclusionCuller(uint32_t width, uint32_t height) {
+	assert(width > 0 && height > 0);
+	// Every level halves the one below, rounded up, down to a single texel
+	size_t offset = 0;
+	uint32_t levelWidth = width;
+	uint32_t levelHeight = height;
+	while (true) {
+		levelOffsets.push_back(offset);
+		levelWidths.push_back(levelWidth);
+		levelHeights.push_back(levelHeight);
+		offset += size_t(levelWidth) * levelHeight;
+		if (levelWidth == 1 && levelHeight == 1) {
+			break;
+		}
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+	depths.assign(offset, 1.0f);
+	tilesX = (width + TileWidth - 1) / TileWidth;
+	tilesY = (height + TileHeight - 1) / TileHeight;
+	bins.resize(size_t(tilesX) * tilesY);
+}
+
+
+void OcclusionCuller::clear() {
+	occluders.clear();
+	triangleCount = 0;
+}
+
+
+void OcclusionCuller::addOccluder(const glm::mat4x4& clipFromObject, const glm::vec3* positions,
+								const uint32_t* indices, size_t indexCount) {
+	Occluder occluder;
+	occluder.clipFromObject = clipFromObject;
+	occluder.positions = positions;
+	occluder.indices = indices;
+	occluder.firstTriangle = triangleCount;
+	occluder.triangleCount = indexCount / 3;
+	occluders.push_back(occluder);
+	triangleCount += occluder.triangleCount;
+}
+
+
+void OcclusionCuller::setupTriangles(const Occluder& occluder) {
+	const float w = static_cast<float>(width());
+	const float h = static_cast<float>(height());
+	for (size_t t = 0; t < occluder.triangleCount; ++t) {
+		size_t slot = occluder.firstTriangle + t;
+		triangleValid[slot] = 0;
+
+		// Pixel coordinates, y going down, and depth
+		glm::vec3 v[3];
+		bool clipped = false;
+		for (int k = 0; k < 3; ++k) {
+			glm::vec4 clip = occluder.clipFromObject * glm::vec4(occluder.positions[occluder.indices[3 * t + k]], 1.0f);
+			clipped = clipped || clip.w <= 0.0f || clip.z < 0.0f;
+			float inverseW = 1.0f / clip.w;
+			v[k] = glm::vec3(snapToSubpixel((clip.x * inverseW * 0.5f + 0.5f) * w),
+							snapToSubpixel((0.5f - clip.y * inverseW * 0.5f) * h), std::min(clip.z * inverseW, 1.0f));
+		}
+		if (clipped) {
+			continue;
+		}
+
+		// Edge functions relative to a pixel next to the first vertex, where
+		// their terms stay small
+		Triangle& triangle = triangles[slot];
+		triangle.originX = static_cast<int32_t>(std::floor(v[0].x));
+		triangle.originY = static_cast<int32_t>(std::floor(v[0].y));
+		glm::vec3 local[3];
+		for (int k = 0; k < 3; ++k) {
+			local[k] = v[k] - glm::vec3(static_cast<float>(triangle.originX), static_cast<float>(triangle.originY), 0.0f);
+		}
+		for (int k = 0; k < 3; ++k) {
+			// Edge opposite to vertex k
+			const glm::vec3& from = local[(k + 1) % 3];
+			const glm::vec3& to = local[(k + 2) % 3];
+			triangle.a[k] = to.y - from.y;
+			triangle.b[k] = from.x - to.x;
+			triangle.c[k] = from.y * to.x - from.x * to.y;
+		}
+		float area = triangle.a[0] * local[0].x + triangle.b[0] * local[0].y + triangle.c[0];
+		if (!(std::abs(area) >= MinDoubleArea)) {
+			continue;
+		}
+		// Occluders are two-sided: both windings end up positive inside
+		float inverseArea = 1.0f / area;
+		for (int k = 0; k < 3; ++k) {
+			triangle.a[k] *= inverseArea;
+			triangle.b[k] *= inverseArea;
+			triangle.c[k] *= inverseArea;
+		}
+		triangle.zA = triangle.a[0] * v[0].z + triangle.a[1] * v[1].z + triangle.a[2] * v[2].z;
+		triangle.zB = triangle.b[0] * v[0].z + triangle.b[1] * v[1].z + triangle.b[2] * v[2].z;
+		triangle.zC = triangle.c[0] * v[0].z + triangle.c[1] * v[1].z + triangle.c[2] * v[2].z;
+		triangle.zMin = std::min({ v[0].z, v[1].z, v[2].z });
+		triangle.zMax = std::max({ v[0].z, v[1].z, v[2].z });
+
+		// Pixels whose center may be covered
+		float minX = std::min({ v[0].x, v[1].x, v[2].x });
+		float maxX = std::max({ v[0].x, v[1].x, v[2].x });
+		float minY = std::min({ v[0].y, v[1].y, v[2].y });
+		float maxY = std::max({ v[0].y, v[1].y, v[2].y });
+		if (maxX < 0.0f || maxY < 0.0f || minX >= w || minY >= h) {
+			continue;
+		}
+		triangle.minX = std::max(0, static_cast<int32_t>(std::ceil(minX - 0.5f)));
+		triangle.minY = std::max(0, static_cast<int32_t>(std::ceil(minY - 0.5f)));
+		triangle.maxX = std::min(static_cast<int32_t>(width()) - 1, static_cast<int32_t>(std::floor(maxX - 0.5f)));
+		triangle.maxY = std::min(static_cast<int32_t>(height()) - 1, static_cast<int32_t>(std::floor(maxY - 0.5f)));
+		triangleValid[slot] = triangle.minX <= triangle.maxX && triangle.minY <= triangle.maxY;
+	}
+}
+
+
+void OcclusionCuller::rasterizeTile(uint32_t tile) {
+	int32_t tileX0 = static_cast<int32_t>((tile % tilesX) * TileWidth);
+	int32_t tileY0 = static_cast<int32_t>((tile / tilesX) * TileHeight);
+	int32_t tileX1 = std::min(tileX0 + static_cast<int32_t>(TileWidth), static_cast<int32_t>(width()));
+	int32_t tileY1 = std::min(tileY0 + static_cast<int32_t>(TileHeight), static_cast<int32_t>(height()));
+	float* buffer = depths.data();
+	for (int32_t y = tileY0; y < tileY1; ++y) {
+		std::fill(buffer + size_t(y) * width() + tileX0, buffer + size_t(y) * width() + tileX1, 1.0f);
+	}
+
+	for (uint32_t index : bins[tile]) {
+		const Triangle& triangle = triangles[index];
+		int32_t x0 = std::max(triangle.minX, tileX0);
+		int32_t x1 = std::min(triangle.maxX + 1, tileX1);
+		int32_t y0 = std::max(triangle.minY, tileY0);
+		int32_t y1 = std::min(triangle.maxY + 1, tileY1);
+		for (int32_t y = y0; y < y1; ++y) {
+			float py = static_cast<float>(y - triangle.originY) + 0.5f;
+			float rowE0 = triangle.b[0] * py + triangle.c[0];
+			float rowE1 = triangle.b[1] * py + triangle.c[1];
+			float rowE2 = triangle.b[2] * py + triangle.c[2];
+			float rowZ = triangle.zB * py + triangle.zC;
+			float a0 = triangle.a[0], a1 = triangle.a[1], a2 = triangle.a[2], zA = triangle.zA;
+			float zMin = triangle.zMin, zMax = triangle.zMax;
+			int32_t originX = triangle.originX;
+			float* row = buffer + size_t(y) * width();
+			// Branch-free so that it vectorizes. The depth is kept within the
+			// triangle on the pixels at its edges.
+			for (int32_t x = x0; x < x1; ++x) {
+				float px = static_cast<float>(x - originX) + 0.5f;
+				float e0 = a0 * px + rowE0;
+				float e1 = a1 * px + rowE1;
+				float e2 = a2 * px + rowE2;
+				float z = std::min(std::max(zA * px + rowZ, zMin), zMax);
+				bool inside = (e0 >= 0.0f) & (e1 >= 0.0f) & (e2 >= 0.0f);
+				float d = row[x];
+				row[x] = inside & (z < d) ? z : d;
+			}
+		}
+	}
+}
+
+
+void OcclusionCuller::buildPyramid() {
+	for (uint32_t level = 1; level < levelCount(); ++level) {
+		const float* below = depth(level - 1);
+		float* above = depths.data() + levelOffsets[level];
+		uint32_t belowWidth = levelWidths[level - 1];
+		uint32_t belowHeight = levelHeights[level - 1];
+		for (uint32_t y = 0; y < levelHeights[level]; ++y) {
+			const float* row0 = below + size_t(2 * y) * belowWidth;
+			const float* row1 = below + size_t(std::min(2 * y + 1, belowHeight - 1)) * belowWidth;
+			for (uint32_t x = 0; x < levelWidths[level]; ++x) {
+				uint32_t x0 = 2 * x;
+				uint32_t x1 = std::min(2 * x + 1, belowWidth - 1);
+				above[size_t(y) * levelWidths[level] + x] = std::max(std::max(row0[x0], row0[x1]), std::max(row1[x0], row1[x1]));
+			}
+		}
+	}
+}
+
+
+void OcclusionCuller::render(ThreadPool* pool) {
+	PROFILE_ZONE("Occluder rasterization");
+	triangles.resize(triangleCount);
+	triangleValid.resize(triangleCount);
+	auto setup = [&](size_t index) { setupTriangles(occluders[index]); };
+	if (pool && occluders.size() > 1) {
+		pool->parallelFor(occluders.size(), setup);
+	}
+	else {
+		for (size_t index = 0; index < occluders.size(); ++index) {
+			setup(index);
+		}
+	}
+
+	// Bin in triangle order, so that every tile sees its triangles in the
+	// same order whatever the threads
+	for (std::vector<uint32_t>& bin : bins) {
+		bin.clear();
+	}
+	rasterized = 0;
+	for (uint32_t index = 0; index < triangleCount; ++index) {
+		if (!triangleValid[index]) {
+			continue;
+		}
+		++rasterized;
+		const Triangle& triangle = triangles[index];
+		for (uint32_t ty = triangle.minY / TileHeight; ty <= triangle.maxY / TileHeight; ++ty) {
+			for (uint32_t tx = triangle.minX / TileWidth; tx <= triangle.maxX / TileWidth; ++tx) {
+				bins[ty * tilesX + tx].push_back(index);
+			}
+		}
+	}
+
+	auto rasterize = [&](size_t tile) { rasterizeTile(static_cast<uint32_t>(tile)); };
+	if (pool) {
+		pool->parallelFor(bins.size(), rasterize);
+	}
+	else {
+		for (size_t tile = 0; tile < bins.size(); ++tile) {
+			rasterize(tile);
+		}
+	}
+	buildPyramid();
+}
+
+
+bool OcclusionCuller::visible(const glm::mat4x4& clipFromObject, const glm::vec3& boxMin, const glm::vec3& boxMax) const {
+	// Screen rectangle and nearest depth of the corners. A box that reaches
+	// in front of the near plane may be seen.
+	float minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+	float nearest = INFINITY;
+	for (int corner = 0; corner < 8; ++corner) {
+		glm::vec4 point((corner & 1) ? boxMax.x : boxMin.x, (corner & 2) ? boxMax.y : boxMin.y,
+						(corner & 4) ? boxMax.z : boxMin.z, 1.0f);
+		glm::vec4 clip = clipFromObject * point;
+		if (clip.w <= 0.0f || clip.z < 0.0f) {
+			return true;
+		}
+		float inverseW = 1.0f / clip.w;
+		float x = (clip.x * inverseW * 0.5f + 0.5f) * static_cast<float>(width());
+		float y = (0.5f - clip.y * inverseW * 0.5f) * static_cast<float>(height());
+		minX = std::min(minX, x);
+		maxX = std::max(maxX, x);
+		minY = std::min(minY, y);
+		maxY = std::max(maxY, y);
+		nearest = std::min(nearest, clip.z * inverseW);
+	}
+	// Out of the viewport, for frustum culling to decide
+	if (maxX < 0.0f || maxY < 0.0f || minX >= static_cast<float>(width()) || minY >= static_cast<float>(height())) {
+		return true;
+	}
+
+	// Every pixel the rectangle touches, then the level where they span 4x4
+	// texels at most
+	uint32_t x0 = static_cast<uint32_t>(std::max(0.0f, std::floor(minX)));
+	uint32_t y0 = static_cast<uint32_t>(std::max(0.0f, std::floor(minY)));
+	uint32_t x1 = std::min(width() - 1, static_cast<uint32_t>(std::floor(maxX)));
+	uint32_t y1 = std::min(height() - 1, static_cast<uint32_t>(std::floor(maxY)));
+	uint32_t level = 0;
+	while (level + 1 < levelCount() && ((x1 >> level) - (x0 >> level) >= 4 || (y1 >> level) - (y0 >> level) >= 4)) {
+		++level;
+	}
+	const float* texels = depth(level);
+	float farthest = 0.0f;
+	for (uint32_t y = y0 >> level; y <= y1 >> level; ++y) {
+		for (uint32_t x = x0 >> level; x <= x1 >> level; ++x) {
+			farthest = std::max(farthest, texels[size_t(y) * levelWidths[level] + x]);
+		}
+	}
+	return nearest <= farthest;
+}
+
+
+uint32_t OcclusionCuller::cull(const glm::mat4x4& clipFromObject, const glm::vec3* boxMin, const glm::vec3* boxMax,
+							size_t count, uint8_t* visibleOut, ThreadPool* pool) const {
+	auto cullChunk = [&](size_t chunk) {
+		size_t end = std::min(count, (chunk + 1) * QueryChunk);
+		for (size_t i = chunk * QueryChunk; i < end; ++i) {
+			if (visibleOut[i]) {
+				visibleOut[i] = visible(clipFromObject, boxMin[i], boxMax[i]) ? 1 : 0;
+			}
+		}
+	};
+	size_t chunkCount = (count + QueryChunk - 1) / QueryChunk;
+	if (pool && chunkCount > 1) {
+		pool->parallelFor(chunkCount, cullChunk);
+	}
+	else {
+		for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+			cullChunk(chunk);
+		}
+	}
+	uint32_t visibleCount = 0;
+	for (size_t i = 0; i < count; ++i) {
+		visibleCount += visibleOut[i];
+	}
+	return visibleCount;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "thread-pool.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Occlusion culling against a small depth buffer rasterized on the CPU,
+ * before any draw is issued for the objects it hides.
+ *
+ *     culler.clear();
+ *     culler.addOccluder(clipFromObject, positions, indices, indexCount);
+ *     culler.render(&ThreadPool::shared());
+ *     culler.cull(clipFromWorld, boxMin, boxMax, count, visible);
+ *
+ * Occluders are low-poly meshes, drawn depth only at pixel centers in a
+ * buffer of a few thousand pixels, their vertices snapped to 1/16 of a
+ * pixel. The triangles are set up and binned by tile, then every tile is
+ * rasterized by its own task, so the result does not depend on the thread
+ * count. The span loops are written, like those of SceneBounds, branch-free
+ * for the compiler to vectorize rather than with intrinsics of one
+ * instruction set. Triangles that reach in front of the near plane, or too
+ * thin to cover a pixel center reliably, are left out, which can only hide
+ * less.
+ *
+ * A pyramid keeps the farthest depth of every 2x2 texels of the level
+ * below. A box is tested at the level where its screen rectangle spans at
+ * most 4x4 texels: it is hidden when its nearest point is farther than all
+ * of them. Depths are those of WebGPU, 0 at the near plane and 1 at the far
+ * one.
+ */
+class OcclusionCuller {
+public:
+	// Depth buffer of width x height pixels, covering the whole viewport
+	OcclusionCuller(uint32_t width, uint32_t height);
+
+	// Forget the occluders of the last frame
+	void clear();
+
+	// Queue the triangles of an occluder, whose positions clipFromObject
+	// maps to clip space. The arrays must stay valid until render().
+	void addOccluder(const glm::mat4x4& clipFromObject, const glm::vec3* positions,
+					const uint32_t* indices, size_t indexCount);
+
+	// Rasterize the queued occluders, on the threads of pool or on the
+	// calling thread without one, and build the pyramid
+	void render(ThreadPool* pool);
+
+	// Whether a box, in the space clipFromObject maps from, may be seen:
+	// false only when the occluders entirely hide it
+	bool visible(const glm::mat4x4& clipFromObject, const glm::vec3& boxMin, const glm::vec3& boxMax) const;
+
+	// Clear visible[i] for the boxes hidden among those it sets, and return
+	// how many stay visible
+	uint32_t cull(const glm::mat4x4& clipFromObject, const glm::vec3* boxMin, const glm::vec3* boxMax,
+				size_t count, uint8_t* visible, ThreadPool* pool = nullptr) const;
+
+	uint32_t width() const { return levelWidths[0]; }
+	uint32_t height() const { return levelHeights[0]; }
+	uint32_t levelCount() const { return static_cast<uint32_t>(levelOffsets.size()); }
+	uint32_t levelWidth(uint32_t level) const { return levelWidths[level]; }
+	uint32_t levelHeight(uint32_t level) const { return levelHeights[level]; }
+	// Rows of a level of the pyramid, level 0 being the depth buffer
+	const float* depth(uint32_t level) const { return depths.data() + levelOffsets[level]; }
+
+	// Triangles queued, and those the last render() rasterized
+	size_t queuedTriangleCount() const { return triangleCount; }
+	size_t lastRasterizedCount() const { return rasterized; }
+
+	// Pixels of a tile, rasterized by one task
+	static constexpr uint32_t TileWidth = 32;
+	static constexpr uint32_t TileHeight = 16;
+
+private:
+	struct Occluder {
+		glm::mat4x4 clipFromObject;
+		const glm::vec3* positions;
+		const uint32_t* indices;
+		size_t firstTriangle;
+		size_t triangleCount;
+	};
+
+	// Edge functions a * x + b * y + c, positive inside, and the depth
+	// plane of a triangle, in pixels from the origin, with its depth range
+	// and its pixel bounds, inclusive
+	struct Triangle {
+		float a[3], b[3], c[3];
+		float zA, zB, zC;
+		float zMin, zMax;
+		int32_t originX, originY;
+		int32_t minX, minY, maxX, maxY;
+	};
+
+	void setupTriangles(const Occluder& occluder);
+	void rasterizeTile(uint32_t tile);
+	void buildPyramid();
+
+	std::vector<Occluder> occluders;
+	size_t triangleCount = 0;
+	size_t rasterized = 0;
+	std::vector<Triangle> triangles;
+	std::vector<uint8_t> triangleValid;
+	// Triangles overlapping every tile, in order
+	std::vector<std::vector<uint32_t>> bins;
+	uint32_t tilesX = 0;
+	uint32_t tilesY = 0;
+	// Every level of the pyramid, one after the other
+	std::vector<float> depths;
+	std::vector<size_t> levelOffsets;
+	std::vector<uint32_t> levelWidths;
+	std::vector<uint32_t> levelHeights;
+};
@@ -0,0 +1,306 @@
+#include "pipeline-cache.h"
+#include "profiler.h"
+
+#include <ostream>
+#include <cstring>
+#include <type_traits>
+
+using namespace wgpu;
+
+namespace {
+
+// Append the bytes of a field. Structs are written field by field, as their
+// padding bytes are undefined.
+template <typename T>
+void append(std::vector<uint8_t>& key, T value) {
+	static_assert(std::is_arithmetic_v<T> || std::is_enum_v<T> || std::is_pointer_v<T>, "Append the fields of structs one by one");
+	size_t size = key.size();
+	key.resize(size + sizeof(T));
+	std::memcpy(key.data() + size, &value, sizeof(T));
+}
+
+
+// Length first, so that consecutive strings cannot be confused
+void appendString(std::vector<uint8_t>& key, const char* text) {
+	if (text == nullptr) {
+		append(key, uint32_t(UINT32_MAX));
+		return;
+	}
+	uint32_t length = static_cast<uint32_t>(std::strlen(text));
+	append(key, length);
+	key.insert(key.end(), text, text + length);
+}
+
+
+void appendConstants(std::vector<uint8_t>& key, const WGPUConstantEntry* constants, size_t count) {
+	append(key, count);
+	for (size_t i = 0; i < count; ++i) {
+		appendString(key, constants[i].key);
+		append(key, constants[i].value);
+	}
+}
+
+
+void appendStencilFace(std::vector<uint8_t>& key, const WGPUStencilFaceState& face) {
+	append(key, face.compare);
+	append(key, face.failOp);
+	append(key, face.depthFailOp);
+	append(key, face.passOp);
+}
+
+
+void appendBlendComponent(std::vector<uint8_t>& key, const WGPUBlendComponent& component) {
+	append(key, component.operation);
+	append(key, component.srcFactor);
+	append(key, component.dstFactor);
+}
+
+
+// FNV-1a on 64-bit words rather than bytes, then the finalizer of
+// MurmurHash3 to spread the words over the bits that index the buckets
+uint64_t hashBytes(const uint8_t* bytes, size_t size) {
+	uint64_t hash = 14695981039346656037ull;
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, bytes + i, 8);
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+	for (; i < size; ++i) {
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	hash ^= hash >> 33;
+	hash *= 0xff51afd7ed558ccdull;
+	hash ^= hash >> 33;
+	hash *= 0xc4ceb9fe1a85ec53ull;
+	hash ^= hash >> 33;
+	return hash;
+}
+
+} // anonymous namespace
+
+
+PipelineCache::PipelineCache(GpuBackend& backend)
+	: backend(backend)
+{}
+
+
+PipelineCache::~PipelineCache() {
+	for (PipelineEntry& entry : pipelines) {
+		backend.release(entry.pipeline);
+	}
+	for (auto& [key, layout] : pipelineLayouts) {
+		backend.release(layout);
+	}
+	for (auto& [key, layout] : bindGroupLayouts) {
+		backend.release(layout);
+	}
+	for (auto& [key, shaderModule] : shaderModules) {
+		backend.release(shaderModule);
+	}
+}
+
+
+void PipelineCache::appendKey(const RenderPipelineDescriptor& descriptor, std::vector<uint8_t>& key) {
+	append(key, descriptor.layout);
+
+	const WGPUVertexState& vertex = descriptor.vertex;
+	append(key, vertex.module);
+	appendString(key, vertex.entryPoint);
+	appendConstants(key, vertex.constants, vertex.constantCount);
+	append(key, vertex.bufferCount);
+	for (size_t i = 0; i < vertex.bufferCount; ++i) {
+		const WGPUVertexBufferLayout& buffer = vertex.buffers[i];
+		append(key, buffer.arrayStride);
+		append(key, buffer.stepMode);
+		append(key, buffer.attributeCount);
+		for (size_t j = 0; j < buffer.attributeCount; ++j) {
+			append(key, buffer.attributes[j].format);
+			append(key, buffer.attributes[j].offset);
+			append(key, buffer.attributes[j].shaderLocation);
+		}
+	}
+
+	append(key, descriptor.primitive.topology);
+	append(key, descriptor.primitive.stripIndexFormat);
+	append(key, descriptor.primitive.frontFace);
+	append(key, descriptor.primitive.cullMode);
+
+	append(key, descriptor.depthStencil != nullptr);
+	if (const WGPUDepthStencilState* depthStencil = descriptor.depthStencil) {
+		append(key, depthStencil->format);
+		append(key, depthStencil->depthWriteEnabled);
+		append(key, depthStencil->depthCompare);
+		appendStencilFace(key, depthStencil->stencilFront);
+		appendStencilFace(key, depthStencil->stencilBack);
+		append(key, depthStencil->stencilReadMask);
+		append(key, depthStencil->stencilWriteMask);
+		append(key, depthStencil->depthBias);
+		append(key, depthStencil->depthBiasSlopeScale);
+		append(key, depthStencil->depthBiasClamp);
+	}
+
+	append(key, descriptor.multisample.count);
+	append(key, descriptor.multisample.mask);
+	append(key, descriptor.multisample.alphaToCoverageEnabled);
+
+	append(key, descriptor.fragment != nullptr);
+	if (const WGPUFragmentState* fragment = descriptor.fragment) {
+		append(key, fragment->module);
+		appendString(key, fragment->entryPoint);
+		appendConstants(key, fragment->constants, fragment->constantCount);
+		append(key, fragment->targetCount);
+		for (size_t i = 0; i < fragment->targetCount; ++i) {
+			const WGPUColorTargetState& target = fragment->targets[i];
+			append(key, target.format);
+			append(key, target.writeMask);
+			append(key, target.blend != nullptr);
+			if (target.blend) {
+				appendBlendComponent(key, target.blend->color);
+				appendBlendComponent(key, target.blend->alpha);
+			}
+		}
+	}
+}
+
+
+void PipelineCache::appendKey(const BindGroupLayoutDescriptor& descriptor, std::vector<uint8_t>& key) {
+	append(key, descriptor.entryCount);
+	for (size_t i = 0; i < descriptor.entryCount; ++i) {
+		const WGPUBindGroupLayoutEntry& entry = descriptor.entries[i];
+		append(key, entry.binding);
+		append(key, entry.visibility);
+		append(key, entry.buffer.type);
+		append(key, entry.buffer.hasDynamicOffset);
+		append(key, entry.buffer.minBindingSize);
+		append(key, entry.sampler.type);
+		append(key, entry.texture.sampleType);
+		append(key, entry.texture.viewDimension);
+		append(key, entry.texture.multisampled);
+		append(key, entry.storageTexture.access);
+		append(key, entry.storageTexture.format);
+		append(key, entry.storageTexture.viewDimension);
+	}
+}
+
+
+void PipelineCache::hashScratch() {
+	scratch.hash = hashBytes(scratch.bytes.data(), scratch.bytes.size());
+}
+
+
+ShaderModule PipelineCache::shaderModule(const std::string& wgslSource) {
+	scratch.bytes.assign(wgslSource.begin(), wgslSource.end());
+	hashScratch();
+	auto it = shaderModules.find(scratch);
+	if (it != shaderModules.end()) {
+		++sharedObjects;
+		return it->second;
+	}
+
+	ShaderModuleWGSLDescriptor shaderCodeDesc{};
+	shaderCodeDesc.chain.next = nullptr;
+	shaderCodeDesc.chain.sType = SType::ShaderModuleWGSLDescriptor;
+	shaderCodeDesc.code = wgslSource.c_str();
+	ShaderModuleDescriptor shaderDesc{};
+	shaderDesc.nextInChain = &shaderCodeDesc.chain;
+	ShaderModule module = backend.createShaderModule(shaderDesc);
+	shaderModules.emplace(scratch, module);
+	return module;
+}
+
+
+BindGroupLayout PipelineCache::bindGroupLayout(const BindGroupLayoutDescriptor& descriptor) {
+	scratch.bytes.clear();
+	appendKey(descriptor, scratch.bytes);
+	hashScratch();
+	auto it = bindGroupLayouts.find(scratch);
+	if (it != bindGroupLayouts.end()) {
+		++sharedObjects;
+		return it->second;
+	}
+
+	BindGroupLayout layout = backend.createBindGroupLayout(descriptor);
+	bindGroupLayouts.emplace(scratch, layout);
+	return layout;
+}
+
+
+PipelineLayout PipelineCache::pipelineLayout(const BindGroupLayout* layouts, size_t count) {
+	scratch.bytes.clear();
+	for (size_t i = 0; i < count; ++i) {
+		append(scratch.bytes, static_cast<WGPUBindGroupLayout>(layouts[i]));
+	}
+	hashScratch();
+	auto it = pipelineLayouts.find(scratch);
+	if (it != pipelineLayouts.end()) {
+		++sharedObjects;
+		return it->second;
+	}
+
+	std::vector<WGPUBindGroupLayout> rawLayouts(layouts, layouts + count);
+	PipelineLayoutDescriptor layoutDesc{};
+	layoutDesc.bindGroupLayoutCount = rawLayouts.size();
+	layoutDesc.bindGroupLayouts = rawLayouts.data();
+	PipelineLayout layout = backend.createPipelineLayout(layoutDesc);
+	pipelineLayouts.emplace(scratch, layout);
+	return layout;
+}
+
+
+PipelineId PipelineCache::requestRenderPipeline(const RenderPipelineDescriptor& descriptor) {
+	scratch.bytes.clear();
+	appendKey(descriptor, scratch.bytes);
+	hashScratch();
+	auto it = pipelineIds.find(scratch);
+	if (it != pipelineIds.end()) {
+		++hits;
+		return it->second;
+	}
+
+	PROFILE_ZONE("Request render pipeline");
+	++misses;
+	++pending;
+	PipelineId id = static_cast<PipelineId>(pipelines.size());
+	pipelines.emplace_back();
+	pipelineIds.emplace(scratch, id);
+	// Some backends call back before returning
+	backend.createRenderPipelineAsync(descriptor, [this, id](RenderPipeline pipeline) {
+		PipelineEntry& entry = pipelines[id];
+		entry.pipeline = pipeline;
+		--pending;
+		if (!pipeline) {
+			++failed;
+		}
+	});
+	return id;
+}
+
+
+RenderPipeline PipelineCache::renderPipeline(PipelineId id) const {
+	return id < pipelines.size() ? pipelines[id].pipeline : RenderPipeline(nullptr);
+}
+
+
+PipelineCache::Stats PipelineCache::stats() const {
+	Stats result;
+	result.hits = hits;
+	result.misses = misses;
+	result.failed = failed;
+	result.pending = pending;
+	result.pipelines = static_cast<uint32_t>(pipelines.size());
+	result.shaderModules = static_cast<uint32_t>(shaderModules.size());
+	result.bindGroupLayouts = static_cast<uint32_t>(bindGroupLayouts.size());
+	result.pipelineLayouts = static_cast<uint32_t>(pipelineLayouts.size());
+	result.sharedObjects = sharedObjects;
+	return result;
+}
+
+
+void PipelineCache::printStats(std::ostream& out) const {
+	Stats s = stats();
+	out << "Pipeline cache: " << (s.hits + s.misses) << " requests, " << s.hits << " hits, " << s.misses << " misses ("
+		<< s.failed << " failed, " << s.pending << " pending), " << s.pipelines << " pipelines from "
+		<< s.shaderModules << " shader modules, " << s.bindGroupLayouts << " bind group layouts and "
+		<< s.pipelineLayouts << " pipeline layouts (" << s.sharedObjects << " shared)" << std::endl;
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <webgpu/webgpu.hpp>
+
+#include <iosfwd>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// Index of a render pipeline in a PipelineCache
+using PipelineId = uint32_t;
+const PipelineId InvalidPipelineId = UINT32_MAX;
+
+/**
+ * Render pipelines, with the shader modules and layouts they are made of,
+ * created once per distinct description and shared by every request.
+ *
+ *     PipelineId id = cache.requestRenderPipeline(descriptor);
+ *     ...
+ *     // Every frame
+ *     if (RenderPipeline pipeline = cache.renderPipeline(id)) { draw }
+ *
+ * Descriptors are written field by field into a canonical key, labels
+ * aside, and looked up by its hash. Shader modules are keyed by their WGSL
+ * source and layouts by their entries, so the modules and layouts the cache
+ * returns stand for their contents in the keys of the pipelines. Chained
+ * structs (nextInChain) are not part of the keys.
+ *
+ * A pipeline missing from the cache is created asynchronously: the request
+ * returns right away and renderPipeline() stays null until it is ready, so
+ * the frame loop never waits for the driver to compile shaders.
+ *
+ * The cache owns everything it creates, until it is destroyed. It is not
+ * thread-safe, the backend calls back on the thread that polls the device.
+ */
+class PipelineCache {
+public:
+	struct Stats {
+		uint64_t hits;          // requests of a pipeline that was created or on the way
+		uint64_t misses;        // requests that started a creation
+		uint64_t failed;        // creations that failed
+		uint32_t pending;       // creations not finished yet
+		uint32_t pipelines;
+		uint32_t shaderModules;
+		uint32_t bindGroupLayouts;
+		uint32_t pipelineLayouts;
+		uint64_t sharedObjects; // shader module and layout requests served by the cache
+	};
+
+	explicit PipelineCache(GpuBackend& backend);
+	~PipelineCache();
+
+	PipelineCache(const PipelineCache&) = delete;
+	PipelineCache& operator=(const PipelineCache&) = delete;
+
+	wgpu::ShaderModule shaderModule(const std::string& wgslSource);
+	wgpu::BindGroupLayout bindGroupLayout(const wgpu::BindGroupLayoutDescriptor& descriptor);
+	wgpu::PipelineLayout pipelineLayout(const wgpu::BindGroupLayout* bindGroupLayouts, size_t count);
+
+	// Start creating the pipeline unless an identical one was requested
+	// before. Layout and modules are best taken from this cache.
+	PipelineId requestRenderPipeline(const wgpu::RenderPipelineDescriptor& descriptor);
+
+	// Null while the pipeline is being created, or if creation failed
+	wgpu::RenderPipeline renderPipeline(PipelineId id) const;
+
+	uint32_t pendingCount() const { return pending; }
+
+	Stats stats() const;
+	void printStats(std::ostream& out) const;
+
+	// Canonical bytes of a descriptor, exposed for the benchmarks
+	static void appendKey(const wgpu::RenderPipelineDescriptor& descriptor, std::vector<uint8_t>& key);
+	static void appendKey(const wgpu::BindGroupLayoutDescriptor& descriptor, std::vector<uint8_t>& key);
+
+private:
+	struct Key {
+		std::vector<uint8_t> bytes;
+		uint64_t hash = 0;
+
+		bool operator==(const Key& other) const { return hash == other.hash && bytes == other.bytes; }
+	};
+	struct KeyHash {
+		size_t operator()(const Key& key) const { return static_cast<size_t>(key.hash); }
+	};
+
+	struct PipelineEntry {
+		wgpu::RenderPipeline pipeline = nullptr;
+	};
+
+	// Hash the bytes of scratch, once they are written
+	void hashScratch();
+
+	GpuBackend& backend;
+	// Reused by every lookup, so that hits do not allocate
+	Key scratch;
+
+	std::unordered_map<Key, wgpu::ShaderModule, KeyHash> shaderModules;
+	std::unordered_map<Key, wgpu::BindGroupLayout, KeyHash> bindGroupLayouts;
+	std::unordered_map<Key, wgpu::PipelineLayout, KeyHash> pipelineLayouts;
+	std::unordered_map<Key, PipelineId, KeyHash> pipelineIds;
+	std::vector<PipelineEntry> pipelines;
+
+	uint64_t hits = 0;
+	uint64_t misses = 0;
+	uint64_t failed = 0;
+	uint32_t pending = 0;
+	uint64_t sharedObjects = 0;
+};
@@ -0,0 +1,33 @@
+#include "process-stats.h"
+
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  define NOMINMAX
+#  define PSAPI_VERSION 2 // GetProcessMemoryInfo from kernel32, no psapi.lib needed
+#  include <windows.h>
+#  include <psapi.h>
+#elif !defined(__EMSCRIPTEN__)
+#  include <sys/resource.h>
+#endif
+
+size_t peakResidentBytes() {
+#if defined(_WIN32)
+	PROCESS_MEMORY_COUNTERS counters = {};
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters))) {
+		return 0;
+	}
+	return counters.PeakWorkingSetSize;
+#elif defined(__EMSCRIPTEN__)
+	return 0;
+#else
+	struct rusage usage = {};
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+#  if defined(__APPLE__)
+	return static_cast<size_t>(usage.ru_maxrss); // already in bytes
+#  else
+	return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#  endif
+#endif
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Memory usage of the running process, for the load logs and benchmarks.
+ */
+
+// Largest resident set size reached so far, in bytes, or 0 where the
+// platform does not report it (Emscripten)
+size_t peakResidentBytes();
+
+// Same, in mebibytes
+inline double peakResidentMiB() {
+	return static_cast<double>(peakResidentBytes()) / (1024.0 * 1024.0);
+}
@@ -0,0 +1,255 @@
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <unordered_map>
+
+namespace {
+
+struct Event {
+	const char* name;
+	uint64_t start;
+	uint64_t end;
+	bool gpu;
+};
+
+// Single producer (the owning thread), single consumer (collect()) ring
+struct ThreadRing {
+	static constexpr uint64_t Capacity = 1 << 14;
+
+	std::array<Event, Capacity> events;
+	std::atomic<uint64_t> head{ 0 };
+	std::atomic<uint64_t> tail{ 0 };
+	std::atomic<uint64_t> dropped{ 0 };
+	uint32_t threadId = 0;
+
+	void push(const Event& event) {
+		uint64_t h = head.load(std::memory_order_relaxed);
+		if (h - tail.load(std::memory_order_acquire) >= Capacity) {
+			dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		events[h % Capacity] = event;
+		head.store(h + 1, std::memory_order_release);
+	}
+};
+
+struct TraceEvent {
+	Event event;
+	uint32_t threadId;
+};
+
+// Last samples of a zone, in a circular buffer
+struct ZoneHistory {
+	static constexpr size_t Window = 512;
+
+	std::vector<double> samples;
+	size_t next = 0;
+	uint64_t count = 0;
+	bool gpu = false;
+
+	void add(double ms) {
+		if (samples.size() < Window) {
+			samples.push_back(ms);
+		}
+		else {
+			samples[next] = ms;
+			next = (next + 1) % Window;
+		}
+		++count;
+	}
+};
+
+const size_t MaxTraceEvents = 4 * 1024 * 1024;
+const uint32_t GpuTrackId = 1000;
+
+struct ProfilerState {
+	std::mutex ringsMutex;
+	std::vector<std::shared_ptr<ThreadRing>> rings;
+	uint32_t nextThreadId = 1;
+
+	std::mutex collectMutex;
+	// The same name may come from string literals at different addresses
+	std::map<std::string, ZoneHistory> zones;
+	std::unordered_map<const char*, ZoneHistory*> zonesByAddress;
+	std::vector<TraceEvent> trace;
+	bool capturing = false;
+};
+
+ProfilerState& state() {
+	static ProfilerState profilerState;
+	return profilerState;
+}
+
+ThreadRing& threadRing() {
+	// The registry keeps the ring alive after its thread exits, so that its
+	// last events can still be collected
+	thread_local std::shared_ptr<ThreadRing> ring = [] {
+		auto newRing = std::make_shared<ThreadRing>();
+		ProfilerState& s = state();
+		std::lock_guard<std::mutex> lock(s.ringsMutex);
+		newRing->threadId = s.nextThreadId++;
+		s.rings.push_back(newRing);
+		return newRing;
+	}();
+	return *ring;
+}
+
+double percentile(std::vector<double>& sorted, double fraction) {
+	size_t index = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+	return sorted[std::min(index, sorted.size() - 1)];
+}
+
+} // anonymous namespace
+
+
+std::atomic<bool> Profiler::enabledFlag{ false };
+
+
+void Profiler::setEnabled(bool enabled) {
+	enabledFlag.store(enabled, std::memory_order_relaxed);
+}
+
+
+uint64_t Profiler::now() {
+	static const auto epoch = std::chrono::steady_clock::now();
+	return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - epoch).count());
+}
+
+
+void Profiler::record(const char* name, uint64_t startNs, uint64_t endNs) {
+	threadRing().push({ name, startNs, endNs, false });
+}
+
+
+void Profiler::recordGpu(const char* name, uint64_t cpuNs, uint64_t durationNs) {
+	if (!enabled()) {
+		return;
+	}
+	threadRing().push({ name, cpuNs, cpuNs + durationNs, true });
+}
+
+
+void Profiler::collect() {
+	ProfilerState& s = state();
+	std::vector<std::shared_ptr<ThreadRing>> rings;
+	{
+		std::lock_guard<std::mutex> lock(s.ringsMutex);
+		rings = s.rings;
+	}
+
+	std::lock_guard<std::mutex> lock(s.collectMutex);
+	for (const auto& ring : rings) {
+		uint64_t t = ring->tail.load(std::memory_order_relaxed);
+		uint64_t h = ring->head.load(std::memory_order_acquire);
+		for (; t < h; ++t) {
+			const Event& event = ring->events[t % ThreadRing::Capacity];
+			ZoneHistory*& history = s.zonesByAddress[event.name];
+			if (!history) {
+				history = &s.zones[event.name];
+			}
+			ZoneHistory& zone = *history;
+			zone.gpu = event.gpu;
+			zone.add(static_cast<double>(event.end - event.start) / 1e6);
+			if (s.capturing && s.trace.size() < MaxTraceEvents) {
+				s.trace.push_back({ event, event.gpu ? GpuTrackId : ring->threadId });
+			}
+		}
+		ring->tail.store(h, std::memory_order_release);
+	}
+}
+
+
+std::vector<Profiler::ZoneStats> Profiler::stats() {
+	ProfilerState& s = state();
+	std::lock_guard<std::mutex> lock(s.collectMutex);
+	std::vector<ZoneStats> result;
+	std::vector<double> sorted;
+	for (const auto& entry : s.zones) {
+		const ZoneHistory& zone = entry.second;
+		if (zone.samples.empty()) continue;
+		sorted = zone.samples;
+		std::sort(sorted.begin(), sorted.end());
+		double total = 0.0;
+		for (double sample : sorted) total += sample;
+		result.push_back({
+			entry.first, zone.gpu, zone.count, total / static_cast<double>(sorted.size()),
+			percentile(sorted, 0.50), percentile(sorted, 0.95), percentile(sorted, 0.99)
+		});
+	}
+	std::sort(result.begin(), result.end(), [](const ZoneStats& a, const ZoneStats& b) {
+		return a.gpu != b.gpu ? b.gpu : a.name < b.name;
+	});
+	return result;
+}
+
+
+void Profiler::printStats(std::ostream& out) {
+	std::vector<ZoneStats> zones = stats();
+	size_t nameWidth = 4;
+	for (const ZoneStats& zone : zones) nameWidth = std::max(nameWidth, zone.name.size() + (zone.gpu ? 6 : 0));
+
+	std::ios_base::fmtflags flags = out.flags();
+	out << std::left << std::setw(static_cast<int>(nameWidth)) << "zone" << std::right
+		<< std::setw(10) << "count" << std::setw(10) << "mean" << std::setw(10) << "p50"
+		<< std::setw(10) << "p95" << std::setw(10) << "p99" << "  (ms)" << std::endl;
+	out << std::fixed << std::setprecision(3);
+	for (const ZoneStats& zone : zones) {
+		out << std::left << std::setw(static_cast<int>(nameWidth)) << (zone.gpu ? "[GPU] " + zone.name : zone.name) << std::right
+			<< std::setw(10) << zone.count << std::setw(10) << zone.meanMs << std::setw(10) << zone.p50Ms
+			<< std::setw(10) << zone.p95Ms << std::setw(10) << zone.p99Ms << std::endl;
+	}
+	uint64_t dropped = droppedEvents();
+	if (dropped > 0) {
+		out << dropped << " events dropped, call Profiler::collect() more often" << std::endl;
+	}
+	out.flags(flags);
+}
+
+
+void Profiler::setCapture(bool capture) {
+	ProfilerState& s = state();
+	std::lock_guard<std::mutex> lock(s.collectMutex);
+	s.capturing = capture;
+}
+
+
+bool Profiler::writeChromeTrace(const fs::path& path) {
+	std::ofstream file(path);
+	if (!file.is_open()) {
+		return false;
+	}
+
+	ProfilerState& s = state();
+	std::lock_guard<std::mutex> lock(s.collectMutex);
+	file << "{\"traceEvents\":[\n";
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":" << GpuTrackId << ",\"args\":{\"name\":\"GPU\"}}";
+	file << std::fixed << std::setprecision(3);
+	for (const TraceEvent& traceEvent : s.trace) {
+		const Event& event = traceEvent.event;
+		// Zone names are string literals from the code, they need no escaping
+		file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":0,\"tid\":" << traceEvent.threadId
+			<< ",\"ts\":" << static_cast<double>(event.start) / 1e3
+			<< ",\"dur\":" << static_cast<double>(event.end - event.start) / 1e3 << "}";
+	}
+	file << "\n]}\n";
+	return file.good();
+}
+
+
+uint64_t Profiler::droppedEvents() {
+	ProfilerState& s = state();
+	std::lock_guard<std::mutex> lock(s.ringsMutex);
+	uint64_t total = 0;
+	for (const auto& ring : s.rings) {
+		total += ring->dropped.load(std::memory_order_relaxed);
+	}
+	return total;
+}
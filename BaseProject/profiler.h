@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <filesystem>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * Lightweight instrumentation of the frame loop and loaders.
+ *
+ *     void Renderer::MainLoop() {
+ *         PROFILE_ZONE("MainLoop");
+ *         ...
+ *     }
+ *
+ * Zones are named by string literals. Every thread records its zones into a
+ * fixed-size ring of its own, without any lock. Profiler::collect(), called
+ * once per frame by the frame loop, drains the rings into rolling per-zone
+ * statistics (p50/p95/p99 over the last samples) and, while capturing, into
+ * a trace that can be saved in the Chrome trace event format (open it in
+ * chrome://tracing or Perfetto).
+ *
+ * While the profiler is disabled a zone costs a relaxed atomic load.
+ * Building with PROFILER_DISABLED defined removes zones altogether.
+ */
+class Profiler {
+public:
+	struct ZoneStats {
+		std::string name;
+		bool gpu;
+		uint64_t count;  // since the profiler was enabled
+		double meanMs;   // over the rolling window
+		double p50Ms;
+		double p95Ms;
+		double p99Ms;
+	};
+
+	static void setEnabled(bool enabled);
+	static bool enabled() { return enabledFlag.load(std::memory_order_relaxed); }
+
+	// Nanoseconds on a monotonic clock
+	static uint64_t now();
+
+	// Record a finished zone from the calling thread
+	static void record(const char* name, uint64_t startNs, uint64_t endNs);
+
+	// Record work measured on the GPU, shown on a separate trace track.
+	// cpuNs places it on the timeline, for instance at submission time.
+	static void recordGpu(const char* name, uint64_t cpuNs, uint64_t durationNs);
+
+	// Move the events recorded by all threads into the statistics and trace
+	static void collect();
+
+	// Statistics of every zone seen so far, sorted by name
+	static std::vector<ZoneStats> stats();
+	static void printStats(std::ostream& out);
+
+	// Keep the collected events (up to a few million) for writeChromeTrace()
+	static void setCapture(bool capture);
+	static bool writeChromeTrace(const fs::path& path);
+
+	// Events lost because a thread ring was full between two collect()
+	static uint64_t droppedEvents();
+
+private:
+	static std::atomic<bool> enabledFlag;
+};
+
+
+class ProfileZone {
+public:
+	explicit ProfileZone(const char* name)
+		: name(name)
+		, active(Profiler::enabled())
+		, start(active ? Profiler::now() : 0)
+	{}
+
+	~ProfileZone() {
+		end();
+	}
+
+	// Close the zone before the end of the scope, for sequential phases
+	void end() {
+		if (active) {
+			Profiler::record(name, start, Profiler::now());
+			active = false;
+		}
+	}
+
+	ProfileZone(const ProfileZone&) = delete;
+	ProfileZone& operator=(const ProfileZone&) = delete;
+
+private:
+	const char* name;
+	bool active;
+	uint64_t start;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+
+#ifdef PROFILER_DISABLED
+#  define PROFILE_ZONE(name) ((void)0)
+#else
+// Time the rest of the enclosing scope
+#  define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone_, __LINE__)(name)
+#endif
@@ -0,0 +1,261 @@
+#include "recording-backend.h"
+#include "profiler.h"
+
+#include <ostream>
+
+using namespace wgpu;
+
+namespace {
+
+// Opaque handle of an object the backend only pretends to create
+template <typename Handle, typename Raw>
+Handle opaqueHandle(uint32_t id) {
+	return Handle(reinterpret_cast<Raw>(static_cast<uintptr_t>(id)));
+}
+
+// Bundle that drops every call, see NullBackend
+class NullBundleRecorder : public RenderBundleRecorder {
+public:
+	void setPipeline(RenderPipeline /* pipeline */) override {}
+	void setBindGroup(uint32_t /* groupIndex */, BindGroup /* group */,
+					uint32_t /* dynamicOffsetCount */, const uint32_t* /* dynamicOffsets */) override {}
+	void setVertexBuffer(uint32_t /* slot */, Buffer /* buffer */, uint64_t /* offset */, uint64_t /* size */) override {}
+	void setIndexBuffer(Buffer /* buffer */, IndexFormat /* format */, uint64_t /* offset */, uint64_t /* size */) override {}
+	void drawIndexed(uint32_t /* indexCount */, uint32_t /* instanceCount */,
+					uint32_t /* firstIndex */, int32_t /* baseVertex */, uint32_t /* firstInstance */) override {}
+	RenderBundle finish() override { return opaqueHandle<RenderBundle, WGPURenderBundle>(1); }
+};
+
+} // anonymous namespace
+
+
+// Bundle that logs the calls it receives, handed to its backend once finished
+class RecordingBackend::BundleRecorder : public RenderBundleRecorder {
+public:
+	explicit BundleRecorder(RecordingBackend& backend) : backend(backend) {}
+
+	void setPipeline(RenderPipeline /* pipeline */) override {
+		append(bundleLog, CommandType::SetPipeline, 0, 0, 0, 0);
+	}
+	void setBindGroup(uint32_t /* groupIndex */, BindGroup /* group */,
+					uint32_t dynamicOffsetCount, const uint32_t* /* dynamicOffsets */) override {
+		append(bundleLog, CommandType::SetBindGroup, 0, 0, dynamicOffsetCount, 0);
+	}
+	void setVertexBuffer(uint32_t /* slot */, Buffer buffer, uint64_t /* offset */, uint64_t size) override {
+		append(bundleLog, CommandType::SetVertexBuffer, bufferId(buffer), size, 0, 0);
+	}
+	void setIndexBuffer(Buffer buffer, IndexFormat /* format */, uint64_t /* offset */, uint64_t size) override {
+		append(bundleLog, CommandType::SetIndexBuffer, bufferId(buffer), size, 0, 0);
+	}
+	void drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+					uint32_t /* firstIndex */, int32_t /* baseVertex */, uint32_t /* firstInstance */) override {
+		append(bundleLog, CommandType::DrawIndexed, 0, 0, indexCount, instanceCount);
+	}
+
+	RenderBundle finish() override {
+		std::lock_guard<std::mutex> lock(backend.bundleMutex);
+		uint32_t id = backend.nextBundleId++;
+		backend.bundleLogs[id] = std::move(bundleLog);
+		return opaqueHandle<RenderBundle, WGPURenderBundle>(id);
+	}
+
+private:
+	RecordingBackend& backend;
+	std::vector<Command> bundleLog;
+};
+
+
+uint32_t RecordingBackend::bufferId(Buffer buffer) {
+	return static_cast<uint32_t>(reinterpret_cast<uintptr_t>(static_cast<WGPUBuffer>(buffer)));
+}
+
+
+void RecordingBackend::append(std::vector<Command>& log, CommandType type, uint32_t buffer, uint64_t bytes, uint32_t count, uint32_t instances) {
+	log.push_back({ type, buffer, bytes, count, instances, Profiler::now() });
+}
+
+
+void RecordingBackend::append(CommandType type, uint32_t buffer, uint64_t bytes, uint32_t count, uint32_t instances) {
+	append(log, type, buffer, bytes, count, instances);
+}
+
+
+Buffer RecordingBackend::createBuffer(const BufferDescriptor& descriptor) {
+	uint32_t id = nextBufferId++;
+	++live;
+	append(CommandType::CreateBuffer, id, descriptor.size, 0, 0);
+	return Buffer(reinterpret_cast<WGPUBuffer>(static_cast<uintptr_t>(id)));
+}
+
+
+void RecordingBackend::destroyBuffer(Buffer buffer) {
+	if (live > 0) --live;
+	append(CommandType::DestroyBuffer, bufferId(buffer), 0, 0, 0);
+}
+
+
+void RecordingBackend::writeBuffer(Buffer buffer, uint64_t /* offset */, const void* /* data */, size_t size) {
+	append(CommandType::WriteBuffer, bufferId(buffer), size, 0, 0);
+}
+
+
+ShaderModule RecordingBackend::createShaderModule(const ShaderModuleDescriptor& /* descriptor */) {
+	append(CommandType::CreateShaderModule, 0, 0, 0, 0);
+	return opaqueHandle<ShaderModule, WGPUShaderModule>(nextObjectId++);
+}
+
+
+BindGroupLayout RecordingBackend::createBindGroupLayout(const BindGroupLayoutDescriptor& descriptor) {
+	append(CommandType::CreateBindGroupLayout, 0, 0, static_cast<uint32_t>(descriptor.entryCount), 0);
+	return opaqueHandle<BindGroupLayout, WGPUBindGroupLayout>(nextObjectId++);
+}
+
+
+PipelineLayout RecordingBackend::createPipelineLayout(const PipelineLayoutDescriptor& descriptor) {
+	append(CommandType::CreatePipelineLayout, 0, 0, static_cast<uint32_t>(descriptor.bindGroupLayoutCount), 0);
+	return opaqueHandle<PipelineLayout, WGPUPipelineLayout>(nextObjectId++);
+}
+
+
+void RecordingBackend::createRenderPipelineAsync(const RenderPipelineDescriptor& /* descriptor */,
+												std::function<void(RenderPipeline)> done) {
+	append(CommandType::CreateRenderPipeline, 0, 0, 0, 0);
+	done(opaqueHandle<RenderPipeline, WGPURenderPipeline>(nextObjectId++));
+}
+
+
+std::unique_ptr<RenderBundleRecorder> RecordingBackend::createRenderBundleRecorder(const RenderBundleEncoderDescriptor& /* descriptor */) {
+	return std::make_unique<BundleRecorder>(*this);
+}
+
+
+void RecordingBackend::release(RenderBundle bundle) {
+	std::lock_guard<std::mutex> lock(bundleMutex);
+	bundleLogs.erase(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(static_cast<WGPURenderBundle>(bundle))));
+}
+
+
+const std::vector<RecordingBackend::Command>& RecordingBackend::bundleCommands(RenderBundle bundle) const {
+	std::lock_guard<std::mutex> lock(bundleMutex);
+	return bundleLogs.at(static_cast<uint32_t>(reinterpret_cast<uintptr_t>(static_cast<WGPURenderBundle>(bundle))));
+}
+
+
+size_t RecordingBackend::liveBundles() const {
+	std::lock_guard<std::mutex> lock(bundleMutex);
+	return bundleLogs.size();
+}
+
+
+void RecordingBackend::setPipeline(RenderPipeline /* pipeline */) {
+	append(CommandType::SetPipeline, 0, 0, 0, 0);
+}
+
+
+void RecordingBackend::setBindGroup(uint32_t /* groupIndex */, BindGroup /* group */,
+									uint32_t dynamicOffsetCount, const uint32_t* /* dynamicOffsets */) {
+	append(CommandType::SetBindGroup, 0, 0, dynamicOffsetCount, 0);
+}
+
+
+void RecordingBackend::setVertexBuffer(uint32_t /* slot */, Buffer buffer, uint64_t /* offset */, uint64_t size) {
+	append(CommandType::SetVertexBuffer, bufferId(buffer), size, 0, 0);
+}
+
+
+void RecordingBackend::setIndexBuffer(Buffer buffer, IndexFormat /* format */, uint64_t /* offset */, uint64_t size) {
+	append(CommandType::SetIndexBuffer, bufferId(buffer), size, 0, 0);
+}
+
+
+void RecordingBackend::drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+								uint32_t /* firstIndex */, int32_t /* baseVertex */, uint32_t /* firstInstance */) {
+	append(CommandType::DrawIndexed, 0, 0, indexCount, instanceCount);
+}
+
+
+void RecordingBackend::executeBundles(size_t bundleCount, const RenderBundle* /* bundles */) {
+	append(CommandType::ExecuteBundles, 0, 0, static_cast<uint32_t>(bundleCount), 0);
+}
+
+
+size_t RecordingBackend::count(CommandType type) const {
+	size_t total = 0;
+	for (const Command& command : log) {
+		if (command.type == type) ++total;
+	}
+	return total;
+}
+
+
+uint64_t RecordingBackend::bytes(CommandType type) const {
+	uint64_t total = 0;
+	for (const Command& command : log) {
+		if (command.type == type) total += command.bytes;
+	}
+	return total;
+}
+
+
+void RecordingBackend::print(std::ostream& out) const {
+	uint64_t origin = log.empty() ? 0 : log.front().timeNs;
+	for (const Command& command : log) {
+		out << "+" << (command.timeNs - origin) << " ns  " << name(command.type);
+		if (command.buffer != 0) out << " buffer=" << command.buffer;
+		if (command.bytes != 0) out << " bytes=" << command.bytes;
+		if (command.count != 0) out << " count=" << command.count;
+		if (command.instances != 0) out << " instances=" << command.instances;
+		out << std::endl;
+	}
+}
+
+
+const char* RecordingBackend::name(CommandType type) {
+	switch (type) {
+	case CommandType::CreateBuffer: return "createBuffer";
+	case CommandType::DestroyBuffer: return "destroyBuffer";
+	case CommandType::WriteBuffer: return "writeBuffer";
+	case CommandType::CreateShaderModule: return "createShaderModule";
+	case CommandType::CreateBindGroupLayout: return "createBindGroupLayout";
+	case CommandType::CreatePipelineLayout: return "createPipelineLayout";
+	case CommandType::CreateRenderPipeline: return "createRenderPipeline";
+	case CommandType::SetPipeline: return "setPipeline";
+	case CommandType::SetBindGroup: return "setBindGroup";
+	case CommandType::SetVertexBuffer: return "setVertexBuffer";
+	case CommandType::SetIndexBuffer: return "setIndexBuffer";
+	case CommandType::DrawIndexed: return "drawIndexed";
+	case CommandType::ExecuteBundles: return "executeBundles";
+	}
+	return "unknown";
+}
+
+
+Buffer NullBackend::createBuffer(const BufferDescriptor& /* descriptor */) {
+	return Buffer(reinterpret_cast<WGPUBuffer>(static_cast<uintptr_t>(nextBufferId++)));
+}
+
+
+ShaderModule NullBackend::createShaderModule(const ShaderModuleDescriptor& /* descriptor */) {
+	return opaqueHandle<ShaderModule, WGPUShaderModule>(nextObjectId++);
+}
+
+
+BindGroupLayout NullBackend::createBindGroupLayout(const BindGroupLayoutDescriptor& /* descriptor */) {
+	return opaqueHandle<BindGroupLayout, WGPUBindGroupLayout>(nextObjectId++);
+}
+
+
+PipelineLayout NullBackend::createPipelineLayout(const PipelineLayoutDescriptor& /* descriptor */) {
+	return opaqueHandle<PipelineLayout, WGPUPipelineLayout>(nextObjectId++);
+}
+
+
+void NullBackend::createRenderPipelineAsync(const RenderPipelineDescriptor& /* descriptor */,
+											std::function<void(RenderPipeline)> done) {
+	done(opaqueHandle<RenderPipeline, WGPURenderPipeline>(nextObjectId++));
+}
+
+
+std::unique_ptr<RenderBundleRecorder> NullBackend::createRenderBundleRecorder(const RenderBundleEncoderDescriptor& /* descriptor */) {
+	return std::make_unique<NullBundleRecorder>();
+}
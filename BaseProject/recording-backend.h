@@ -0,0 +1,150 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <map>
+#include <mutex>
+#include <vector>
+#include <iosfwd>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * GpuBackend and render pass that do not talk to any GPU, but keep a log of
+ * the calls they receive, with their sizes and the time they were made at.
+ * Buffers and pipeline objects it creates are opaque handles that must not
+ * be passed to a real WebGPU object. Pipelines are ready right away.
+ *
+ * Used by the benchmarks to measure the CPU cost of encoding a frame and to
+ * count what a frame would send to the GPU. clear() keeps the memory of the
+ * log, so that recording a frame like the previous one does not allocate.
+ *
+ * Render bundles have logs of their own, so that they can be recorded on
+ * other threads; the pass only logs the bundles it executes.
+ */
+class RecordingBackend : public GpuBackend, public RenderPassCommands {
+public:
+	enum class CommandType {
+		CreateBuffer,
+		DestroyBuffer,
+		WriteBuffer,
+		CreateShaderModule,
+		CreateBindGroupLayout,
+		CreatePipelineLayout,
+		CreateRenderPipeline,
+		SetPipeline,
+		SetBindGroup,
+		SetVertexBuffer,
+		SetIndexBuffer,
+		DrawIndexed,
+		ExecuteBundles,
+	};
+
+	struct Command {
+		CommandType type;
+		uint32_t buffer;    // id of the buffer involved, 0 if none
+		uint64_t bytes;     // size created, written or bound
+		uint32_t count;     // dynamic offsets, indices per instance, or bundles
+		uint32_t instances; // instance count of draws
+		uint64_t timeNs;    // when the call was made, on the Profiler::now() clock
+	};
+
+	wgpu::Buffer createBuffer(const wgpu::BufferDescriptor& descriptor) override;
+	void destroyBuffer(wgpu::Buffer buffer) override;
+	void writeBuffer(wgpu::Buffer buffer, uint64_t offset, const void* data, size_t size) override;
+
+	wgpu::ShaderModule createShaderModule(const wgpu::ShaderModuleDescriptor& descriptor) override;
+	wgpu::BindGroupLayout createBindGroupLayout(const wgpu::BindGroupLayoutDescriptor& descriptor) override;
+	wgpu::PipelineLayout createPipelineLayout(const wgpu::PipelineLayoutDescriptor& descriptor) override;
+	void createRenderPipelineAsync(const wgpu::RenderPipelineDescriptor& descriptor,
+								std::function<void(wgpu::RenderPipeline)> done) override;
+	void release(wgpu::ShaderModule /* shaderModule */) override {}
+	void release(wgpu::BindGroupLayout /* bindGroupLayout */) override {}
+	void release(wgpu::PipelineLayout /* pipelineLayout */) override {}
+	void release(wgpu::RenderPipeline /* pipeline */) override {}
+	std::unique_ptr<RenderBundleRecorder> createRenderBundleRecorder(
+		const wgpu::RenderBundleEncoderDescriptor& descriptor) override;
+	void release(wgpu::RenderBundle bundle) override;
+
+	void setPipeline(wgpu::RenderPipeline pipeline) override;
+	void setBindGroup(uint32_t groupIndex, wgpu::BindGroup group,
+					uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) override;
+	void setVertexBuffer(uint32_t slot, wgpu::Buffer buffer, uint64_t offset, uint64_t size) override;
+	void setIndexBuffer(wgpu::Buffer buffer, wgpu::IndexFormat format, uint64_t offset, uint64_t size) override;
+	void drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+					uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) override;
+	void executeBundles(size_t bundleCount, const wgpu::RenderBundle* bundles);
+
+	const std::vector<Command>& commands() const { return log; }
+	// Commands of a bundle finished and not released yet
+	const std::vector<Command>& bundleCommands(wgpu::RenderBundle bundle) const;
+	// Bundles finished and not released yet
+	size_t liveBundles() const;
+	size_t count(CommandType type) const;
+	uint64_t bytes(CommandType type) const;
+
+	// Buffers created and not destroyed yet
+	uint32_t liveBuffers() const { return live; }
+
+	// Forget the recorded commands, buffers stay valid
+	void clear() { log.clear(); }
+
+	// One line per command, for debugging
+	void print(std::ostream& out) const;
+
+	static const char* name(CommandType type);
+
+private:
+	class BundleRecorder;
+
+	static uint32_t bufferId(wgpu::Buffer buffer);
+	static void append(std::vector<Command>& log, CommandType type, uint32_t buffer, uint64_t bytes, uint32_t count, uint32_t instances);
+	void append(CommandType type, uint32_t buffer, uint64_t bytes, uint32_t count, uint32_t instances);
+
+	std::vector<Command> log;
+	uint32_t nextBufferId = 1;
+	uint32_t nextObjectId = 1;
+	uint32_t live = 0;
+	// Logs of the finished bundles, by id, which recorders add from any thread
+	mutable std::mutex bundleMutex;
+	std::map<uint32_t, std::vector<Command>> bundleLogs;
+	uint32_t nextBundleId = 1;
+};
+
+
+/**
+ * GpuBackend and render pass that drop every call. Gives the cost of the
+ * renderer's own code, without that of the recording.
+ */
+class NullBackend : public GpuBackend, public RenderPassCommands {
+public:
+	wgpu::Buffer createBuffer(const wgpu::BufferDescriptor& descriptor) override;
+	void destroyBuffer(wgpu::Buffer /* buffer */) override {}
+	void writeBuffer(wgpu::Buffer /* buffer */, uint64_t /* offset */, const void* /* data */, size_t /* size */) override {}
+
+	wgpu::ShaderModule createShaderModule(const wgpu::ShaderModuleDescriptor& descriptor) override;
+	wgpu::BindGroupLayout createBindGroupLayout(const wgpu::BindGroupLayoutDescriptor& descriptor) override;
+	wgpu::PipelineLayout createPipelineLayout(const wgpu::PipelineLayoutDescriptor& descriptor) override;
+	void createRenderPipelineAsync(const wgpu::RenderPipelineDescriptor& descriptor,
+								std::function<void(wgpu::RenderPipeline)> done) override;
+	void release(wgpu::ShaderModule /* shaderModule */) override {}
+	void release(wgpu::BindGroupLayout /* bindGroupLayout */) override {}
+	void release(wgpu::PipelineLayout /* pipelineLayout */) override {}
+	void release(wgpu::RenderPipeline /* pipeline */) override {}
+	std::unique_ptr<RenderBundleRecorder> createRenderBundleRecorder(
+		const wgpu::RenderBundleEncoderDescriptor& descriptor) override;
+	void release(wgpu::RenderBundle /* bundle */) override {}
+
+	void setPipeline(wgpu::RenderPipeline /* pipeline */) override {}
+	void setBindGroup(uint32_t /* groupIndex */, wgpu::BindGroup /* group */,
+					uint32_t /* dynamicOffsetCount */, const uint32_t* /* dynamicOffsets */) override {}
+	void setVertexBuffer(uint32_t /* slot */, wgpu::Buffer /* buffer */, uint64_t /* offset */, uint64_t /* size */) override {}
+	void setIndexBuffer(wgpu::Buffer /* buffer */, wgpu::IndexFormat /* format */, uint64_t /* offset */, uint64_t /* size */) override {}
+	void drawIndexed(uint32_t /* indexCount */, uint32_t /* instanceCount */,
+					uint32_t /* firstIndex */, int32_t /* baseVertex */, uint32_t /* firstInstance */) override {}
+	void executeBundles(size_t /* bundleCount */, const wgpu::RenderBundle* /* bundles */) {}
+
+private:
+	uint32_t nextBufferId = 1;
+	uint32_t nextObjectId = 1;
+};
@@ -0,0 +1,309 @@
+#include "render-bundles.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <cassert>
+#include <cstring>
+
+using namespace wgpu;
+
+static_assert(sizeof(DrawList::Command) == 72, "DrawList::Command must not have padding, it is hashed as bytes");
+
+namespace {
+
+constexpr size_t None = SIZE_MAX;
+
+template <typename Raw>
+uint64_t handleBits(Raw raw) {
+	return static_cast<uint64_t>(reinterpret_cast<uintptr_t>(raw));
+}
+
+template <typename Handle, typename Raw>
+Handle handleFrom(uint64_t bits) {
+	return Handle(reinterpret_cast<Raw>(static_cast<uintptr_t>(bits)));
+}
+
+// FNV-1a on 64-bit words, as PipelineCache hashes its keys, continued over
+// several runs of commands
+uint64_t hashCommands(uint64_t hash, const DrawList::Command* commands, size_t count) {
+	const uint8_t* bytes = reinterpret_cast<const uint8_t*>(commands);
+	size_t size = count * sizeof(DrawList::Command);
+	for (size_t i = 0; i < size; i += 8) {
+		uint64_t word;
+		std::memcpy(&word, bytes + i, 8);
+		hash = (hash ^ word) * 1099511628211ull;
+	}
+	return hash;
+}
+
+} // anonymous namespace
+
+
+void DrawList::clear() {
+	list.clear();
+	draws = 0;
+}
+
+
+void DrawList::setPipeline(RenderPipeline pipeline) {
+	Command command = {};
+	command.type = CommandType::SetPipeline;
+	command.handle = handleBits(static_cast<WGPURenderPipeline>(pipeline));
+	list.push_back(command);
+}
+
+
+void DrawList::setBindGroup(uint32_t groupIndex, BindGroup group,
+							uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) {
+	assert(dynamicOffsetCount <= MaxDynamicOffsets);
+	Command command = {};
+	command.type = CommandType::SetBindGroup;
+	command.slot = groupIndex;
+	command.handle = handleBits(static_cast<WGPUBindGroup>(group));
+	command.dynamicOffsetCount = std::min(dynamicOffsetCount, MaxDynamicOffsets);
+	std::copy(dynamicOffsets, dynamicOffsets + command.dynamicOffsetCount, command.dynamicOffsets);
+	list.push_back(command);
+}
+
+
+void DrawList::setVertexBuffer(uint32_t slot, Buffer buffer, uint64_t offset, uint64_t size) {
+	Command command = {};
+	command.type = CommandType::SetVertexBuffer;
+	command.slot = slot;
+	command.handle = handleBits(static_cast<WGPUBuffer>(buffer));
+	command.offset = offset;
+	command.size = size;
+	list.push_back(command);
+}
+
+
+void DrawList::setIndexBuffer(Buffer buffer, IndexFormat format, uint64_t offset, uint64_t size) {
+	Command command = {};
+	command.type = CommandType::SetIndexBuffer;
+	command.slot = static_cast<uint32_t>(format);
+	command.handle = handleBits(static_cast<WGPUBuffer>(buffer));
+	command.offset = offset;
+	command.size = size;
+	list.push_back(command);
+}
+
+
+void DrawList::drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+							uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) {
+	Command command = {};
+	command.type = CommandType::DrawIndexed;
+	command.indexCount = indexCount;
+	command.instanceCount = instanceCount;
+	command.firstIndex = firstIndex;
+	command.baseVertex = baseVertex;
+	command.firstInstance = firstInstance;
+	list.push_back(command);
+	++draws;
+}
+
+
+void DrawList::replay(RenderPassCommands& out) const {
+	for (const Command& command : list) {
+		send(out, command);
+	}
+}
+
+
+void DrawList::send(RenderPassCommands& out, const Command& command) {
+	switch (command.type) {
+	case CommandType::SetPipeline:
+		out.setPipeline(handleFrom<RenderPipeline, WGPURenderPipeline>(command.handle));
+		break;
+	case CommandType::SetBindGroup:
+		out.setBindGroup(command.slot, handleFrom<BindGroup, WGPUBindGroup>(command.handle),
+						command.dynamicOffsetCount, command.dynamicOffsets);
+		break;
+	case CommandType::SetVertexBuffer:
+		out.setVertexBuffer(command.slot, handleFrom<Buffer, WGPUBuffer>(command.handle), command.offset, command.size);
+		break;
+	case CommandType::SetIndexBuffer:
+		out.setIndexBuffer(handleFrom<Buffer, WGPUBuffer>(command.handle), IndexFormat(static_cast<WGPUIndexFormat>(command.slot)),
+						command.offset, command.size);
+		break;
+	case CommandType::DrawIndexed:
+		out.drawIndexed(command.indexCount, command.instanceCount, command.firstIndex, command.baseVertex, command.firstInstance);
+		break;
+	}
+}
+
+
+RenderBundles::RenderBundles(GpuBackend& backend, WGPUTextureFormat colorFormat, WGPUTextureFormat depthStencilFormat)
+	: backend(backend)
+	, colorFormat(colorFormat)
+{
+	descriptor.label = "Scene bundle";
+	descriptor.colorFormatCount = 1;
+	descriptor.colorFormats = &this->colorFormat;
+	descriptor.depthStencilFormat = depthStencilFormat;
+	descriptor.sampleCount = 1;
+	descriptor.depthReadOnly = false;
+	descriptor.stencilReadOnly = true;
+}
+
+
+RenderBundles::~RenderBundles() {
+	clear();
+}
+
+
+void RenderBundles::clear() {
+	for (auto& entry : cache) {
+		backend.release(entry.second.bundle);
+	}
+	cache.clear();
+	for (RenderBundle bundle : uncached) {
+		backend.release(bundle);
+	}
+	uncached.clear();
+	bundles.clear();
+}
+
+
+const std::vector<RenderBundle>& RenderBundles::record(const DrawList& draws, ThreadPool* pool) {
+	PROFILE_ZONE("Render bundles");
+	for (RenderBundle bundle : uncached) {
+		backend.release(bundle);
+	}
+	uncached.clear();
+	bundles.clear();
+	recorded = 0;
+	reused = 0;
+	++frame;
+	if (draws.drawCount() == 0) {
+		return bundles;
+	}
+
+	// Cut after every drawsPerSlice draws, and keep the commands that set the
+	// state in effect at every cut
+	using Command = DrawList::Command;
+	using CommandType = DrawList::CommandType;
+	const std::vector<Command>& commands = draws.commands();
+	size_t threadCount = pool ? pool->threadCount() : 1;
+	size_t sliceCount = std::max<size_t>(1, std::min(threadCount, draws.drawCount() / MinDrawsPerBundle));
+	size_t drawsPerSlice = (draws.drawCount() + sliceCount - 1) / sliceCount;
+	slices.resize(sliceCount);
+
+	size_t pipeline = None;
+	size_t indexBuffer = None;
+	std::array<size_t, MaxBindGroups> bindGroups;
+	std::array<size_t, MaxVertexBuffers> vertexBuffers;
+	bindGroups.fill(None);
+	vertexBuffers.fill(None);
+	auto startSlice = [&](Slice& slice, size_t first) {
+		slice.state.clear();
+		for (size_t index : { pipeline, indexBuffer }) {
+			if (index != None) slice.state.push_back(commands[index]);
+		}
+		for (size_t index : bindGroups) {
+			if (index != None) slice.state.push_back(commands[index]);
+		}
+		for (size_t index : vertexBuffers) {
+			if (index != None) slice.state.push_back(commands[index]);
+		}
+		slice.first = first;
+	};
+
+	size_t sliceIndex = 0;
+	size_t sliceDraws = 0;
+	startSlice(slices[0], 0);
+	for (size_t i = 0; i < commands.size(); ++i) {
+		const Command& command = commands[i];
+		switch (command.type) {
+		case CommandType::SetPipeline: pipeline = i; break;
+		case CommandType::SetIndexBuffer: indexBuffer = i; break;
+		case CommandType::SetBindGroup:
+			assert(command.slot < MaxBindGroups);
+			bindGroups[command.slot] = i;
+			break;
+		case CommandType::SetVertexBuffer:
+			assert(command.slot < MaxVertexBuffers);
+			vertexBuffers[command.slot] = i;
+			break;
+		case CommandType::DrawIndexed:
+			if (++sliceDraws == drawsPerSlice && sliceIndex + 1 < sliceCount) {
+				slices[sliceIndex].end = i + 1;
+				startSlice(slices[++sliceIndex], i + 1);
+				sliceDraws = 0;
+			}
+			break;
+		}
+	}
+	slices[sliceIndex].end = commands.size();
+	slices.resize(sliceIndex + 1);
+
+	// Reuse the bundles that hold the same commands and record the others,
+	// a slice per task. The cache is only read meanwhile.
+	auto recordSlice = [&](size_t index) {
+		Slice& slice = slices[index];
+		size_t stateCount = slice.state.size();
+		size_t rangeCount = slice.end - slice.first;
+		slice.hash = hashCommands(14695981039346656037ull, slice.state.data(), stateCount);
+		slice.hash = hashCommands(slice.hash, commands.data() + slice.first, rangeCount);
+		auto it = cache.find(slice.hash);
+		const CachedBundle* entry = it != cache.end() ? &it->second : nullptr;
+		slice.cached = entry && entry->commands.size() == stateCount + rangeCount
+			&& std::memcmp(entry->commands.data(), slice.state.data(), stateCount * sizeof(Command)) == 0
+			&& std::memcmp(entry->commands.data() + stateCount, commands.data() + slice.first, rangeCount * sizeof(Command)) == 0;
+		if (slice.cached) {
+			slice.bundle = entry->bundle;
+			return;
+		}
+		std::unique_ptr<RenderBundleRecorder> recorder = backend.createRenderBundleRecorder(descriptor);
+		for (const Command& command : slice.state) {
+			DrawList::send(*recorder, command);
+		}
+		for (size_t i = slice.first; i < slice.end; ++i) {
+			DrawList::send(*recorder, commands[i]);
+		}
+		slice.bundle = recorder->finish();
+	};
+	if (pool && slices.size() > 1) {
+		pool->parallelFor(slices.size(), recordSlice);
+	}
+	else {
+		for (size_t index = 0; index < slices.size(); ++index) {
+			recordSlice(index);
+		}
+	}
+
+	for (Slice& slice : slices) {
+		bundles.push_back(slice.bundle);
+		CachedBundle& entry = cache[slice.hash];
+		if (slice.cached) {
+			entry.lastFrame = frame;
+			++reused;
+			continue;
+		}
+		++recorded;
+		if (entry.bundle && entry.lastFrame == frame) {
+			// Another bundle of this frame has the same hash
+			uncached.push_back(slice.bundle);
+			continue;
+		}
+		if (entry.bundle) {
+			backend.release(entry.bundle);
+		}
+		entry.commands.assign(slice.state.begin(), slice.state.end());
+		entry.commands.insert(entry.commands.end(), commands.begin() + slice.first, commands.begin() + slice.end);
+		entry.bundle = slice.bundle;
+		entry.lastFrame = frame;
+	}
+
+	// Forget the bundles that were not used for a while
+	for (auto it = cache.begin(); it != cache.end();) {
+		if (frame - it->second.lastFrame >= KeepFrames) {
+			backend.release(it->second.bundle);
+			it = cache.erase(it);
+		}
+		else {
+			++it;
+		}
+	}
+	return bundles;
+}
@@ -0,0 +1,147 @@
+#pragma once
+
+#include "gpu-backend.h"
+#include "thread-pool.h"
+
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Draws of a frame recorded into render bundles on the threads of a pool,
+ * for the render pass to replay with executeBundles().
+ *
+ *     drawList.clear();
+ *     encodeScene(drawList, scene, dynamicOffset, instances);  // captured only
+ *     const auto& bundles = renderBundles.record(drawList, &ThreadPool::shared());
+ *     pass.executeBundles(bundles.size(), bundles.data());
+ *
+ * The draw list is cut in slices of about the same number of draws, one per
+ * thread and none smaller than MinDrawsPerBundle. A bundle inherits no state
+ * from the pass, so every slice starts by setting again the pipeline, bind
+ * groups and buffers in effect where it was cut.
+ *
+ * Bundles are cached by the commands they hold: a slice that sends the same
+ * commands as one recorded in the last KeepFrames frames reuses its bundle
+ * and records nothing, which is what static content does. The uniform ring
+ * moves the dynamic offset of a frame through a few regions, so such
+ * content keeps one bundle per region. Bundles reference objects by handle:
+ * clear() the cache before releasing any of them.
+ */
+
+// Commands of a render pass kept on the CPU, to be sent later
+class DrawList : public RenderPassCommands {
+public:
+	// Dynamic offsets kept per setBindGroup()
+	static constexpr uint32_t MaxDynamicOffsets = 4;
+
+	enum class CommandType : uint32_t {
+		SetPipeline,
+		SetBindGroup,
+		SetVertexBuffer,
+		SetIndexBuffer,
+		DrawIndexed,
+	};
+
+	// The fields of its type, the others left at 0, so that commands compare
+	// and hash as bytes
+	struct Command {
+		CommandType type;
+		uint32_t slot;      // bind group index, vertex buffer slot, or index format
+		uint64_t handle;    // pipeline, bind group or buffer
+		uint64_t offset;
+		uint64_t size;
+		uint32_t indexCount;
+		uint32_t instanceCount;
+		uint32_t firstIndex;
+		int32_t baseVertex;
+		uint32_t firstInstance;
+		uint32_t dynamicOffsetCount;
+		uint32_t dynamicOffsets[MaxDynamicOffsets];
+	};
+
+	void clear();
+
+	void setPipeline(wgpu::RenderPipeline pipeline) override;
+	void setBindGroup(uint32_t groupIndex, wgpu::BindGroup group,
+					uint32_t dynamicOffsetCount, const uint32_t* dynamicOffsets) override;
+	void setVertexBuffer(uint32_t slot, wgpu::Buffer buffer, uint64_t offset, uint64_t size) override;
+	void setIndexBuffer(wgpu::Buffer buffer, wgpu::IndexFormat format, uint64_t offset, uint64_t size) override;
+	void drawIndexed(uint32_t indexCount, uint32_t instanceCount,
+					uint32_t firstIndex, int32_t baseVertex, uint32_t firstInstance) override;
+
+	const std::vector<Command>& commands() const { return list; }
+	size_t drawCount() const { return draws; }
+
+	// Send the commands to a pass or a bundle
+	void replay(RenderPassCommands& out) const;
+	static void send(RenderPassCommands& out, const Command& command);
+
+private:
+	std::vector<Command> list;
+	size_t draws = 0;
+};
+
+
+class RenderBundles {
+public:
+	// Bundles for the render passes with these attachments
+	RenderBundles(GpuBackend& backend, WGPUTextureFormat colorFormat, WGPUTextureFormat depthStencilFormat);
+	~RenderBundles();
+
+	RenderBundles(const RenderBundles&) = delete;
+	RenderBundles& operator=(const RenderBundles&) = delete;
+
+	// Record the bundles of a draw list, on the threads of pool or on the
+	// calling thread without one, and return them in the order to execute
+	// them. They stay valid until the next record() or clear().
+	const std::vector<wgpu::RenderBundle>& record(const DrawList& draws, ThreadPool* pool);
+
+	// Release every bundle
+	void clear();
+
+	// Bundles the last record() recorded and reused, and those cached
+	uint32_t lastRecorded() const { return recorded; }
+	uint32_t lastReused() const { return reused; }
+	size_t cachedCount() const { return cache.size(); }
+
+	// Bundles do not get fewer draws than this, but for the last one
+	static constexpr size_t MinDrawsPerBundle = 128;
+	// Frames a bundle stays cached without being used
+	static constexpr uint64_t KeepFrames = 4;
+
+private:
+	// Bind groups and vertex buffers whose state is carried over the cuts
+	static constexpr uint32_t MaxBindGroups = 4;
+	static constexpr uint32_t MaxVertexBuffers = 8;
+
+	// Commands of a bundle: those that set the state in effect at the cut,
+	// then the commands [first, end) of the draw list
+	struct Slice {
+		std::vector<DrawList::Command> state;
+		size_t first = 0;
+		size_t end = 0;
+		uint64_t hash = 0;
+		wgpu::RenderBundle bundle = nullptr;
+		bool cached = false;
+	};
+	struct CachedBundle {
+		std::vector<DrawList::Command> commands;
+		wgpu::RenderBundle bundle = nullptr;
+		uint64_t lastFrame = 0;
+	};
+
+	GpuBackend& backend;
+	WGPUTextureFormat colorFormat;
+	wgpu::RenderBundleEncoderDescriptor descriptor;
+	std::vector<Slice> slices;
+	// Keyed by the hash of the commands
+	std::unordered_map<uint64_t, CachedBundle> cache;
+	// Bundles of the last record() that could not be cached
+	std::vector<wgpu::RenderBundle> uncached;
+	std::vector<wgpu::RenderBundle> bundles;
+	uint64_t frame = 0;
+	uint32_t recorded = 0;
+	uint32_t reused = 0;
+};
@@ -0,0 +1,318 @@
+#include "render-graph.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cassert>
+#include <iostream>
+
+using namespace wgpu;
+
+namespace {
+
+// Bytes per texel of the formats render targets use, 4 for the others
+uint64_t texelSize(WGPUTextureFormat format) {
+	switch (format) {
+	case TextureFormat::R8Unorm:
+	case TextureFormat::Stencil8:
+		return 1;
+	case TextureFormat::R16Float:
+	case TextureFormat::RG8Unorm:
+	case TextureFormat::Depth16Unorm:
+		return 2;
+	case TextureFormat::RG32Float:
+	case TextureFormat::RGBA16Float:
+		return 8;
+	case TextureFormat::RGBA32Float:
+		return 16;
+	default:
+		return 4;
+	}
+}
+
+bool sameShape(const GraphTextureDesc& a, const GraphTextureDesc& b) {
+	return a.width == b.width && a.height == b.height && a.format == b.format
+		&& a.mipLevelCount == b.mipLevelCount && a.sampleCount == b.sampleCount;
+}
+
+bool mappable(const GraphBufferDesc& desc) {
+	return (desc.usage & (WGPUBufferUsage_MapRead | WGPUBufferUsage_MapWrite)) != 0;
+}
+
+} // anonymous namespace
+
+
+void RenderGraph::clear() {
+	resources.clear();
+	passes.clear();
+	order.clear();
+	allocationList.clear();
+	lastStats = RenderGraphStats();
+	isCompiled = false;
+}
+
+
+RenderGraph::ResourceId RenderGraph::createTexture(const std::string& name, const GraphTextureDesc& desc) {
+	Resource resource;
+	resource.name = name;
+	resource.textureDesc = desc;
+	return addResource(std::move(resource));
+}
+
+
+RenderGraph::ResourceId RenderGraph::createBuffer(const std::string& name, const GraphBufferDesc& desc) {
+	Resource resource;
+	resource.name = name;
+	resource.texture = false;
+	resource.bufferDesc = desc;
+	return addResource(std::move(resource));
+}
+
+
+RenderGraph::ResourceId RenderGraph::importTexture(const std::string& name) {
+	Resource resource;
+	resource.name = name;
+	resource.imported = true;
+	return addResource(std::move(resource));
+}
+
+
+RenderGraph::ResourceId RenderGraph::importBuffer(const std::string& name) {
+	Resource resource;
+	resource.name = name;
+	resource.texture = false;
+	resource.imported = true;
+	return addResource(std::move(resource));
+}
+
+
+RenderGraph::ResourceId RenderGraph::addResource(Resource resource) {
+	resources.push_back(std::move(resource));
+	isCompiled = false;
+	return static_cast<ResourceId>(resources.size() - 1);
+}
+
+
+RenderGraph::PassId RenderGraph::addPass(const std::string& name, Execute execute) {
+	Pass pass;
+	pass.name = name;
+	pass.execute = std::move(execute);
+	passes.push_back(std::move(pass));
+	isCompiled = false;
+	return static_cast<PassId>(passes.size() - 1);
+}
+
+
+void RenderGraph::read(PassId pass, ResourceId resource) {
+	access(pass, resource, AccessType::Read);
+}
+
+
+void RenderGraph::write(PassId pass, ResourceId resource) {
+	access(pass, resource, AccessType::Write);
+}
+
+
+void RenderGraph::colorAttachment(PassId pass, ResourceId resource) {
+	assert(resources[resource].texture);
+	access(pass, resource, AccessType::ColorAttachment);
+}
+
+
+void RenderGraph::depthAttachment(PassId pass, ResourceId resource) {
+	assert(resources[resource].texture);
+	access(pass, resource, AccessType::DepthAttachment);
+}
+
+
+void RenderGraph::access(PassId pass, ResourceId resource, AccessType type) {
+	assert(pass < passes.size() && resource < resources.size());
+	passes[pass].accesses.push_back({ resource, type });
+	isCompiled = false;
+}
+
+
+void RenderGraph::keepPass(PassId pass) {
+	passes[pass].keep = true;
+	isCompiled = false;
+}
+
+
+void RenderGraph::execute(PassId pass, WebGpuRenderPass& renderPass) const {
+	if (passes[pass].execute) {
+		passes[pass].execute(renderPass);
+	}
+}
+
+
+bool RenderGraph::compile() {
+	auto start = std::chrono::steady_clock::now();
+	isCompiled = false;
+
+	// Walk back from the outputs: a pass lives if it writes a resource that
+	// a later live pass uses, and then needs everything it uses itself, as
+	// a write keeps what earlier passes wrote
+	std::vector<uint8_t> needed(resources.size(), 0);
+	for (size_t p = passes.size(); p-- > 0;) {
+		Pass& pass = passes[p];
+		pass.live = pass.keep;
+		for (const Access& access : pass.accesses) {
+			if (access.type != AccessType::Read && (needed[access.resource] || resources[access.resource].imported)) {
+				pass.live = true;
+			}
+		}
+		if (pass.live) {
+			for (const Access& access : pass.accesses) {
+				needed[access.resource] = 1;
+			}
+		}
+	}
+
+	// Lifetimes, as indices in the order of the live passes
+	order.clear();
+	for (Resource& resource : resources) {
+		resource.firstUse = UINT32_MAX;
+		resource.lastUse = 0;
+		resource.allocation = NoAllocation;
+	}
+	for (PassId p = 0; p < passes.size(); ++p) {
+		if (!passes[p].live) {
+			continue;
+		}
+		uint32_t index = static_cast<uint32_t>(order.size());
+		order.push_back(p);
+		for (const Access& access : passes[p].accesses) {
+			Resource& resource = resources[access.resource];
+			if (resource.firstUse == UINT32_MAX && access.type == AccessType::Read && !resource.imported) {
+				std::cout << "*** ERROR *** Render graph pass " << passes[p].name << " reads "
+					<< resource.name << " before any pass writes it" << std::endl;
+				return false;
+			}
+			resource.firstUse = std::min(resource.firstUse, index);
+			resource.lastUse = index;
+		}
+	}
+	for (uint32_t index = 0; index < order.size(); ++index) {
+		for (Access& access : passes[order[index]].accesses) {
+			access.first = resources[access.resource].firstUse == index;
+			access.last = resources[access.resource].lastUse == index;
+		}
+	}
+
+	allocate();
+
+	lastStats = RenderGraphStats();
+	lastStats.passCount = static_cast<uint32_t>(passes.size());
+	lastStats.culledPassCount = static_cast<uint32_t>(passes.size() - order.size());
+	for (const Resource& resource : resources) {
+		if (resource.imported) {
+			continue;
+		}
+		++lastStats.resourceCount;
+		if (resource.allocation == NoAllocation) {
+			++lastStats.culledResourceCount;
+		}
+		else {
+			lastStats.requestedBytes += resource.texture ? textureBytes(resource.textureDesc) : resource.bufferDesc.size;
+		}
+	}
+	lastStats.allocationCount = static_cast<uint32_t>(allocationList.size());
+	for (const Allocation& allocation : allocationList) {
+		lastStats.allocatedBytes += allocation.bytes;
+	}
+	lastStats.compileMicroseconds = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+	isCompiled = true;
+	return true;
+}
+
+
+void RenderGraph::allocate() {
+	// Greedy interval sharing: by order of first use, every resource takes
+	// an allocation that is free by then, or a new one. Buffers take the one
+	// that grows the least.
+	std::vector<ResourceId> sorted;
+	for (ResourceId r = 0; r < resources.size(); ++r) {
+		if (!resources[r].imported && resources[r].firstUse != UINT32_MAX) {
+			sorted.push_back(r);
+		}
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [&](ResourceId a, ResourceId b) {
+		return resources[a].firstUse < resources[b].firstUse;
+	});
+
+	allocationList.clear();
+	std::vector<uint32_t> freeAfter;
+	for (ResourceId r : sorted) {
+		Resource& resource = resources[r];
+		uint32_t best = NoAllocation;
+		uint64_t bestGrowth = UINT64_MAX;
+		for (uint32_t a = 0; a < allocationList.size(); ++a) {
+			const Allocation& allocation = allocationList[a];
+			if (freeAfter[a] >= resource.firstUse || allocation.texture != resource.texture) {
+				continue;
+			}
+			if (resource.texture) {
+				if (sameShape(allocation.textureDesc, resource.textureDesc)) {
+					best = a;
+					break;
+				}
+				continue;
+			}
+			if (mappable(allocation.bufferDesc) || mappable(resource.bufferDesc)) {
+				continue;
+			}
+			uint64_t size = allocation.bufferDesc.size;
+			uint64_t growth = resource.bufferDesc.size > size ? resource.bufferDesc.size - size : 0;
+			if (best == NoAllocation || growth < bestGrowth || (growth == bestGrowth && size < allocationList[best].bufferDesc.size)) {
+				best = a;
+				bestGrowth = growth;
+			}
+		}
+
+		if (best == NoAllocation) {
+			best = static_cast<uint32_t>(allocationList.size());
+			Allocation allocation;
+			allocation.texture = resource.texture;
+			allocation.textureDesc = resource.textureDesc;
+			allocation.bufferDesc = resource.bufferDesc;
+			allocationList.push_back(allocation);
+			freeAfter.push_back(0);
+		}
+		Allocation& allocation = allocationList[best];
+		if (resource.texture) {
+			allocation.textureDesc.usage |= resource.textureDesc.usage;
+			allocation.bytes = textureBytes(allocation.textureDesc);
+		}
+		else {
+			allocation.bufferDesc.usage |= resource.bufferDesc.usage;
+			allocation.bufferDesc.size = std::max(allocation.bufferDesc.size, resource.bufferDesc.size);
+			allocation.bytes = allocation.bufferDesc.size;
+		}
+		freeAfter[best] = resource.lastUse;
+		resource.allocation = best;
+	}
+}
+
+
+uint64_t RenderGraph::textureBytes(const GraphTextureDesc& desc) {
+	uint64_t bytes = 0;
+	uint64_t width = desc.width;
+	uint64_t height = desc.height;
+	for (uint32_t level = 0; level < desc.mipLevelCount; ++level) {
+		bytes += width * height * texelSize(desc.format);
+		width = std::max<uint64_t>(1, width / 2);
+		height = std::max<uint64_t>(1, height / 2);
+	}
+	return bytes * desc.sampleCount;
+}
+
+
+void RenderGraph::printStats(std::ostream& out) const {
+	if (!isCompiled) {
+		out << "Render graph: not compiled" << std::endl;
+		return;
+	}
+	out << "Render graph: " << lastStats.passCount - lastStats.culledPassCount << " of " << lastStats.passCount
+		<< " pass(es) run, " << lastStats.resourceCount - lastStats.culledResourceCount << " transient resource(s) in "
+		<< lastStats.allocationCount << " allocation(s), " << lastStats.allocatedBytes / 1024 << " KiB instead of "
+		<< lastStats.requestedBytes / 1024 << " KiB, compiled in " << lastStats.compileMicroseconds << " us" << std::endl;
+}
@@ -0,0 +1,184 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <webgpu/webgpu.hpp>
+
+#include <functional>
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Passes of a frame declared with the resources they read and write, rather
+ * than wired by hand, and compiled into the list of passes to run and the
+ * textures and buffers to create.
+ *
+ *     RenderGraph::ResourceId target = graph.importTexture("Surface");
+ *     RenderGraph::ResourceId depth = graph.createTexture("Depth", { width, height, depthFormat, usage });
+ *     RenderGraph::PassId scene = graph.addPass("Scene", [&](WebGpuRenderPass& pass) { ... });
+ *     graph.colorAttachment(scene, target);
+ *     graph.depthAttachment(scene, depth);
+ *     graph.compile();
+ *
+ * Passes run in the order they were added. Imported resources live outside
+ * the graph, like the surface, and writing them is what a frame is for:
+ * compile() culls every pass whose writes neither reach an imported resource
+ * nor a pass kept with keepPass(). The resources only the culled passes use
+ * are not allocated.
+ *
+ * The others are transient: they only live from the first to the last pass
+ * that uses them, and resources whose lifetimes do not overlap share an
+ * allocation. WebGPU has no placed resources, so textures only share with
+ * textures of the same size, format, mip count and sample count, and
+ * buffers with buffers that are not mappable, the allocation getting the
+ * union of their usages and the largest size.
+ *
+ * A write keeps what earlier passes wrote. The first pass that uses a
+ * resource in the frame clears it, and its last one does not store it unless
+ * it is imported. The graph is only compiled again after its topology
+ * changed; the compiler only looks at the declarations, the GPU objects are
+ * created by the caller from allocations().
+ */
+
+struct GraphTextureDesc {
+	uint32_t width = 0;
+	uint32_t height = 0;
+	WGPUTextureFormat format = 0;
+	WGPUFlags usage = 0;
+	uint32_t mipLevelCount = 1;
+	uint32_t sampleCount = 1;
+};
+
+struct GraphBufferDesc {
+	uint64_t size = 0;
+	WGPUFlags usage = 0;
+};
+
+struct RenderGraphStats {
+	uint32_t passCount = 0;
+	uint32_t culledPassCount = 0;
+	// Transient resources, and those only culled passes used
+	uint32_t resourceCount = 0;
+	uint32_t culledResourceCount = 0;
+	uint32_t allocationCount = 0;
+	// Bytes of the transient resources used, each on its own, and of the
+	// allocations they share
+	uint64_t requestedBytes = 0;
+	uint64_t allocatedBytes = 0;
+	double compileMicroseconds = 0.0;
+
+	uint64_t savedBytes() const { return requestedBytes - allocatedBytes; }
+};
+
+class RenderGraph {
+public:
+	using ResourceId = uint32_t;
+	using PassId = uint32_t;
+	// Allocation of the imported and unused resources
+	static constexpr uint32_t NoAllocation = UINT32_MAX;
+
+	// Encode the commands of a pass, whose attachments are set
+	using Execute = std::function<void(WebGpuRenderPass& pass)>;
+
+	enum class AccessType {
+		Read,
+		Write,
+		ColorAttachment,
+		DepthAttachment,
+	};
+
+	struct Access {
+		ResourceId resource;
+		AccessType type;
+		// Whether this is the first or the last live pass using the resource,
+		// set by compile(): the first clears it, the last may discard it
+		bool first = false;
+		bool last = false;
+	};
+
+	struct Allocation {
+		bool texture = true;
+		GraphTextureDesc textureDesc;
+		GraphBufferDesc bufferDesc;
+		uint64_t bytes = 0;
+	};
+
+	// Forget every pass and resource
+	void clear();
+
+	// Resources, named for the reports
+	ResourceId createTexture(const std::string& name, const GraphTextureDesc& desc);
+	ResourceId createBuffer(const std::string& name, const GraphBufferDesc& desc);
+	ResourceId importTexture(const std::string& name);
+	ResourceId importBuffer(const std::string& name);
+
+	PassId addPass(const std::string& name, Execute execute);
+	// What a pass does with a resource, to declare after the resource
+	void read(PassId pass, ResourceId resource);
+	void write(PassId pass, ResourceId resource);
+	void colorAttachment(PassId pass, ResourceId resource);
+	void depthAttachment(PassId pass, ResourceId resource);
+	// Never cull a pass, as one that reads back or presents
+	void keepPass(PassId pass);
+
+	// Cull the passes, compute the lifetimes and share the allocations.
+	// Returns false, leaving the graph uncompiled, if a pass reads a
+	// transient resource that no earlier pass writes.
+	bool compile();
+	bool compiled() const { return isCompiled; }
+
+	// Passes to run, in order, once compiled
+	const std::vector<PassId>& passOrder() const { return order; }
+	bool culled(PassId pass) const { return !passes[pass].live; }
+	const std::string& passName(PassId pass) const { return passes[pass].name; }
+	const std::vector<Access>& accesses(PassId pass) const { return passes[pass].accesses; }
+	void execute(PassId pass, WebGpuRenderPass& renderPass) const;
+
+	bool imported(ResourceId resource) const { return resources[resource].imported; }
+	const std::string& resourceName(ResourceId resource) const { return resources[resource].name; }
+	uint32_t allocation(ResourceId resource) const { return resources[resource].allocation; }
+	const std::vector<Allocation>& allocations() const { return allocationList; }
+	size_t resourceCount() const { return resources.size(); }
+	size_t passCount() const { return passes.size(); }
+
+	const RenderGraphStats& stats() const { return lastStats; }
+	void printStats(std::ostream& out) const;
+
+	// Bytes of a texture, with its mip chain
+	static uint64_t textureBytes(const GraphTextureDesc& desc);
+
+private:
+	struct Resource {
+		std::string name;
+		bool texture = true;
+		bool imported = false;
+		GraphTextureDesc textureDesc;
+		GraphBufferDesc bufferDesc;
+		uint32_t allocation = NoAllocation;
+		// Live passes using it, as indices in order
+		uint32_t firstUse = UINT32_MAX;
+		uint32_t lastUse = 0;
+	};
+
+	struct Pass {
+		std::string name;
+		Execute execute;
+		std::vector<Access> accesses;
+		bool keep = false;
+		bool live = false;
+	};
+
+	ResourceId addResource(Resource resource);
+	void access(PassId pass, ResourceId resource, AccessType type);
+	void allocate();
+
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	std::vector<PassId> order;
+	std::vector<Allocation> allocationList;
+	RenderGraphStats lastStats;
+	bool isCompiled = false;
+};
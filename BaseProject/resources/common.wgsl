@@ -0,0 +1,36 @@
+struct MyUniforms {
+    projectionMatrix: mat4x4f,
+    viewMatrix: mat4x4f,
+    modelMatrix: mat4x4f,
+    color: vec4f,
+    positionOffset: vec4f,
+    positionScale: vec4f,
+    time: f32,
+};
+
+@group(0) @binding(0) var<uniform> uMyUniforms: MyUniforms;
+
+struct InstanceData {
+    modelMatrix: mat4x4f,
+    color: vec4f,
+};
+
+@group(0) @binding(1) var<storage, read> instances: array<InstanceData>;
+
+// Material of the submesh being drawn
+struct Material {
+    diffuse: vec4f,
+};
+
+@group(1) @binding(0) var<uniform> uMaterial: Material;
+
+// Compact vertices: positions are unorm16 in the bounding box of the mesh
+// (positionOffset and positionScale), normals are octahedral encoded in two
+// snorm16 and colors are unorm8.
+fn octahedralDecode(e: vec2f) -> vec3f {
+    var n = vec3f(e, 1.0 - abs(e.x) - abs(e.y));
+    let fold = max(-n.z, 0.0);
+    n.x += select(fold, -fold, n.x >= 0.0);
+    n.y += select(fold, -fold, n.y >= 0.0);
+    return normalize(n);
+}
@@ -1,13 +1,7 @@
+#include "common.wgsl"
 
-struct MyUniforms {
-    projectionMatrix: mat4x4f,
-    viewMatrix: mat4x4f,
-    modelMatrix: mat4x4f,
-    color: vec4f,
-    time: f32   
-};
-
-@group(0) @binding(0) var<uniform> uMyUniforms: MyUniforms;
+// Specialized when the pipeline is created, see ShaderVariants
+override compactVertices: bool = false;
 
 struct VertexInput {
     @location(0) position: vec3f,
@@ -17,17 +11,32 @@ struct VertexInput {
 
 struct VertexOutput {
     @builtin(position) position: vec4f,
+#ifdef VERTEX_COLORS
     @location(0) color: vec3f,
-    @location(1) normal: vec3f,
+#else
+    @location(0) normal: vec3f,
+#endif
 };
 
 @vertex
-fn vs_main(in: VertexInput) -> VertexOutput  {
+fn vs_main(in: VertexInput, @builtin(instance_index) instanceIndex: u32) -> VertexOutput  {
 	var out: VertexOutput;
+    let instance = instances[instanceIndex];
+    var position = in.position;
+    if (compactVertices) {
+        position = uMyUniforms.positionOffset.xyz + in.position * uMyUniforms.positionScale.xyz;
+    }
     out.position = uMyUniforms.projectionMatrix * uMyUniforms.viewMatrix 
-                    * uMyUniforms.modelMatrix * vec4f(in.position, 1.0);
-    out.color = in.color;
-    out.normal = in.normal;
+                    * uMyUniforms.modelMatrix * instance.modelMatrix * vec4f(position, 1.0);
+#ifdef VERTEX_COLORS
+    out.color = in.color * instance.color.rgb;
+#else
+    if (compactVertices) {
+        out.normal = octahedralDecode(in.normal.xy);
+    } else {
+        out.normal = in.normal;
+    }
+#endif
     return out;
 }
 
@@ -35,7 +44,11 @@ fn vs_main(in: VertexInput) -> VertexOutput  {
 @fragment
 fn fs_main(in: VertexOutput) -> @location(0) vec4f {
 
-    let color = in.normal * 0.5 + 0.5;
+#ifdef VERTEX_COLORS
+    let color = in.color * uMaterial.diffuse.rgb;
+#else
+    let color = (in.normal * 0.5 + 0.5) * uMaterial.diffuse.rgb;
+#endif
     
-    return vec4f(color, uMyUniforms.color.a);
+    return vec4f(color, uMyUniforms.color.a * uMaterial.diffuse.a);
 }
\ No newline at end of file
@@ -0,0 +1,297 @@
+#include "scene-bounds.h"
+
+#include <algorithm>
+#include <cmath>
+
+FrustumPlanes::FrustumPlanes(const glm::mat4x4& m) {
+	// -w <= x, y <= w and 0 <= z <= w
+	glm::vec4 row0(m[0][0], m[1][0], m[2][0], m[3][0]);
+	glm::vec4 row1(m[0][1], m[1][1], m[2][1], m[3][1]);
+	glm::vec4 row2(m[0][2], m[1][2], m[2][2], m[3][2]);
+	glm::vec4 row3(m[0][3], m[1][3], m[2][3], m[3][3]);
+	glm::vec4 planes[6] = { row3 + row0, row3 - row0, row3 + row1, row3 - row1, row2, row3 - row2 };
+	for (int p = 0; p < 6; ++p) {
+		// A degenerate plane lets everything through
+		float length = glm::length(glm::vec3(planes[p]));
+		float scale = length > 0.0f ? 1.0f / length : 0.0f;
+		x[p] = planes[p].x * scale;
+		y[p] = planes[p].y * scale;
+		z[p] = planes[p].z * scale;
+		w[p] = length > 0.0f ? planes[p].w * scale : 1.0f;
+	}
+}
+
+
+void transformBounds(const glm::mat4x4& matrix, glm::vec3& boxMin, glm::vec3& boxMax, glm::vec4& sphere) {
+	// Center moved, extent spread over the axes by the absolute matrix
+	// (Arvo)
+	glm::vec3 center = glm::vec3(matrix * glm::vec4((boxMin + boxMax) * 0.5f, 1.0f));
+	glm::vec3 extent = (boxMax - boxMin) * 0.5f;
+	glm::vec3 transformedExtent = glm::abs(glm::vec3(matrix[0])) * extent.x + glm::abs(glm::vec3(matrix[1])) * extent.y
+		+ glm::abs(glm::vec3(matrix[2])) * extent.z;
+	boxMin = center - transformedExtent;
+	boxMax = center + transformedExtent;
+
+	float scale = std::max({ glm::length(glm::vec3(matrix[0])), glm::length(glm::vec3(matrix[1])), glm::length(glm::vec3(matrix[2])) });
+	sphere = glm::vec4(glm::vec3(matrix * glm::vec4(glm::vec3(sphere), 1.0f)), sphere.w * scale);
+}
+
+
+void SceneBounds::clear() {
+	for (std::vector<float>* column : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ, &centerX, &centerY, &centerZ, &radius }) {
+		column->clear();
+	}
+	objectIds.clear();
+	nodes.clear();
+	reordered = false;
+}
+
+
+uint32_t SceneBounds::add(const glm::vec3& boxMin, const glm::vec3& boxMax) {
+	glm::vec3 center = (boxMin + boxMax) * 0.5f;
+	return add(boxMin, boxMax, glm::vec4(center, glm::length(boxMax - center)));
+}
+
+
+uint32_t SceneBounds::add(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec4& sphere) {
+	nodes.clear();
+	minX.push_back(boxMin.x);
+	minY.push_back(boxMin.y);
+	minZ.push_back(boxMin.z);
+	maxX.push_back(boxMax.x);
+	maxY.push_back(boxMax.y);
+	maxZ.push_back(boxMax.z);
+	centerX.push_back(sphere.x);
+	centerY.push_back(sphere.y);
+	centerZ.push_back(sphere.z);
+	radius.push_back(sphere.w);
+	uint32_t id = static_cast<uint32_t>(objectIds.size());
+	objectIds.push_back(id);
+	return id;
+}
+
+
+void SceneBounds::buildHierarchy(uint32_t leafSize) {
+	nodes.clear();
+	size_t count = objectCount();
+	if (count == 0) {
+		return;
+	}
+	std::vector<uint32_t> order(count);
+	std::vector<glm::vec3> centroids(count);
+	for (size_t i = 0; i < count; ++i) {
+		order[i] = static_cast<uint32_t>(i);
+		centroids[i] = glm::vec3(minX[i] + maxX[i], minY[i] + maxY[i], minZ[i] + maxZ[i]) * 0.5f;
+	}
+	nodes.reserve(2 * (count / std::max(leafSize, 1u) + 1));
+	buildNode(0, static_cast<uint32_t>(count), std::max(leafSize, 1u), order, centroids);
+
+	// Store the objects in the order of the leaves
+	for (std::vector<float>* column : { &minX, &minY, &minZ, &maxX, &maxY, &maxZ, &centerX, &centerY, &centerZ, &radius }) {
+		std::vector<float> sorted(count);
+		for (size_t i = 0; i < count; ++i) {
+			sorted[i] = (*column)[order[i]];
+		}
+		column->swap(sorted);
+	}
+	std::vector<uint32_t> sortedIds(count);
+	for (size_t i = 0; i < count; ++i) {
+		sortedIds[i] = objectIds[order[i]];
+	}
+	objectIds.swap(sortedIds);
+	reordered = true;
+}
+
+
+uint32_t SceneBounds::buildNode(uint32_t first, uint32_t count, uint32_t leafSize, std::vector<uint32_t>& order,
+								const std::vector<glm::vec3>& centroids) {
+	uint32_t index = static_cast<uint32_t>(nodes.size());
+	nodes.push_back({ glm::vec3(INFINITY), first, glm::vec3(-INFINITY), count, 0 });
+	glm::vec3 boxMin(INFINITY);
+	glm::vec3 boxMax(-INFINITY);
+	glm::vec3 centroidMin(INFINITY);
+	glm::vec3 centroidMax(-INFINITY);
+	for (uint32_t i = first; i < first + count; ++i) {
+		uint32_t object = order[i];
+		boxMin = glm::min(boxMin, glm::vec3(minX[object], minY[object], minZ[object]));
+		boxMax = glm::max(boxMax, glm::vec3(maxX[object], maxY[object], maxZ[object]));
+		centroidMin = glm::min(centroidMin, centroids[object]);
+		centroidMax = glm::max(centroidMax, centroids[object]);
+	}
+	nodes[index].boxMin = boxMin;
+	nodes[index].boxMax = boxMax;
+	if (count <= leafSize) {
+		return index;
+	}
+
+	// Halves of the objects along the longest extent of their centroids
+	glm::vec3 extent = centroidMax - centroidMin;
+	int axis = extent.x >= extent.y && extent.x >= extent.z ? 0 : (extent.y >= extent.z ? 1 : 2);
+	uint32_t half = count / 2;
+	std::nth_element(order.begin() + first, order.begin() + first + half, order.begin() + first + count,
+		[&](uint32_t a, uint32_t b) { return centroids[a][axis] < centroids[b][axis]; });
+
+	buildNode(first, half, leafSize, order, centroids);
+	uint32_t secondChild = buildNode(first + half, count - half, leafSize, order, centroids);
+	nodes[index].secondChild = secondChild;
+	return index;
+}
+
+
+uint32_t SceneBounds::cullRange(const FrustumPlanes& planes, size_t first, size_t end, uint8_t* out) const {
+	const float* x0 = minX.data();
+	const float* y0 = minY.data();
+	const float* z0 = minZ.data();
+	const float* x1 = maxX.data();
+	const float* y1 = maxY.data();
+	const float* z1 = maxZ.data();
+	const float* cx = centerX.data();
+	const float* cy = centerY.data();
+	const float* cz = centerZ.data();
+	const float* r = radius.data();
+	// Locals, which stores to out cannot alias
+	float px[6], py[6], pz[6], pw[6];
+	std::copy(planes.x, planes.x + 6, px);
+	std::copy(planes.y, planes.y + 6, py);
+	std::copy(planes.z, planes.z + 6, pz);
+	std::copy(planes.w, planes.w + 6, pw);
+	uint32_t passed = 0;
+
+	// Branch-free, without short-circuits, so that the compiler turns it
+	// into SIMD code
+	for (size_t i = first; i < end; ++i) {
+		int inside = 1;
+		for (int p = 0; p < 6; ++p) {
+			inside &= px[p] * cx[i] + py[p] * cy[i] + pz[p] * cz[i] + pw[p] > -r[i] ? 1 : 0;
+			// Distance of the corner of the box farthest along the normal
+			float farthest = std::max(px[p] * x0[i], px[p] * x1[i]) + std::max(py[p] * y0[i], py[p] * y1[i])
+				+ std::max(pz[p] * z0[i], pz[p] * z1[i]) + pw[p];
+			inside &= farthest >= 0.0f ? 1 : 0;
+		}
+		out[i] = static_cast<uint8_t>(inside);
+		passed += static_cast<uint32_t>(inside);
+	}
+	objectTests += end - first;
+	return passed;
+}
+
+
+uint32_t SceneBounds::cullLinear(const FrustumPlanes& planes, std::vector<uint8_t>& visible) const {
+	visible.resize(objectCount());
+	objectTests = 0;
+	if (!reordered) {
+		return cullRange(planes, 0, objectCount(), visible.data());
+	}
+	storageVisible.resize(objectCount());
+	uint32_t passed = cullRange(planes, 0, objectCount(), storageVisible.data());
+	for (size_t i = 0; i < objectCount(); ++i) {
+		visible[objectIds[i]] = storageVisible[i];
+	}
+	return passed;
+}
+
+
+template <typename Accept, typename Test>
+void SceneBounds::traverse(const FrustumPlanes& planes, Accept accept, Test test) const {
+	nodeTests = 0;
+	objectTests = 0;
+
+	// Nodes to visit, with a bit per plane the node may still cross. The
+	// depth stays below 64 for any balanced tree of 32-bit counts.
+	struct Visit {
+		uint32_t node;
+		uint32_t planeMask;
+	};
+	Visit stack[64];
+	size_t stackSize = 0;
+	stack[stackSize++] = { 0, 0x3f };
+	while (stackSize > 0) {
+		Visit visit = stack[--stackSize];
+		const Node& node = nodes[visit.node];
+		++nodeTests;
+
+		bool outside = false;
+		uint32_t planeMask = visit.planeMask;
+		for (int p = 0; p < 6 && !outside; ++p) {
+			if ((planeMask & (1u << p)) == 0) {
+				continue;
+			}
+			float nx = planes.x[p], ny = planes.y[p], nz = planes.z[p];
+			float farthest = nx * (nx > 0.0f ? node.boxMax.x : node.boxMin.x) + ny * (ny > 0.0f ? node.boxMax.y : node.boxMin.y)
+				+ nz * (nz > 0.0f ? node.boxMax.z : node.boxMin.z) + planes.w[p];
+			float nearest = nx * (nx > 0.0f ? node.boxMin.x : node.boxMax.x) + ny * (ny > 0.0f ? node.boxMin.y : node.boxMax.y)
+				+ nz * (nz > 0.0f ? node.boxMin.z : node.boxMax.z) + planes.w[p];
+			outside = farthest < 0.0f;
+			if (nearest >= 0.0f) {
+				planeMask &= ~(1u << p);
+			}
+		}
+
+		if (outside) {
+			continue;
+		}
+		if (planeMask == 0) {
+			// Entirely inside: every object of the node passes both tests
+			accept(node.first, node.first + node.count);
+		}
+		else if (node.secondChild == 0) {
+			cullRange(planes, node.first, node.first + node.count, storageVisible.data());
+			test(node.first, node.first + node.count);
+		}
+		else {
+			stack[stackSize++] = { node.secondChild, planeMask };
+			stack[stackSize++] = { visit.node + 1, planeMask };
+		}
+	}
+}
+
+
+uint32_t SceneBounds::cull(const FrustumPlanes& planes, std::vector<uint8_t>& visible) const {
+	if (!hasHierarchy()) {
+		return cullLinear(planes, visible);
+	}
+	// Only the visible objects are written, wherever their ids send them
+	visible.assign(objectCount(), 0);
+	storageVisible.resize(objectCount());
+	uint32_t passed = 0;
+	traverse(planes,
+		[&](size_t first, size_t end) {
+			for (size_t i = first; i < end; ++i) {
+				visible[objectIds[i]] = 1;
+			}
+			passed += static_cast<uint32_t>(end - first);
+		},
+		[&](size_t first, size_t end) {
+			for (size_t i = first; i < end; ++i) {
+				if (storageVisible[i]) {
+					visible[objectIds[i]] = 1;
+					++passed;
+				}
+			}
+		});
+	return passed;
+}
+
+
+uint32_t SceneBounds::cull(const FrustumPlanes& planes, std::vector<uint32_t>& visibleIds) const {
+	visibleIds.clear();
+	storageVisible.resize(objectCount());
+	auto test = [&](size_t first, size_t end) {
+		for (size_t i = first; i < end; ++i) {
+			if (storageVisible[i]) {
+				visibleIds.push_back(objectIds[i]);
+			}
+		}
+	};
+	if (!hasHierarchy()) {
+		objectTests = 0;
+		cullRange(planes, 0, objectCount(), storageVisible.data());
+		test(0, objectCount());
+	}
+	else {
+		traverse(planes,
+			[&](size_t first, size_t end) { visibleIds.insert(visibleIds.end(), objectIds.begin() + first, objectIds.begin() + end); },
+			test);
+	}
+	return static_cast<uint32_t>(visibleIds.size());
+}
@@ -0,0 +1,113 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Bounds of the objects of a scene, to skip those out of the view frustum
+ * before anything is submitted for them.
+ *
+ * Every object has a box and a sphere, stored as structure of arrays. The
+ * per-object test is written, like MeshletCuller::cull(), as branch-free
+ * loops the compiler vectorizes (SSE, AVX with -march, NEON or WebAssembly
+ * SIMD) rather than with intrinsics of one instruction set. An object is
+ * visible unless its sphere or its box, which must both contain it, is
+ * entirely behind one of the planes.
+ *
+ * Large scenes can add a bounding volume hierarchy: the objects are then
+ * reordered so that every node covers a contiguous run of them, and a node
+ * entirely inside the frustum accepts its whole run without testing it,
+ * while a node outside rejects it. Both paths give the same visibility.
+ *
+ *     bounds.add(boxMin, boxMax);
+ *     bounds.buildHierarchy();                    // optional, 10k+ objects
+ *     bounds.cull(FrustumPlanes(viewProjection), visible);      // or visibleIds
+ */
+
+// Planes of a view frustum, normalized so that they give distances, as
+// arrays so that the loops over them unroll: x * p.x + y * p.y + z * p.z + w
+// is negative out of the frustum
+struct FrustumPlanes {
+	float x[6], y[6], z[6], w[6];
+
+	// Planes of a matrix that maps to clip space (WebGPU depth range, 0 to
+	// w), expressed in the coordinates it maps from (Gribb and Hartmann)
+	explicit FrustumPlanes(const glm::mat4x4& clipFromObject);
+};
+
+// Box and sphere of an object once transformed by matrix, which may rotate
+// and scale it
+void transformBounds(const glm::mat4x4& matrix, glm::vec3& boxMin, glm::vec3& boxMax, glm::vec4& sphere);
+
+class SceneBounds {
+public:
+	// Forget every object and the hierarchy
+	void clear();
+
+	// Add an object, return its index. The sphere is the one around the box
+	// unless it is given as (center, radius).
+	uint32_t add(const glm::vec3& boxMin, const glm::vec3& boxMax);
+	uint32_t add(const glm::vec3& boxMin, const glm::vec3& boxMax, const glm::vec4& sphere);
+
+	size_t objectCount() const { return objectIds.size(); }
+
+	// Group the objects added so far in a hierarchy of about leafSize objects
+	// per leaf. Objects added later drop it.
+	void buildHierarchy(uint32_t leafSize = 32);
+	bool hasHierarchy() const { return !nodes.empty(); }
+	size_t nodeCount() const { return nodes.size(); }
+
+	// Set visible[i] to 1 for the objects that may be seen and 0 for the
+	// others, resizing it to objectCount(). Returns how many are visible.
+	// Uses the hierarchy when there is one.
+	uint32_t cull(const FrustumPlanes& planes, std::vector<uint8_t>& visible) const;
+
+	// Same, testing every object
+	uint32_t cullLinear(const FrustumPlanes& planes, std::vector<uint8_t>& visible) const;
+
+	// Ids of the visible objects, in no particular order. Costs as much as
+	// the objects tested and found, rather than as the whole scene.
+	uint32_t cull(const FrustumPlanes& planes, std::vector<uint32_t>& visibleIds) const;
+
+	// Nodes visited and objects tested by the last cull() of the hierarchy
+	size_t lastNodeTests() const { return nodeTests; }
+	size_t lastObjectTests() const { return objectTests; }
+
+private:
+	// Node of the hierarchy, in depth-first order: the first child follows
+	// its parent, secondChild is 0 for the leaves. Every node covers the
+	// objects [first, first + count).
+	struct Node {
+		glm::vec3 boxMin;
+		uint32_t first;
+		glm::vec3 boxMax;
+		uint32_t count;
+		uint32_t secondChild;
+	};
+
+	// Test the objects [first, end), in storage order, and write their
+	// visibility to out[first, end)
+	uint32_t cullRange(const FrustumPlanes& planes, size_t first, size_t end, uint8_t* out) const;
+	// Visit the nodes that are not outside the planes. accept(first, end)
+	// receives the runs of objects entirely inside, test(first, end) those
+	// of the leaves that cross a plane, once cullRange() wrote them to
+	// storageVisible.
+	template <typename Accept, typename Test>
+	void traverse(const FrustumPlanes& planes, Accept accept, Test test) const;
+	uint32_t buildNode(uint32_t first, uint32_t count, uint32_t leafSize, std::vector<uint32_t>& order,
+					const std::vector<glm::vec3>& centroids);
+
+	std::vector<float> minX, minY, minZ, maxX, maxY, maxZ;
+	std::vector<float> centerX, centerY, centerZ, radius;
+	// Index the caller knows each object by, they differ once reordered
+	std::vector<uint32_t> objectIds;
+	std::vector<Node> nodes;
+	bool reordered = false;
+	// Visibility in storage order of the objects last tested
+	mutable std::vector<uint8_t> storageVisible;
+	mutable size_t nodeTests = 0;
+	mutable size_t objectTests = 0;
+};
@@ -0,0 +1,107 @@
+#include "shader-variants.h"
+#include "profiler.h"
+
+#include <iostream>
+#include <algorithm>
+
+using namespace wgpu;
+
+namespace {
+
+enum class FeatureKind {
+	Define,
+	Override,
+};
+
+struct FeatureInfo {
+	ShaderFeature feature;
+	FeatureKind kind;
+	const char* name; // of the define or of the override constant
+};
+
+constexpr FeatureInfo Features[] = {
+	{ ShaderFeatureCompactVertices, FeatureKind::Override, "compactVertices" },
+	{ ShaderFeatureVertexColors, FeatureKind::Define, "VERTEX_COLORS" },
+};
+
+} // anonymous namespace
+
+
+ShaderVariants::ShaderVariants(PipelineCache& pipelineCache, ShaderSources sources)
+	: pipelineCache(pipelineCache)
+	, sources(std::move(sources))
+{}
+
+
+ShaderDefines ShaderVariants::defines(ShaderFeatures features) {
+	ShaderDefines result;
+	for (const FeatureInfo& info : Features) {
+		if (info.kind == FeatureKind::Define && (features & info.feature) != 0) {
+			result.emplace_back(info.name, "");
+		}
+	}
+	return result;
+}
+
+
+bool ShaderVariants::preprocess(ShaderFeatures features, std::string& source) const {
+	PROFILE_ZONE("Preprocess shader");
+	std::string error;
+	if (!preprocessWgsl(sources, defines(features), source, error)) {
+		std::cout << "*** ERROR *** Could not preprocess shader variant " << features << ": " << error << std::endl;
+		return false;
+	}
+	return true;
+}
+
+
+const ShaderVariant& ShaderVariants::add(ShaderFeatures features, bool preprocessed, const std::string& source) {
+	ShaderVariant& variant = variants[features];
+	if (!preprocessed) {
+		return variant;
+	}
+	// Variants that only differ by override constants have the same source,
+	// and get the same module from the cache
+	variant.module = pipelineCache.shaderModule(source);
+	for (const FeatureInfo& info : Features) {
+		if (info.kind == FeatureKind::Override) {
+			ConstantEntry constant;
+			constant.key = info.name;
+			constant.value = (features & info.feature) != 0 ? 1.0 : 0.0;
+			variant.constants.push_back(constant);
+		}
+	}
+	return variant;
+}
+
+
+const ShaderVariant& ShaderVariants::variant(ShaderFeatures features) {
+	auto it = variants.find(features);
+	if (it != variants.end()) {
+		return it->second;
+	}
+	std::string source;
+	bool preprocessed = preprocess(features, source);
+	return add(features, preprocessed, source);
+}
+
+
+void ShaderVariants::prewarm(const std::vector<ShaderFeatures>& featureSets, ThreadPool& pool) {
+	std::vector<ShaderFeatures> missing;
+	for (ShaderFeatures features : featureSets) {
+		if (variants.count(features) == 0 && std::find(missing.begin(), missing.end(), features) == missing.end()) {
+			missing.push_back(features);
+		}
+	}
+
+	// Text work on the pool, then the modules on this thread, which owns the
+	// pipeline cache
+	std::vector<std::string> missingSources(missing.size());
+	std::vector<char> preprocessed(missing.size(), 0);
+	pool.parallelFor(missing.size(), [&](size_t i) {
+		preprocessed[i] = preprocess(missing[i], missingSources[i]);
+	});
+	for (size_t i = 0; i < missing.size(); ++i) {
+		add(missing[i], preprocessed[i] != 0, missingSources[i]);
+	}
+}
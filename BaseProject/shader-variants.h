@@ -0,0 +1,75 @@
+#pragma once
+
+#include "wgsl-preprocessor.h"
+#include "pipeline-cache.h"
+#include "thread-pool.h"
+
+#include <webgpu/webgpu.hpp>
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Variants of a shader specialized for a set of features, rather than
+ * branching on them at run time.
+ *
+ * A feature is either a define of the WGSL preprocessor, which makes a
+ * different source and thus another shader module, or a pipeline-overridable
+ * constant of the shader (`override name: bool`), which only changes the
+ * constants of the pipeline and leaves the driver to fold the branches on
+ * it. Variants that differ by constants only share their module.
+ *
+ *     ShaderVariants variants(pipelineCache, sources);
+ *     const ShaderVariant& variant = variants.variant(ShaderFeatureCompactVertices);
+ *     pipelineDesc.vertex.module = variant.module;
+ *     pipelineDesc.vertex.constantCount = variant.constants.size();
+ *     pipelineDesc.vertex.constants = variant.constants.data();
+ *
+ * Variants are made the first time they are requested, or ahead of time by
+ * prewarm(), which preprocesses them in parallel.
+ */
+
+enum ShaderFeature : uint32_t {
+	// Vertices are CompactVertex, to dequantize and decode (override
+	// constant compactVertices)
+	ShaderFeatureCompactVertices = 1u << 0,
+	// Shade with the vertex colors rather than the normals (define
+	// VERTEX_COLORS)
+	ShaderFeatureVertexColors = 1u << 1,
+};
+
+// Bitmask of ShaderFeature
+using ShaderFeatures = uint32_t;
+
+struct ShaderVariant {
+	// Owned by the pipeline cache, null if the source did not preprocess
+	wgpu::ShaderModule module = nullptr;
+	// Value of every override feature, for both stages of the pipeline
+	std::vector<wgpu::ConstantEntry> constants;
+};
+
+class ShaderVariants {
+public:
+	ShaderVariants(PipelineCache& pipelineCache, ShaderSources sources);
+
+	const ShaderVariant& variant(ShaderFeatures features);
+
+	// Make the variants not made yet, their sources preprocessed on the pool
+	void prewarm(const std::vector<ShaderFeatures>& featureSets, ThreadPool& pool = ThreadPool::shared());
+
+	size_t variantCount() const { return variants.size(); }
+
+	// Defines of the preprocessor for a set of features
+	static ShaderDefines defines(ShaderFeatures features);
+
+private:
+	// Preprocess the source of a variant, report errors
+	bool preprocess(ShaderFeatures features, std::string& source) const;
+	const ShaderVariant& add(ShaderFeatures features, bool preprocessed, const std::string& source);
+
+	PipelineCache& pipelineCache;
+	ShaderSources sources;
+	std::unordered_map<ShaderFeatures, ShaderVariant> variants;
+};
@@ -0,0 +1,59 @@
+#include "staging-ring.h"
+
+#include <algorithm>
+#include <cassert>
+
+StagingRing::StagingRing(uint32_t chunkCount, uint64_t chunkSize)
+	: chunks(std::max(chunkCount, 1u))
+	, size(std::max(chunkSize & ~(Alignment - 1), Alignment))
+{}
+
+
+int StagingRing::acquire() {
+	if (filling >= 0) {
+		return filling;
+	}
+	if (chunks[next].state != State::Free) {
+		++stalls;
+		return -1;
+	}
+	filling = static_cast<int>(next);
+	chunks[next].state = State::Filling;
+	chunks[next].used = 0;
+	next = (next + 1) % chunkCount();
+	return filling;
+}
+
+
+uint64_t StagingRing::reserve(uint64_t byteSize, uint64_t& chunkOffset) {
+	assert(byteSize % Alignment == 0);
+	if (filling < 0) {
+		return 0;
+	}
+	Chunk& chunk = chunks[filling];
+	uint64_t granted = std::min(byteSize, size - chunk.used);
+	chunkOffset = chunk.used;
+	chunk.used += granted;
+	return granted;
+}
+
+
+int StagingRing::submit() {
+	if (filling < 0) {
+		return -1;
+	}
+	int chunk = filling;
+	chunks[chunk].state = State::InFlight;
+	filling = -1;
+	++inFlight;
+	++submitted;
+	return chunk;
+}
+
+
+void StagingRing::recycle(uint32_t chunk) {
+	assert(chunks[chunk].state == State::InFlight);
+	chunks[chunk].state = State::Free;
+	chunks[chunk].used = 0;
+	--inFlight;
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+/**
+ * Bookkeeping of a fixed ring of staging chunks, kept apart from any GPU
+ * object so that the upload scheduling can be driven and checked on its own.
+ *
+ * A chunk goes Free (mapped, ready to be written) -> Filling -> InFlight
+ * (its copies are submitted, waiting to be mapped again) -> Free. Chunks are
+ * handed out in ring order, which is also the order in which the GPU
+ * completes them, so the host never holds more than chunkCount * chunkSize
+ * bytes of staging memory.
+ */
+class StagingRing {
+public:
+	enum class State { Free, Filling, InFlight };
+
+	// All offsets and sizes are kept multiples of 4, as copyBufferToBuffer requires
+	static constexpr uint64_t Alignment = 4;
+
+	StagingRing(uint32_t chunkCount, uint64_t chunkSize);
+
+	// Start filling the next chunk of the ring. Return its index, or -1 if
+	// it is still in flight and the caller has to wait for a recycle().
+	int acquire();
+
+	// Reserve up to byteSize bytes at the end of the chunk being filled. Return
+	// the number of bytes granted (0 if there is no chunk being filled or it
+	// is full) and set chunkOffset to where they start.
+	uint64_t reserve(uint64_t byteSize, uint64_t& chunkOffset);
+
+	// Hand the chunk being filled over to the GPU, return its index or -1 if
+	// there was none
+	int submit();
+
+	// The GPU is done with an in-flight chunk and it is mapped again
+	void recycle(uint32_t chunk);
+
+	// Chunk being filled, or -1
+	int current() const { return filling; }
+	uint64_t used(uint32_t chunk) const { return chunks[chunk].used; }
+	State state(uint32_t chunk) const { return chunks[chunk].state; }
+	uint32_t chunkCount() const { return static_cast<uint32_t>(chunks.size()); }
+	uint64_t chunkSize() const { return size; }
+	uint32_t inFlightCount() const { return inFlight; }
+
+	// Number of acquire() calls that found no free chunk
+	uint64_t stallCount() const { return stalls; }
+	uint64_t submittedCount() const { return submitted; }
+
+private:
+	struct Chunk {
+		State state = State::Free;
+		uint64_t used = 0;
+	};
+
+	std::vector<Chunk> chunks;
+	uint64_t size;
+	uint32_t next = 0;
+	int filling = -1;
+	uint32_t inFlight = 0;
+	uint64_t stalls = 0;
+	uint64_t submitted = 0;
+};
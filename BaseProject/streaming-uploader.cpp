@@ -0,0 +1,134 @@
+#include "streaming-uploader.h"
+#include "webgpu-utils.h"
+
+#include <iostream>
+#include <cstring>
+#include <cassert>
+
+using namespace wgpu;
+
+StreamingUploader::StreamingUploader(Device device, Queue queue, uint32_t chunkCount, uint64_t chunkSize)
+	: device(device)
+	, queue(queue)
+	, stagingRing(chunkCount, chunkSize)
+	, chunks(stagingRing.chunkCount())
+{
+	BufferDescriptor bufferDesc;
+	bufferDesc.label = "Staging Chunk";
+	bufferDesc.size = stagingRing.chunkSize();
+	bufferDesc.usage = BufferUsage::MapWrite | BufferUsage::CopySrc;
+	bufferDesc.mappedAtCreation = true;
+	for (Chunk& chunk : chunks) {
+		chunk.buffer = device.createBuffer(bufferDesc);
+		chunk.mapped = static_cast<uint8_t*>(chunk.buffer.getMappedRange(0, bufferDesc.size));
+	}
+}
+
+
+StreamingUploader::~StreamingUploader() {
+	flush();
+	for (Chunk& chunk : chunks) {
+		if (chunk.mapped) {
+			chunk.buffer.unmap();
+		}
+		chunk.buffer.destroy();
+		chunk.buffer.release();
+	}
+}
+
+
+void StreamingUploader::write(Buffer dst, uint64_t dstOffset, const void* data, uint64_t size) {
+	assert(dstOffset % StagingRing::Alignment == 0 && size % StagingRing::Alignment == 0);
+	const uint8_t* src = static_cast<const uint8_t*>(data);
+	while (size > 0) {
+		while (stagingRing.acquire() < 0) {
+			poll();
+		}
+
+		Chunk& chunk = chunks[stagingRing.current()];
+		if (!chunk.mapped) {
+			// Mapping the chunk again failed, which only happens when the
+			// device is lost. Let the queue deal with what is left.
+			queue.writeBuffer(dst, dstOffset, src, size);
+			uploaded += size;
+			return;
+		}
+
+		uint64_t chunkOffset = 0;
+		uint64_t granted = stagingRing.reserve(size, chunkOffset);
+		if (granted == 0) {
+			submitCurrent();
+			continue;
+		}
+		std::memcpy(chunk.mapped + chunkOffset, src, granted);
+		chunk.copies.push_back({ dst, dstOffset, chunkOffset, granted });
+
+		src += granted;
+		dstOffset += granted;
+		size -= granted;
+		uploaded += granted;
+	}
+}
+
+
+void StreamingUploader::submit() {
+	submitCurrent();
+}
+
+
+void StreamingUploader::flush() {
+	submitCurrent();
+	while (stagingRing.inFlightCount() > 0) {
+		poll();
+	}
+}
+
+
+void StreamingUploader::submitCurrent() {
+	int index = stagingRing.submit();
+	if (index < 0) {
+		return;
+	}
+	uint32_t chunkIndex = static_cast<uint32_t>(index);
+	Chunk& chunk = chunks[chunkIndex];
+	if (!chunk.mapped) {
+		stagingRing.recycle(chunkIndex);
+		return;
+	}
+
+	chunk.buffer.unmap();
+	chunk.mapped = nullptr;
+
+	CommandEncoderDescriptor encoderDesc = {};
+	encoderDesc.label = "Staging upload encoder";
+	CommandEncoder encoder = device.createCommandEncoder(encoderDesc);
+	for (const PendingCopy& copy : chunk.copies) {
+		encoder.copyBufferToBuffer(chunk.buffer, copy.srcOffset, copy.dst, copy.dstOffset, copy.size);
+	}
+	chunk.copies.clear();
+
+	CommandBufferDescriptor cmdBufferDescriptor = {};
+	cmdBufferDescriptor.label = "Staging upload";
+	CommandBuffer command = encoder.finish(cmdBufferDescriptor);
+	encoder.release();
+	queue.submit(1, &command);
+	command.release();
+
+	// The chunk can be mapped again once the GPU is done copying from it
+	uint64_t size = stagingRing.chunkSize();
+	chunk.mapCallback = chunk.buffer.mapAsync(MapMode::Write, 0, size, [this, chunkIndex, size](BufferMapAsyncStatus status) {
+		Chunk& mappedChunk = chunks[chunkIndex];
+		if (status == BufferMapAsyncStatus::Success) {
+			mappedChunk.mapped = static_cast<uint8_t*>(mappedChunk.buffer.getMappedRange(0, size));
+		}
+		else {
+			std::cout << "*** ERROR *** Could not map staging chunk " << chunkIndex << ": status " << status << std::endl;
+		}
+		stagingRing.recycle(chunkIndex);
+	});
+}
+
+
+void StreamingUploader::poll() {
+	pollDevice(device, true);
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "staging-ring.h"
+
+#include <webgpu/webgpu.hpp>
+
+#include <memory>
+#include <vector>
+#include <cstdint>
+
+/**
+ * Upload of large buffers through a fixed ring of staging buffers, as an
+ * alternative to queue.writeBuffer, which keeps a full copy of the data on
+ * the host until it reaches the GPU.
+ *
+ * Data passed to write() is copied into a mapped staging chunk right away, so
+ * the caller may reuse its memory as soon as write() returns. Full chunks are
+ * unmapped and copied to their destinations with copyBufferToBuffer, then
+ * mapped again for reuse. When every chunk is in flight, write() polls the
+ * device until one comes back.
+ */
+class StreamingUploader {
+public:
+	StreamingUploader(wgpu::Device device, wgpu::Queue queue,
+					uint32_t chunkCount = 4, uint64_t chunkSize = 4 * 1024 * 1024);
+	~StreamingUploader();
+
+	StreamingUploader(const StreamingUploader&) = delete;
+	StreamingUploader& operator=(const StreamingUploader&) = delete;
+
+	// Copy size bytes into dst at dstOffset. dst needs the CopyDst usage,
+	// dstOffset and size must be multiples of 4.
+	void write(wgpu::Buffer dst, uint64_t dstOffset, const void* data, uint64_t size);
+
+	// Submit the copies of the chunk being filled, without waiting. They run
+	// before any command submitted after them.
+	void submit();
+
+	// Submit the chunk being filled and wait until every copy has been
+	// executed by the GPU
+	void flush();
+
+	uint64_t uploadedBytes() const { return uploaded; }
+	const StagingRing& ring() const { return stagingRing; }
+
+private:
+	struct PendingCopy {
+		wgpu::Buffer dst;
+		uint64_t dstOffset;
+		uint64_t srcOffset;
+		uint64_t size;
+	};
+
+	struct Chunk {
+		wgpu::Buffer buffer = nullptr;
+		uint8_t* mapped = nullptr;
+		std::vector<PendingCopy> copies;
+		std::unique_ptr<wgpu::BufferMapCallback> mapCallback;
+	};
+
+	// Encode the copies of the chunk being filled and submit them
+	void submitCurrent();
+
+	// Let the device make progress so that map callbacks get a chance to run
+	void poll();
+
+	wgpu::Device device;
+	wgpu::Queue queue;
+	StagingRing stagingRing;
+	std::vector<Chunk> chunks;
+	uint64_t uploaded = 0;
+};
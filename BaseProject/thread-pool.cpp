@@ -0,0 +1,114 @@
+#include "thread-pool.h"
+
+#include <algorithm>
+#include <atomic>
+
+#if defined(__EMSCRIPTEN__) && !defined(__EMSCRIPTEN_PTHREADS__)
+#  define THREAD_POOL_INLINE
+#endif
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+#ifndef THREAD_POOL_INLINE
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	workers.reserve(threadCount);
+	for (unsigned i = 0; i < threadCount; ++i) {
+		workers.emplace_back([this]() { workerLoop(); });
+	}
+#else
+	(void)threadCount;
+#endif
+}
+
+
+ThreadPool::~ThreadPool() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	wakeUp.notify_all();
+	for (std::thread& worker : workers) {
+		worker.join();
+	}
+}
+
+
+unsigned ThreadPool::threadCount() const {
+	return workers.empty() ? 1u : static_cast<unsigned>(workers.size());
+}
+
+
+ThreadPool& ThreadPool::shared() {
+	static ThreadPool pool;
+	return pool;
+}
+
+
+void ThreadPool::enqueue(std::function<void()> task) {
+	if (workers.empty()) {
+		task();
+		return;
+	}
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	wakeUp.notify_one();
+}
+
+
+void ThreadPool::workerLoop() {
+	for (;;) {
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			wakeUp.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty()) {
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body) {
+	if (count == 0) return;
+	if (count == 1 || workers.empty()) {
+		for (size_t i = 0; i < count; ++i) body(i);
+		return;
+	}
+
+	// Items are claimed one at a time from a shared counter, so that uneven
+	// items still balance across threads.
+	struct Shared {
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	auto shared = std::make_shared<Shared>();
+	auto work = [shared, count, &body]() {
+		size_t completed = 0;
+		for (size_t i = shared->next++; i < count; i = shared->next++) {
+			body(i);
+			++completed;
+		}
+		if (completed > 0 && shared->done.fetch_add(completed) + completed == count) {
+			std::lock_guard<std::mutex> lock(shared->mutex);
+			shared->finished.notify_all();
+		}
+	};
+
+	size_t helpers = std::min(count - 1, workers.size());
+	for (size_t i = 0; i < helpers; ++i) {
+		enqueue(work);
+	}
+	work();
+
+	std::unique_lock<std::mutex> lock(shared->mutex);
+	shared->finished.wait(lock, [&]() { return shared->done.load() == count; });
+}
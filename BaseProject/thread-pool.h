@@ -0,0 +1,57 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Fixed set of worker threads consuming a FIFO of tasks.
+ *
+ * On Emscripten builds without pthread support there is no worker at all and
+ * tasks run inline in the calling thread, so code using the pool does not
+ * need a separate single-threaded path.
+ */
+class ThreadPool {
+public:
+	// 0 means one worker per hardware thread
+	explicit ThreadPool(unsigned threadCount = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// Number of workers, at least 1 even when tasks run inline
+	unsigned threadCount() const;
+
+	// Queue a task and get a future for its result
+	template <typename Task>
+	auto submit(Task&& task) -> std::future<decltype(task())> {
+		using Result = decltype(task());
+		auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+		std::future<Result> result = packaged->get_future();
+		enqueue([packaged]() { (*packaged)(); });
+		return result;
+	}
+
+	// Call body(i) for every i in [0, count) and wait for all of them. The
+	// calling thread takes part in the work.
+	void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+	// Pool shared by the whole application
+	static ThreadPool& shared();
+
+private:
+	void enqueue(std::function<void()> task);
+	void workerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	bool stopping = false;
+};
@@ -0,0 +1,222 @@
+#include "transform-hierarchy.h"
+
+#include <algorithm>
+#include <cassert>
+
+namespace {
+
+constexpr uint32_t NoParent = UINT32_MAX;
+
+// Move the elements of values that have a new slot there, in order
+template <typename T>
+void compact(std::vector<T>& values, const std::vector<uint32_t>& newSlots, size_t newCount) {
+	for (size_t slot = 0; slot < values.size(); ++slot) {
+		if (newSlots[slot] != NoParent) {
+			values[newSlots[slot]] = values[slot];
+		}
+	}
+	values.resize(newCount);
+}
+
+// Move every element of values to newSlots[]
+template <typename T>
+void permute(std::vector<T>& values, const std::vector<uint32_t>& newSlots, std::vector<T>& scratch) {
+	scratch.resize(values.size());
+	for (size_t slot = 0; slot < values.size(); ++slot) {
+		scratch[newSlots[slot]] = values[slot];
+	}
+	values.swap(scratch);
+}
+
+} // anonymous namespace
+
+
+void TransformHierarchy::clear() {
+	parents.clear();
+	depths.clear();
+	locals.clear();
+	worlds.clear();
+	dirty.clear();
+	recomputed.clear();
+	slots.clear();
+	ids.clear();
+	depthStart.assign(1, 0);
+	sorted = true;
+	firstDirtyDepth = UINT32_MAX;
+}
+
+
+TransformId TransformHierarchy::add(TransformId parent, const glm::mat4x4& local) {
+	assert(parent == InvalidTransform || parent < slots.size());
+	uint32_t slot = static_cast<uint32_t>(parents.size());
+	uint32_t depth = parent == InvalidTransform ? 0 : depths[slots[parent]] + 1;
+	TransformId id = static_cast<TransformId>(slots.size());
+
+	parents.push_back(parent == InvalidTransform ? NoParent : slots[parent]);
+	depths.push_back(depth);
+	locals.push_back(local);
+	worlds.push_back(local);
+	dirty.push_back(1);
+	recomputed.push_back(0);
+	slots.push_back(slot);
+	ids.push_back(id);
+	firstDirtyDepth = std::min(firstDirtyDepth, depth);
+
+	// Nodes added depth after depth stay sorted, the others wait for update()
+	if (sorted && depth + 1 == depthCount()) {
+		++depthStart.back();
+	}
+	else if (sorted && depth == depthCount()) {
+		depthStart.push_back(slot + 1);
+	}
+	else {
+		sorted = false;
+	}
+	return id;
+}
+
+
+void TransformHierarchy::truncate(size_t count) {
+	if (count >= ids.size()) {
+		return;
+	}
+	// Children come after their parents, so the nodes kept never lose theirs
+	std::vector<uint32_t> newSlots(parents.size(), NoParent);
+	uint32_t kept = 0;
+	for (size_t slot = 0; slot < parents.size(); ++slot) {
+		if (ids[slot] < count) {
+			newSlots[slot] = kept++;
+		}
+	}
+	for (size_t slot = 0; slot < parents.size(); ++slot) {
+		if (newSlots[slot] != NoParent && parents[slot] != NoParent) {
+			parents[slot] = newSlots[parents[slot]];
+		}
+	}
+	compact(parents, newSlots, kept);
+	compact(depths, newSlots, kept);
+	compact(locals, newSlots, kept);
+	compact(worlds, newSlots, kept);
+	compact(dirty, newSlots, kept);
+	compact(recomputed, newSlots, kept);
+	compact(ids, newSlots, kept);
+	slots.resize(count);
+	for (uint32_t slot = 0; slot < kept; ++slot) {
+		slots[ids[slot]] = slot;
+	}
+	firstDirtyDepth = UINT32_MAX;
+	for (uint32_t slot = 0; slot < kept; ++slot) {
+		if (dirty[slot]) {
+			firstDirtyDepth = std::min(firstDirtyDepth, depths[slot]);
+		}
+	}
+
+	if (sorted) {
+		depthStart.assign(1, 0);
+		for (uint32_t depth : depths) {
+			if (depth + 1 == depthStart.size()) {
+				depthStart.push_back(0);
+			}
+			++depthStart.back();
+		}
+		for (size_t depth = 1; depth < depthStart.size(); ++depth) {
+			depthStart[depth] += depthStart[depth - 1];
+		}
+	}
+}
+
+
+void TransformHierarchy::setLocal(TransformId id, const glm::mat4x4& local) {
+	uint32_t slot = slots[id];
+	locals[slot] = local;
+	dirty[slot] = 1;
+	firstDirtyDepth = std::min(firstDirtyDepth, depths[slot]);
+}
+
+
+void TransformHierarchy::sortByDepth() {
+	// Counting sort, stable so that the nodes of a depth keep their order
+	uint32_t maxDepth = *std::max_element(depths.begin(), depths.end());
+	depthStart.assign(maxDepth + 2, 0);
+	for (uint32_t depth : depths) {
+		++depthStart[depth + 1];
+	}
+	for (size_t depth = 1; depth < depthStart.size(); ++depth) {
+		depthStart[depth] += depthStart[depth - 1];
+	}
+	std::vector<uint32_t> newSlots(parents.size());
+	std::vector<uint32_t> next(depthStart.begin(), depthStart.end() - 1);
+	for (size_t slot = 0; slot < parents.size(); ++slot) {
+		newSlots[slot] = next[depths[slot]]++;
+	}
+
+	for (uint32_t& parent : parents) {
+		if (parent != NoParent) {
+			parent = newSlots[parent];
+		}
+	}
+	std::vector<uint32_t> scratch32;
+	std::vector<glm::mat4x4> scratchMatrices;
+	std::vector<uint8_t> scratch8;
+	permute(parents, newSlots, scratch32);
+	permute(depths, newSlots, scratch32);
+	permute(ids, newSlots, scratch32);
+	permute(locals, newSlots, scratchMatrices);
+	permute(worlds, newSlots, scratchMatrices);
+	permute(dirty, newSlots, scratch8);
+	permute(recomputed, newSlots, scratch8);
+	for (uint32_t slot = 0; slot < ids.size(); ++slot) {
+		slots[ids[slot]] = slot;
+	}
+	sorted = true;
+}
+
+
+size_t TransformHierarchy::update(ThreadPool& pool) {
+	if (!sorted) {
+		sortByDepth();
+	}
+	// Nothing above the first dirty depth moved, only forget what the last
+	// update recomputed there
+	uint32_t firstDepth = std::min(firstDirtyDepth, depthCount());
+	std::fill(recomputed.begin(), recomputed.begin() + depthStart[firstDepth], uint8_t(0));
+
+	size_t total = 0;
+	std::vector<size_t> chunkCounts;
+	for (uint32_t depth = firstDepth; depth < depthCount(); ++depth) {
+		size_t first = depthStart[depth];
+		size_t end = depthStart[depth + 1];
+		size_t chunkCount = (end - first + ChunkSize - 1) / ChunkSize;
+		chunkCounts.assign(chunkCount, 0);
+
+		auto updateChunk = [&](size_t chunk) {
+			size_t chunkFirst = first + chunk * ChunkSize;
+			size_t chunkEnd = std::min(chunkFirst + ChunkSize, end);
+			size_t count = 0;
+			for (size_t slot = chunkFirst; slot < chunkEnd; ++slot) {
+				uint32_t parent = parents[slot];
+				uint8_t changed = dirty[slot] | (depth > 0 ? recomputed[parent] : uint8_t(0));
+				recomputed[slot] = changed;
+				dirty[slot] = 0;
+				if (changed) {
+					worlds[slot] = depth > 0 ? worlds[parent] * locals[slot] : locals[slot];
+					++count;
+				}
+			}
+			chunkCounts[chunk] = count;
+		};
+		if (chunkCount == 1) {
+			updateChunk(0);
+		}
+		else {
+			// Every node of the depth only reads the one above, so that the
+			// chunks are independent
+			pool.parallelFor(chunkCount, updateChunk);
+		}
+		for (size_t count : chunkCounts) {
+			total += count;
+		}
+	}
+	firstDirtyDepth = UINT32_MAX;
+	return total;
+}
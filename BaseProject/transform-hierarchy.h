@@ -0,0 +1,88 @@
+#pragma once
+
+#include "thread-pool.h"
+
+#include <glm/glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Hierarchy of transforms, stored as structure of arrays sorted by depth
+ * rather than as a tree of nodes, so that an update is a few linear passes.
+ *
+ *     TransformId model = transforms.add(InvalidTransform, rotation);
+ *     TransformId mesh = transforms.add(model, translation * scale);
+ *     transforms.setLocal(model, newRotation);    // mesh is dirty too
+ *     transforms.update();
+ *     uniforms.modelMatrix = transforms.world(mesh);
+ *
+ * Every node comes after its parent, as all the nodes of a depth come
+ * after those of the depth above. update() then walks the depths in order:
+ * a node is recomputed when its local transform was set or its parent was
+ * recomputed, so clean subtrees cost a flag test per node and no matrix
+ * product, and the depths above the first dirty node are skipped. The
+ * nodes of a depth do not depend on each other and are split in chunks
+ * among the threads of the pool.
+ *
+ * Nodes are appended at the end and sorted into place by the next update(),
+ * so TransformId values stay valid while the storage moves.
+ */
+
+using TransformId = uint32_t;
+constexpr TransformId InvalidTransform = UINT32_MAX;
+
+class TransformHierarchy {
+public:
+	// Forget every node
+	void clear();
+
+	// Add a node under parent (InvalidTransform for a root), which must have
+	// been added before. Ids count up from 0 in the order of the calls.
+	TransformId add(TransformId parent, const glm::mat4x4& local);
+
+	// Forget the nodes added after the first count, and with them their ids
+	void truncate(size_t count);
+
+	// Set the transform of a node relative to its parent, its world transform
+	// and those below it follow at the next update()
+	void setLocal(TransformId id, const glm::mat4x4& local);
+	const glm::mat4x4& local(TransformId id) const { return locals[slots[id]]; }
+
+	// Transform of a node relative to the roots, as of the last update()
+	const glm::mat4x4& world(TransformId id) const { return worlds[slots[id]]; }
+
+	// Whether the last update() recomputed the world transform of a node
+	bool changed(TransformId id) const { return recomputed[slots[id]] != 0; }
+
+	// Recompute the world transforms of the dirty nodes and their subtrees.
+	// Returns how many were recomputed.
+	size_t update(ThreadPool& pool = ThreadPool::shared());
+
+	size_t nodeCount() const { return parents.size(); }
+	uint32_t depthCount() const { return static_cast<uint32_t>(depthStart.size()) - 1; }
+
+	// Nodes of a depth are recomputed by chunks of this many
+	static constexpr size_t ChunkSize = 2048;
+
+private:
+	// Move the nodes appended since the last update to the end of their depth
+	void sortByDepth();
+
+	// Per node, in storage order. parents holds storage slots.
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> depths;
+	std::vector<glm::mat4x4> locals;
+	std::vector<glm::mat4x4> worlds;
+	std::vector<uint8_t> dirty;
+	std::vector<uint8_t> recomputed;
+	// Storage slot of every id, and id of every slot
+	std::vector<uint32_t> slots;
+	std::vector<TransformId> ids;
+	// First slot of every depth, and one past the last node
+	std::vector<uint32_t> depthStart = { 0 };
+	bool sorted = true;
+	// Shallowest depth with a dirty node, the update starts there
+	uint32_t firstDirtyDepth = UINT32_MAX;
+};
@@ -0,0 +1,69 @@
+#include "uniform-ring.h"
+
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+
+using namespace wgpu;
+
+namespace {
+
+uint64_t alignUp(uint64_t value, uint64_t alignment) {
+	return (value + alignment - 1) / alignment * alignment;
+}
+
+} // anonymous namespace
+
+
+UniformRing::UniformRing(GpuBackend& backend, uint32_t alignment, uint64_t frameCapacity, uint32_t frameCount)
+	: backend(backend)
+	, blockAlignment(std::max(alignment, 4u))
+	, frameCount(std::max(frameCount, 1u))
+{
+	frameIndex = this->frameCount - 1;
+	frameData.resize(alignUp(std::max<uint64_t>(frameCapacity, 1), blockAlignment));
+
+	BufferDescriptor bufferDesc;
+	bufferDesc.label = "Uniform Ring";
+	bufferDesc.size = frameData.size() * this->frameCount;
+	bufferDesc.usage = BufferUsage::CopyDst | BufferUsage::Uniform;
+	bufferDesc.mappedAtCreation = false;
+	ringBuffer = backend.createBuffer(bufferDesc);
+}
+
+
+UniformRing::~UniformRing() {
+	backend.destroyBuffer(ringBuffer);
+}
+
+
+void UniformRing::beginFrame() {
+	frameIndex = (frameIndex + 1) % frameCount;
+	used = 0;
+}
+
+
+uint32_t UniformRing::push(const void* data, size_t size) {
+	uint64_t frameBase = static_cast<uint64_t>(frameIndex) * frameData.size();
+	uint64_t offset = alignUp(used, blockAlignment);
+	if (offset + size > frameData.size()) {
+		if (!overflowReported) {
+			std::cout << "*** ERROR *** Uniform ring is full (" << frameData.size()
+				<< " bytes per frame), extra blocks overwrite the first one" << std::endl;
+			overflowReported = true;
+		}
+		offset = 0;
+	}
+	std::memcpy(frameData.data() + offset, data, size);
+	used = std::max(used, offset + size);
+	return static_cast<uint32_t>(frameBase + offset);
+}
+
+
+void UniformRing::flush() {
+	if (used == 0) {
+		return;
+	}
+	uint64_t frameBase = static_cast<uint64_t>(frameIndex) * frameData.size();
+	backend.writeBuffer(ringBuffer, frameBase, frameData.data(), alignUp(used, 4));
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include "gpu-backend.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/**
+ * Per-frame allocator of uniform blocks, bound with a dynamic offset.
+ *
+ * The GPU buffer is split into frameCount regions used in turn, so the blocks
+ * of a frame never overwrite those that the previous frames may still be
+ * reading. Within a frame, blocks are packed contiguously (each one aligned
+ * to minUniformBufferOffsetAlignment) in a host copy of the region, which
+ * flush() uploads with a single writeBuffer.
+ *
+ *     ring.beginFrame();
+ *     uint32_t offset = ring.push(uniforms);  // once per object
+ *     ring.flush();
+ *     renderPass.setBindGroup(0, bindGroup, 1, &offset);
+ */
+class UniformRing {
+public:
+	UniformRing(GpuBackend& backend, uint32_t alignment,
+				uint64_t frameCapacity, uint32_t frameCount = 3);
+	~UniformRing();
+
+	UniformRing(const UniformRing&) = delete;
+	UniformRing& operator=(const UniformRing&) = delete;
+
+	// Move on to the next region and start packing from its beginning
+	void beginFrame();
+
+	// Copy a block into the current frame, return its dynamic offset
+	uint32_t push(const void* data, size_t size);
+
+	template <typename T>
+	uint32_t push(const T& block) {
+		return push(&block, sizeof(T));
+	}
+
+	// Upload the blocks pushed since beginFrame()
+	void flush();
+
+	wgpu::Buffer buffer() const { return ringBuffer; }
+	uint32_t alignment() const { return blockAlignment; }
+	uint32_t currentFrame() const { return frameIndex; }
+	uint64_t usedBytes() const { return used; }
+
+private:
+	GpuBackend& backend;
+	wgpu::Buffer ringBuffer = nullptr;
+	std::vector<uint8_t> frameData;
+	uint32_t blockAlignment;
+	uint32_t frameCount;
+	uint32_t frameIndex = 0;
+	uint64_t used = 0;
+	bool overflowReported = false;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+
+// Uniform block shared by all the vertices of an object, laid out like
+// MyUniforms in the shader
+struct MyUniforms {
+	glm::mat4x4 projectionMatrix;
+	glm::mat4x4 viewMatrix;
+	glm::mat4x4 modelMatrix;
+	std::array<float, 4> color;
+	// Decode of compact vertex positions, see PositionDecode. w is unused.
+	glm::vec4 positionOffset;
+	glm::vec4 positionScale;
+	float time;
+	float _pad[3];
+};
@@ -30,6 +30,10 @@
 #  include <emscripten.h>
 #endif // __EMSCRIPTEN__
 
+#ifdef WEBGPU_BACKEND_WGPU
+#  include <webgpu/wgpu.h>
+#endif // WEBGPU_BACKEND_WGPU
+
 #include <iostream>
 #include <vector>
 #include <cassert>
@@ -216,4 +220,21 @@ void inspectDevice(WGPUDevice device) {
 		std::cout << " - maxComputeWorkgroupSizeZ: " << limits.limits.maxComputeWorkgroupSizeZ << std::endl;
 		std::cout << " - maxComputeWorkgroupsPerDimension: " << limits.limits.maxComputeWorkgroupsPerDimension << std::endl;
 	}
-}
\ No newline at end of file
+}
+
+void pollDevice(WGPUDevice device, bool wait) {
+#if defined(WEBGPU_BACKEND_DAWN)
+	(void)wait;
+	wgpuDeviceTick(device);
+#elif defined(WEBGPU_BACKEND_WGPU)
+	wgpuDevicePoll(device, wait, nullptr);
+#elif defined(__EMSCRIPTEN__)
+	(void)device;
+	if (wait) {
+		emscripten_sleep(1);
+	}
+#else
+	(void)device;
+	(void)wait;
+#endif
+}
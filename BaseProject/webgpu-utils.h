@@ -54,4 +54,12 @@ void inspectAdapter(WGPUAdapter adapter);
 /**
  * Display information about a device
  */
-void inspectDevice(WGPUDevice device);
\ No newline at end of file
+void inspectDevice(WGPUDevice device);
+
+/**
+ * Let the device process finished work and run pending callbacks (buffer
+ * mapping for instance). With wait, block until the submitted work is done
+ * where the backend supports it (wgpu-native); otherwise this returns right
+ * away, so code waiting for a callback should call it in a loop.
+ */
+void pollDevice(WGPUDevice device, bool wait);
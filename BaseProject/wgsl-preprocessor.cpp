@@ -0,0 +1,239 @@
+#include "wgsl-preprocessor.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+#include <set>
+#include <cctype>
+
+namespace {
+
+bool isIdentifierStart(char c) {
+	return std::isalpha(static_cast<unsigned char>(c)) || c == '_';
+}
+
+bool isIdentifierChar(char c) {
+	return std::isalnum(static_cast<unsigned char>(c)) || c == '_';
+}
+
+
+// Split "#name argument" into its parts. Returns false for the lines that
+// are not directives.
+bool parseDirective(const std::string& line, std::string& name, std::string& argument) {
+	size_t start = line.find_first_not_of(" \t");
+	if (start == std::string::npos || line[start] != '#') {
+		return false;
+	}
+	size_t nameEnd = std::min(line.find_first_of(" \t\r", start), line.size());
+	name = line.substr(start + 1, nameEnd - start - 1);
+	size_t argumentStart = line.find_first_not_of(" \t", nameEnd);
+	size_t argumentEnd = line.find_last_not_of(" \t\r");
+	argument = argumentStart == std::string::npos || argumentEnd < argumentStart
+		? std::string() : line.substr(argumentStart, argumentEnd - argumentStart + 1);
+	return true;
+}
+
+
+// File name between the quotes of an #include
+bool parseIncludeName(const std::string& argument, std::string& name) {
+	if (argument.size() < 3 || argument.front() != '"' || argument.back() != '"') {
+		return false;
+	}
+	name = argument.substr(1, argument.size() - 2);
+	return true;
+}
+
+
+bool readShaderFile(const fs::path& directory, const std::string& name, ShaderSources& sources) {
+	if (sources.files.count(name) > 0) {
+		return true;
+	}
+	std::ifstream file(directory / name);
+	if (!file.is_open()) {
+		std::cout << "*** ERROR *** Invalid path: " << directory / name << std::endl;
+		return false;
+	}
+	std::stringstream text;
+	text << file.rdbuf();
+	std::string& source = sources.files[name] = text.str();
+
+	std::istringstream lines(source);
+	std::string line;
+	std::string directive;
+	std::string argument;
+	std::string includeName;
+	while (std::getline(lines, line)) {
+		if (parseDirective(line, directive, argument) && directive == "include"
+			&& parseIncludeName(argument, includeName) && !readShaderFile(directory, includeName, sources)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+
+class Preprocessor {
+public:
+	Preprocessor(const ShaderSources& sources, const ShaderDefines& initialDefines, std::string& out, std::string& error)
+		: sources(sources)
+		, out(out)
+		, error(error)
+		, defines(initialDefines.begin(), initialDefines.end())
+	{}
+
+	// Append a file to the output, the files it includes in place
+	bool expand(const std::string& name);
+
+private:
+	// Append an active line, with the values of the defines in place of
+	// their names
+	void substitute(const std::string& line);
+
+	const ShaderSources& sources;
+	std::string& out;
+	std::string& error;
+	std::map<std::string, std::string> defines;
+	std::set<std::string> included;
+	std::vector<std::string> includeStack;
+};
+
+
+bool Preprocessor::expand(const std::string& name) {
+	auto file = sources.files.find(name);
+	if (file == sources.files.end()) {
+		error = "missing source \"" + name + "\"";
+		return false;
+	}
+	included.insert(name);
+	includeStack.push_back(name);
+
+	struct Conditional {
+		bool enclosingActive;
+		bool condition;
+		bool inElse;
+	};
+	std::vector<Conditional> conditionals;
+	bool active = true;
+
+	std::istringstream lines(file->second);
+	std::string line;
+	std::string directive;
+	std::string argument;
+	for (uint32_t lineNumber = 1; std::getline(lines, line); ++lineNumber) {
+		if (!parseDirective(line, directive, argument)) {
+			if (active) {
+				substitute(line);
+			}
+			continue;
+		}
+
+		auto fail = [&](const std::string& reason) {
+			error = name + ":" + std::to_string(lineNumber) + ": " + reason;
+			return false;
+		};
+		if (directive == "ifdef" || directive == "ifndef") {
+			bool defined = defines.count(argument) > 0;
+			conditionals.push_back({ active, defined == (directive == "ifdef"), false });
+			active = active && conditionals.back().condition;
+		}
+		else if (directive == "else") {
+			if (conditionals.empty() || conditionals.back().inElse) {
+				return fail("#else without #ifdef");
+			}
+			conditionals.back().inElse = true;
+			active = conditionals.back().enclosingActive && !conditionals.back().condition;
+		}
+		else if (directive == "endif") {
+			if (conditionals.empty()) {
+				return fail("#endif without #ifdef");
+			}
+			active = conditionals.back().enclosingActive;
+			conditionals.pop_back();
+		}
+		else if (!active) {
+			continue;
+		}
+		else if (directive == "define") {
+			size_t nameEnd = std::min(argument.find_first_of(" \t"), argument.size());
+			std::string defineName = argument.substr(0, nameEnd);
+			if (defineName.empty() || !isIdentifierStart(defineName[0])) {
+				return fail("expected #define NAME [value]");
+			}
+			size_t valueStart = argument.find_first_not_of(" \t", nameEnd);
+			defines[defineName] = valueStart == std::string::npos ? std::string() : argument.substr(valueStart);
+		}
+		else if (directive == "undef") {
+			defines.erase(argument);
+		}
+		else if (directive == "include") {
+			std::string includeName;
+			if (!parseIncludeName(argument, includeName)) {
+				return fail("expected #include \"file\"");
+			}
+			if (std::find(includeStack.begin(), includeStack.end(), includeName) != includeStack.end()) {
+				return fail("recursive #include \"" + includeName + "\"");
+			}
+			if (included.count(includeName) > 0) {
+				continue;
+			}
+			if (sources.files.count(includeName) == 0) {
+				return fail("missing #include \"" + includeName + "\"");
+			}
+			if (!expand(includeName)) {
+				return false;
+			}
+		}
+		else {
+			return fail("unknown directive #" + directive);
+		}
+	}
+	if (!conditionals.empty()) {
+		error = name + ": #ifdef without #endif";
+		return false;
+	}
+	includeStack.pop_back();
+	return true;
+}
+
+
+void Preprocessor::substitute(const std::string& line) {
+	size_t i = 0;
+	while (i < line.size()) {
+		if (!isIdentifierChar(line[i])) {
+			out += line[i++];
+			continue;
+		}
+		// Whole words only, numbers such as 2u included
+		size_t end = i;
+		while (end < line.size() && isIdentifierChar(line[end])) {
+			++end;
+		}
+		auto define = isIdentifierStart(line[i]) ? defines.find(line.substr(i, end - i)) : defines.end();
+		if (define != defines.end() && !define->second.empty()) {
+			out += define->second;
+		}
+		else {
+			out.append(line, i, end - i);
+		}
+		i = end;
+	}
+	out += '\n';
+}
+
+} // anonymous namespace
+
+
+bool loadShaderSources(const fs::path& path, ShaderSources& sources) {
+	sources.mainName = path.filename().string();
+	sources.files.clear();
+	return readShaderFile(path.parent_path(), sources.mainName, sources);
+}
+
+
+bool preprocessWgsl(const ShaderSources& sources, const ShaderDefines& defines, std::string& out, std::string& error) {
+	out.clear();
+	error.clear();
+	Preprocessor preprocessor(sources, defines, out, error);
+	return preprocessor.expand(sources.mainName);
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <filesystem>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+/**
+ * Preprocessor run over WGSL sources before they are compiled, so that
+ * variants of a shader share their code rather than being copies of it.
+ *
+ *     #include "common.wgsl"   // relative to the main file, once per output
+ *     #define NAME value       // NAME is replaced by value in the lines below
+ *     #undef NAME
+ *     #ifdef NAME / #ifndef NAME / #else / #endif
+ *
+ * Directives take a line of their own. Defines without a value only serve
+ * #ifdef. Sources are read once, with every file they may include, and
+ * preprocessed from memory for each set of defines.
+ */
+
+// The main file and the files it includes, by include name
+struct ShaderSources {
+	std::string mainName;
+	std::map<std::string, std::string> files;
+};
+
+using ShaderDefines = std::vector<std::pair<std::string, std::string>>;
+
+// Read a shader and, recursively, every file named by an #include, whether
+// or not the conditionals around it keep it
+bool loadShaderSources(const fs::path& path, ShaderSources& sources);
+
+// Expand the main file with the given defines. Returns false with the file,
+// line and reason in error if an include is missing or recursive, or the
+// conditionals do not balance.
+bool preprocessWgsl(const ShaderSources& sources, const ShaderDefines& defines, std::string& out, std::string& error);